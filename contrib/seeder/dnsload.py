@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+#
+# dnsload.py:  Flood a bitcoin-seeder DNS server with queries and report the
+# throughput and reply latency.
+#
+# Copyright (c) 2018 The Bitcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#
+
+import argparse
+import multiprocessing
+import random
+import select
+import socket
+import struct
+import time
+
+TYPES = {'A': 1, 'NS': 2, 'SOA': 6, 'AAAA': 28, 'ANY': 255}
+
+
+def build_query(qid, name, qtype):
+    header = struct.pack('>HHHHHH', qid, 0x0100, 1, 0, 0, 0)
+    question = b''.join(
+        struct.pack('B', len(label)) + label.encode('ascii')
+        for label in name.split('.') if label)
+    return header + question + b'\x00' + struct.pack('>HH', qtype, 1)
+
+
+def worker(args, result):
+    """Keep args.window queries outstanding for args.duration seconds."""
+    sock = socket.socket(socket.AF_INET6 if ':' in args.host
+                         else socket.AF_INET, socket.SOCK_DGRAM)
+    sock.connect((args.host, args.port))
+    sock.setblocking(False)
+    qtype = TYPES[args.type]
+
+    pending = {}
+    latencies = []
+    sent = lost = 0
+    qid = random.randrange(0x10000)
+    end = time.perf_counter() + args.duration
+    while True:
+        now = time.perf_counter()
+        if now >= end:
+            break
+        while len(pending) < args.window:
+            qid = (qid + 1) & 0xFFFF
+            if qid in pending:
+                break
+            sock.send(build_query(qid, args.name, qtype))
+            pending[qid] = time.perf_counter()
+            sent += 1
+        if not select.select([sock], [], [], 0.1)[0]:
+            now = time.perf_counter()
+            expired = [q for q, t in pending.items()
+                       if now - t > args.timeout]
+            for q in expired:
+                del pending[q]
+            lost += len(expired)
+            continue
+        while True:
+            try:
+                reply = sock.recv(512)
+            except BlockingIOError:
+                break
+            now = time.perf_counter()
+            if len(reply) < 12:
+                continue
+            start = pending.pop(struct.unpack('>H', reply[:2])[0], None)
+            if start is not None:
+                latencies.append(now - start)
+    result.put((sent, lost, latencies))
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    return values[min(len(values) - 1, int(len(values) * p / 100.0))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--host', default='127.0.0.1',
+                        help='address of the DNS server (default: %(default)s)')
+    parser.add_argument('--port', type=int, default=53,
+                        help='port of the DNS server (default: %(default)s)')
+    parser.add_argument('--name', default='seed.example.com',
+                        help='hostname to query, as passed to the seeder '
+                        'with -h (default: %(default)s)')
+    parser.add_argument('--type', default='A', choices=sorted(TYPES),
+                        help='query type (default: %(default)s)')
+    parser.add_argument('--workers', type=int,
+                        default=multiprocessing.cpu_count(),
+                        help='number of client processes (default: number '
+                        'of CPUs)')
+    parser.add_argument('--window', type=int, default=32,
+                        help='queries kept in flight per client (default: '
+                        '%(default)s)')
+    parser.add_argument('--duration', type=float, default=10.0,
+                        help='seconds to run for (default: %(default)s)')
+    parser.add_argument('--timeout', type=float, default=1.0,
+                        help='seconds after which a query is counted as '
+                        'lost (default: %(default)s)')
+    args = parser.parse_args()
+
+    result = multiprocessing.Queue()
+    procs = [multiprocessing.Process(target=worker, args=(args, result))
+             for _ in range(args.workers)]
+    for p in procs:
+        p.start()
+    sent = lost = 0
+    latencies = []
+    for _ in procs:
+        s, l, lat = result.get()
+        sent += s
+        lost += l
+        latencies.extend(lat)
+    for p in procs:
+        p.join()
+
+    latencies.sort()
+    print('%d queries sent, %d answered, %d timed out' %
+          (sent, len(latencies), lost))
+    print('%.0f queries/s' % (len(latencies) / args.duration))
+    print('latency (ms): p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f' %
+          tuple(1000 * percentile(latencies, p)
+                for p in (50, 90, 99, 99.9, 100)))
+
+
+if __name__ == '__main__':
+    main()
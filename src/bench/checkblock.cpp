@@ -32,6 +32,21 @@ static void DeserializeBlockTest(benchmark::State &state) {
     }
 }
 
+static void DeserializeBlockInArenaTest(benchmark::State &state) {
+    CDataStream stream((const char *)block_bench::block413567,
+                       (const char *)&block_bench::block413567[sizeof(
+                           block_bench::block413567)],
+                       SER_NETWORK, PROTOCOL_VERSION);
+    char a;
+    stream.write(&a, 1); // Prevent compaction
+
+    while (state.KeepRunning()) {
+        CBlock block;
+        UnserializeBlockInArena(stream, block);
+        assert(stream.Rewind(sizeof(block_bench::block413567)));
+    }
+}
+
 static void DeserializeAndCheckBlockTest(benchmark::State &state) {
     CDataStream stream((const char *)block_bench::block413567,
                        (const char *)&block_bench::block413567[sizeof(
@@ -53,5 +68,26 @@ static void DeserializeAndCheckBlockTest(benchmark::State &state) {
     }
 }
 
+static void DeserializeInArenaAndCheckBlockTest(benchmark::State &state) {
+    CDataStream stream((const char *)block_bench::block413567,
+                       (const char *)&block_bench::block413567[sizeof(
+                           block_bench::block413567)],
+                       SER_NETWORK, PROTOCOL_VERSION);
+    char a;
+    stream.write(&a, 1); // Prevent compaction
+
+    const Config &config = GetConfig();
+    while (state.KeepRunning()) {
+        CBlock block;
+        UnserializeBlockInArena(stream, block);
+        assert(stream.Rewind(sizeof(block_bench::block413567)));
+
+        CValidationState validationState;
+        assert(CheckBlock(config, block, validationState));
+    }
+}
+
 BENCHMARK(DeserializeBlockTest);
+BENCHMARK(DeserializeBlockInArenaTest);
 BENCHMARK(DeserializeAndCheckBlockTest);
+BENCHMARK(DeserializeInArenaAndCheckBlockTest);
@@ -4,6 +4,7 @@
 
 #include "bench.h"
 #include "chainparams.h"
+#include "random.h"
 #include "wallet/wallet.h"
 
 #include <set>
@@ -61,4 +62,48 @@ static void CoinSelection(benchmark::State &state) {
     }
 }
 
+// Selection from wallets holding many coins of assorted values, none of which
+// is large enough to pay for the target alone. The coins are only built once,
+// so that the selection itself is what gets measured.
+static void CoinSelectionManyCoins(benchmark::State &state, int nCoins) {
+    const CWallet wallet(Params());
+    std::vector<COutput> vCoins;
+    LOCK(wallet.cs_wallet);
+
+    FastRandomContext insecure_rand(true);
+    for (int i = 0; i < nCoins; i++) {
+        addCoin(Amount(int64_t(insecure_rand.randrange(COIN.GetSatoshis())) +
+                       1000),
+                wallet, vCoins);
+    }
+
+    while (state.KeepRunning()) {
+        std::set<std::pair<const CWalletTx *, unsigned int>> setCoinsRet;
+        Amount nValueRet;
+        bool success = wallet.SelectCoinsMinConf(
+            10 * COIN + Amount(1), 1, 6, 0, vCoins, setCoinsRet, nValueRet);
+        assert(success);
+        assert(nValueRet > 10 * COIN);
+    }
+
+    for (COutput output : vCoins) {
+        delete output.tx;
+    }
+}
+
+static void CoinSelection1kCoins(benchmark::State &state) {
+    CoinSelectionManyCoins(state, 1000);
+}
+
+static void CoinSelection10kCoins(benchmark::State &state) {
+    CoinSelectionManyCoins(state, 10000);
+}
+
+static void CoinSelection100kCoins(benchmark::State &state) {
+    CoinSelectionManyCoins(state, 100000);
+}
+
 BENCHMARK(CoinSelection);
+BENCHMARK(CoinSelection1kCoins);
+BENCHMARK(CoinSelection10kCoins);
+BENCHMARK(CoinSelection100kCoins);
@@ -0,0 +1,90 @@
+// Copyright (c) 2018 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "key.h"
+#include "primitives/transaction.h"
+#include "pubkey.h"
+#include "random.h"
+#include "script/sigcache.h"
+
+#include <boost/thread/thread.hpp>
+
+#include <mutex>
+#include <vector>
+
+// Each thread looks up already cached signatures, which is what the script
+// check threads mostly do while connecting a block whose transactions were in
+// the mempool. The lookups being cheap, contention on the cache shows up as
+// the time per iteration growing with the number of threads.
+static const size_t SIGNATURES = 256;
+static const size_t LOOKUPS_PER_THREAD = 4000;
+
+struct CachedSignature {
+    uint256 hash;
+    CPubKey pubkey;
+    std::vector<uint8_t> vchSig;
+};
+
+static void SigCacheLookups(benchmark::State &state, int nThreads) {
+    static std::once_flag initSignatureCacheFlag;
+    std::call_once(initSignatureCacheFlag, InitSignatureCache);
+    ECCVerifyHandle verifyHandle;
+
+    CMutableTransaction mtx;
+    CTransaction tx(mtx);
+    PrecomputedTransactionData txdata(tx);
+    CachingTransactionSignatureChecker checker(&tx, 0, Amount(0), true,
+                                               txdata);
+
+    FastRandomContext insecure_rand(true);
+    std::vector<CachedSignature> signatures(SIGNATURES);
+    for (CachedSignature &signature : signatures) {
+        CKey key;
+        key.MakeNewKey(true);
+        signature.hash = insecure_rand.rand256();
+        signature.pubkey = key.GetPubKey();
+        key.Sign(signature.hash, signature.vchSig);
+        // Verify once to add the signature to the cache.
+        checker.VerifySignature(signature.vchSig, signature.pubkey,
+                                signature.hash);
+    }
+
+    while (state.KeepRunning()) {
+        boost::thread_group threads;
+        for (int i = 0; i < nThreads; i++) {
+            threads.create_thread([&signatures, &checker, i] {
+                for (size_t j = 0; j < LOOKUPS_PER_THREAD; j++) {
+                    const CachedSignature &signature =
+                        signatures[(i + j) % signatures.size()];
+                    checker.VerifySignature(signature.vchSig, signature.pubkey,
+                                            signature.hash);
+                }
+            });
+        }
+        threads.join_all();
+    }
+}
+
+static void SigCacheLookups1Thread(benchmark::State &state) {
+    SigCacheLookups(state, 1);
+}
+
+static void SigCacheLookups2Threads(benchmark::State &state) {
+    SigCacheLookups(state, 2);
+}
+
+static void SigCacheLookups4Threads(benchmark::State &state) {
+    SigCacheLookups(state, 4);
+}
+
+static void SigCacheLookups8Threads(benchmark::State &state) {
+    SigCacheLookups(state, 8);
+}
+
+BENCHMARK(SigCacheLookups1Thread);
+BENCHMARK(SigCacheLookups2Threads);
+BENCHMARK(SigCacheLookups4Threads);
+BENCHMARK(SigCacheLookups8Threads);
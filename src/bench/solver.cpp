@@ -0,0 +1,86 @@
+// Copyright (c) 2018 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "primitives/block.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "version.h"
+
+#include <cassert>
+#include <vector>
+
+namespace block_bench {
+#include "bench/data/block413567.raw.h"
+}
+
+/**
+ * The scripts a mainnet block makes the node classify: the scriptPubKeys of
+ * its outputs, mostly P2PKH and P2SH with some data carriers, and the redeem
+ * scripts of its P2SH spends, mostly multisig.
+ */
+static std::vector<CScript> GetBlockScripts() {
+    CDataStream stream((const char *)block_bench::block413567,
+                       (const char *)&block_bench::block413567[sizeof(
+                           block_bench::block413567)],
+                       SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+
+    std::vector<CScript> scripts;
+    for (const auto &tx : block.vtx) {
+        for (const CTxOut &txout : tx->vout) {
+            scripts.push_back(txout.scriptPubKey);
+        }
+
+        if (tx->IsCoinBase()) {
+            continue;
+        }
+
+        for (const CTxIn &txin : tx->vin) {
+            CScript::const_iterator pc = txin.scriptSig.begin();
+            opcodetype opcode;
+            std::vector<uint8_t> data, last;
+            while (txin.scriptSig.GetOp(pc, opcode, data)) {
+                last.swap(data);
+            }
+
+            CScript redeemScript(last.begin(), last.end());
+            if (!last.empty() && redeemScript.back() == OP_CHECKMULTISIG) {
+                scripts.push_back(redeemScript);
+            }
+        }
+    }
+
+    return scripts;
+}
+
+static void SolverBlockScripts(benchmark::State &state) {
+    const std::vector<CScript> scripts = GetBlockScripts();
+    assert(!scripts.empty());
+
+    txnouttype type;
+    std::vector<std::vector<uint8_t>> vSolutions;
+    while (state.KeepRunning()) {
+        for (const CScript &script : scripts) {
+            Solver(script, type, vSolutions);
+        }
+    }
+}
+
+static void SolveScriptBlockScripts(benchmark::State &state) {
+    const std::vector<CScript> scripts = GetBlockScripts();
+    assert(!scripts.empty());
+
+    CScriptSolution solution;
+    while (state.KeepRunning()) {
+        for (const CScript &script : scripts) {
+            SolveScript(script, solution);
+        }
+    }
+}
+
+BENCHMARK(SolverBlockScripts);
+BENCHMARK(SolveScriptBlockScripts);
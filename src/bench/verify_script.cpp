@@ -0,0 +1,110 @@
+// Copyright (c) 2018 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "hash.h"
+#include "primitives/block.h"
+#include "pubkey.h"
+#include "script/interpreter.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "version.h"
+
+#include <vector>
+
+namespace block_bench {
+#include "bench/data/block413567.raw.h"
+}
+
+// Block 413567 predates SIGHASH_FORKID, so the signatures commit to neither
+// the amount nor the flags below.
+static const uint32_t BENCH_FLAGS =
+    SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC | SCRIPT_VERIFY_DERSIG;
+
+struct ScriptToVerify {
+    CTransactionRef tx;
+    unsigned int nIn;
+    CScript scriptPubKey;
+};
+
+/**
+ * The spent outputs are not available, so rebuild them from the inputs of the
+ * block: P2PKH from the public key in the scriptSig, P2SH from the redeem
+ * script. Only the inputs for which this produces a valid spend are kept.
+ */
+static std::vector<ScriptToVerify> GetBlockScripts() {
+    CDataStream stream((const char *)block_bench::block413567,
+                       (const char *)&block_bench::block413567[sizeof(
+                           block_bench::block413567)],
+                       SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+
+    std::vector<ScriptToVerify> scripts;
+    for (const auto &tx : block.vtx) {
+        if (tx->IsCoinBase()) {
+            continue;
+        }
+
+        for (unsigned int i = 0; i < tx->vin.size(); i++) {
+            const CScript &scriptSig = tx->vin[i].scriptSig;
+            std::vector<std::vector<uint8_t>> pushes;
+            CScript::const_iterator pc = scriptSig.begin();
+            opcodetype opcode;
+            std::vector<uint8_t> data;
+            while (scriptSig.GetOp(pc, opcode, data)) {
+                pushes.push_back(data);
+            }
+            if (pushes.empty()) {
+                continue;
+            }
+
+            const std::vector<uint8_t> &last = pushes.back();
+            for (const CScript &scriptPubKey :
+                 {GetScriptForDestination(CKeyID(Hash160(last))),
+                  GetScriptForDestination(CScriptID(CScript(last.begin(),
+                                                            last.end())))}) {
+                TransactionSignatureChecker checker(tx.get(), i, Amount(0));
+                if (VerifyScriptGeneric(scriptSig, scriptPubKey, BENCH_FLAGS,
+                                        checker)) {
+                    scripts.push_back({tx, i, scriptPubKey});
+                    break;
+                }
+            }
+        }
+    }
+
+    return scripts;
+}
+
+static void VerifyScriptBench(benchmark::State &state, bool fFastPath) {
+    ECCVerifyHandle verifyHandle;
+    const std::vector<ScriptToVerify> scripts = GetBlockScripts();
+    assert(!scripts.empty());
+
+    while (state.KeepRunning()) {
+        for (const ScriptToVerify &s : scripts) {
+            TransactionSignatureChecker checker(s.tx.get(), s.nIn, Amount(0));
+            const CScript &scriptSig = s.tx->vin[s.nIn].scriptSig;
+            bool ret = fFastPath
+                           ? VerifyScript(scriptSig, s.scriptPubKey,
+                                          BENCH_FLAGS, checker)
+                           : VerifyScriptGeneric(scriptSig, s.scriptPubKey,
+                                                 BENCH_FLAGS, checker);
+            assert(ret);
+        }
+    }
+}
+
+static void VerifyBlockScriptsGeneric(benchmark::State &state) {
+    VerifyScriptBench(state, false);
+}
+
+static void VerifyBlockScriptsFastPath(benchmark::State &state) {
+    VerifyScriptBench(state, true);
+}
+
+BENCHMARK(VerifyBlockScriptsGeneric);
+BENCHMARK(VerifyBlockScriptsFastPath);
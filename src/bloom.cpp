@@ -160,10 +160,10 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction &tx) {
                     insert(COutPoint(txid, i));
                 } else if ((nFlags & BLOOM_UPDATE_MASK) ==
                            BLOOM_UPDATE_P2PUBKEY_ONLY) {
-                    txnouttype type;
-                    std::vector<std::vector<uint8_t>> vSolutions;
-                    if (Solver(txout.scriptPubKey, type, vSolutions) &&
-                        (type == TX_PUBKEY || type == TX_MULTISIG)) {
+                    CScriptSolution solution;
+                    if (SolveScript(txout.scriptPubKey, solution) &&
+                        (solution.type == TX_PUBKEY ||
+                         solution.type == TX_MULTISIG)) {
                         insert(COutPoint(txid, i));
                     }
                 }
@@ -455,6 +455,21 @@ public:
         }
         return false;
     }
+
+    /**
+     * for_each_element calls f on every element stored in the cache which has
+     * not been marked as discardable, e.g. to persist the cache. Not threadsafe
+     * with any concurrent operation.
+     *
+     * @param f callable taking a const Element &
+     */
+    template <typename F> void for_each_element(F f) const {
+        for (uint32_t i = 0; i < size; ++i) {
+            if (!collection_flags.bit_is_set(i)) {
+                f(table[i]);
+            }
+        }
+    }
 };
 } // namespace CuckooCache
 
@@ -10,6 +10,8 @@
 #include "crypto/hmac_sha256.h"
 #include "httpserver.h"
 #include "random.h"
+#include "rpc/jsonwriter.h"
+#include "rpc/metrics.h"
 #include "rpc/protocol.h"
 #include "rpc/server.h"
 #include "sync.h"
@@ -79,6 +81,59 @@ static void JSONErrorReply(HTTPRequest *req, const UniValue &objError,
     req->WriteReply(nStatus, strReply);
 }
 
+/**
+ * Send the reply to a single JSON-RPC request, in the same format as
+ * JSONRPCReply. Replies that fit in one JSONWriter chunk are sent in one go;
+ * larger ones are sent with chunked transfer encoding as they are written,
+ * so the full reply is never held in memory.
+ */
+static void JSONStreamReply(HTTPRequest *req,
+                            const RPCResultWriter &writeResult,
+                            const UniValue &id) {
+    bool fStarted = false;
+    JSONWriter writer([req, &fStarted](const std::string &chunk) {
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->StartReply(HTTP_OK);
+            fStarted = true;
+        }
+        if (!req->WriteReplyChunk(chunk)) {
+            throw std::runtime_error("connection closed");
+        }
+    });
+
+    try {
+        writer.BeginObject();
+        writer.Key("result");
+        writeResult(writer);
+        writer.Key("error");
+        writer.Value(NullUniValue);
+        writer.Key("id");
+        writer.Value(id);
+        writer.EndObject();
+        writer.Raw("\n");
+        if (fStarted) {
+            writer.Flush();
+        }
+    } catch (...) {
+        if (!fStarted) {
+            // Nothing sent yet, so the error can still be reported properly.
+            throw;
+        }
+        // Too late for an error reply, the client will see truncated JSON.
+        LogPrintf("%s: reply aborted halfway\n", __func__);
+        req->EndReply();
+        return;
+    }
+
+    if (fStarted) {
+        req->EndReply();
+    } else {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, writer.GetBuffer());
+    }
+}
+
 // This function checks username and password against -rpcauth entries from
 // config file.
 static bool multiUserAuthorized(std::string strUserPass) {
@@ -273,20 +328,11 @@ static bool checkCORS(HTTPRequest *req) {
     return false;
 }
 
-static bool HTTPReq_JSONRPC(Config &config, HTTPRequest *req,
-                            const std::string &) {
-    // First, check and/or set CORS headers
-    if (checkCORS(req)) {
-        return true;
-    }
-
-    // JSONRPC handles only POST
-    if (req->GetRequestMethod() != HTTPRequest::POST) {
-        req->WriteReply(HTTP_BAD_METHOD,
-                        "JSONRPC server handles only POST requests");
-        return false;
-    }
-    // Check authorization
+/**
+ * Check the credentials of req and reply with 401 Unauthorized if they are
+ * missing or wrong.
+ */
+static bool HTTPAuthorized(HTTPRequest *req, std::string &strAuthUser) {
     std::pair<bool, std::string> authHeader = req->GetHeader("authorization");
     if (!authHeader.first) {
         req->WriteHeader("WWW-Authenticate", WWW_AUTH_HEADER_DATA);
@@ -294,8 +340,7 @@ static bool HTTPReq_JSONRPC(Config &config, HTTPRequest *req,
         return false;
     }
 
-    JSONRPCRequest jreq;
-    if (!RPCAuthorized(authHeader.second, jreq.authUser)) {
+    if (!RPCAuthorized(authHeader.second, strAuthUser)) {
         LogPrintf("ThreadRPCServer incorrect password attempt from %s\n",
                   req->GetPeer().ToString());
 
@@ -308,6 +353,27 @@ static bool HTTPReq_JSONRPC(Config &config, HTTPRequest *req,
         req->WriteReply(HTTP_UNAUTHORIZED);
         return false;
     }
+    return true;
+}
+
+static bool HTTPReq_JSONRPC(Config &config, HTTPRequest *req,
+                            const std::string &) {
+    // First, check and/or set CORS headers
+    if (checkCORS(req)) {
+        return true;
+    }
+
+    // JSONRPC handles only POST
+    if (req->GetRequestMethod() != HTTPRequest::POST) {
+        req->WriteReply(HTTP_BAD_METHOD,
+                        "JSONRPC server handles only POST requests");
+        return false;
+    }
+    // Check authorization
+    JSONRPCRequest jreq;
+    if (!HTTPAuthorized(req, jreq.authUser)) {
+        return false;
+    }
 
     try {
         // Parse request
@@ -318,24 +384,30 @@ static bool HTTPReq_JSONRPC(Config &config, HTTPRequest *req,
         // Set the URI
         jreq.URI = req->GetURI();
 
-        std::string strReply;
         // singleton request
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            RPCResultWriter writeResult;
+            jreq.resultWriter = &writeResult;
             UniValue result = tableRPC.execute(config, jreq);
+            if (!writeResult) {
+                writeResult = [&result](JSONWriter &writer) {
+                    writer.Value(result);
+                };
+            }
 
             // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            JSONStreamReply(req, writeResult, jreq.id);
         } else if (valRequest.isArray()) {
             // array of requests
-            strReply = JSONRPCExecBatch(config, jreq, valRequest.get_array());
+            std::string strReply = JSONRPCExecBatch(
+                config, jreq, valRequest.get_array(), EnqueueHTTPWork);
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReply(HTTP_OK, strReply);
         } else {
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
         }
-
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strReply);
     } catch (const UniValue &objError) {
         JSONErrorReply(req, objError, jreq.id);
         return false;
@@ -346,6 +418,23 @@ static bool HTTPReq_JSONRPC(Config &config, HTTPRequest *req,
     return true;
 }
 
+/** Plain-text RPC and work queue statistics for monitoring systems */
+static bool HTTPReq_Metrics(Config &config, HTTPRequest *req,
+                            const std::string &) {
+    if (req->GetRequestMethod() != HTTPRequest::GET) {
+        req->WriteReply(HTTP_BAD_METHOD, "Metrics are served on GET only");
+        return false;
+    }
+    std::string strAuthUser;
+    if (!HTTPAuthorized(req, strAuthUser)) {
+        return false;
+    }
+
+    req->WriteHeader("Content-Type", "text/plain; version=0.0.4");
+    req->WriteReply(HTTP_OK, FormatMetricsText());
+    return true;
+}
+
 static bool InitRPCAuthentication() {
     if (gArgs.GetArg("-rpcpassword", "") == "") {
         LogPrintf("No rpcpassword set - using random cookie authentication\n");
@@ -375,6 +464,7 @@ bool StartHTTPRPC() {
     if (!InitRPCAuthentication()) return false;
 
     RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/metrics", true, HTTPReq_Metrics);
 #ifdef ENABLE_WALLET
     // ifdef can be removed once we switch to better endpoint support and API
     // versioning
@@ -393,6 +483,7 @@ void InterruptHTTPRPC() {
 void StopHTTPRPC() {
     LogPrint(BCLog::RPC, "Stopping HTTP RPC server\n");
     UnregisterHTTPHandler("/", true);
+    UnregisterHTTPHandler("/metrics", true);
     if (httpRPCTimerInterface) {
         RPCUnsetTimerInterface(httpRPCTimerInterface);
         delete httpRPCTimerInterface;
@@ -32,10 +32,16 @@
 #endif
 #endif
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <future>
+#include <memory>
+#include <mutex>
 
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
@@ -63,6 +69,17 @@ private:
     Config *config;
 };
 
+/** Work item running an arbitrary task on a worker thread */
+class HTTPTask final : public HTTPClosure {
+public:
+    HTTPTask(const std::function<void()> &_task) : task(_task) {}
+
+    void operator()() override { task(); }
+
+private:
+    std::function<void()> task;
+};
+
 /**
  * Simple work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
@@ -70,12 +87,23 @@ private:
 template <typename WorkItem> class WorkQueue {
 private:
     /** Mutex protects entire object */
+    typedef std::chrono::steady_clock Clock;
+
     std::mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    /** Queued items along with the time they were enqueued */
+    std::deque<std::pair<std::unique_ptr<WorkItem>, Clock::time_point>> queue;
     bool running;
     size_t maxDepth;
     int numThreads;
+    /** Number of threads currently running an item */
+    int numBusy;
+    size_t peakDepth;
+    uint64_t numEnqueued;
+    uint64_t numRejected;
+    uint64_t numWaited;
+    int64_t waitMicros;
+    int64_t maxWaitMicros;
 
     /** RAII object to keep track of number of running worker threads */
     class ThreadCounter {
@@ -94,7 +122,9 @@ private:
 
 public:
     WorkQueue(size_t _maxDepth)
-        : running(true), maxDepth(_maxDepth), numThreads(0) {}
+        : running(true), maxDepth(_maxDepth), numThreads(0), numBusy(0),
+          peakDepth(0), numEnqueued(0), numRejected(0), numWaited(0),
+          waitMicros(0), maxWaitMicros(0) {}
     /** Precondition: worker threads have all stopped
      * (call WaitExit)
      */
@@ -103,9 +133,12 @@ public:
     bool Enqueue(WorkItem *item) {
         std::unique_lock<std::mutex> lock(cs);
         if (queue.size() >= maxDepth) {
+            numRejected++;
             return false;
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        queue.emplace_back(std::unique_ptr<WorkItem>(item), Clock::now());
+        numEnqueued++;
+        peakDepth = std::max(peakDepth, queue.size());
         cond.notify_one();
         return true;
     }
@@ -119,10 +152,20 @@ public:
                 while (running && queue.empty())
                     cond.wait(lock);
                 if (!running) break;
-                i = std::move(queue.front());
+                i = std::move(queue.front().first);
+                const int64_t waited =
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        Clock::now() - queue.front().second)
+                        .count();
+                numWaited++;
+                waitMicros += waited;
+                maxWaitMicros = std::max(maxWaitMicros, waited);
                 queue.pop_front();
+                numBusy++;
             }
             (*i)();
+            std::unique_lock<std::mutex> lock(cs);
+            numBusy--;
         }
     }
     /** Interrupt and exit loops */
@@ -143,6 +186,22 @@ public:
         std::unique_lock<std::mutex> lock(cs);
         return queue.size();
     }
+
+    HTTPWorkQueueStats GetStats() {
+        std::unique_lock<std::mutex> lock(cs);
+        HTTPWorkQueueStats stats;
+        stats.nDepth = queue.size();
+        stats.nMaxDepth = maxDepth;
+        stats.nPeakDepth = peakDepth;
+        stats.nThreads = numThreads;
+        stats.nBusy = numBusy;
+        stats.nEnqueued = numEnqueued;
+        stats.nRejected = numRejected;
+        stats.nWaitCount = numWaited;
+        stats.nWaitMicros = waitMicros;
+        stats.nMaxWaitMicros = maxWaitMicros;
+        return stats;
+    }
 };
 
 struct HTTPPathHandler {
@@ -489,6 +548,7 @@ void StopHTTPServer() {
         LogPrint(BCLog::HTTP, "Waiting for HTTP worker threads to exit\n");
         workQueue->WaitExit();
         delete workQueue;
+        workQueue = 0;
     }
     if (eventBase) {
         LogPrint(BCLog::HTTP, "Waiting for HTTP event thread to exit\n");
@@ -523,6 +583,25 @@ struct event_base *EventBase() {
     return eventBase;
 }
 
+bool EnqueueHTTPWork(const std::function<void()> &task) {
+    if (!workQueue) {
+        return false;
+    }
+    std::unique_ptr<HTTPTask> item(new HTTPTask(task));
+    if (!workQueue->Enqueue(item.get())) {
+        return false;
+    }
+    item.release();
+    return true;
+}
+
+HTTPWorkQueueStats GetHTTPWorkQueueStats() {
+    if (!workQueue) {
+        return HTTPWorkQueueStats();
+    }
+    return workQueue->GetStats();
+}
+
 static void httpevent_callback_fn(evutil_socket_t, short, void *data) {
     // Static handler: simply call inner handler
     HTTPEvent *self = ((HTTPEvent *)data);
@@ -551,7 +630,11 @@ void HTTPEvent::trigger(struct timeval *tv) {
 HTTPRequest::HTTPRequest(struct evhttp_request *_req)
     : req(_req), replySent(false) {}
 HTTPRequest::~HTTPRequest() {
-    if (!replySent) {
+    if (stream) {
+        // Chunked reply was abandoned halfway, finish what was sent
+        LogPrintf("%s: Unfinished reply\n", __func__);
+        EndReply();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -601,7 +684,7 @@ void HTTPRequest::WriteHeader(const std::string &hdr,
  * done from worker threads.
  */
 void HTTPRequest::WriteReply(int nStatus, const std::string &strReply) {
-    assert(!replySent && req);
+    assert(!replySent && !stream && req);
     // Send event to main http thread to send reply message
     struct evbuffer *evb = evhttp_request_get_output_buffer(req);
     assert(evb);
@@ -616,6 +699,133 @@ void HTTPRequest::WriteReply(int nStatus, const std::string &strReply) {
     req = 0;
 }
 
+/**
+ * Chunked reply in progress. Shared between the worker producing the reply
+ * and the events that hand its chunks to libevent in the main http thread.
+ */
+struct HTTPReplyStream {
+    std::mutex cs;
+    std::condition_variable cond;
+    /** Bytes passed to WriteReplyChunk so far */
+    size_t nQueued;
+    /** Bytes known to have been written to the connection */
+    size_t nSent;
+    /** Bytes handed to libevent so far (main http thread only) */
+    size_t nHanded;
+    /** Whether the connection was closed before the reply was finished */
+    bool fClosed;
+
+    HTTPReplyStream() : nQueued(0), nSent(0), nHanded(0), fClosed(false) {}
+};
+
+/** Called by libevent once everything handed to it has been written out */
+static void http_reply_stream_sent_cb(struct evhttp_connection *, void *arg) {
+    HTTPReplyStream *stream = static_cast<HTTPReplyStream *>(arg);
+    std::lock_guard<std::mutex> lock(stream->cs);
+    stream->nSent = stream->nHanded;
+    stream->cond.notify_all();
+}
+
+/** Called by libevent when the connection of an unfinished reply closes */
+static void http_reply_stream_closed_cb(struct evhttp_connection *,
+                                        void *arg) {
+    HTTPReplyStream *stream = static_cast<HTTPReplyStream *>(arg);
+    std::lock_guard<std::mutex> lock(stream->cs);
+    stream->fClosed = true;
+    stream->cond.notify_all();
+}
+
+void HTTPRequest::StartReply(int nStatus) {
+    assert(!replySent && !stream && req);
+    stream = std::make_shared<HTTPReplyStream>();
+    struct evhttp_request *_req = req;
+    std::shared_ptr<HTTPReplyStream> _stream = stream;
+    HTTPEvent *ev = new HTTPEvent(eventBase, true, [_req, _stream, nStatus]() {
+        evhttp_send_reply_start(_req, nStatus, nullptr);
+        evhttp_connection *evcon = evhttp_request_get_connection(_req);
+        if (evcon) {
+            evhttp_connection_set_closecb(evcon, http_reply_stream_closed_cb,
+                                          _stream.get());
+        }
+    });
+    ev->trigger(0);
+}
+
+bool HTTPRequest::WriteReplyChunk(const std::string &strChunk) {
+    assert(!replySent && stream && req);
+    {
+        std::unique_lock<std::mutex> lock(stream->cs);
+        while (!stream->fClosed &&
+               stream->nQueued - stream->nSent >= MAX_REPLY_BACKLOG) {
+            stream->cond.wait(lock);
+        }
+        if (stream->fClosed) {
+            return false;
+        }
+        stream->nQueued += strChunk.size();
+    }
+
+    struct evbuffer *evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    struct evhttp_request *_req = req;
+    std::shared_ptr<HTTPReplyStream> _stream = stream;
+    HTTPEvent *ev = new HTTPEvent(eventBase, true, [_req, _stream, evb]() {
+        _stream->nHanded += evbuffer_get_length(evb);
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+        evhttp_send_reply_chunk_with_cb(_req, evb, http_reply_stream_sent_cb,
+                                        _stream.get());
+#else
+        // No completion callback: consider the chunk sent once libevent has
+        // it, which leaves the backlog to the connection's output buffer.
+        evhttp_send_reply_chunk(_req, evb);
+        http_reply_stream_sent_cb(nullptr, _stream.get());
+#endif
+        evbuffer_free(evb);
+    });
+    ev->trigger(0);
+    return true;
+}
+
+void HTTPRequest::EndReply() {
+    assert(!replySent && stream && req);
+    struct evhttp_request *_req = req;
+    std::shared_ptr<HTTPReplyStream> _stream = stream;
+    HTTPEvent *ev = new HTTPEvent(eventBase, true, [_req, _stream]() {
+        // The connection may outlive this reply, so stop it from calling
+        // back into the stream state when it closes.
+        evhttp_connection *evcon = evhttp_request_get_connection(_req);
+        if (evcon) {
+            evhttp_connection_set_closecb(evcon, nullptr, nullptr);
+        }
+        evhttp_send_reply_end(_req);
+    });
+    ev->trigger(0);
+    replySent = true;
+    stream.reset();
+    // transferred back to main thread.
+    req = 0;
+}
+
+void HTTPRequest::AbortReply() {
+    assert(!replySent && stream && req);
+    struct evhttp_request *_req = req;
+    HTTPEvent *ev = new HTTPEvent(eventBase, true, [_req]() {
+        evhttp_connection *evcon = evhttp_request_get_connection(_req);
+        if (evcon) {
+            evhttp_connection_set_closecb(evcon, nullptr, nullptr);
+            // Also frees the request
+            evhttp_connection_free(evcon);
+        } else {
+            evhttp_send_reply_end(_req);
+        }
+    });
+    ev->trigger(0);
+    replySent = true;
+    stream.reset();
+    req = 0;
+}
+
 CService HTTPRequest::GetPeer() {
     evhttp_connection *con = evhttp_request_get_connection(req);
     CService peer;
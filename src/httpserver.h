@@ -7,11 +7,14 @@
 
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
 
 static const int DEFAULT_HTTP_THREADS = 4;
 static const int DEFAULT_HTTP_WORKQUEUE = 16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT = 30;
+/** Bytes of a chunked reply that may be waiting to be sent before blocking */
+static const size_t MAX_REPLY_BACKLOG = 4 * 1024 * 1024;
 
 struct evhttp_request;
 struct event_base;
@@ -19,6 +22,7 @@ struct event_base;
 class Config;
 class CService;
 class HTTPRequest;
+struct HTTPReplyStream;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -52,6 +56,39 @@ void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
  */
 struct event_base *EventBase();
 
+/** Run task on one of the HTTP worker threads.
+ * Returns false, without running it, if the work queue is full.
+ */
+bool EnqueueHTTPWork(const std::function<void()> &task);
+
+/** Statistics of the HTTP work queue since the server was initialized */
+struct HTTPWorkQueueStats {
+    size_t nDepth;
+    size_t nMaxDepth;
+    /** Highest depth reached */
+    size_t nPeakDepth;
+    int nThreads;
+    /** Worker threads busy handling an item */
+    int nBusy;
+    uint64_t nEnqueued;
+    /** Items turned away because the queue was full */
+    uint64_t nRejected;
+    /** Items picked up by a worker */
+    uint64_t nWaitCount;
+    /** Total and longest time items spent in the queue before a worker
+     * picked them up */
+    int64_t nWaitMicros;
+    int64_t nMaxWaitMicros;
+
+    HTTPWorkQueueStats()
+        : nDepth(0), nMaxDepth(0), nPeakDepth(0), nThreads(0), nBusy(0),
+          nEnqueued(0), nRejected(0), nWaitCount(0), nWaitMicros(0),
+          nMaxWaitMicros(0) {}
+};
+
+/** Current HTTP work queue statistics, all zero when the server is down */
+HTTPWorkQueueStats GetHTTPWorkQueueStats();
+
 /** In-flight HTTP request.
  * Thin C++ wrapper around evhttp_request.
  */
@@ -59,6 +96,8 @@ class HTTPRequest {
 private:
     struct evhttp_request *req;
     bool replySent;
+    /** State of a chunked reply, if one was started */
+    std::shared_ptr<HTTPReplyStream> stream;
 
 public:
     HTTPRequest(struct evhttp_request *req);
@@ -110,6 +149,37 @@ public:
      * this.
      */
     void WriteReply(int nStatus, const std::string &strReply = "");
+
+    /**
+     * Start a chunked HTTP reply, for bodies that are produced piece by
+     * piece. The body is sent with WriteReplyChunk and finished by EndReply.
+     *
+     * @note Call this instead of WriteReply, after any WriteHeader calls.
+     */
+    void StartReply(int nStatus);
+
+    /**
+     * Send the next part of a reply started with StartReply. Blocks while
+     * more than MAX_REPLY_BACKLOG bytes of the reply are waiting to be
+     * written to the client.
+     *
+     * @returns false if the connection to the client was closed, in which
+     * case producing the rest of the body is pointless.
+     */
+    bool WriteReplyChunk(const std::string &strChunk);
+
+    /**
+     * Finish a reply started with StartReply. Like WriteReply, this gives
+     * the request back to the main thread.
+     */
+    void EndReply();
+
+    /**
+     * Give up on a reply started with StartReply by closing the connection,
+     * so the client cannot mistake the truncated body for a complete one.
+     * Like EndReply, this gives the request back to the main thread.
+     */
+    void AbortReply();
 };
 
 /** Event handler closure.
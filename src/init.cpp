@@ -208,6 +208,10 @@ void Shutdown() {
     if (fDumpMempoolLater &&
         gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         DumpMempool();
+        // Signatures and scripts of the mempool transactions were verified
+        // already, so save the caches along with them.
+        DumpSignatureCache();
+        DumpScriptExecutionCache();
     }
 
     if (fFeeEstimatesInitialized) {
@@ -267,6 +271,7 @@ void Shutdown() {
     globalVerifyHandle.reset();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
+    GetLogger().Flush();
 }
 
 /**
@@ -405,8 +410,10 @@ std::string HelpMessage(HelpMessageMode mode) {
     }
     strUsage +=
         HelpMessageOpt("-persistmempool",
-                       strprintf(_("Whether to save the mempool on shutdown "
-                                   "and load on restart (default: %u)"),
+                       strprintf(_("Whether to save the mempool, along with the "
+                                   "signature and script execution caches, on "
+                                   "shutdown and load on restart (default: "
+                                   "%u)"),
                                  DEFAULT_PERSIST_MEMPOOL));
     strUsage += HelpMessageOpt(
         "-blockreconstructionextratxn=<n>",
@@ -619,6 +626,9 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage +=
         HelpMessageOpt("-zmqpubrawtx=<address>",
                        _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt(
+        "-zmqpubsequence=<address>",
+        _("Enable publish hash block and tx sequence in <address>"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -726,6 +736,17 @@ std::string HelpMessage(HelpMessageMode mode) {
         "-logtimestamps",
         strprintf(_("Prepend debug output with timestamp (default: %d)"),
                   DEFAULT_LOGTIMESTAMPS));
+    strUsage += HelpMessageOpt(
+        "-logratelimit=<n>",
+        strprintf(_("Log at most <n> debug messages per second of each "
+                    "category, 0 for no limit (default: %u)"),
+                  DEFAULT_LOGRATELIMIT));
+    strUsage += HelpMessageOpt(
+        "-logsync",
+        strprintf(_("Write debug messages to disk as they are logged rather "
+                    "than from a background thread, so that none are lost if "
+                    "the node crashes (default: %d)"),
+                  DEFAULT_LOGSYNC));
     if (showDebug) {
         strUsage += HelpMessageOpt(
             "-logtimemicros",
@@ -889,6 +910,12 @@ std::string HelpMessage(HelpMessageMode mode) {
         strprintf(
             _("Set the number of threads to service RPC calls (default: %d)"),
             DEFAULT_HTTP_THREADS));
+    strUsage += HelpMessageOpt(
+        "-rpcbatchconcurrency=<n>",
+        strprintf(_("Set the number of requests of a JSON-RPC batch that may "
+                    "run at the same time, using the RPC threads (default: "
+                    "%d, 1 runs batches sequentially)"),
+                  DEFAULT_RPC_BATCH_CONCURRENCY));
     strUsage += HelpMessageOpt(
         "-rpccorsdomain=value",
         "Domain from which to accept cross origin requests (browser enforced)");
@@ -1234,6 +1261,9 @@ void InitLogging() {
         gArgs.GetBoolArg("-logtimestamps", DEFAULT_LOGTIMESTAMPS);
     logger.fLogTimeMicros =
         gArgs.GetBoolArg("-logtimemicros", DEFAULT_LOGTIMEMICROS);
+    logger.nMaxCategoryRate = std::max<int64_t>(
+        0, gArgs.GetArg("-logratelimit", DEFAULT_LOGRATELIMIT));
+    logger.fWriteSynchronously = gArgs.GetBoolArg("-logsync", DEFAULT_LOGSYNC);
 
     fLogIPs = gArgs.GetBoolArg("-logips", DEFAULT_LOGIPS);
 
@@ -1765,6 +1795,10 @@ bool AppInitMain(Config &config, boost::thread_group &threadGroup,
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    if (gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        LoadSignatureCache();
+        LoadScriptExecutionCache();
+    }
 
     LogPrintf("Using %u threads for script verification\n",
               nScriptCheckThreads);
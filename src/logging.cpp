@@ -8,6 +8,8 @@
 #include "util.h"
 #include "utiltime.h"
 
+#include <cstdlib>
+
 bool fLogIPs = DEFAULT_LOGIPS;
 
 /**
@@ -22,9 +24,19 @@ bool fLogIPs = DEFAULT_LOGIPS;
  *
  * This method of initialization was originally introduced in
  * ee3374234c60aba2cc4c5cd5cac1c0aefc2d817c.
+ *
+ * As the destructor never runs, what is still queued for the writer thread
+ * is flushed by an exit handler instead.
  */
+static void FlushLoggerAtExit() {
+    GetLogger().Flush();
+}
+
 BCLog::Logger &GetLogger() {
-    static BCLog::Logger *const logger = new BCLog::Logger();
+    static BCLog::Logger *const logger = [] {
+        std::atexit(FlushLoggerAtExit);
+        return new BCLog::Logger();
+    }();
     return *logger;
 }
 
@@ -39,16 +51,74 @@ void BCLog::Logger::OpenDebugLog() {
     fs::path pathDebug = GetDataDir() / "debug.log";
     fileout = fsbridge::fopen(pathDebug, "a");
     if (fileout) {
-        // Unbuffered.
+        // Unbuffered, lines are written in batches by the writer thread or
+        // one at a time by the logging threads themselves.
         setbuf(fileout, nullptr);
         // Dump buffered messages from before we opened the log.
         while (!vMsgsBeforeOpenLog.empty()) {
             FileWriteStr(vMsgsBeforeOpenLog.front(), fileout);
             vMsgsBeforeOpenLog.pop_front();
         }
+
+        if (!fWriteSynchronously) {
+            writerThread = std::thread([this] {
+                RenameThread("bitcoin-logger");
+                WriterThread();
+            });
+        }
+    }
+}
+
+void BCLog::Logger::ReopenIfRequested() {
+    if (fReopenDebugLog.exchange(false)) {
+        fs::path pathDebug = GetDataDir() / "debug.log";
+        if (fsbridge::freopen(pathDebug, "a", fileout) != nullptr) {
+            // unbuffered.
+            setbuf(fileout, nullptr);
+        }
+    }
+}
+
+void BCLog::Logger::WriterThread() {
+    std::vector<LogEntry> vBatch;
+    std::string strBatch;
+
+    std::unique_lock<std::mutex> lock(mutexDebugLog);
+    while (true) {
+        condPending.wait(lock,
+                         [this] { return !vPending.empty() || fStopWriter; });
+        if (vPending.empty()) {
+            break;
+        }
+
+        vBatch.swap(vPending);
+        nPendingBytes = 0;
+        fWriting = true;
+        lock.unlock();
+        condWritten.notify_all();
+
+        strBatch.clear();
+        for (const LogEntry &entry : vBatch) {
+            AppendTimestamped(strBatch, entry.nTimeMicros, entry.str);
+        }
+        vBatch.clear();
+
+        ReopenIfRequested();
+        FileWriteStr(strBatch, fileout);
+
+        lock.lock();
+        fWriting = false;
+        condWritten.notify_all();
     }
 }
 
+void BCLog::Logger::Flush() {
+    std::unique_lock<std::mutex> lock(mutexDebugLog);
+    condWritten.wait(lock, [this] {
+        return (vPending.empty() && !fWriting) || !writerThread.joinable();
+    });
+}
+
 struct CLogCategoryDesc {
     BCLog::LogFlags flag;
     std::string category;
@@ -95,6 +165,15 @@ bool GetLogCategory(BCLog::LogFlags &flag, const std::string &str) {
     return false;
 }
 
+static const char *GetLogCategoryName(BCLog::LogFlags flag) {
+    for (const CLogCategoryDesc &category_desc : LogCategories) {
+        if (category_desc.flag == flag) {
+            return category_desc.category.c_str();
+        }
+    }
+    return "unknown";
+}
+
 std::string ListLogCategories() {
     std::string ret;
     int outcount = 0;
@@ -111,66 +190,136 @@ std::string ListLogCategories() {
 }
 
 BCLog::Logger::~Logger() {
+    if (writerThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> scoped_lock(mutexDebugLog);
+            fStopWriter = true;
+        }
+        condPending.notify_one();
+        writerThread.join();
+    }
     if (fileout) {
         fclose(fileout);
     }
 }
 
-std::string BCLog::Logger::LogTimestampStr(const std::string &str) {
-    std::string strStamped;
+void BCLog::Logger::AppendTimestamped(std::string &strOut,
+                                      int64_t nTimeMicros,
+                                      const std::string &str) {
+    if (fLogTimestamps && fStartedNewLine) {
+        // Lines come in bursts, only format the date once per second.
+        const int64_t nSecond = nTimeMicros / 1000000;
+        if (nSecond != nTimestampSecond) {
+            nTimestampSecond = nSecond;
+            strTimestampSecond =
+                DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nSecond);
+        }
+        strOut += strTimestampSecond;
+        if (fLogTimeMicros) {
+            strOut += strprintf(".%06d", nTimeMicros % 1000000);
+        }
+        strOut += ' ';
+    }
+    strOut += str;
+
+    fStartedNewLine = !str.empty() && str[str.size() - 1] == '\n';
+}
+
+bool BCLog::Logger::IsRateLimited(LogFlags category, int64_t nTimeMicros,
+                                  std::string &strSuppressed) {
+    if (nMaxCategoryRate == 0 || category == NONE) {
+        return false;
+    }
 
-    if (!fLogTimestamps) return str;
+    unsigned int nBit = 0;
+    while (!(category & (uint32_t(1) << nBit))) {
+        nBit++;
+    }
 
-    if (fStartedNewLine) {
-        int64_t nTimeMicros = GetLogTimeMicros();
-        strStamped =
-            DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nTimeMicros / 1000000);
-        if (fLogTimeMicros)
-            strStamped += strprintf(".%06d", nTimeMicros % 1000000);
-        strStamped += ' ' + str;
-    } else
-        strStamped = str;
+    CategoryRate &rate = categoryRates[nBit];
+    const int64_t nSecond = nTimeMicros / 1000000;
+    if (nSecond != rate.nSecond) {
+        if (rate.nSuppressed) {
+            strSuppressed = strprintf(
+                "Suppressed %u %s messages over -logratelimit=%u\n",
+                rate.nSuppressed, GetLogCategoryName(category),
+                nMaxCategoryRate);
+        }
+        rate.nSecond = nSecond;
+        rate.nCount = 0;
+        rate.nSuppressed = 0;
+    }
 
-    if (!str.empty() && str[str.size() - 1] == '\n')
-        fStartedNewLine = true;
-    else
-        fStartedNewLine = false;
+    if (rate.nCount >= nMaxCategoryRate) {
+        rate.nSuppressed++;
+        return true;
+    }
 
-    return strStamped;
+    rate.nCount++;
+    return false;
 }
 
-int BCLog::Logger::LogPrintStr(const std::string &str) {
-    // Returns total number of characters written.
-    int ret = 0;
+int BCLog::Logger::LogPrintStr(const std::string &str, LogFlags category) {
+    // Returns total number of characters written or queued.
+    const int64_t nTimeMicros = GetLogTimeMicros();
 
-    std::string strTimestamped = LogTimestampStr(str);
+    std::unique_lock<std::mutex> lock(mutexDebugLog);
+    std::string strSuppressed;
+    if (IsRateLimited(category, nTimeMicros, strSuppressed)) {
+        return 0;
+    }
 
     if (fPrintToConsole) {
         // Print to console.
-        ret = fwrite(strTimestamped.data(), 1, strTimestamped.size(), stdout);
+        std::string strTimestamped;
+        if (!strSuppressed.empty()) {
+            AppendTimestamped(strTimestamped, nTimeMicros, strSuppressed);
+        }
+        AppendTimestamped(strTimestamped, nTimeMicros, str);
+        int ret = fwrite(strTimestamped.data(), 1, strTimestamped.size(),
+                         stdout);
         fflush(stdout);
-    } else if (fPrintToDebugLog) {
-        std::lock_guard<std::mutex> scoped_lock(mutexDebugLog);
+        return ret;
+    }
 
-        // Buffer if we haven't opened the log yet.
+    if (!fPrintToDebugLog) {
+        return 0;
+    }
+
+    if (!writerThread.joinable()) {
+        std::string strTimestamped;
+        if (!strSuppressed.empty()) {
+            AppendTimestamped(strTimestamped, nTimeMicros, strSuppressed);
+        }
+        AppendTimestamped(strTimestamped, nTimeMicros, str);
         if (fileout == nullptr) {
-            ret = strTimestamped.length();
+            // Buffer if we haven't opened the log yet.
             vMsgsBeforeOpenLog.push_back(strTimestamped);
         } else {
-            // Reopen the log file, if requested.
-            if (fReopenDebugLog) {
-                fReopenDebugLog = false;
-                fs::path pathDebug = GetDataDir() / "debug.log";
-                if (fsbridge::freopen(pathDebug, "a", fileout) != nullptr) {
-                    // unbuffered.
-                    setbuf(fileout, nullptr);
-                }
-            }
-
-            ret = FileWriteStr(strTimestamped, fileout);
+            // -logsync
+            ReopenIfRequested();
+            FileWriteStr(strTimestamped, fileout);
         }
+        return strTimestamped.length();
     }
-    return ret;
+
+    // Let the writer catch up if it falls too far behind, rather than growing
+    // the backlog without bound.
+    condWritten.wait(lock, [this] { return nPendingBytes < nMaxBacklog; });
+
+    const bool fWasEmpty = vPending.empty();
+    if (!strSuppressed.empty()) {
+        nPendingBytes += strSuppressed.size();
+        vPending.push_back(LogEntry{nTimeMicros, std::move(strSuppressed)});
+    }
+    nPendingBytes += str.size();
+    vPending.push_back(LogEntry{nTimeMicros, str});
+    lock.unlock();
+
+    if (fWasEmpty) {
+        condPending.notify_one();
+    }
+    return str.size();
 }
 
 void BCLog::Logger::ShrinkDebugFile() {
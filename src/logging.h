@@ -8,14 +8,24 @@
 #define BITCOIN_LOGGING_H
 
 #include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <list>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 static const bool DEFAULT_LOGTIMEMICROS = false;
 static const bool DEFAULT_LOGIPS = false;
 static const bool DEFAULT_LOGTIMESTAMPS = true;
+//! -logratelimit default, 0 for no limit
+static const unsigned int DEFAULT_LOGRATELIMIT = 0;
+//! Bytes of messages waiting for the debug.log writer past which the logging
+//! threads wait for it to catch up
+static const size_t MAX_LOG_BACKLOG = 16 * 1024 * 1024;
+//! -logsync default
+static const bool DEFAULT_LOGSYNC = false;
 
 extern bool fLogIPs;
 
@@ -53,19 +63,71 @@ private:
     std::mutex mutexDebugLog;
     std::list<std::string> vMsgsBeforeOpenLog;
 
+    /**
+     * Once debug.log is open, messages are queued in vPending and written out
+     * in batches by a dedicated thread, so the logging threads neither wait
+     * for the disk nor for each other beyond appending to the queue. The
+     * timestamps are formatted by the writer too.
+     */
+    struct LogEntry {
+        int64_t nTimeMicros;
+        std::string str;
+    };
+    std::vector<LogEntry> vPending;
+    size_t nPendingBytes = 0;
+    //! Whether the writer thread is writing a batch it took from vPending.
+    bool fWriting = false;
+    bool fStopWriter = false;
+    std::thread writerThread;
+    //! Signals the writer thread that vPending is no longer empty.
+    std::condition_variable condPending;
+    //! Signals the logging threads that the writer took or wrote a batch.
+    std::condition_variable condWritten;
+
+    //! Messages logged in the current second per category, for rate limiting.
+    struct CategoryRate {
+        int64_t nSecond = 0;
+        unsigned int nCount = 0;
+        unsigned int nSuppressed = 0;
+    };
+    CategoryRate categoryRates[32];
+
     /**
      * fStartedNewLine is a state variable that will suppress printing of the
      * timestamp when multiple calls are made that don't end in a newline.
      */
     std::atomic_bool fStartedNewLine{true};
 
+    //! The formatted date and time of the last second a timestamp was made for.
+    int64_t nTimestampSecond = -1;
+    std::string strTimestampSecond;
+
     /**
      * Log categories bitfield. Leveldb/libevent need special handling if their
      * flags are changed at runtime.
      */
     std::atomic<uint32_t> logCategories{0};
 
-    std::string LogTimestampStr(const std::string &str);
+    /**
+     * Append str to strOut, prefixed with a timestamp if it starts a line.
+     * Called by the writer thread once it runs, before that with
+     * mutexDebugLog held.
+     */
+    void AppendTimestamped(std::string &strOut, int64_t nTimeMicros,
+                           const std::string &str);
+
+    /**
+     * Whether a message of the given category is over -logratelimit. Sets
+     * strSuppressed to a note about the messages dropped in the previous
+     * second, if any. Requires mutexDebugLog.
+     */
+    bool IsRateLimited(LogFlags category, int64_t nTimeMicros,
+                       std::string &strSuppressed);
+
+    void WriterThread();
+
+    //! Reopen debug.log if fReopenDebugLog is set. Called by whoever writes.
+    void ReopenIfRequested();
 
 public:
     bool fPrintToConsole = false;
@@ -74,16 +136,33 @@ public:
     bool fLogTimestamps = DEFAULT_LOGTIMESTAMPS;
     bool fLogTimeMicros = DEFAULT_LOGTIMEMICROS;
 
+    //! Maximum messages per second logged for each category, 0 for no limit.
+    unsigned int nMaxCategoryRate = DEFAULT_LOGRATELIMIT;
+    //! Bytes waiting for the writer thread past which logging threads block.
+    size_t nMaxBacklog = MAX_LOG_BACKLOG;
+    /**
+     * Write every message to debug.log before LogPrintStr returns instead of
+     * handing it to the writer thread, so that nothing is lost if the process
+     * crashes. Must be set before OpenDebugLog.
+     */
+    bool fWriteSynchronously = DEFAULT_LOGSYNC;
+
     std::atomic<bool> fReopenDebugLog{false};
 
     ~Logger();
 
     /** Send a string to the log output */
-    int LogPrintStr(const std::string &str);
+    int LogPrintStr(const std::string &str, LogFlags category = NONE);
 
     void OpenDebugLog();
     void ShrinkDebugFile();
 
+    /**
+     * Wait until everything logged so far is written to debug.log. Called on
+     * the paths that are likely to end the process.
+     */
+    void Flush();
+
     void EnableCategory(LogFlags category);
     void DisableCategory(LogFlags category);
 
@@ -112,7 +191,7 @@ bool GetLogCategory(BCLog::LogFlags &flag, const std::string &str);
 #define LogPrint(category, ...)                                                \
     do {                                                                       \
         if (LogAcceptCategory((category))) {                                   \
-            GetLogger().LogPrintStr(tfm::format(__VA_ARGS__));                 \
+            GetLogger().LogPrintStr(tfm::format(__VA_ARGS__), (category));     \
         }                                                                      \
     } while (0)
 
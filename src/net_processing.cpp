@@ -1215,7 +1215,8 @@ static void ProcessGetData(const Config &config, CNode *pfrom,
                 if (send && (mi->second->nStatus.hasData())) {
                     // Send block from disk
                     CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, config)) {
+                    if (!ReadBlockFromDisk(block, (*mi).second, config,
+                                           true)) {
                         assert(!"cannot load block from disk");
                     }
 
@@ -1958,7 +1959,7 @@ static bool ProcessMessage(const Config &config, CNode *pfrom,
         }
 
         CBlock block;
-        bool ret = ReadBlockFromDisk(block, it->second, config);
+        bool ret = ReadBlockFromDisk(block, it->second, config, true);
         assert(ret);
 
         SendBlockTransactions(block, req, pfrom, connman);
@@ -3434,7 +3435,8 @@ bool SendMessages(const Config &config, CNode *pto, CConnman &connman,
                 }
                 if (!fGotBlockFromCache) {
                     CBlock block;
-                    bool ret = ReadBlockFromDisk(block, pBestIndex, config);
+                    bool ret =
+                        ReadBlockFromDisk(block, pBestIndex, config, true);
                     assert(ret);
                     CBlockHeaderAndShortTxIDs cmpctblock(block);
                     connman.PushMessage(pto,
@@ -28,14 +28,16 @@
  *   DUP CHECKSIG DROP ... repeated 100 times... OP_1
  */
 bool IsStandard(const CScript &scriptPubKey, txnouttype &whichType) {
-    std::vector<std::vector<uint8_t>> vSolutions;
-    if (!Solver(scriptPubKey, whichType, vSolutions)) {
+    CScriptSolution solution;
+    const bool fSolved = SolveScript(scriptPubKey, solution);
+    whichType = solution.type;
+    if (!fSolved) {
         return false;
     }
 
     if (whichType == TX_MULTISIG) {
-        uint8_t m = vSolutions.front()[0];
-        uint8_t n = vSolutions.back()[0];
+        uint8_t m = solution.nRequired;
+        uint8_t n = solution.nData;
         // Support up to x-of-3 multisig txns as standard
         if (n < 1 || n > 3) return false;
         if (m < 1 || m > n) return false;
@@ -125,15 +127,14 @@ bool AreInputsStandard(const CTransaction &tx,
     for (size_t i = 0; i < tx.vin.size(); i++) {
         const CTxOut &prev = mapInputs.GetOutputFor(tx.vin[i]);
 
-        std::vector<std::vector<uint8_t>> vSolutions;
-        txnouttype whichType;
+        CScriptSolution solution;
         // get the scriptPubKey corresponding to this input:
         const CScript &prevScript = prev.scriptPubKey;
-        if (!Solver(prevScript, whichType, vSolutions)) {
+        if (!SolveScript(prevScript, solution)) {
             return false;
         }
 
-        if (whichType == TX_SCRIPTHASH) {
+        if (solution.type == TX_SCRIPTHASH) {
             std::vector<std::vector<uint8_t>> stack;
             // convert the scriptSig into a stack, so we can inspect the
             // redeemScript
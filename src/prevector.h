@@ -354,7 +354,9 @@ public:
         }
     }
 
-    prevector(prevector<N, T, Size, Diff> &&other) : _size(0) { swap(other); }
+    prevector(prevector<N, T, Size, Diff> &&other) noexcept : _size(0) {
+        swap(other);
+    }
 
     prevector &operator=(const prevector<N, T, Size, Diff> &other) {
         if (&other == this) {
@@ -101,6 +101,58 @@ public:
     std::string ToString() const;
 };
 
+/**
+ * Backing storage for the transactions of a block deserialized with
+ * UnserializeBlockInArena(). Transactions are constructed in place in a few
+ * large chunks instead of one shared_ptr allocation each. Every
+ * CTransactionRef handed out shares ownership of the whole arena, so the
+ * memory is released once the last reference to any of its transactions is
+ * dropped.
+ */
+class CBlockTxArena {
+private:
+    // Chunks never grow past the capacity reserved when they are created, so
+    // pointers to their elements stay valid for the lifetime of the arena.
+    std::vector<std::vector<CTransaction>> chunks;
+
+public:
+    template <typename Stream>
+    const CTransaction *Emplace(Stream &s, size_t nRemaining) {
+        if (chunks.empty() ||
+            chunks.back().size() == chunks.back().capacity()) {
+            chunks.emplace_back();
+            // Limit the size per chunk so bogus transaction counts won't
+            // cause out of memory, as done for vectors in serialize.h.
+            chunks.back().reserve(
+                std::min(nRemaining, 1 + 4999999 / sizeof(CTransaction)));
+        }
+        chunks.back().emplace_back(deserialize, s);
+        return &chunks.back().back();
+    }
+};
+
+/**
+ * Deserialize a block the same way as `s >> block`, but allocate all of its
+ * transactions in a single CBlockTxArena.
+ *
+ * Any reference to one of the transactions keeps the whole block's
+ * transactions alive, so this should only be used for blocks whose
+ * transactions are not retained individually afterward (serving blocks to
+ * peers, RPC, REST...).
+ */
+template <typename Stream>
+void UnserializeBlockInArena(Stream &s, CBlock &block) {
+    block.SetNull();
+    s >> *(CBlockHeader *)&block;
+
+    const size_t nTx = ReadCompactSize(s);
+    auto arena = std::make_shared<CBlockTxArena>();
+    block.vtx.reserve(std::min(nTx, 1 + 4999999 / sizeof(CTransactionRef)));
+    for (size_t i = 0; i < nTx; i++) {
+        block.vtx.emplace_back(arena, arena->Emplace(s, nTx - i));
+    }
+}
+
 /**
  * Describes a place in the block chain to another node such that if the other
  * node doesn't have the same branch, it can find a recent common trunk.  The
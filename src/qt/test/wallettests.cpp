@@ -99,10 +99,7 @@ void WalletTests::walletTests() {
                               "receive");
         wallet.AddKeyPubKey(test.coinbaseKey, test.coinbaseKey.GetPubKey());
     }
-    {
-        LOCK(cs_main);
-        wallet.ScanForWalletTransactions(chainActive.Genesis(), true);
-    }
+    wallet.ScanForWalletTransactions(chainActive.Genesis(), true);
     wallet.SetBroadcastTransactions(true);
 
     // Create widgets for sending coins and listing transactions.
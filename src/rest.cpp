@@ -15,17 +15,26 @@
 #include "streams.h"
 #include "sync.h"
 #include "txmempool.h"
+#include "util.h"
 #include "utilstrencodings.h"
 #include "validation.h"
 #include "version.h"
 
 #include <boost/algorithm/string.hpp>
 
+#include <limits>
+
 #include <univalue.h>
 
 // Allow a max of 15 outpoints to be queried at once.
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15;
 
+// Most headers, and blocks or undo records, served by one range request.
+static const int MAX_REST_RANGE_HEADERS = 100000;
+static const int MAX_REST_RANGE_BLOCKS = 1000;
+// Size at which range replies are handed to the HTTP server.
+static const size_t REST_RANGE_CHUNK_SIZE = 256 * 1024;
+
 enum RetFormat {
     RF_UNDEF,
     RF_BINARY,
@@ -241,7 +250,7 @@ static bool rest_block(const Config &config, HTTPRequest *req,
                            hashStr + " not available (pruned data)");
         }
 
-        if (!ReadBlockFromDisk(block, pblockindex, config)) {
+        if (!ReadBlockFromDisk(block, pblockindex, config, true)) {
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
         }
     }
@@ -296,6 +305,197 @@ static bool rest_block_notxdetails(Config &config, HTTPRequest *req,
     return rest_block(config, req, strURIPart, false);
 }
 
+enum class RangeData {
+    HEADERS,
+    BLOCKS,
+    UNDO,
+};
+
+/**
+ * Parse the heights requested from a range endpoint, either in the path as
+ * /<first>/<count> or, if the path is empty, in a "Range: height=<first>-"
+ * or "Range: height=<first>-<last>" header.
+ */
+static bool ParseHeightRange(HTTPRequest *req, const std::string &param,
+                             int &nFirst, int &nCount, bool &fRangeHeader) {
+    std::vector<std::string> parts;
+    fRangeHeader = param.empty();
+    if (fRangeHeader) {
+        const std::pair<bool, std::string> range = req->GetHeader("Range");
+        const std::string unit = "height=";
+        if (!range.first || range.second.compare(0, unit.size(), unit) != 0) {
+            return false;
+        }
+        boost::split(parts, range.second.substr(unit.size()),
+                     boost::is_any_of("-"));
+        if (parts.size() != 2 || !ParseInt32(parts[0], &nFirst)) {
+            return false;
+        }
+        int nLast = std::numeric_limits<int>::max();
+        if (!parts[1].empty() && !ParseInt32(parts[1], &nLast)) {
+            return false;
+        }
+        nCount = std::min<int64_t>(int64_t(nLast) - nFirst + 1,
+                                   std::numeric_limits<int>::max());
+    } else {
+        boost::split(parts, param, boost::is_any_of("/"));
+        if (parts.size() != 3 || !parts[0].empty() ||
+            !ParseInt32(parts[1], &nFirst) || !ParseInt32(parts[2], &nCount)) {
+            return false;
+        }
+    }
+    return nFirst >= 0 && nCount > 0;
+}
+
+/**
+ * Serve a contiguous range of the active chain by height: block headers, or
+ * blocks or their undo data as stored on disk. Blocks and undo data are read
+ * and sent one at a time, each preceded by the network magic and its size as
+ * in the block files. The genesis block has an empty undo record.
+ *
+ * The reply is cut short at the tip, at the per-request limit and at the
+ * first block that was pruned. It is then a 206 Partial Content reply whose
+ * Content-Range header tells which heights were sent, so clients continue
+ * from the next one.
+ */
+static bool rest_range(Config &config, HTTPRequest *req,
+                       const std::string &strURIPart, RangeData data) {
+    if (!CheckWarmup(req)) {
+        return false;
+    }
+
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (rf != RF_BINARY) {
+        return RESTERR(req, HTTP_NOT_FOUND,
+                       "output format not found (available: .bin)");
+    }
+
+    int nFirst, nCount;
+    bool fRangeHeader;
+    if (!ParseHeightRange(req, param, nFirst, nCount, fRangeHeader)) {
+        return RESTERR(req, HTTP_BAD_REQUEST,
+                       "Invalid range. Use /<first>/<count>.bin or a "
+                       "\"Range: height=<first>-[<last>]\" header.");
+    }
+    const int nMaxCount = data == RangeData::HEADERS ? MAX_REST_RANGE_HEADERS
+                                                     : MAX_REST_RANGE_BLOCKS;
+
+    std::vector<CBlockHeader> headers;
+    std::vector<CDiskBlockPos> positions;
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+        if (nFirst > nHeight) {
+            req->WriteHeader("Content-Range",
+                             strprintf("height */%d", nHeight + 1));
+            return RESTERR(req, HTTP_RANGE_NOT_SATISFIABLE,
+                           strprintf("Height %d is beyond the tip", nFirst));
+        }
+
+        const int nEnd = std::min<int64_t>(
+            nHeight + 1, int64_t(nFirst) + std::min(nCount, nMaxCount));
+        for (int i = nFirst; i < nEnd; i++) {
+            const CBlockIndex *pindex = chainActive[i];
+            if (data == RangeData::HEADERS) {
+                headers.push_back(pindex->GetBlockHeader());
+            } else if (data == RangeData::BLOCKS) {
+                if (!pindex->nStatus.hasData()) {
+                    break;
+                }
+                positions.push_back(pindex->GetBlockPos());
+            } else if (!pindex->pprev) {
+                // Null position for the empty undo data of genesis
+                positions.push_back(CDiskBlockPos());
+            } else {
+                if (!pindex->nStatus.hasUndo()) {
+                    break;
+                }
+                positions.push_back(pindex->GetUndoPos());
+            }
+        }
+    }
+
+    const int nSent =
+        data == RangeData::HEADERS ? headers.size() : positions.size();
+    if (nSent == 0) {
+        return RESTERR(req, HTTP_NOT_FOUND,
+                       strprintf("Height %d not available (pruned data)",
+                                 nFirst));
+    }
+
+    req->WriteHeader("Content-Type", "application/octet-stream");
+    req->WriteHeader("Accept-Ranges", "height");
+    if (fRangeHeader || nSent < nCount) {
+        req->WriteHeader("Content-Range",
+                         strprintf("height %d-%d/%d", nFirst,
+                                   nFirst + nSent - 1, nHeight + 1));
+        req->StartReply(HTTP_PARTIAL_CONTENT);
+    } else {
+        req->StartReply(HTTP_OK);
+    }
+
+    const CMessageHeader::MessageMagic &magic =
+        config.GetChainParams().DiskMagic();
+    CDataStream ssChunk(SER_NETWORK, PROTOCOL_VERSION);
+    std::vector<uint8_t> record;
+    for (int i = 0; i < nSent; i++) {
+        if (data == RangeData::HEADERS) {
+            ssChunk << headers[i];
+        } else {
+            bool fRead;
+            if (data == RangeData::BLOCKS) {
+                fRead = ReadRawBlockFromDisk(record, positions[i], magic);
+            } else if (positions[i].IsNull()) {
+                record.assign(1, 0);
+                fRead = true;
+            } else {
+                fRead = ReadRawUndoFromDisk(record, positions[i], magic);
+            }
+            if (!fRead) {
+                // Drop the connection rather than end the reply cleanly, so
+                // the client does not take a short body for the whole range.
+                LogPrintf("REST range reply aborted at height %d\n",
+                          nFirst + i);
+                req->AbortReply();
+                return false;
+            }
+            ssChunk << FLATDATA(magic) << uint32_t(record.size());
+            ssChunk.write((const char *)record.data(), record.size());
+        }
+
+        if (ssChunk.size() >= REST_RANGE_CHUNK_SIZE) {
+            if (!req->WriteReplyChunk(ssChunk.str())) {
+                // Client went away
+                req->EndReply();
+                return false;
+            }
+            ssChunk.clear();
+        }
+    }
+    if (!ssChunk.empty()) {
+        req->WriteReplyChunk(ssChunk.str());
+    }
+    req->EndReply();
+    return true;
+}
+
+static bool rest_headerrange(Config &config, HTTPRequest *req,
+                             const std::string &strURIPart) {
+    return rest_range(config, req, strURIPart, RangeData::HEADERS);
+}
+
+static bool rest_blockrange(Config &config, HTTPRequest *req,
+                            const std::string &strURIPart) {
+    return rest_range(config, req, strURIPart, RangeData::BLOCKS);
+}
+
+static bool rest_undorange(Config &config, HTTPRequest *req,
+                           const std::string &strURIPart) {
+    return rest_range(config, req, strURIPart, RangeData::UNDO);
+}
+
 static bool rest_chaininfo(Config &config, HTTPRequest *req,
                            const std::string &strURIPart) {
     if (!CheckWarmup(req)) {
@@ -679,6 +879,9 @@ static const struct {
     {"/rest/mempool/info", rest_mempool_info},
     {"/rest/mempool/contents", rest_mempool_contents},
     {"/rest/headers/", rest_headers},
+    {"/rest/headerrange", rest_headerrange},
+    {"/rest/blockrange", rest_blockrange},
+    {"/rest/undorange", rest_undorange},
     {"/rest/getutxos", rest_getutxos},
 };
 
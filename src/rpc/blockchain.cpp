@@ -15,6 +15,7 @@
 #include "hash.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
+#include "rpc/jsonwriter.h"
 #include "rpc/server.h"
 #include "rpc/tojson.h"
 #include "streams.h"
@@ -28,6 +29,7 @@
 
 #include <condition_variable>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 
 struct CUpdatedBlock {
@@ -99,8 +101,9 @@ UniValue blockheaderToJSON(const CBlockIndex *blockindex) {
     return result;
 }
 
-UniValue blockToJSON(const Config &config, const CBlock &block,
-                     const CBlockIndex *blockindex, bool txDetails) {
+/** Build the blockToJSON object around an already converted "tx" array. */
+static UniValue blockToJSON(const CBlock &block, const CBlockIndex *blockindex,
+                            const UniValue &txs) {
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
     int confirmations = -1;
@@ -115,16 +118,6 @@ UniValue blockToJSON(const Config &config, const CBlock &block,
     result.push_back(Pair("version", block.nVersion));
     result.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
     result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    UniValue txs(UniValue::VARR);
-    for (const auto &tx : block.vtx) {
-        if (txDetails) {
-            UniValue objTx(UniValue::VOBJ);
-            TxToJSON(config, *tx, uint256(), objTx);
-            txs.push_back(objTx);
-        } else {
-            txs.push_back(tx->GetId().GetHex());
-        }
-    }
     result.push_back(Pair("tx", txs));
     result.push_back(Pair("time", block.GetBlockTime()));
     result.push_back(
@@ -145,6 +138,46 @@ UniValue blockToJSON(const Config &config, const CBlock &block,
     return result;
 }
 
+UniValue blockToJSON(const Config &config, const CBlock &block,
+                     const CBlockIndex *blockindex, bool txDetails) {
+    UniValue txs(UniValue::VARR);
+    for (const auto &tx : block.vtx) {
+        if (txDetails) {
+            UniValue objTx(UniValue::VOBJ);
+            TxToJSON(config, *tx, uint256(), objTx);
+            txs.push_back(objTx);
+        } else {
+            txs.push_back(tx->GetId().GetHex());
+        }
+    }
+    return blockToJSON(block, blockindex, txs);
+}
+
+/**
+ * Write the object blockToJSON returns without txDetails. fields is that
+ * object with an empty "tx" array, which is filled in from the block while
+ * writing.
+ */
+static void WriteBlockJSON(JSONWriter &writer, const UniValue &fields,
+                           const CBlock &block) {
+    const std::vector<std::string> &keys = fields.getKeys();
+    const std::vector<UniValue> &values = fields.getValues();
+    writer.BeginObject();
+    for (size_t i = 0; i < keys.size(); i++) {
+        writer.Key(keys[i]);
+        if (keys[i] != "tx") {
+            writer.Value(values[i]);
+            continue;
+        }
+        writer.BeginArray();
+        for (const auto &tx : block.vtx) {
+            writer.String(tx->GetId().GetHex());
+        }
+        writer.EndArray();
+    }
+    writer.EndObject();
+}
+
 UniValue getblockcount(const Config &config, const JSONRPCRequest &request) {
     if (request.fHelp || request.params.size() != 0) {
         throw std::runtime_error(
@@ -456,20 +489,77 @@ UniValue mempoolToJSON(bool fVerbose = false) {
     }
 }
 
+/** Number of mempool entries converted to JSON per lock of mempool.cs */
+static const size_t MEMPOOL_JSON_BATCH = 1000;
+
+/**
+ * Write the object mempoolToJSON(true) returns. Entries are converted in
+ * batches, so mempool.cs is not held while they are sent. Transactions that
+ * leave the mempool while writing are skipped and ones that enter it are
+ * not included.
+ */
+static void WriteMempoolJSON(JSONWriter &writer) {
+    std::vector<uint256> vtxid;
+    {
+        LOCK(mempool.cs);
+        vtxid.reserve(mempool.mapTx.size());
+        for (const CTxMemPoolEntry &e : mempool.mapTx) {
+            vtxid.push_back(e.GetTx().GetId());
+        }
+    }
+
+    writer.BeginObject();
+    std::vector<std::pair<std::string, UniValue>> batch;
+    for (size_t i = 0; i < vtxid.size(); i += MEMPOOL_JSON_BATCH) {
+        size_t end = std::min(vtxid.size(), i + MEMPOOL_JSON_BATCH);
+        {
+            LOCK(mempool.cs);
+            for (size_t j = i; j < end; j++) {
+                auto it = mempool.mapTx.find(vtxid[j]);
+                if (it == mempool.mapTx.end()) {
+                    continue;
+                }
+                UniValue info(UniValue::VOBJ);
+                entryToJSON(info, *it);
+                batch.emplace_back(vtxid[j].ToString(), std::move(info));
+            }
+        }
+        for (const auto &entry : batch) {
+            writer.Key(entry.first);
+            writer.Value(entry.second);
+        }
+        batch.clear();
+    }
+    writer.EndObject();
+}
+
 UniValue getrawmempool(const Config &config, const JSONRPCRequest &request) {
-    if (request.fHelp || request.params.size() > 1) {
+    if (request.fHelp || request.params.size() > 2) {
         throw std::runtime_error(
-            "getrawmempool ( verbose )\n"
+            "getrawmempool ( verbose mempool_sequence )\n"
             "\nReturns all transaction ids in memory pool as a json array of "
             "string transaction ids.\n"
             "\nArguments:\n"
             "1. verbose (boolean, optional, default=false) True for a json "
             "object, false for array of transaction ids\n"
+            "2. mempool_sequence (boolean, optional, default=false) If "
+            "verbose is false, return a json object with the transaction ids "
+            "and the mempool sequence number they correspond to\n"
             "\nResult: (for verbose = false):\n"
             "[                     (json array of string)\n"
             "  \"transactionid\"     (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult: (for verbose = false and mempool_sequence = true):\n"
+            "{                           (json object)\n"
+            "  \"txids\" : [               (json array of string)\n"
+            "    \"transactionid\"       (string) The transaction id\n"
+            "    ,...\n"
+            "  ],\n"
+            "  \"mempool_sequence\" : n    (numeric) The sequence number the "
+            "next mempool change will be published with on the ZMQ sequence "
+            "topic\n"
+            "}\n"
             "\nResult: (for verbose = true):\n"
             "{                           (json object)\n"
             "  \"transactionid\" : {       (json object)\n" +
@@ -481,10 +571,34 @@ UniValue getrawmempool(const Config &config, const JSONRPCRequest &request) {
     }
 
     bool fVerbose = false;
-    if (request.params.size() > 0) {
+    if (!request.params[0].isNull()) {
         fVerbose = request.params[0].get_bool();
     }
 
+    bool fIncludeMempoolSequence = false;
+    if (!request.params[1].isNull()) {
+        fIncludeMempoolSequence = request.params[1].get_bool();
+    }
+
+    if (fIncludeMempoolSequence) {
+        if (fVerbose) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER,
+                               "Verbose results cannot contain mempool "
+                               "sequence values");
+        }
+        // Hold mempool.cs so the sequence number matches the list exactly
+        LOCK(mempool.cs);
+        UniValue o(UniValue::VOBJ);
+        o.push_back(Pair("txids", mempoolToJSON(false)));
+        o.push_back(Pair("mempool_sequence", mempool.GetSequence()));
+        return o;
+    }
+
+    if (fVerbose && request.resultWriter) {
+        *request.resultWriter = WriteMempoolJSON;
+        return NullUniValue;
+    }
+
     return mempoolToJSON(fVerbose);
 }
 
@@ -831,7 +945,7 @@ UniValue getblock(const Config &config, const JSONRPCRequest &request) {
         throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
     }
 
-    if (!ReadBlockFromDisk(block, pblockindex, config)) {
+    if (!ReadBlockFromDisk(block, pblockindex, config, true)) {
         // Block not found on disk. This could be because we have the block
         // header in our index but don't have the block (for example if a
         // non-whitelisted node sends us an unrequested long chain of valid
@@ -840,13 +954,35 @@ UniValue getblock(const Config &config, const JSONRPCRequest &request) {
     }
 
     if (!fVerbose) {
-        CDataStream ssBlock(SER_NETWORK,
-                            PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
+        auto ssBlock = std::make_shared<CDataStream>(
+            SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+        *ssBlock << block;
+        if (request.resultWriter) {
+            // Hex-encode straight into the reply instead of into a string
+            // twice the size of the block.
+            *request.resultWriter = [ssBlock](JSONWriter &writer) {
+                const uint8_t *begin =
+                    reinterpret_cast<const uint8_t *>(ssBlock->data());
+                writer.HexString(begin, begin + ssBlock->size());
+            };
+            return NullUniValue;
+        }
+        std::string strHex = HexStr(ssBlock->begin(), ssBlock->end());
         return strHex;
     }
 
+    if (request.resultWriter) {
+        // Only the block's own fields need cs_main, the transaction ids are
+        // written from the block once the lock is released.
+        auto pblock = std::make_shared<const CBlock>(std::move(block));
+        UniValue fields =
+            blockToJSON(*pblock, pblockindex, UniValue(UniValue::VARR));
+        *request.resultWriter = [pblock, fields](JSONWriter &writer) {
+            WriteBlockJSON(writer, fields, *pblock);
+        };
+        return NullUniValue;
+    }
+
     return blockToJSON(config, block, pblockindex);
 }
 
@@ -1727,34 +1863,34 @@ UniValue getchaintxstats(const Config &config, const JSONRPCRequest &request) {
 
 // clang-format off
 static const CRPCCommand commands[] = {
-    //  category            name                      actor (function)        okSafe argNames
-    //  ------------------- ------------------------  ----------------------  ------ ----------
-    { "blockchain",         "getblockchaininfo",      getblockchaininfo,      true,  {} },
-    { "blockchain",         "getchaintxstats",        &getchaintxstats,       true,  {"nblocks", "blockhash"} },
-    { "blockchain",         "getbestblockhash",       getbestblockhash,       true,  {} },
-    { "blockchain",         "getblockcount",          getblockcount,          true,  {} },
-    { "blockchain",         "getblock",               getblock,               true,  {"blockhash","verbose"} },
-    { "blockchain",         "getblockhash",           getblockhash,           true,  {"height"} },
-    { "blockchain",         "getblockheader",         getblockheader,         true,  {"blockhash","verbose"} },
-    { "blockchain",         "getchaintips",           getchaintips,           true,  {} },
-    { "blockchain",         "getdifficulty",          getdifficulty,          true,  {} },
-    { "blockchain",         "getmempoolancestors",    getmempoolancestors,    true,  {"txid","verbose"} },
-    { "blockchain",         "getmempooldescendants",  getmempooldescendants,  true,  {"txid","verbose"} },
-    { "blockchain",         "getmempoolentry",        getmempoolentry,        true,  {"txid"} },
-    { "blockchain",         "getmempoolinfo",         getmempoolinfo,         true,  {} },
-    { "blockchain",         "getrawmempool",          getrawmempool,          true,  {"verbose"} },
-    { "blockchain",         "gettxout",               gettxout,               true,  {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        gettxoutsetinfo,        true,  {} },
-    { "blockchain",         "pruneblockchain",        pruneblockchain,        true,  {"height"} },
-    { "blockchain",         "verifychain",            verifychain,            true,  {"checklevel","nblocks"} },
-    { "blockchain",         "preciousblock",          preciousblock,          true,  {"blockhash"} },
+    //  category            name                      actor (function)        okSafe argNames                         parallel
+    //  ------------------- ------------------------  ----------------------  ------ ----------                       --------
+    { "blockchain",         "getblockchaininfo",      getblockchaininfo,      true,  {},                              true  },
+    { "blockchain",         "getchaintxstats",        &getchaintxstats,       true,  {"nblocks", "blockhash"},        true  },
+    { "blockchain",         "getbestblockhash",       getbestblockhash,       true,  {},                              true  },
+    { "blockchain",         "getblockcount",          getblockcount,          true,  {},                              true  },
+    { "blockchain",         "getblock",               getblock,               true,  {"blockhash","verbose"},         true  },
+    { "blockchain",         "getblockhash",           getblockhash,           true,  {"height"},                      true  },
+    { "blockchain",         "getblockheader",         getblockheader,         true,  {"blockhash","verbose"},         true  },
+    { "blockchain",         "getchaintips",           getchaintips,           true,  {},                              true  },
+    { "blockchain",         "getdifficulty",          getdifficulty,          true,  {},                              true  },
+    { "blockchain",         "getmempoolancestors",    getmempoolancestors,    true,  {"txid","verbose"},              true  },
+    { "blockchain",         "getmempooldescendants",  getmempooldescendants,  true,  {"txid","verbose"},              true  },
+    { "blockchain",         "getmempoolentry",        getmempoolentry,        true,  {"txid"},                        true  },
+    { "blockchain",         "getmempoolinfo",         getmempoolinfo,         true,  {},                              true  },
+    { "blockchain",         "getrawmempool",          getrawmempool,          true,  {"verbose","mempool_sequence"},  true  },
+    { "blockchain",         "gettxout",               gettxout,               true,  {"txid","n","include_mempool"},  true  },
+    { "blockchain",         "gettxoutsetinfo",        gettxoutsetinfo,        true,  {},                              false },
+    { "blockchain",         "pruneblockchain",        pruneblockchain,        true,  {"height"},                      false },
+    { "blockchain",         "verifychain",            verifychain,            true,  {"checklevel","nblocks"},        false },
+    { "blockchain",         "preciousblock",          preciousblock,          true,  {"blockhash"},                   false },
 
     /* Not shown in help */
-    { "hidden",             "invalidateblock",        invalidateblock,        true,  {"blockhash"} },
-    { "hidden",             "reconsiderblock",        reconsiderblock,        true,  {"blockhash"} },
-    { "hidden",             "waitfornewblock",        waitfornewblock,        true,  {"timeout"} },
-    { "hidden",             "waitforblock",           waitforblock,           true,  {"blockhash","timeout"} },
-    { "hidden",             "waitforblockheight",     waitforblockheight,     true,  {"height","timeout"} },
+    { "hidden",             "invalidateblock",        invalidateblock,        true,  {"blockhash"},                   false },
+    { "hidden",             "reconsiderblock",        reconsiderblock,        true,  {"blockhash"},                   false },
+    { "hidden",             "waitfornewblock",        waitfornewblock,        true,  {"timeout"},                     false },
+    { "hidden",             "waitforblock",           waitforblock,           true,  {"blockhash","timeout"},         false },
+    { "hidden",             "waitforblockheight",     waitforblockheight,     true,  {"height","timeout"},            false },
 };
 // clang-format on
 
@@ -59,12 +59,14 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     {"listtransactions", 1, "count"},
     {"listtransactions", 2, "skip"},
     {"listtransactions", 3, "include_watchonly"},
+    {"listtransactions", 4, "cursor"},
     {"listaccounts", 0, "minconf"},
     {"listaccounts", 1, "include_watchonly"},
     {"walletpassphrase", 1, "timeout"},
     {"getblocktemplate", 0, "template_request"},
     {"listsinceblock", 1, "target_confirmations"},
     {"listsinceblock", 2, "include_watchonly"},
+    {"listsinceblock", 3, "count"},
     {"sendmany", 1, "amounts"},
     {"sendmany", 2, "minconf"},
     {"sendmany", 4, "subtractfeefrom"},
@@ -103,6 +105,7 @@ static const CRPCConvertParam vRPCConvertParams[] = {
     {"pruneblockchain", 0, "height"},
     {"keypoolrefill", 0, "newsize"},
     {"getrawmempool", 0, "verbose"},
+    {"getrawmempool", 1, "mempool_sequence"},
     {"estimatefee", 0, "nblocks"},
     {"prioritisetransaction", 1, "priority_delta"},
     {"prioritisetransaction", 2, "fee_delta"},
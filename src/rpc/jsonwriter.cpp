@@ -0,0 +1,178 @@
+// Copyright (c) 2018 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonwriter.h"
+
+#include <cassert>
+
+static const char hexmap[16] = {'0', '1', '2', '3', '4', '5', '6', '7',
+                                '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+
+JSONWriter::JSONWriter(const Sink &_sink, size_t _nFlushSize)
+    : sink(_sink), nFlushSize(_nFlushSize), fAfterKey(false) {
+    buffer.reserve(nFlushSize);
+}
+
+void JSONWriter::BeginValue() {
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (vEmpty.empty()) {
+        return;
+    }
+    if (!vEmpty.back()) {
+        buffer += ',';
+    }
+    vEmpty.back() = false;
+}
+
+void JSONWriter::BeginObject() {
+    BeginValue();
+    buffer += '{';
+    vEmpty.push_back(true);
+}
+
+void JSONWriter::EndObject() {
+    assert(!vEmpty.empty() && !fAfterKey);
+    vEmpty.pop_back();
+    buffer += '}';
+    MaybeFlush();
+}
+
+void JSONWriter::BeginArray() {
+    BeginValue();
+    buffer += '[';
+    vEmpty.push_back(true);
+}
+
+void JSONWriter::EndArray() {
+    assert(!vEmpty.empty() && !fAfterKey);
+    vEmpty.pop_back();
+    buffer += ']';
+    MaybeFlush();
+}
+
+void JSONWriter::Key(const std::string &key) {
+    assert(!vEmpty.empty() && !fAfterKey);
+    BeginValue();
+    WriteEscaped(key);
+    buffer += ':';
+    fAfterKey = true;
+}
+
+void JSONWriter::Value(const UniValue &value) {
+    switch (value.getType()) {
+        case UniValue::VOBJ: {
+            BeginObject();
+            const std::vector<std::string> &keys = value.getKeys();
+            const std::vector<UniValue> &values = value.getValues();
+            for (size_t i = 0; i < keys.size(); i++) {
+                Key(keys[i]);
+                Value(values[i]);
+            }
+            EndObject();
+            return;
+        }
+        case UniValue::VARR: {
+            BeginArray();
+            for (const UniValue &v : value.getValues()) {
+                Value(v);
+            }
+            EndArray();
+            return;
+        }
+        case UniValue::VSTR:
+            String(value.get_str());
+            return;
+        case UniValue::VNUM:
+            BeginValue();
+            buffer += value.getValStr();
+            break;
+        case UniValue::VBOOL:
+            BeginValue();
+            buffer += value.get_bool() ? "true" : "false";
+            break;
+        case UniValue::VNULL:
+            BeginValue();
+            buffer += "null";
+            break;
+    }
+    MaybeFlush();
+}
+
+void JSONWriter::String(const std::string &str) {
+    BeginValue();
+    WriteEscaped(str);
+    MaybeFlush();
+}
+
+void JSONWriter::HexString(const uint8_t *begin, const uint8_t *end) {
+    BeginValue();
+    buffer += '"';
+    for (const uint8_t *p = begin; p != end; p++) {
+        buffer += hexmap[*p >> 4];
+        buffer += hexmap[*p & 15];
+        MaybeFlush();
+    }
+    buffer += '"';
+    MaybeFlush();
+}
+
+void JSONWriter::Raw(const std::string &str) {
+    buffer += str;
+    MaybeFlush();
+}
+
+void JSONWriter::Flush() {
+    if (buffer.empty()) {
+        return;
+    }
+    sink(buffer);
+    buffer.clear();
+}
+
+/**
+ * Same escaping as UniValue: control characters and DEL become \uXXXX (or
+ * their short forms), quotes and backslashes are backslash-escaped, and
+ * everything else, including UTF-8 sequences, is copied verbatim.
+ */
+void JSONWriter::WriteEscaped(const std::string &str) {
+    buffer += '"';
+    for (char c : str) {
+        uint8_t ch = c;
+        switch (ch) {
+            case '"':
+                buffer += "\\\"";
+                break;
+            case '\\':
+                buffer += "\\\\";
+                break;
+            case '\b':
+                buffer += "\\b";
+                break;
+            case '\t':
+                buffer += "\\t";
+                break;
+            case '\n':
+                buffer += "\\n";
+                break;
+            case '\f':
+                buffer += "\\f";
+                break;
+            case '\r':
+                buffer += "\\r";
+                break;
+            default:
+                if (ch < 0x20 || ch == 0x7f) {
+                    buffer += "\\u00";
+                    buffer += hexmap[ch >> 4];
+                    buffer += hexmap[ch & 15];
+                } else {
+                    buffer += c;
+                }
+        }
+    }
+    buffer += '"';
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2018 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONWRITER_H
+#define BITCOIN_RPC_JSONWRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <univalue.h>
+
+/** Size at which JSONWriter hands its buffered output to the sink */
+static const size_t DEFAULT_JSON_FLUSH_SIZE = 64 * 1024;
+
+/**
+ * Incremental JSON emitter.
+ *
+ * Produces exactly the same text as UniValue::write() without indentation,
+ * but lets callers write a document piece by piece instead of building the
+ * whole tree first. Output is buffered and handed to the sink whenever more
+ * than nFlushSize bytes are pending, so only one chunk of the document is in
+ * memory at a time.
+ *
+ * The sink may throw to abort the document, e.g. when the client went away.
+ */
+class JSONWriter {
+public:
+    typedef std::function<void(const std::string &chunk)> Sink;
+
+    explicit JSONWriter(const Sink &sink,
+                        size_t nFlushSize = DEFAULT_JSON_FLUSH_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    /** Write the key of the next member of the current object. */
+    void Key(const std::string &key);
+
+    /** Write a complete value, recursing into arrays and objects. */
+    void Value(const UniValue &value);
+    /** Write a string value without wrapping it in a UniValue first. */
+    void String(const std::string &str);
+    /** Write a string value holding the hex encoding of [begin, end). */
+    void HexString(const uint8_t *begin, const uint8_t *end);
+
+    /** Write text as is, e.g. the newline terminating a JSON-RPC reply. */
+    void Raw(const std::string &str);
+
+    /** Hand everything written so far to the sink. */
+    void Flush();
+
+    /** Output written since the last flush. */
+    std::string &GetBuffer() { return buffer; }
+
+private:
+    Sink sink;
+    size_t nFlushSize;
+    std::string buffer;
+
+    /** For each open array or object, whether it has no members yet */
+    std::vector<bool> vEmpty;
+    /** Whether a key was just written, so no separator is needed */
+    bool fAfterKey;
+
+    void BeginValue();
+    void WriteEscaped(const std::string &str);
+    void MaybeFlush() {
+        if (buffer.size() >= nFlushSize) {
+            Flush();
+        }
+    }
+};
+
+#endif // BITCOIN_RPC_JSONWRITER_H
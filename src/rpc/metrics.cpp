@@ -0,0 +1,153 @@
+// Copyright (c) 2018 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/metrics.h"
+
+#include "httpserver.h"
+#include "tinyformat.h"
+
+#include <univalue.h>
+
+#include <algorithm>
+#include <mutex>
+
+static std::mutex cs_rpcMetrics;
+static std::map<std::string, RPCMethodStats> mapRPCMethodStats;
+
+void LatencyHistogram::Add(int64_t nMicros) {
+    const int64_t *bound =
+        std::lower_bound(std::begin(LATENCY_BUCKET_BOUNDS),
+                         std::end(LATENCY_BUCKET_BOUNDS), nMicros);
+    vCounts[bound - std::begin(LATENCY_BUCKET_BOUNDS)]++;
+    nCount++;
+    nSumMicros += nMicros;
+    nMaxMicros = std::max(nMaxMicros, nMicros);
+}
+
+static std::string FormatSeconds(int64_t nMicros) {
+    return strprintf("%d.%06d", nMicros / 1000000, nMicros % 1000000);
+}
+
+/** Label of the bucket with index i, i.e. its upper bound in seconds */
+static std::string BucketLabel(size_t i) {
+    if (i + 1 == NUM_LATENCY_BUCKETS) {
+        return "+Inf";
+    }
+    return strprintf("%g", LATENCY_BUCKET_BOUNDS[i] / 1e6);
+}
+
+UniValue LatencyHistogram::ToJSON() const {
+    UniValue buckets(UniValue::VOBJ);
+    for (size_t i = 0; i < NUM_LATENCY_BUCKETS; i++) {
+        buckets.push_back(Pair(BucketLabel(i), vCounts[i]));
+    }
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("count", nCount));
+    ret.push_back(Pair("sum", nSumMicros / 1e6));
+    ret.push_back(Pair("max", nMaxMicros / 1e6));
+    ret.push_back(Pair("buckets", buckets));
+    return ret;
+}
+
+void RecordRPCCall(const std::string &strMethod, int64_t nMicros,
+                   int64_t nLockWaitMicros, bool fError) {
+    std::lock_guard<std::mutex> lock(cs_rpcMetrics);
+    RPCMethodStats &stats = mapRPCMethodStats[strMethod];
+    stats.latency.Add(nMicros);
+    stats.nLockWaitMicros += nLockWaitMicros;
+    if (fError) {
+        stats.nErrors++;
+    }
+}
+
+std::map<std::string, RPCMethodStats> GetRPCMethodStats() {
+    std::lock_guard<std::mutex> lock(cs_rpcMetrics);
+    return mapRPCMethodStats;
+}
+
+static void WriteHelp(std::string &out, const std::string &name,
+                      const std::string &type, const std::string &help) {
+    out += strprintf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/** Samples of a histogram, labels must be empty or end with a comma */
+static void WriteHistogram(std::string &out, const std::string &name,
+                           const std::string &labels,
+                           const LatencyHistogram &histogram) {
+    uint64_t nCumulative = 0;
+    for (size_t i = 0; i < NUM_LATENCY_BUCKETS; i++) {
+        nCumulative += histogram.vCounts[i];
+        out += strprintf("%s_bucket{%sle=\"%s\"} %d\n", name, labels,
+                         BucketLabel(i), nCumulative);
+    }
+    const std::string braced =
+        labels.empty() ? ""
+                       : "{" + labels.substr(0, labels.size() - 1) + "}";
+    out += strprintf("%s_sum%s %s\n", name, braced,
+                     FormatSeconds(histogram.nSumMicros));
+    out += strprintf("%s_count%s %d\n", name, braced, histogram.nCount);
+}
+
+std::string FormatMetricsText() {
+    const std::map<std::string, RPCMethodStats> stats = GetRPCMethodStats();
+    const HTTPWorkQueueStats queue = GetHTTPWorkQueueStats();
+    std::string out;
+
+    WriteHelp(out, "bitcoin_rpc_duration_seconds", "histogram",
+              "Time spent handling RPC calls, by method.");
+    for (const auto &it : stats) {
+        WriteHistogram(out, "bitcoin_rpc_duration_seconds",
+                       strprintf("method=\"%s\",", it.first),
+                       it.second.latency);
+    }
+    WriteHelp(out, "bitcoin_rpc_errors_total", "counter",
+              "RPC calls that returned an error, by method.");
+    for (const auto &it : stats) {
+        out += strprintf("bitcoin_rpc_errors_total{method=\"%s\"} %d\n",
+                         it.first, it.second.nErrors);
+    }
+    WriteHelp(out, "bitcoin_rpc_cs_main_wait_seconds_total", "counter",
+              "Time RPC calls spent waiting for cs_main, by method.");
+    for (const auto &it : stats) {
+        out += strprintf(
+            "bitcoin_rpc_cs_main_wait_seconds_total{method=\"%s\"} %s\n",
+            it.first, FormatSeconds(it.second.nLockWaitMicros));
+    }
+
+    WriteHelp(out, "bitcoin_http_workqueue_depth", "gauge",
+              "Requests waiting for an HTTP worker.");
+    out += strprintf("bitcoin_http_workqueue_depth %d\n", queue.nDepth);
+    WriteHelp(out, "bitcoin_http_workqueue_max_depth", "gauge",
+              "Configured HTTP work queue depth (-rpcworkqueue).");
+    out += strprintf("bitcoin_http_workqueue_max_depth %d\n",
+                     queue.nMaxDepth);
+    WriteHelp(out, "bitcoin_http_workqueue_peak_depth", "gauge",
+              "Highest HTTP work queue depth reached.");
+    out += strprintf("bitcoin_http_workqueue_peak_depth %d\n",
+                     queue.nPeakDepth);
+    WriteHelp(out, "bitcoin_http_workers", "gauge", "HTTP worker threads.");
+    out += strprintf("bitcoin_http_workers %d\n", queue.nThreads);
+    WriteHelp(out, "bitcoin_http_workers_busy", "gauge",
+              "HTTP worker threads handling a request.");
+    out += strprintf("bitcoin_http_workers_busy %d\n", queue.nBusy);
+    WriteHelp(out, "bitcoin_http_workqueue_enqueued_total", "counter",
+              "Items added to the HTTP work queue.");
+    out += strprintf("bitcoin_http_workqueue_enqueued_total %d\n",
+                     queue.nEnqueued);
+    WriteHelp(out, "bitcoin_http_workqueue_rejected_total", "counter",
+              "Items rejected because the HTTP work queue was full.");
+    out += strprintf("bitcoin_http_workqueue_rejected_total %d\n",
+                     queue.nRejected);
+    WriteHelp(out, "bitcoin_http_workqueue_wait_seconds", "summary",
+              "Time items waited in the HTTP work queue.");
+    out += strprintf("bitcoin_http_workqueue_wait_seconds_sum %s\n",
+                     FormatSeconds(queue.nWaitMicros));
+    out += strprintf("bitcoin_http_workqueue_wait_seconds_count %d\n",
+                     queue.nWaitCount);
+    WriteHelp(out, "bitcoin_http_workqueue_max_wait_seconds", "gauge",
+              "Longest time an item waited in the HTTP work queue.");
+    out += strprintf("bitcoin_http_workqueue_max_wait_seconds %s\n",
+                     FormatSeconds(queue.nMaxWaitMicros));
+    return out;
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2018 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_METRICS_H
+#define BITCOIN_RPC_METRICS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+class UniValue;
+
+/** Upper bounds of the latency histogram buckets, in microseconds */
+static const int64_t LATENCY_BUCKET_BOUNDS[] = {
+    100,    250,    500,     1000,    2500,    5000,    10000,   25000,
+    50000,  100000, 250000,  500000,  1000000, 2500000, 5000000, 10000000};
+/** Number of buckets, including the one for durations above all bounds */
+static const size_t NUM_LATENCY_BUCKETS =
+    sizeof(LATENCY_BUCKET_BOUNDS) / sizeof(LATENCY_BUCKET_BOUNDS[0]) + 1;
+
+/** Distribution of durations over fixed buckets */
+struct LatencyHistogram {
+    /** Number of durations falling into each bucket (not cumulative) */
+    std::array<uint64_t, NUM_LATENCY_BUCKETS> vCounts;
+    uint64_t nCount;
+    int64_t nSumMicros;
+    int64_t nMaxMicros;
+
+    LatencyHistogram() : nCount(0), nSumMicros(0), nMaxMicros(0) {
+        vCounts.fill(0);
+    }
+
+    void Add(int64_t nMicros);
+    UniValue ToJSON() const;
+};
+
+/** Accumulated statistics of one RPC method */
+struct RPCMethodStats {
+    uint64_t nErrors;
+    /** Time spent in the handler, the number of calls is latency.nCount */
+    LatencyHistogram latency;
+    /** Time spent blocked on cs_main within the handler */
+    int64_t nLockWaitMicros;
+
+    RPCMethodStats() : nErrors(0), nLockWaitMicros(0) {}
+};
+
+/** Account one finished call of an RPC method. */
+void RecordRPCCall(const std::string &strMethod, int64_t nMicros,
+                   int64_t nLockWaitMicros, bool fError);
+
+/** Statistics of every RPC method called since startup, by name. */
+std::map<std::string, RPCMethodStats> GetRPCMethodStats();
+
+/**
+ * RPC and HTTP work queue statistics in the Prometheus text exposition
+ * format, as served on /metrics.
+ */
+std::string FormatMetricsText();
+
+#endif // BITCOIN_RPC_METRICS_H
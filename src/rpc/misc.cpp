@@ -8,10 +8,12 @@
 #include "clientversion.h"
 #include "config.h"
 #include "dstencode.h"
+#include "httpserver.h"
 #include "init.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpc/blockchain.h"
+#include "rpc/metrics.h"
 #include "rpc/server.h"
 #include "timedata.h"
 #include "util.h"
@@ -614,6 +616,87 @@ static UniValue getmemoryinfo(const Config &config,
     return obj;
 }
 
+static UniValue getrpcmetrics(const Config &config,
+                              const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() != 0) {
+        throw std::runtime_error(
+            "getrpcmetrics\n"
+            "Returns statistics about RPC calls and the HTTP work queue since "
+            "startup.\n"
+            "Durations are in seconds. Histograms count durations per bucket, "
+            "keyed by the bucket's upper bound.\n"
+            "The same data is served in plain text on /metrics.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"methods\": {              (json object) Statistics by method\n"
+            "    \"method\": {\n"
+            "      \"errors\": n,          (numeric) Calls that failed\n"
+            "      \"cs_main_wait\": x.x,  (numeric) Total time spent "
+            "waiting for cs_main\n"
+            "      \"latency\": {          (json object) Time spent handling "
+            "calls\n"
+            "        \"count\": n,         (numeric) Number of calls\n"
+            "        \"sum\": x.x,         (numeric) Total time\n"
+            "        \"max\": x.x,         (numeric) Longest call\n"
+            "        \"buckets\": {...}    (json object) Calls by duration\n"
+            "      }\n"
+            "    }, ...\n"
+            "  },\n"
+            "  \"workqueue\": {            (json object) HTTP work queue\n"
+            "    \"depth\": n,             (numeric) Requests currently "
+            "queued\n"
+            "    \"max_depth\": n,         (numeric) Configured depth\n"
+            "    \"peak_depth\": n,        (numeric) Highest depth reached\n"
+            "    \"threads\": n,           (numeric) Worker threads\n"
+            "    \"busy\": n,              (numeric) Worker threads handling "
+            "a request\n"
+            "    \"enqueued\": n,          (numeric) Requests queued\n"
+            "    \"rejected\": n,          (numeric) Requests rejected "
+            "because the queue was full\n"
+            "    \"wait\": {             (json object) Time spent queued\n"
+            "      \"count\": n,         (numeric) Requests picked up by a "
+            "worker\n"
+            "      \"sum\": x.x,         (numeric) Total time\n"
+            "      \"max\": x.x,         (numeric) Longest wait\n"
+            "    }\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getrpcmetrics", "") +
+            HelpExampleRpc("getrpcmetrics", ""));
+    }
+
+    UniValue methods(UniValue::VOBJ);
+    for (const auto &it : GetRPCMethodStats()) {
+        UniValue method(UniValue::VOBJ);
+        method.push_back(Pair("errors", it.second.nErrors));
+        method.push_back(
+            Pair("cs_main_wait", it.second.nLockWaitMicros / 1e6));
+        method.push_back(Pair("latency", it.second.latency.ToJSON()));
+        methods.push_back(Pair(it.first, method));
+    }
+
+    const HTTPWorkQueueStats stats = GetHTTPWorkQueueStats();
+    UniValue queue(UniValue::VOBJ);
+    queue.push_back(Pair("depth", uint64_t(stats.nDepth)));
+    queue.push_back(Pair("max_depth", uint64_t(stats.nMaxDepth)));
+    queue.push_back(Pair("peak_depth", uint64_t(stats.nPeakDepth)));
+    queue.push_back(Pair("threads", stats.nThreads));
+    queue.push_back(Pair("busy", stats.nBusy));
+    queue.push_back(Pair("enqueued", stats.nEnqueued));
+    queue.push_back(Pair("rejected", stats.nRejected));
+    UniValue wait(UniValue::VOBJ);
+    wait.push_back(Pair("count", stats.nWaitCount));
+    wait.push_back(Pair("sum", stats.nWaitMicros / 1e6));
+    wait.push_back(Pair("max", stats.nMaxWaitMicros / 1e6));
+    queue.push_back(Pair("wait", wait));
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("methods", methods));
+    obj.push_back(Pair("workqueue", queue));
+    return obj;
+}
+
 static UniValue echo(const Config &config, const JSONRPCRequest &request) {
     if (request.fHelp) {
         throw std::runtime_error(
@@ -634,6 +717,7 @@ static const CRPCCommand commands[] = {
     //  ------------------- ------------------------  ----------------------  ----------
     { "control",            "getinfo",                getinfo,                true,  {} }, /* uses wallet if enabled */
     { "control",            "getmemoryinfo",          getmemoryinfo,          true,  {} },
+    { "control",            "getrpcmetrics",          getrpcmetrics,          true,  {} },
     { "util",               "validateaddress",        validateaddress,        true,  {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         createmultisig,         true,  {"nrequired","keys"} },
     { "util",               "verifymessage",          verifymessage,          true,  {"address","signature","message"} },
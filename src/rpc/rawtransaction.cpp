@@ -1175,17 +1175,17 @@ static UniValue sendrawtransaction(const Config &config,
 
 // clang-format off
 static const CRPCCommand commands[] = {
-    //  category            name                      actor (function)        okSafeMode
-    //  ------------------- ------------------------  ----------------------  ----------
-    { "rawtransactions",    "getrawtransaction",      getrawtransaction,      true,  {"txid","verbose"} },
-    { "rawtransactions",    "createrawtransaction",   createrawtransaction,   true,  {"inputs","outputs","locktime"} },
-    { "rawtransactions",    "decoderawtransaction",   decoderawtransaction,   true,  {"hexstring"} },
-    { "rawtransactions",    "decodescript",           decodescript,           true,  {"hexstring"} },
-    { "rawtransactions",    "sendrawtransaction",     sendrawtransaction,     false, {"hexstring","allowhighfees"} },
-    { "rawtransactions",    "signrawtransaction",     signrawtransaction,     false, {"hexstring","prevtxs","privkeys","sighashtype"} }, /* uses wallet if enabled */
-
-    { "blockchain",         "gettxoutproof",          gettxoutproof,          true,  {"txids", "blockhash"} },
-    { "blockchain",         "verifytxoutproof",       verifytxoutproof,       true,  {"proof"} },
+    //  category            name                      actor (function)        okSafe argNames                                           parallel
+    //  ------------------- ------------------------  ----------------------  ------ ----------                                         --------
+    { "rawtransactions",    "getrawtransaction",      getrawtransaction,      true,  {"txid","verbose"},                                true  },
+    { "rawtransactions",    "createrawtransaction",   createrawtransaction,   true,  {"inputs","outputs","locktime"},                   true  },
+    { "rawtransactions",    "decoderawtransaction",   decoderawtransaction,   true,  {"hexstring"},                                     true  },
+    { "rawtransactions",    "decodescript",           decodescript,           true,  {"hexstring"},                                     true  },
+    { "rawtransactions",    "sendrawtransaction",     sendrawtransaction,     false, {"hexstring","allowhighfees"},                     false },
+    { "rawtransactions",    "signrawtransaction",     signrawtransaction,     false, {"hexstring","prevtxs","privkeys","sighashtype"},  false }, /* uses wallet if enabled */
+
+    { "blockchain",         "gettxoutproof",          gettxoutproof,          true,  {"txids", "blockhash"},                            true  },
+    { "blockchain",         "verifytxoutproof",       verifytxoutproof,       true,  {"proof"},                                         true  },
 };
 // clang-format on
 
@@ -10,10 +10,12 @@
 #include "fs.h"
 #include "init.h"
 #include "random.h"
+#include "rpc/metrics.h"
 #include "sync.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "validation.h"
 
 #include <univalue.h>
 
@@ -22,7 +24,9 @@
 #include <boost/signals2/signal.hpp>
 #include <boost/thread.hpp>
 
+#include <condition_variable>
 #include <memory> // for unique_ptr
+#include <mutex>
 #include <set>
 #include <unordered_map>
 
@@ -30,6 +34,8 @@ static bool fRPCRunning = false;
 static bool fRPCInWarmup = true;
 static std::string rpcWarmupStatus("RPC server started");
 static CCriticalSection cs_rpcWarmup;
+/* Maximum number of elements of one batch executing at the same time */
+static int nRPCBatchConcurrency = DEFAULT_RPC_BATCH_CONCURRENCY;
 /* Timer-creating functions */
 static RPCTimerInterface *timerInterface = nullptr;
 /* Map of name to timer. */
@@ -324,6 +330,9 @@ bool CRPCTable::appendCommand(const std::string &name,
 
 bool StartRPC() {
     LogPrint(BCLog::RPC, "Starting RPC\n");
+    nRPCBatchConcurrency = std::max<int>(
+        gArgs.GetArg("-rpcbatchconcurrency", DEFAULT_RPC_BATCH_CONCURRENCY),
+        1);
     fRPCRunning = true;
     g_rpcSignals.Started();
     return true;
@@ -413,13 +422,100 @@ static UniValue JSONRPCExecOne(Config &config, JSONRPCRequest jreq,
     return rpc_result;
 }
 
+/** Whether a batch element calls a command flagged as parallel-safe */
+static bool IsParallelSafeRequest(const UniValue &req) {
+    if (!req.isObject()) {
+        return false;
+    }
+    const UniValue &method = find_value(req, "method");
+    if (!method.isStr()) {
+        return false;
+    }
+    const CRPCCommand *pcmd = tableRPC[method.get_str()];
+    return pcmd && pcmd->fParallelSafe;
+}
+
+/**
+ * A run of batch elements being executed by several threads. Each thread
+ * claims the next element until none are left.
+ */
+struct RPCBatchRun {
+    std::mutex cs;
+    std::condition_variable cond;
+    size_t nNext;
+    size_t nEnd;
+    /** Number of claimed elements still executing */
+    int nRunning;
+
+    Config *config;
+    const JSONRPCRequest *jreq;
+    const UniValue *vReq;
+    std::vector<UniValue> *results;
+
+    /** Execute elements until all have been claimed */
+    void Work() {
+        std::unique_lock<std::mutex> lock(cs);
+        while (nNext < nEnd) {
+            size_t i = nNext++;
+            nRunning++;
+            lock.unlock();
+            (*results)[i] = JSONRPCExecOne(*config, *jreq, (*vReq)[i]);
+            lock.lock();
+            nRunning--;
+        }
+        cond.notify_all();
+    }
+};
+
 std::string JSONRPCExecBatch(Config &config, const JSONRPCRequest &jreq,
-                             const UniValue &vReq) {
-    UniValue ret(UniValue::VARR);
-    for (size_t i = 0; i < vReq.size(); i++) {
-        ret.push_back(JSONRPCExecOne(config, jreq, vReq[i]));
+                             const UniValue &vReq,
+                             const RPCTaskRunner &runTask) {
+    std::vector<UniValue> results(vReq.size());
+    size_t i = 0;
+    while (i < vReq.size()) {
+        size_t end = i;
+        while (end < vReq.size() && IsParallelSafeRequest(vReq[end])) {
+            end++;
+        }
+        if (end - i < 2 || !runTask || nRPCBatchConcurrency < 2) {
+            // Run on its own, after everything before it has finished
+            results[i] = JSONRPCExecOne(config, jreq, vReq[i]);
+            i++;
+            continue;
+        }
+
+        auto run = std::make_shared<RPCBatchRun>();
+        run->nNext = i;
+        run->nEnd = end;
+        run->nRunning = 0;
+        run->config = &config;
+        run->jreq = &jreq;
+        run->vReq = &vReq;
+        run->results = &results;
+
+        // Helpers that only get to run after all elements were claimed exit
+        // without touching anything but the run itself. This thread works
+        // on the run too, so it never waits for a helper that did not start.
+        size_t nHelpers =
+            std::min<size_t>(nRPCBatchConcurrency - 1, end - i - 1);
+        for (size_t n = 0; n < nHelpers; n++) {
+            if (!runTask([run]() { run->Work(); })) {
+                break;
+            }
+        }
+        run->Work();
+        {
+            std::unique_lock<std::mutex> lock(run->cs);
+            while (run->nRunning > 0) {
+                run->cond.wait(lock);
+            }
+        }
+        i = end;
     }
 
+    UniValue ret(UniValue::VARR);
+    ret.push_backV(results);
+
     return ret.write() + "\n";
 }
 
@@ -467,6 +563,29 @@ transformNamedArguments(const JSONRPCRequest &in,
     return out;
 }
 
+/**
+ * Wrap the result writer of a streaming call to account the call, including
+ * the time spent writing the result, once it is done.
+ */
+static RPCResultWriter TimedResultWriter(const std::string &strMethod,
+                                         const RPCResultWriter &write,
+                                         int64_t nMicros,
+                                         int64_t nLockWaitMicros) {
+    return [=](JSONWriter &writer) {
+        const int64_t nStart = GetTimeMicros();
+        LockWaitTimer lockWait(&cs_main);
+        try {
+            write(writer);
+        } catch (...) {
+            RecordRPCCall(strMethod, nMicros + GetTimeMicros() - nStart,
+                          nLockWaitMicros + lockWait.GetWaitMicros(), true);
+            throw;
+        }
+        RecordRPCCall(strMethod, nMicros + GetTimeMicros() - nStart,
+                      nLockWaitMicros + lockWait.GetWaitMicros(), false);
+    };
+}
+
 UniValue CRPCTable::execute(Config &config,
                             const JSONRPCRequest &request) const {
     // Return immediately if in warmup
@@ -481,19 +600,41 @@ UniValue CRPCTable::execute(Config &config,
 
     g_rpcSignals.PreCommand(*pcmd);
 
+    // Time the call, including how long it is blocked on cs_main
+    const int64_t nStart = GetTimeMicros();
+    LockWaitTimer lockWait(&cs_main);
+    UniValue result;
     try {
         // Execute, convert arguments to array if necessary
         if (request.params.isObject()) {
-            return pcmd->call(config,
-                              transformNamedArguments(request, pcmd->argNames));
+            result = pcmd->call(
+                config, transformNamedArguments(request, pcmd->argNames));
         } else {
-            return pcmd->call(config, request);
+            result = pcmd->call(config, request);
         }
     } catch (const std::exception &e) {
+        RecordRPCCall(pcmd->name, GetTimeMicros() - nStart,
+                      lockWait.GetWaitMicros(), true);
         throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    } catch (...) {
+        RecordRPCCall(pcmd->name, GetTimeMicros() - nStart,
+                      lockWait.GetWaitMicros(), true);
+        throw;
+    }
+
+    if (request.resultWriter && *request.resultWriter) {
+        // The result is streamed after we return, so the call is only
+        // accounted once it has been written.
+        *request.resultWriter = TimedResultWriter(
+            pcmd->name, *request.resultWriter, GetTimeMicros() - nStart,
+            lockWait.GetWaitMicros());
+    } else {
+        RecordRPCCall(pcmd->name, GetTimeMicros() - nStart,
+                      lockWait.GetWaitMicros(), false);
     }
 
     g_rpcSignals.PostCommand(*pcmd);
+    return result;
 }
 
 std::vector<std::string> CRPCTable::listCommands() const {
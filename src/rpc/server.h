@@ -32,6 +32,10 @@ void OnPostCommand(std::function<void(const CRPCCommand &)> slot);
 class CBlockIndex;
 class Config;
 class CNetAddr;
+class JSONWriter;
+
+/** Writes the result of an RPC command to a JSONWriter */
+typedef std::function<void(JSONWriter &writer)> RPCResultWriter;
 
 /** Wrapper for UniValue::VType, which includes typeAny:
  * Used to denote don't care type. Only used by RPCTypeCheckObj */
@@ -50,11 +54,20 @@ public:
     bool fHelp;
     std::string URI;
     std::string authUser;
+    /**
+     * Set when the transport can stream the result. A command with a large
+     * result may then store a function writing it here and return
+     * NullUniValue, instead of building the result as a UniValue. The
+     * function runs after the command returned, so it must not rely on any
+     * locks the command held.
+     */
+    RPCResultWriter *resultWriter;
 
     JSONRPCRequest() {
         id = NullUniValue;
         params = NullUniValue;
         fHelp = false;
+        resultWriter = nullptr;
     }
 
     void parse(const UniValue &valRequest);
@@ -159,12 +172,18 @@ private:
 
 public:
     std::vector<std::string> argNames;
+    /**
+     * Whether calls have no side effects, so the elements of a batch calling
+     * it may run concurrently and in any order.
+     */
+    bool fParallelSafe;
 
     CRPCCommand(std::string _category, std::string _name, rpcfn_type _actor,
-                bool _okSafeMode, std::vector<std::string> _argNames)
+                bool _okSafeMode, std::vector<std::string> _argNames,
+                bool _fParallelSafe = false)
         : category{std::move(_category)}, name{std::move(_name)},
-          okSafeMode{_okSafeMode}, useConstConfig{false}, argNames{std::move(
-                                                              _argNames)} {
+          okSafeMode{_okSafeMode}, useConstConfig{false},
+          argNames{std::move(_argNames)}, fParallelSafe{_fParallelSafe} {
         actor.fn = _actor;
     }
 
@@ -175,10 +194,11 @@ public:
      */
     CRPCCommand(std::string _category, std::string _name,
                 const_rpcfn_type _actor, bool _okSafeMode,
-                std::vector<std::string> _argNames)
+                std::vector<std::string> _argNames,
+                bool _fParallelSafe = false)
         : category{std::move(_category)}, name{std::move(_name)},
-          okSafeMode{_okSafeMode}, useConstConfig{true}, argNames{std::move(
-                                                             _argNames)} {
+          okSafeMode{_okSafeMode}, useConstConfig{true},
+          argNames{std::move(_argNames)}, fParallelSafe{_fParallelSafe} {
         actor.cfn = _actor;
     }
 
@@ -242,11 +262,27 @@ extern std::string HelpExampleCli(const std::string &methodname,
 extern std::string HelpExampleRpc(const std::string &methodname,
                                   const std::string &args);
 
+/** Default for -rpcbatchconcurrency */
+static const int DEFAULT_RPC_BATCH_CONCURRENCY = 4;
+
+/**
+ * Runs a task on another thread, for JSONRPCExecBatch. Returns false if the
+ * task could not be queued, in which case it is not run.
+ */
+typedef std::function<bool(const std::function<void()> &task)> RPCTaskRunner;
+
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
+/**
+ * Execute a batch of requests and return the array of replies, in the order
+ * of the requests. Runs of consecutive requests for parallel-safe commands
+ * are spread over runTask's threads, up to -rpcbatchconcurrency at a time;
+ * every other request runs on its own once those before it have finished.
+ */
 std::string JSONRPCExecBatch(Config &config, const JSONRPCRequest &req,
-                             const UniValue &vReq);
+                             const UniValue &vReq,
+                             const RPCTaskRunner &runTask = nullptr);
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
 // Retrieves any serialization flags requested in command line argument
@@ -13,7 +13,9 @@
 #include "script/script.h"
 #include "uint256.h"
 
-typedef std::vector<uint8_t> valtype;
+#include <cstring>
+
+typedef CScriptStackElement valtype;
 
 namespace {
 
@@ -31,6 +33,41 @@ inline bool set_error(ScriptError *ret, const ScriptError serror) {
     return false;
 }
 
+/**
+ * Interpreter stack borrowed from a per thread pool. Script check threads
+ * evaluate one script after another, so recycling the buffers spares growing
+ * new stacks for every input. Each PooledStack owns its buffer while alive,
+ * which keeps the stacks of nested evaluations independent.
+ */
+class PooledStack {
+public:
+    std::vector<valtype> stack;
+
+    PooledStack() {
+        std::vector<std::vector<valtype>> &pool = GetPool();
+        if (!pool.empty()) {
+            stack.swap(pool.back());
+            pool.pop_back();
+        }
+    }
+
+    ~PooledStack() {
+        std::vector<std::vector<valtype>> &pool = GetPool();
+        if (pool.size() < MAX_POOLED_STACKS) {
+            stack.clear();
+            pool.push_back(std::move(stack));
+        }
+    }
+
+private:
+    static const size_t MAX_POOLED_STACKS = 8;
+
+    static std::vector<std::vector<valtype>> &GetPool() {
+        static thread_local std::vector<std::vector<valtype>> pool;
+        return pool;
+    }
+};
+
 } // namespace
 
 bool CastToBool(const valtype &vch) {
@@ -104,7 +141,7 @@ static bool IsCompressedPubKey(const valtype &vchPubKey) {
  *
  * This function is consensus-critical since BIP66.
  */
-static bool IsValidSignatureEncoding(const std::vector<uint8_t> &sig) {
+template <typename T> static bool IsValidSignatureEncoding(const T &sig) {
     // Format: 0x30 [total-length] 0x02 [R-length] [R] 0x02 [S-length] [S]
     // [sighash]
     // * total-length: 1-byte length descriptor of everything that follows,
@@ -173,7 +210,8 @@ static bool IsValidSignatureEncoding(const std::vector<uint8_t> &sig) {
     return true;
 }
 
-static bool IsLowDERSignature(const valtype &vchSig, ScriptError *serror) {
+template <typename T>
+static bool IsLowDERSignature(const T &vchSig, ScriptError *serror) {
     if (!IsValidSignatureEncoding(vchSig)) {
         return set_error(serror, SCRIPT_ERR_SIG_DER);
     }
@@ -185,7 +223,7 @@ static bool IsLowDERSignature(const valtype &vchSig, ScriptError *serror) {
     return true;
 }
 
-static SigHashType GetHashType(const valtype &vchSig) {
+template <typename T> static SigHashType GetHashType(const T &vchSig) {
     if (vchSig.size() == 0) {
         return SigHashType(0);
     }
@@ -193,18 +231,19 @@ static SigHashType GetHashType(const valtype &vchSig) {
     return SigHashType(vchSig[vchSig.size() - 1]);
 }
 
-static void CleanupScriptCode(CScript &scriptCode,
-                              const std::vector<uint8_t> &vchSig,
+static void CleanupScriptCode(CScript &scriptCode, const valtype &vchSig,
                               uint32_t flags) {
     // Drop the signature in scripts when SIGHASH_FORKID is not used.
     SigHashType sigHashType = GetHashType(vchSig);
     if (!(flags & SCRIPT_ENABLE_SIGHASH_FORKID) || !sigHashType.hasForkId()) {
-        scriptCode.FindAndDelete(CScript(vchSig));
+        scriptCode.FindAndDelete(
+            CScript(std::vector<uint8_t>(vchSig.begin(), vchSig.end())));
     }
 }
 
-bool CheckSignatureEncoding(const std::vector<uint8_t> &vchSig, uint32_t flags,
-                            ScriptError *serror) {
+template <typename T>
+static bool CheckSignatureEncodingImpl(const T &vchSig, uint32_t flags,
+                                       ScriptError *serror) {
     // Empty signature. Not strictly DER encoded, but allowed to provide a
     // compact way to provide an invalid signature for use with CHECK(MULTI)SIG
     if (vchSig.size() == 0) {
@@ -236,6 +275,16 @@ bool CheckSignatureEncoding(const std::vector<uint8_t> &vchSig, uint32_t flags,
     return true;
 }
 
+bool CheckSignatureEncoding(const std::vector<uint8_t> &vchSig, uint32_t flags,
+                            ScriptError *serror) {
+    return CheckSignatureEncodingImpl(vchSig, flags, serror);
+}
+
+bool CheckSignatureEncoding(const valtype &vchSig, uint32_t flags,
+                            ScriptError *serror) {
+    return CheckSignatureEncodingImpl(vchSig, flags, serror);
+}
+
 static bool CheckPubKeyEncoding(const valtype &vchPubKey, uint32_t flags,
                                 ScriptError *serror) {
     if ((flags & SCRIPT_VERIFY_STRICTENC) != 0 &&
@@ -251,7 +300,8 @@ static bool CheckPubKeyEncoding(const valtype &vchPubKey, uint32_t flags,
     return true;
 }
 
-static bool CheckMinimalPush(const valtype &data, opcodetype opcode) {
+static bool CheckMinimalPush(const std::vector<uint8_t> &data,
+                             opcodetype opcode) {
     if (data.size() == 0) {
         // Could have used OP_0.
         return opcode == OP_0;
@@ -317,16 +367,17 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
                 ScriptError *serror) {
     static const CScriptNum bnZero(0);
     static const CScriptNum bnOne(1);
-    static const valtype vchFalse(0);
-    static const valtype vchTrue(1, 1);
+    static const valtype vchFalse;
+    static const valtype vchTrue(1U, uint8_t(1));
 
     CScript::const_iterator pc = script.begin();
     CScript::const_iterator pend = script.end();
     CScript::const_iterator pbegincodehash = script.begin();
     opcodetype opcode;
-    valtype vchPushValue;
+    std::vector<uint8_t> vchPushValue;
     std::vector<bool> vfExec;
-    std::vector<valtype> altstack;
+    PooledStack pooledAltstack;
+    std::vector<valtype> &altstack = pooledAltstack.stack;
     set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
     if (script.size() > MAX_SCRIPT_SIZE) {
         return set_error(serror, SCRIPT_ERR_SCRIPT_SIZE);
@@ -363,7 +414,7 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
                     !CheckMinimalPush(vchPushValue, opcode)) {
                     return set_error(serror, SCRIPT_ERR_MINIMALDATA);
                 }
-                stack.push_back(vchPushValue);
+                stack.emplace_back(vchPushValue.begin(), vchPushValue.end());
             } else if (fExec || (OP_IF <= opcode && opcode <= OP_ENDIF)) {
                 switch (opcode) {
                     //
@@ -388,7 +439,7 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
                     case OP_16: {
                         // ( -- value)
                         CScriptNum bn((int)opcode - (int)(OP_1 - 1));
-                        stack.push_back(bn.getvch());
+                        stack.push_back(bn.getstackelement());
                         // The result of these opcodes should always be the
                         // minimal way to push the data they push, so no need
                         // for a CheckMinimalPush here.
@@ -668,8 +719,8 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
                             return set_error(
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
-                        swap(stacktop(-4), stacktop(-2));
-                        swap(stacktop(-3), stacktop(-1));
+                        std::swap(stacktop(-4), stacktop(-2));
+                        std::swap(stacktop(-3), stacktop(-1));
                     } break;
 
                     case OP_IFDUP: {
@@ -687,7 +738,7 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
                     case OP_DEPTH: {
                         // -- stacksize
                         CScriptNum bn(stack.size());
-                        stack.push_back(bn.getvch());
+                        stack.push_back(bn.getstackelement());
                     } break;
 
                     case OP_DROP: {
@@ -758,8 +809,8 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
                             return set_error(
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
-                        swap(stacktop(-3), stacktop(-2));
-                        swap(stacktop(-2), stacktop(-1));
+                        std::swap(stacktop(-3), stacktop(-2));
+                        std::swap(stacktop(-2), stacktop(-1));
                     } break;
 
                     case OP_SWAP: {
@@ -768,7 +819,7 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
                             return set_error(
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
-                        swap(stacktop(-2), stacktop(-1));
+                        std::swap(stacktop(-2), stacktop(-1));
                     } break;
 
                     case OP_TUCK: {
@@ -788,7 +839,7 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
                         CScriptNum bn(stacktop(-1).size());
-                        stack.push_back(bn.getvch());
+                        stack.push_back(bn.getstackelement());
                     } break;
 
                     //
@@ -910,7 +961,7 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
                                 break;
                         }
                         popstack(stack);
-                        stack.push_back(bn.getvch());
+                        stack.push_back(bn.getstackelement());
                     } break;
 
                     case OP_ADD:
@@ -1002,7 +1053,7 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
                         }
                         popstack(stack);
                         popstack(stack);
-                        stack.push_back(bn.getvch());
+                        stack.push_back(bn.getstackelement());
 
                         if (opcode == OP_NUMEQUALVERIFY) {
                             if (CastToBool(stacktop(-1))) {
@@ -1044,11 +1095,12 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
                                 serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                         }
                         valtype &vch = stacktop(-1);
-                        valtype vchHash((opcode == OP_RIPEMD160 ||
-                                         opcode == OP_SHA1 ||
-                                         opcode == OP_HASH160)
-                                            ? 20
-                                            : 32);
+                        valtype vchHash;
+                        vchHash.resize((opcode == OP_RIPEMD160 ||
+                                        opcode == OP_SHA1 ||
+                                        opcode == OP_HASH160)
+                                           ? 20
+                                           : 32);
                         if (opcode == OP_RIPEMD160) {
                             CRIPEMD160()
                                 .Write(vch.data(), vch.size())
@@ -1389,6 +1441,24 @@ bool EvalScript(std::vector<valtype> &stack, const CScript &script,
     return set_success(serror);
 }
 
+bool EvalScript(std::vector<std::vector<uint8_t>> &stack, const CScript &script,
+                uint32_t flags, const BaseSignatureChecker &checker,
+                ScriptError *serror) {
+    PooledStack pooledStack;
+    std::vector<valtype> &elements = pooledStack.stack;
+    for (const std::vector<uint8_t> &vch : stack) {
+        elements.emplace_back(vch.begin(), vch.end());
+    }
+
+    bool fSuccess = EvalScript(elements, script, flags, checker, serror);
+
+    stack.clear();
+    for (const valtype &vch : elements) {
+        stack.emplace_back(vch.begin(), vch.end());
+    }
+    return fSuccess;
+}
+
 namespace {
 
 /**
@@ -1627,16 +1697,17 @@ bool TransactionSignatureChecker::VerifySignature(
     return pubkey.Verify(sighash, vchSig);
 }
 
-bool TransactionSignatureChecker::CheckSig(
-    const std::vector<uint8_t> &vchSigIn, const std::vector<uint8_t> &vchPubKey,
-    const CScript &scriptCode, uint32_t flags) const {
-    CPubKey pubkey(vchPubKey);
+bool TransactionSignatureChecker::CheckSig(const valtype &vchSigIn,
+                                           const valtype &vchPubKey,
+                                           const CScript &scriptCode,
+                                           uint32_t flags) const {
+    CPubKey pubkey(vchPubKey.begin(), vchPubKey.end());
     if (!pubkey.IsValid()) {
         return false;
     }
 
     // Hash type is one byte tacked on to the end of the signature
-    std::vector<uint8_t> vchSig(vchSigIn);
+    std::vector<uint8_t> vchSig(vchSigIn.begin(), vchSigIn.end());
     if (vchSig.empty()) {
         return false;
     }
@@ -1741,9 +1812,9 @@ bool TransactionSignatureChecker::CheckSequence(
     return true;
 }
 
-bool VerifyScript(const CScript &scriptSig, const CScript &scriptPubKey,
-                  uint32_t flags, const BaseSignatureChecker &checker,
-                  ScriptError *serror) {
+bool VerifyScriptGeneric(const CScript &scriptSig, const CScript &scriptPubKey,
+                         uint32_t flags, const BaseSignatureChecker &checker,
+                         ScriptError *serror) {
     set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
 
     // If FORKID is enabled, we also ensure strict encoding.
@@ -1755,7 +1826,9 @@ bool VerifyScript(const CScript &scriptSig, const CScript &scriptPubKey,
         return set_error(serror, SCRIPT_ERR_SIG_PUSHONLY);
     }
 
-    std::vector<valtype> stack, stackCopy;
+    PooledStack pooledStack, pooledStackCopy;
+    std::vector<valtype> &stack = pooledStack.stack;
+    std::vector<valtype> &stackCopy = pooledStackCopy.stack;
     if (!EvalScript(stack, scriptSig, flags, checker, serror)) {
         // serror is set
         return false;
@@ -1782,7 +1855,7 @@ bool VerifyScript(const CScript &scriptSig, const CScript &scriptPubKey,
         }
 
         // Restore stack.
-        swap(stack, stackCopy);
+        stack.swap(stackCopy);
 
         // stack cannot be empty here, because if it was the P2SH  HASH <> EQUAL
         // scriptPubKey would be evaluated with an empty stack and the
@@ -1790,7 +1863,8 @@ bool VerifyScript(const CScript &scriptSig, const CScript &scriptPubKey,
         assert(!stack.empty());
 
         const valtype &pubKeySerialized = stack.back();
-        CScript pubKey2(pubKeySerialized.begin(), pubKeySerialized.end());
+        CScript pubKey2(pubKeySerialized.data(),
+                        pubKeySerialized.data() + pubKeySerialized.size());
         popstack(stack);
 
         if (!EvalScript(stack, pubKey2, flags, checker, serror)) {
@@ -1821,3 +1895,293 @@ bool VerifyScript(const CScript &scriptSig, const CScript &scriptPubKey,
 
     return set_success(serror);
 }
+
+namespace {
+
+/**
+ * Collect the elements a scriptSig made only of data pushes leaves on the
+ * stack. Returns false for anything else, including any push EvalScript would
+ * reject, so that the caller falls back to the generic interpreter which
+ * reports the exact error.
+ */
+bool GetScriptSigPushes(const CScript &scriptSig, uint32_t flags,
+                        std::vector<valtype> &stack) {
+    if (scriptSig.size() > MAX_SCRIPT_SIZE) {
+        return false;
+    }
+
+    CScript::const_iterator pc = scriptSig.begin();
+    opcodetype opcode;
+    std::vector<uint8_t> vchPushValue;
+    while (pc < scriptSig.end()) {
+        if (!scriptSig.GetOp(pc, opcode, vchPushValue) ||
+            opcode > OP_PUSHDATA4 ||
+            vchPushValue.size() > MAX_SCRIPT_ELEMENT_SIZE) {
+            return false;
+        }
+        if ((flags & SCRIPT_VERIFY_MINIMALDATA) &&
+            !CheckMinimalPush(vchPushValue, opcode)) {
+            return false;
+        }
+        // No template needs more than the multisig dummy, the signatures and
+        // a redeem script.
+        if (stack.size() > MAX_PUBKEYS_PER_MULTISIG + 1) {
+            return false;
+        }
+        stack.emplace_back(vchPushValue.begin(), vchPushValue.end());
+    }
+    return true;
+}
+
+bool MatchPayToPubKeyHash(const CScript &script) {
+    return script.size() == 25 && script[0] == OP_DUP &&
+           script[1] == OP_HASH160 && script[2] == 20 &&
+           script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG;
+}
+
+bool MatchPayToPubKey(const CScript &script, valtype &pubkey) {
+    if (script.size() != 35 && script.size() != 67) {
+        return false;
+    }
+    if (script[0] != script.size() - 2 || script.back() != OP_CHECKSIG) {
+        return false;
+    }
+    pubkey.assign(script.begin() + 1, script.end() - 1);
+    return true;
+}
+
+/**
+ * Match OP_m <pubkey>... OP_n OP_CHECKMULTISIG with 1 <= m <= n, where every
+ * key is a direct push of 33 or 65 bytes.
+ */
+bool MatchMultisig(const CScript &script, int &nRequired,
+                   std::vector<valtype> &pubkeys) {
+    CScript::const_iterator pc = script.begin();
+    opcodetype opcode;
+    std::vector<uint8_t> data;
+    if (!script.GetOp(pc, opcode, data) || opcode < OP_1 || opcode > OP_16) {
+        return false;
+    }
+    nRequired = CScript::DecodeOP_N(opcode);
+
+    pubkeys.clear();
+    while (script.GetOp(pc, opcode, data) &&
+           (opcode == 33 || opcode == 65)) {
+        pubkeys.emplace_back(data.begin(), data.end());
+    }
+    if (opcode < OP_1 || opcode > OP_16 ||
+        CScript::DecodeOP_N(opcode) != int(pubkeys.size()) ||
+        nRequired > int(pubkeys.size())) {
+        return false;
+    }
+
+    return script.GetOp(pc, opcode) && opcode == OP_CHECKMULTISIG &&
+           pc == script.end();
+}
+
+/**
+ * Equivalent of OP_CHECKSIG followed by the final checks of VerifyScript, for
+ * a script consisting of nothing else than the signature check.
+ */
+bool FastCheckSig(const valtype &vchSig, const valtype &vchPubKey,
+                  const CScript &script, uint32_t flags,
+                  const BaseSignatureChecker &checker, ScriptError *serror) {
+    if (!CheckSignatureEncoding(vchSig, flags, serror) ||
+        !CheckPubKeyEncoding(vchPubKey, flags, serror)) {
+        // serror is set
+        return false;
+    }
+
+    CScript scriptCode(script.begin(), script.end());
+    CleanupScriptCode(scriptCode, vchSig, flags);
+
+    bool fSuccess = checker.CheckSig(vchSig, vchPubKey, scriptCode, flags);
+    if (!fSuccess && (flags & SCRIPT_VERIFY_NULLFAIL) && vchSig.size()) {
+        return set_error(serror, SCRIPT_ERR_SIG_NULLFAIL);
+    }
+    if (!fSuccess) {
+        return set_error(serror, SCRIPT_ERR_EVAL_FALSE);
+    }
+    return set_success(serror);
+}
+
+/**
+ * Equivalent of OP_CHECKMULTISIG followed by the final checks of
+ * VerifyScript. The stack holds the dummy element followed by exactly
+ * nRequired signatures. Signatures and keys are consumed in the same order as
+ * in EvalScript, so that failures are reported identically.
+ */
+bool FastCheckMultiSig(const std::vector<valtype> &stack, int nRequired,
+                       const std::vector<valtype> &pubkeys,
+                       const CScript &script, uint32_t flags,
+                       const BaseSignatureChecker &checker,
+                       ScriptError *serror) {
+    CScript scriptCode(script.begin(), script.end());
+
+    // Remove signature for pre-fork scripts
+    for (int k = nRequired; k > 0; k--) {
+        CleanupScriptCode(scriptCode, stack[k], flags);
+    }
+
+    int nSigsCount = nRequired;
+    int nKeysCount = pubkeys.size();
+    int isig = nRequired;
+    int ikey = nKeysCount - 1;
+    bool fSuccess = true;
+    while (fSuccess && nSigsCount > 0) {
+        const valtype &vchSig = stack[isig];
+        const valtype &vchPubKey = pubkeys[ikey];
+
+        if (!CheckSignatureEncoding(vchSig, flags, serror) ||
+            !CheckPubKeyEncoding(vchPubKey, flags, serror)) {
+            // serror is set
+            return false;
+        }
+
+        if (checker.CheckSig(vchSig, vchPubKey, scriptCode, flags)) {
+            isig--;
+            nSigsCount--;
+        }
+        ikey--;
+        nKeysCount--;
+
+        if (nSigsCount > nKeysCount) {
+            fSuccess = false;
+        }
+    }
+
+    if (!fSuccess && (flags & SCRIPT_VERIFY_NULLFAIL)) {
+        for (int k = 1; k <= nRequired; k++) {
+            if (stack[k].size()) {
+                return set_error(serror, SCRIPT_ERR_SIG_NULLFAIL);
+            }
+        }
+    }
+    if ((flags & SCRIPT_VERIFY_NULLDUMMY) && stack[0].size()) {
+        return set_error(serror, SCRIPT_ERR_SIG_NULLDUMMY);
+    }
+    if (!fSuccess) {
+        return set_error(serror, SCRIPT_ERR_EVAL_FALSE);
+    }
+    return set_success(serror);
+}
+
+} // namespace
+
+bool VerifyScriptFastPath(const CScript &scriptSig,
+                          const CScript &scriptPubKey, uint32_t flags,
+                          const BaseSignatureChecker &checker, bool &fSuccess,
+                          ScriptError *serror) {
+    // If FORKID is enabled, we also ensure strict encoding.
+    if (flags & SCRIPT_ENABLE_SIGHASH_FORKID) {
+        flags |= SCRIPT_VERIFY_STRICTENC;
+    }
+
+    // Leave the invalid CLEANSTACK without P2SH combination to the generic
+    // path, which asserts on it.
+    if ((flags & SCRIPT_VERIFY_CLEANSTACK) &&
+        !(flags & SCRIPT_VERIFY_P2SH)) {
+        return false;
+    }
+
+    PooledStack pooledStack;
+    std::vector<valtype> &stack = pooledStack.stack;
+    if (!GetScriptSigPushes(scriptSig, flags, stack)) {
+        return false;
+    }
+
+    int nRequired;
+    valtype vchPubKey;
+    PooledStack pooledPubkeys;
+    std::vector<valtype> &pubkeys = pooledPubkeys.stack;
+
+    // Signature checking may throw, which EvalScript reports as an unknown
+    // error.
+    try {
+        if (MatchPayToPubKeyHash(scriptPubKey)) {
+            if (stack.size() != 2) {
+                return false;
+            }
+
+            uint160 hash;
+            CHash160()
+                .Write(stack[1].data(), stack[1].size())
+                .Finalize(hash.begin());
+            if (memcmp(hash.begin(), &scriptPubKey[3], 20) != 0) {
+                fSuccess = set_error(serror, SCRIPT_ERR_EQUALVERIFY);
+                return true;
+            }
+
+            fSuccess = FastCheckSig(stack[0], stack[1], scriptPubKey, flags,
+                                    checker, serror);
+            return true;
+        }
+
+        if (MatchPayToPubKey(scriptPubKey, vchPubKey)) {
+            if (stack.size() != 1) {
+                return false;
+            }
+
+            fSuccess = FastCheckSig(stack[0], vchPubKey, scriptPubKey, flags,
+                                    checker, serror);
+            return true;
+        }
+
+        if (MatchMultisig(scriptPubKey, nRequired, pubkeys)) {
+            if (int(stack.size()) != nRequired + 1) {
+                return false;
+            }
+
+            fSuccess = FastCheckMultiSig(stack, nRequired, pubkeys,
+                                         scriptPubKey, flags, checker, serror);
+            return true;
+        }
+
+        if ((flags & SCRIPT_VERIFY_P2SH) && scriptPubKey.IsPayToScriptHash()) {
+            if (stack.empty()) {
+                return false;
+            }
+
+            const valtype &vchRedeemScript = stack.back();
+            CScript redeemScript(vchRedeemScript.data(),
+                                 vchRedeemScript.data() +
+                                     vchRedeemScript.size());
+            if (!MatchMultisig(redeemScript, nRequired, pubkeys) ||
+                int(stack.size()) != nRequired + 2) {
+                return false;
+            }
+
+            uint160 hash;
+            CHash160()
+                .Write(vchRedeemScript.data(), vchRedeemScript.size())
+                .Finalize(hash.begin());
+            if (memcmp(hash.begin(), &scriptPubKey[2], 20) != 0) {
+                fSuccess = set_error(serror, SCRIPT_ERR_EVAL_FALSE);
+                return true;
+            }
+
+            stack.pop_back();
+            fSuccess = FastCheckMultiSig(stack, nRequired, pubkeys,
+                                         redeemScript, flags, checker, serror);
+            return true;
+        }
+    } catch (...) {
+        fSuccess = set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
+        return true;
+    }
+
+    return false;
+}
+
+bool VerifyScript(const CScript &scriptSig, const CScript &scriptPubKey,
+                  uint32_t flags, const BaseSignatureChecker &checker,
+                  ScriptError *serror) {
+    bool fSuccess;
+    if (VerifyScriptFastPath(scriptSig, scriptPubKey, flags, checker, fSuccess,
+                             serror)) {
+        return fSuccess;
+    }
+
+    return VerifyScriptGeneric(scriptSig, scriptPubKey, flags, checker,
+                               serror);
+}
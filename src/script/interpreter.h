@@ -7,6 +7,7 @@
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
 #include "primitives/transaction.h"
+#include "script/script.h"
 #include "script_error.h"
 #include "sighashtype.h"
 
@@ -114,6 +115,8 @@ enum {
 
 bool CheckSignatureEncoding(const std::vector<uint8_t> &vchSig, uint32_t flags,
                             ScriptError *serror);
+bool CheckSignatureEncoding(const CScriptStackElement &vchSig, uint32_t flags,
+                            ScriptError *serror);
 
 uint256 SignatureHash(const CScript &scriptCode, const CTransaction &txTo,
                       unsigned int nIn, SigHashType sigHashType,
@@ -123,8 +126,8 @@ uint256 SignatureHash(const CScript &scriptCode, const CTransaction &txTo,
 
 class BaseSignatureChecker {
 public:
-    virtual bool CheckSig(const std::vector<uint8_t> &scriptSig,
-                          const std::vector<uint8_t> &vchPubKey,
+    virtual bool CheckSig(const CScriptStackElement &scriptSig,
+                          const CScriptStackElement &vchPubKey,
                           const CScript &scriptCode, uint32_t flags) const {
         return false;
     }
@@ -160,8 +163,8 @@ public:
                                 const Amount amountIn,
                                 const PrecomputedTransactionData &txdataIn)
         : txTo(txToIn), nIn(nInIn), amount(amountIn), txdata(&txdataIn) {}
-    bool CheckSig(const std::vector<uint8_t> &scriptSig,
-                  const std::vector<uint8_t> &vchPubKey,
+    bool CheckSig(const CScriptStackElement &scriptSig,
+                  const CScriptStackElement &vchPubKey,
                   const CScript &scriptCode, uint32_t flags) const override;
     bool CheckLockTime(const CScriptNum &nLockTime) const override;
     bool CheckSequence(const CScriptNum &nSequence) const override;
@@ -177,6 +180,13 @@ public:
         : TransactionSignatureChecker(&txTo, nInIn, amount), txTo(*txToIn) {}
 };
 
+bool EvalScript(std::vector<CScriptStackElement> &stack, const CScript &script,
+                uint32_t flags, const BaseSignatureChecker &checker,
+                ScriptError *error = nullptr);
+/**
+ * Same as above, for callers working with plain byte vectors. The stack is
+ * converted to and from interpreter stack elements around the evaluation.
+ */
 bool EvalScript(std::vector<std::vector<uint8_t>> &stack, const CScript &script,
                 uint32_t flags, const BaseSignatureChecker &checker,
                 ScriptError *error = nullptr);
@@ -184,4 +194,24 @@ bool VerifyScript(const CScript &scriptSig, const CScript &scriptPubKey,
                   uint32_t flags, const BaseSignatureChecker &checker,
                   ScriptError *serror = nullptr);
 
+/**
+ * Verify P2PKH, P2PK, bare multisig and P2SH multisig spends without going
+ * through EvalScript. Returns false if the scripts do not match one of these
+ * templates, in which case VerifyScriptGeneric must be used. Otherwise, the
+ * result of the verification is stored in fSuccess, and fSuccess and serror
+ * are exactly what VerifyScriptGeneric would produce.
+ */
+bool VerifyScriptFastPath(const CScript &scriptSig,
+                          const CScript &scriptPubKey, uint32_t flags,
+                          const BaseSignatureChecker &checker, bool &fSuccess,
+                          ScriptError *serror = nullptr);
+
+/**
+ * Verify scripts with the generic interpreter only. VerifyScript uses it for
+ * scripts which do not have a fast path.
+ */
+bool VerifyScriptGeneric(const CScript &scriptSig, const CScript &scriptPubKey,
+                         uint32_t flags, const BaseSignatureChecker &checker,
+                         ScriptError *serror = nullptr);
+
 #endif // BITCOIN_SCRIPT_INTERPRETER_H
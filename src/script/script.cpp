@@ -264,8 +264,10 @@ const char *GetOpName(opcodetype opcode) {
     }
 }
 
-bool CScriptNum::IsMinimallyEncoded(const std::vector<uint8_t> &vch,
-                                    const size_t nMaxNumSize) {
+namespace {
+
+template <typename T>
+bool IsMinimallyEncodedNum(const T &vch, const size_t nMaxNumSize) {
     if (vch.size() > nMaxNumSize) {
         return false;
     }
@@ -292,7 +294,7 @@ bool CScriptNum::IsMinimallyEncoded(const std::vector<uint8_t> &vch,
     return true;
 }
 
-bool CScriptNum::MinimallyEncode(std::vector<uint8_t> &data) {
+template <typename T> bool MinimallyEncodeNum(T &data) {
     if (data.size() == 0) {
         return false;
     }
@@ -306,7 +308,7 @@ bool CScriptNum::MinimallyEncode(std::vector<uint8_t> &data) {
     // If the script is one byte long, then we have a zero, which encodes as an
     // empty array.
     if (data.size() == 1) {
-        data = {};
+        data.clear();
         return true;
     }
 
@@ -334,10 +336,30 @@ bool CScriptNum::MinimallyEncode(std::vector<uint8_t> &data) {
     }
 
     // If we the whole thing is zeros, then we have a zero.
-    data = {};
+    data.clear();
     return true;
 }
 
+} // namespace
+
+bool CScriptNum::IsMinimallyEncoded(const std::vector<uint8_t> &vch,
+                                    const size_t nMaxNumSize) {
+    return IsMinimallyEncodedNum(vch, nMaxNumSize);
+}
+
+bool CScriptNum::IsMinimallyEncoded(const CScriptStackElement &vch,
+                                    const size_t nMaxNumSize) {
+    return IsMinimallyEncodedNum(vch, nMaxNumSize);
+}
+
+bool CScriptNum::MinimallyEncode(std::vector<uint8_t> &data) {
+    return MinimallyEncodeNum(data);
+}
+
+bool CScriptNum::MinimallyEncode(CScriptStackElement &data) {
+    return MinimallyEncodeNum(data);
+}
+
 unsigned int CScript::GetSigOpCount(bool fAccurate) const {
     unsigned int n = 0;
     const_iterator pc = begin();
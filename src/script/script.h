@@ -31,6 +31,13 @@ static const int MAX_PUBKEYS_PER_MULTISIG = 20;
 // Maximum script length in bytes
 static const int MAX_SCRIPT_SIZE = 10000;
 
+/**
+ * Element of the script interpreter stacks. Signatures with their hash type
+ * (up to 73 bytes) and public keys (up to 65 bytes) are stored inline, so
+ * pushing and copying them does not allocate.
+ */
+typedef prevector<76, uint8_t> CScriptStackElement;
+
 // Threshold for nLockTime: below this value it is interpreted as block number,
 // otherwise as UNIX timestamp. Thresold is Tue Nov 5 00:53:20 1985 UTC
 static const unsigned int LOCKTIME_THRESHOLD = 500000000;
@@ -210,7 +217,8 @@ public:
 
     explicit CScriptNum(const int64_t &n) { m_value = n; }
 
-    explicit CScriptNum(const std::vector<uint8_t> &vch, bool fRequireMinimal,
+    template <typename T>
+    explicit CScriptNum(const T &vch, bool fRequireMinimal,
                         const size_t nMaxNumSize = MAXIMUM_ELEMENT_SIZE) {
         if (vch.size() > nMaxNumSize) {
             throw scriptnum_error("script number overflow");
@@ -224,8 +232,12 @@ public:
     static bool IsMinimallyEncoded(
         const std::vector<uint8_t> &vch,
         const size_t nMaxNumSize = CScriptNum::MAXIMUM_ELEMENT_SIZE);
+    static bool IsMinimallyEncoded(
+        const CScriptStackElement &vch,
+        const size_t nMaxNumSize = CScriptNum::MAXIMUM_ELEMENT_SIZE);
 
     static bool MinimallyEncode(std::vector<uint8_t> &data);
+    static bool MinimallyEncode(CScriptStackElement &data);
 
     inline bool operator==(const int64_t &rhs) const { return m_value == rhs; }
     inline bool operator!=(const int64_t &rhs) const { return m_value != rhs; }
@@ -341,10 +353,23 @@ public:
 
     std::vector<uint8_t> getvch() const { return serialize(m_value); }
 
-    static std::vector<uint8_t> serialize(const int64_t &value) {
-        if (value == 0) return std::vector<uint8_t>();
+    CScriptStackElement getstackelement() const {
+        CScriptStackElement result;
+        serialize(m_value, result);
+        return result;
+    }
 
+    static std::vector<uint8_t> serialize(const int64_t &value) {
         std::vector<uint8_t> result;
+        serialize(value, result);
+        return result;
+    }
+
+private:
+    template <typename T>
+    static void serialize(const int64_t &value, T &result) {
+        if (value == 0) return;
+
         const bool neg = value < 0;
         uint64_t absvalue = neg ? -value : value;
 
@@ -366,12 +391,9 @@ public:
         } else if (neg) {
             result.back() |= 0x80;
         }
-
-        return result;
     }
 
-private:
-    static int64_t set_vch(const std::vector<uint8_t> &vch) {
+    template <typename T> static int64_t set_vch(const T &vch) {
         if (vch.empty()) return 0;
 
         int64_t result = 0;
@@ -4,11 +4,13 @@
 
 #include "scriptcache.h"
 
+#include "clientversion.h"
 #include "crypto/sha256.h"
 #include "cuckoocache.h"
 #include "primitives/transaction.h"
 #include "random.h"
 #include "script/sigcache.h"
+#include "streams.h"
 #include "sync.h"
 #include "util.h"
 #include "validation.h"
@@ -59,3 +61,87 @@ void AddKeyInScriptCache(uint256 key) {
     AssertLockHeld(cs_main);
     scriptExecutionCache.insert(key);
 }
+
+static const uint64_t SCRIPT_CACHE_DUMP_VERSION = 1;
+
+void DumpScriptExecutionCache() {
+    int64_t start = GetTimeMicros();
+
+    uint256 nonce;
+    std::vector<uint256> entries;
+    {
+        LOCK(cs_main);
+        nonce = scriptExecutionCacheNonce;
+        scriptExecutionCache.for_each_element(
+            [&entries](const uint256 &entry) { entries.push_back(entry); });
+    }
+
+    try {
+        FILE *filestr =
+            fsbridge::fopen(GetDataDir() / "scriptcache.dat.new", "wb");
+        if (!filestr) {
+            return;
+        }
+
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        file << SCRIPT_CACHE_DUMP_VERSION;
+        file << CLIENT_VERSION;
+        file << nonce;
+        file << entries;
+        FileCommit(file.Get());
+        file.fclose();
+        RenameOver(GetDataDir() / "scriptcache.dat.new",
+                   GetDataDir() / "scriptcache.dat");
+        LogPrintf("Dumped %u script execution cache entries: %gs\n",
+                  entries.size(), (GetTimeMicros() - start) * 0.000001);
+    } catch (const std::exception &e) {
+        LogPrintf("Failed to dump script execution cache: %s. Continuing "
+                  "anyway.\n",
+                  e.what());
+    }
+}
+
+bool LoadScriptExecutionCache() {
+    FILE *filestr = fsbridge::fopen(GetDataDir() / "scriptcache.dat", "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open script execution cache file from disk. "
+                  "Continuing anyway.\n");
+        return false;
+    }
+
+    uint256 nonce;
+    std::vector<uint256> entries;
+    try {
+        uint64_t version;
+        int nClientVersion;
+        file >> version >> nClientVersion;
+        // Entries vouch for the result of checks, so only the binary that
+        // made them may trust them: an upgrade can change that result.
+        if (version != SCRIPT_CACHE_DUMP_VERSION ||
+            nClientVersion != CLIENT_VERSION) {
+            LogPrintf("Discarding script execution cache file written by "
+                      "version %d\n",
+                      nClientVersion);
+            file.fclose();
+            fs::remove(GetDataDir() / "scriptcache.dat");
+            return false;
+        }
+        file >> nonce;
+        file >> entries;
+    } catch (const std::exception &e) {
+        LogPrintf("Failed to deserialize script execution cache data on disk: "
+                  "%s. Continuing anyway.\n",
+                  e.what());
+        return false;
+    }
+
+    LOCK(cs_main);
+    scriptExecutionCacheNonce = nonce;
+    for (const uint256 &entry : entries) {
+        scriptExecutionCache.insert(entry);
+    }
+    LogPrintf("Imported %u script execution cache entries from disk\n",
+              entries.size());
+    return true;
+}
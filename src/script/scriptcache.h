@@ -30,4 +30,15 @@ bool IsKeyInScriptCache(uint256 key, bool erase);
 /** Add an entry in the cache. */
 void AddKeyInScriptCache(uint256 key);
 
+/** Write the script-execution cache and its nonce to scriptcache.dat. */
+void DumpScriptExecutionCache();
+
+/**
+ * Reload the entries saved by DumpScriptExecutionCache(). Must be called after
+ * InitScriptExecutionCache() and before any transaction is validated. A file
+ * written by any other client version is deleted instead, as its entries may
+ * not hold for this version's script interpreter.
+ */
+bool LoadScriptExecutionCache();
+
 #endif // BITCOIN_SCRIPT_SCRIPTCACHE_H
@@ -5,29 +5,131 @@
 
 #include "sigcache.h"
 
+#include "clientversion.h"
 #include "cuckoocache.h"
 #include "memusage.h"
 #include "pubkey.h"
 #include "random.h"
+#include "streams.h"
 #include "uint256.h"
 #include "util.h"
 
-#include <boost/thread.hpp>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <mutex>
 
 namespace {
 
+/**
+ * A signature cache entry whose words are loaded and stored with relaxed
+ * atomics, so that lookups may read the table while an insert rewrites it
+ * without that being a data race. A lookup overlapping an insert can still see
+ * a mix of the old and new words, which the shard's sequence number catches.
+ */
+class CSignatureCacheEntry {
+private:
+    std::array<std::atomic<uint64_t>, 4> words;
+
+public:
+    CSignatureCacheEntry() {
+        for (std::atomic<uint64_t> &word : words) {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    explicit CSignatureCacheEntry(const uint256 &hash) {
+        for (size_t i = 0; i < words.size(); i++) {
+            uint64_t word;
+            std::memcpy(&word, hash.begin() + 8 * i, 8);
+            words[i].store(word, std::memory_order_relaxed);
+        }
+    }
+
+    CSignatureCacheEntry(const CSignatureCacheEntry &other) { *this = other; }
+
+    CSignatureCacheEntry &operator=(const CSignatureCacheEntry &other) {
+        for (size_t i = 0; i < words.size(); i++) {
+            words[i].store(other.GetWord(i), std::memory_order_relaxed);
+        }
+        return *this;
+    }
+
+    uint64_t GetWord(size_t i) const {
+        return words[i].load(std::memory_order_relaxed);
+    }
+
+    uint256 GetHash() const {
+        uint256 hash;
+        for (size_t i = 0; i < words.size(); i++) {
+            uint64_t word = GetWord(i);
+            std::memcpy(hash.begin() + 8 * i, &word, 8);
+        }
+        return hash;
+    }
+
+    bool operator==(const CSignatureCacheEntry &other) const {
+        for (size_t i = 0; i < words.size(); i++) {
+            if (GetWord(i) != other.GetWord(i)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/** SignatureCacheHasher for CSignatureCacheEntry. */
+class CSignatureCacheEntryHasher {
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const CSignatureCacheEntry &entry) const {
+        static_assert(hash_select < 8, "Only 8 hashes are available.");
+        return entry.GetWord(hash_select / 2) >> (32 * (hash_select % 2));
+    }
+};
+
 /**
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
  * twice for every transaction (once when accepted into memory pool, and
  * again when accepted into the block chain)
+ *
+ * The cache is split in shards selected by the entry. Inserts into a shard
+ * take its lock, and bump its sequence number before and after changing the
+ * table, seqlock style. Lookups take no lock: they read the table and retry if
+ * the sequence number shows an insert ran meanwhile, which only happens when
+ * two threads hit the same shard at once. Marking an entry as erasable on a
+ * hit is done with atomic flags; a lookup that has to retry may flag a slot
+ * the insert just filled, which at worst evicts that entry early.
  */
 class CSignatureCache {
 private:
+    static const size_t SHARD_COUNT = 16;
+
+    typedef CuckooCache::cache<CSignatureCacheEntry,
+                               CSignatureCacheEntryHasher>
+        map_type;
+
+    // Aligned so that inserting into one shard does not bounce the cache line
+    // of another shard's sequence number.
+    struct alignas(64) Shard {
+        //! Odd while an insert is changing setValid.
+        std::atomic<uint32_t> nSequence{0};
+        map_type setValid;
+        //! Serializes the writers of setValid.
+        std::mutex cs;
+    };
+
     //! Entries are SHA256(nonce || signature hash || public key || signature):
     uint256 nonce;
-    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
-    map_type setValid;
-    boost::shared_mutex cs_sigcache;
+    std::array<Shard, SHARD_COUNT> shards;
+
+    Shard &GetShard(const uint256 &entry) {
+        // The table indexes are the low bits of the 32 bit words of the entry
+        // (see CSignatureCacheEntryHasher), so use the top bits of the last
+        // word, which no shard is large enough to need.
+        static_assert(SHARD_COUNT == 16, "Shard selection uses 4 bits");
+        return shards[entry.begin()[31] >> 4];
+    }
 
 public:
     CSignatureCache() { GetRandBytes(nonce.begin(), 32); }
@@ -44,15 +146,71 @@ public:
     }
 
     bool Get(const uint256 &entry, const bool erase) {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
-        return setValid.contains(entry, erase);
+        Shard &shard = GetShard(entry);
+        const CSignatureCacheEntry key(entry);
+        while (true) {
+            uint32_t nSequence =
+                shard.nSequence.load(std::memory_order_acquire);
+            if (nSequence & 1) {
+                continue;
+            }
+            bool fFound = shard.setValid.contains(key, erase);
+            // Order the reads of the table before checking that no insert
+            // overlapped them.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (shard.nSequence.load(std::memory_order_relaxed) == nSequence) {
+                return fFound;
+            }
+        }
     }
 
     void Set(uint256 &entry) {
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        setValid.insert(entry);
+        Shard &shard = GetShard(entry);
+        std::lock_guard<std::mutex> lock(shard.cs);
+        uint32_t nSequence = shard.nSequence.load(std::memory_order_relaxed);
+        shard.nSequence.store(nSequence + 1, std::memory_order_relaxed);
+        // Lookups that see any of the new table contents see the odd count.
+        std::atomic_thread_fence(std::memory_order_release);
+        shard.setValid.insert(CSignatureCacheEntry(entry));
+        shard.nSequence.store(nSequence + 2, std::memory_order_release);
+    }
+
+    // Not safe with concurrent lookups, only meant for startup.
+    uint32_t setup_bytes(size_t n) {
+        // Start afresh: entries computed with the previous nonce are never
+        // found again.
+        GetRandBytes(nonce.begin(), 32);
+        uint32_t nElems = 0;
+        for (Shard &shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.cs);
+            nElems += shard.setValid.setup_bytes(n / SHARD_COUNT);
+        }
+        return nElems;
+    }
+
+    void GetEntries(uint256 &nonceOut, std::vector<uint256> &entries) {
+        nonceOut = nonce;
+        for (Shard &shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.cs);
+            shard.setValid.for_each_element(
+                [&entries](const CSignatureCacheEntry &entry) {
+                    entries.push_back(entry.GetHash());
+                });
+        }
+    }
+
+    /**
+     * Replace the nonce and add entries computed with it. Entries already in
+     * the cache become unreachable, so this must be done before the cache is
+     * used.
+     */
+    void SetEntries(const uint256 &nonceIn,
+                    const std::vector<uint256> &entries) {
+        nonce = nonceIn;
+        for (uint256 entry : entries) {
+            Set(entry);
+        }
     }
-    uint32_t setup_bytes(size_t n) { return setValid.setup_bytes(n); }
 };
 
 /**
@@ -81,6 +239,88 @@ void InitSignatureCache() {
               (nElems * sizeof(uint256)) >> 20, nMaxCacheSize >> 20, nElems);
 }
 
+static const uint64_t SIGNATURE_CACHE_DUMP_VERSION = 1;
+
+void DumpSignatureCache() {
+    int64_t start = GetTimeMicros();
+
+    uint256 nonce;
+    std::vector<uint256> entries;
+    signatureCache.GetEntries(nonce, entries);
+
+    try {
+        FILE *filestr =
+            fsbridge::fopen(GetDataDir() / "sigcache.dat.new", "wb");
+        if (!filestr) {
+            return;
+        }
+
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        file << SIGNATURE_CACHE_DUMP_VERSION;
+        file << CLIENT_VERSION;
+        file << nonce;
+        file << entries;
+        FileCommit(file.Get());
+        file.fclose();
+        RenameOver(GetDataDir() / "sigcache.dat.new",
+                   GetDataDir() / "sigcache.dat");
+        LogPrintf("Dumped %u signature cache entries: %gs\n", entries.size(),
+                  (GetTimeMicros() - start) * 0.000001);
+    } catch (const std::exception &e) {
+        LogPrintf("Failed to dump signature cache: %s. Continuing anyway.\n",
+                  e.what());
+    }
+}
+
+bool LoadSignatureCache() {
+    FILE *filestr = fsbridge::fopen(GetDataDir() / "sigcache.dat", "rb");
+    CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open signature cache file from disk. Continuing "
+                  "anyway.\n");
+        return false;
+    }
+
+    uint256 nonce;
+    std::vector<uint256> entries;
+    try {
+        uint64_t version;
+        int nClientVersion;
+        file >> version >> nClientVersion;
+        // Entries vouch for the result of checks, so only the binary that
+        // made them may trust them: an upgrade can change that result.
+        if (version != SIGNATURE_CACHE_DUMP_VERSION ||
+            nClientVersion != CLIENT_VERSION) {
+            LogPrintf("Discarding signature cache file written by version "
+                      "%d\n",
+                      nClientVersion);
+            file.fclose();
+            fs::remove(GetDataDir() / "sigcache.dat");
+            return false;
+        }
+        file >> nonce;
+        file >> entries;
+    } catch (const std::exception &e) {
+        LogPrintf("Failed to deserialize signature cache data on disk: %s. "
+                  "Continuing anyway.\n",
+                  e.what());
+        return false;
+    }
+
+    signatureCache.SetEntries(nonce, entries);
+    LogPrintf("Imported %u signature cache entries from disk\n",
+              entries.size());
+    return true;
+}
+
+bool CachingTransactionSignatureChecker::IsCached(
+    const std::vector<uint8_t> &vchSig, const CPubKey &pubkey,
+    const uint256 &sighash) const {
+    uint256 entry;
+    signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
+    return signatureCache.Get(entry, false);
+}
+
 bool CachingTransactionSignatureChecker::VerifySignature(
     const std::vector<uint8_t> &vchSig, const CPubKey &pubkey,
     const uint256 &sighash) const {
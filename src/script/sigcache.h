@@ -51,6 +51,10 @@ public:
         : TransactionSignatureChecker(txToIn, nInIn, amount, txdataIn),
           store(storeIn) {}
 
+    /** Whether a successful check of this signature is in the cache. */
+    bool IsCached(const std::vector<uint8_t> &vchSig, const CPubKey &vchPubKey,
+                  const uint256 &sighash) const;
+
     bool VerifySignature(const std::vector<uint8_t> &vchSig,
                          const CPubKey &vchPubKey,
                          const uint256 &sighash) const override;
@@ -58,4 +62,15 @@ public:
 
 void InitSignatureCache();
 
+/** Write the signature cache and its nonce to sigcache.dat. */
+void DumpSignatureCache();
+
+/**
+ * Reload the entries saved by DumpSignatureCache(). Must be called after
+ * InitSignatureCache() and before any signature is checked, as previously
+ * cached entries are lost when the nonce is restored. A file written by any
+ * other client version is deleted instead.
+ */
+bool LoadSignatureCache();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
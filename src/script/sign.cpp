@@ -239,8 +239,10 @@ static std::vector<valtype> CombineMultisig(
                 continue;
             }
 
-            if (checker.CheckSig(sig, pubkey, scriptPubKey,
-                                 STANDARD_SCRIPT_VERIFY_FLAGS)) {
+            if (checker.CheckSig(
+                    CScriptStackElement(sig.begin(), sig.end()),
+                    CScriptStackElement(pubkey.begin(), pubkey.end()),
+                    scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS)) {
                 sigs[pubkey] = sig;
                 break;
             }
@@ -358,8 +360,8 @@ class DummySignatureChecker : public BaseSignatureChecker {
 public:
     DummySignatureChecker() {}
 
-    bool CheckSig(const std::vector<uint8_t> &scriptSig,
-                  const std::vector<uint8_t> &vchPubKey,
+    bool CheckSig(const CScriptStackElement &scriptSig,
+                  const CScriptStackElement &vchPubKey,
                   const CScript &scriptCode, uint32_t flags) const override {
         return true;
     }
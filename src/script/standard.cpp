@@ -10,6 +10,8 @@
 #include "util.h"
 #include "utilstrencodings.h"
 
+#include <algorithm>
+
 typedef std::vector<uint8_t> valtype;
 
 bool fAcceptDatacarrier = DEFAULT_ACCEPT_DATACARRIER;
@@ -35,43 +37,75 @@ const char *GetTxnOutputType(txnouttype t) {
     return nullptr;
 }
 
-/**
- * Return public keys or hashes from scriptPubKey, for 'standard' transaction
- * types.
- */
-bool Solver(const CScript &scriptPubKey, txnouttype &typeRet,
-            std::vector<std::vector<uint8_t>> &vSolutionsRet) {
-    // Templates
-    static std::multimap<txnouttype, CScript> mTemplates;
-    if (mTemplates.empty()) {
-        // Standard tx, sender provides pubkey, receiver adds signature
-        mTemplates.insert(
-            std::make_pair(TX_PUBKEY, CScript() << OP_PUBKEY << OP_CHECKSIG));
-
-        // Bitcoin address tx, sender provides hash of pubkey, receiver provides
-        // signature and pubkey
-        mTemplates.insert(
-            std::make_pair(TX_PUBKEYHASH,
-                           CScript() << OP_DUP << OP_HASH160 << OP_PUBKEYHASH
-                                     << OP_EQUALVERIFY << OP_CHECKSIG));
-
-        // Sender provides N pubkeys, receivers provides M signatures
-        mTemplates.insert(
-            std::make_pair(TX_MULTISIG,
-                           CScript() << OP_SMALLINTEGER << OP_PUBKEYS
-                                     << OP_SMALLINTEGER << OP_CHECKMULTISIG));
+namespace {
+
+/** CScript::GetOp(), returning the pushed data as a slice of the script. */
+bool GetScriptOp(const uint8_t *&pc, const uint8_t *pend,
+                 opcodetype &opcodeRet, CScriptSlice &dataRet) {
+    opcodeRet = OP_INVALIDOPCODE;
+    dataRet = CScriptSlice();
+    if (pc >= pend) {
+        return false;
     }
 
-    vSolutionsRet.clear();
+    unsigned int opcode = *pc++;
+    if (opcode <= OP_PUSHDATA4) {
+        unsigned int nSize = 0;
+        if (opcode < OP_PUSHDATA1) {
+            nSize = opcode;
+        } else if (opcode == OP_PUSHDATA1) {
+            if (pend - pc < 1) {
+                return false;
+            }
+            nSize = *pc++;
+        } else if (opcode == OP_PUSHDATA2) {
+            if (pend - pc < 2) {
+                return false;
+            }
+            nSize = ReadLE16(pc);
+            pc += 2;
+        } else if (opcode == OP_PUSHDATA4) {
+            if (pend - pc < 4) {
+                return false;
+            }
+            nSize = ReadLE32(pc);
+            pc += 4;
+        }
+        if ((unsigned int)(pend - pc) < nSize) {
+            return false;
+        }
+        dataRet = CScriptSlice(pc, pc + nSize);
+        pc += nSize;
+    }
+
+    opcodeRet = (opcodetype)opcode;
+    return true;
+}
+
+bool IsPubKeySize(const CScriptSlice &data) {
+    return data.size() >= 33 && data.size() <= 65;
+}
+
+bool IsSmallInteger(opcodetype opcode) {
+    return opcode == OP_0 || (opcode >= OP_1 && opcode <= OP_16);
+}
+
+} // namespace
+
+bool SolveScript(const CScript &scriptPubKey, CScriptSolution &solutionRet) {
+    solutionRet.type = TX_NONSTANDARD;
+    solutionRet.nRequired = 0;
+    solutionRet.nData = 0;
 
     // Shortcut for pay-to-script-hash, which are more constrained than the
     // other types:
     // it is always OP_HASH160 20 [20 byte hash] OP_EQUAL
     if (scriptPubKey.IsPayToScriptHash()) {
-        typeRet = TX_SCRIPTHASH;
-        std::vector<uint8_t> hashBytes(scriptPubKey.begin() + 2,
-                                       scriptPubKey.begin() + 22);
-        vSolutionsRet.push_back(hashBytes);
+        solutionRet.type = TX_SCRIPTHASH;
+        solutionRet.nRequired = 1;
+        solutionRet.nData = 1;
+        solutionRet.data[0] = CScriptSlice(scriptPubKey.data() + 2,
+                                           scriptPubKey.data() + 22);
         return true;
     }
 
@@ -82,99 +116,142 @@ bool Solver(const CScript &scriptPubKey, txnouttype &typeRet,
     // script.
     if (scriptPubKey.size() >= 1 && scriptPubKey[0] == OP_RETURN &&
         scriptPubKey.IsPushOnly(scriptPubKey.begin() + 1)) {
-        typeRet = TX_NULL_DATA;
+        solutionRet.type = TX_NULL_DATA;
         return true;
     }
 
-    // Scan templates
-    const CScript &script1 = scriptPubKey;
-    for (const std::pair<txnouttype, CScript> &tplate : mTemplates) {
-        const CScript &script2 = tplate.second;
-        vSolutionsRet.clear();
-
-        opcodetype opcode1, opcode2;
-        std::vector<uint8_t> vch1, vch2;
-
-        // Compare
-        CScript::const_iterator pc1 = script1.begin();
-        CScript::const_iterator pc2 = script2.begin();
-        while (true) {
-            if (pc1 == script1.end() && pc2 == script2.end()) {
-                // Found a match
-                typeRet = tplate.first;
-                if (typeRet == TX_MULTISIG) {
-                    // Additional checks for TX_MULTISIG:
-                    uint8_t m = vSolutionsRet.front()[0];
-                    uint8_t n = vSolutionsRet.back()[0];
-                    if (m < 1 || n < 1 || m > n ||
-                        vSolutionsRet.size() - 2 != n) {
-                        return false;
-                    }
-                }
-                return true;
-            }
-            if (!script1.GetOp(pc1, opcode1, vch1)) {
-                break;
-            }
-            if (!script2.GetOp(pc2, opcode2, vch2)) {
-                break;
-            }
+    const uint8_t *pc = scriptPubKey.data();
+    const uint8_t *pend = pc + scriptPubKey.size();
+    opcodetype opcode;
+    CScriptSlice data;
+    if (!GetScriptOp(pc, pend, opcode, data)) {
+        return false;
+    }
 
-            // Template matching opcodes:
-            if (opcode2 == OP_PUBKEYS) {
-                while (vch1.size() >= 33 && vch1.size() <= 65) {
-                    vSolutionsRet.push_back(vch1);
-                    if (!script1.GetOp(pc1, opcode1, vch1)) {
-                        break;
-                    }
-                }
-                if (!script2.GetOp(pc2, opcode2, vch2)) {
-                    break;
-                }
-                // Normal situation is to fall through to other if/else
-                // statements
-            }
+    // The first operation tells which of the templates the script may match,
+    // and pushes may use any of the push opcodes.
+    if (opcode == OP_DUP) {
+        // Bitcoin address tx, sender provides hash of pubkey, receiver
+        // provides signature and pubkey:
+        // OP_DUP OP_HASH160 [20 byte hash] OP_EQUALVERIFY OP_CHECKSIG
+        CScriptSlice hash;
+        if (!GetScriptOp(pc, pend, opcode, data) || opcode != OP_HASH160 ||
+            !GetScriptOp(pc, pend, opcode, hash) ||
+            hash.size() != sizeof(uint160) ||
+            !GetScriptOp(pc, pend, opcode, data) ||
+            opcode != OP_EQUALVERIFY ||
+            !GetScriptOp(pc, pend, opcode, data) || opcode != OP_CHECKSIG ||
+            pc != pend) {
+            return false;
+        }
 
-            if (opcode2 == OP_PUBKEY) {
-                if (vch1.size() < 33 || vch1.size() > 65) {
-                    break;
-                }
-                vSolutionsRet.push_back(vch1);
-            } else if (opcode2 == OP_PUBKEYHASH) {
-                if (vch1.size() != sizeof(uint160)) {
-                    break;
-                }
-                vSolutionsRet.push_back(vch1);
-            } else if (opcode2 == OP_SMALLINTEGER) {
-                // Single-byte small integer pushed onto vSolutions
-                if (opcode1 == OP_0 || (opcode1 >= OP_1 && opcode1 <= OP_16)) {
-                    char n = (char)CScript::DecodeOP_N(opcode1);
-                    vSolutionsRet.push_back(valtype(1, n));
-                } else {
-                    break;
-                }
-            } else if (opcode1 != opcode2 || vch1 != vch2) {
-                // Others must match exactly
-                break;
+        solutionRet.type = TX_PUBKEYHASH;
+        solutionRet.nRequired = 1;
+        solutionRet.nData = 1;
+        solutionRet.data[0] = hash;
+        return true;
+    }
+
+    if (IsPubKeySize(data)) {
+        // Standard tx, sender provides pubkey, receiver adds signature:
+        // [pubkey] OP_CHECKSIG
+        const CScriptSlice pubkey = data;
+        if (!GetScriptOp(pc, pend, opcode, data) || opcode != OP_CHECKSIG ||
+            pc != pend) {
+            return false;
+        }
+
+        solutionRet.type = TX_PUBKEY;
+        solutionRet.nRequired = 1;
+        solutionRet.nData = 1;
+        solutionRet.data[0] = pubkey;
+        return true;
+    }
+
+    if (IsSmallInteger(opcode)) {
+        // Sender provides N pubkeys, receivers provides M signatures:
+        // M [pubkey]... N OP_CHECKMULTISIG
+        const int nRequired = CScript::DecodeOP_N(opcode);
+        size_t nKeys = 0;
+        while (GetScriptOp(pc, pend, opcode, data) && IsPubKeySize(data)) {
+            if (nKeys < CScriptSolution::MAX_KEYS) {
+                solutionRet.data[nKeys] = data;
             }
+            nKeys++;
         }
+        if (!IsSmallInteger(opcode)) {
+            return false;
+        }
+        const int nKeysDeclared = CScript::DecodeOP_N(opcode);
+        if (!GetScriptOp(pc, pend, opcode, data) ||
+            opcode != OP_CHECKMULTISIG || pc != pend) {
+            return false;
+        }
+
+        solutionRet.type = TX_MULTISIG;
+        solutionRet.nRequired = nRequired;
+        solutionRet.nData = nKeys < CScriptSolution::MAX_KEYS
+                                ? nKeys
+                                : size_t(CScriptSolution::MAX_KEYS);
+        return nRequired >= 1 && nKeysDeclared >= 1 &&
+               nRequired <= nKeysDeclared && nKeys == size_t(nKeysDeclared);
     }
 
-    vSolutionsRet.clear();
-    typeRet = TX_NONSTANDARD;
     return false;
 }
 
+/**
+ * Return public keys or hashes from scriptPubKey, for 'standard' transaction
+ * types.
+ */
+bool Solver(const CScript &scriptPubKey, txnouttype &typeRet,
+            std::vector<std::vector<uint8_t>> &vSolutionsRet) {
+    vSolutionsRet.clear();
+
+    CScriptSolution solution;
+    const bool fSolved = SolveScript(scriptPubKey, solution);
+    typeRet = solution.type;
+    if (typeRet == TX_MULTISIG && !fSolved) {
+        // Callers ignoring the result still get M, the keys and N of invalid
+        // multisig scripts. There may be more keys than a solution holds, so
+        // read them again from the script.
+        CScript::const_iterator pc = scriptPubKey.begin();
+        opcodetype opcode;
+        valtype vch;
+        scriptPubKey.GetOp(pc, opcode);
+        vSolutionsRet.push_back(valtype(1, CScript::DecodeOP_N(opcode)));
+        while (scriptPubKey.GetOp(pc, opcode, vch) && vch.size() >= 33 &&
+               vch.size() <= 65) {
+            vSolutionsRet.push_back(vch);
+        }
+        vSolutionsRet.push_back(valtype(1, CScript::DecodeOP_N(opcode)));
+        return false;
+    }
+
+    if (typeRet == TX_MULTISIG) {
+        vSolutionsRet.push_back(valtype(1, solution.nRequired));
+    }
+    for (size_t i = 0; i < solution.nData; i++) {
+        vSolutionsRet.emplace_back(solution.data[i].begin(),
+                                   solution.data[i].end());
+    }
+    if (typeRet == TX_MULTISIG) {
+        vSolutionsRet.push_back(valtype(1, solution.nData));
+    }
+
+    return fSolved;
+}
+
 bool ExtractDestination(const CScript &scriptPubKey,
                         CTxDestination &addressRet) {
-    std::vector<valtype> vSolutions;
-    txnouttype whichType;
-    if (!Solver(scriptPubKey, whichType, vSolutions)) {
+    CScriptSolution solution;
+    if (!SolveScript(scriptPubKey, solution)) {
         return false;
     }
 
-    if (whichType == TX_PUBKEY) {
-        CPubKey pubKey(vSolutions[0]);
+    const CScriptSlice &data = solution.data[0];
+    if (solution.type == TX_PUBKEY) {
+        CPubKey pubKey(data.begin(), data.end());
         if (!pubKey.IsValid()) {
             return false;
         }
@@ -182,12 +259,16 @@ bool ExtractDestination(const CScript &scriptPubKey,
         addressRet = pubKey.GetID();
         return true;
     }
-    if (whichType == TX_PUBKEYHASH) {
-        addressRet = CKeyID(uint160(vSolutions[0]));
+    if (solution.type == TX_PUBKEYHASH) {
+        uint160 hash;
+        std::copy(data.begin(), data.end(), hash.begin());
+        addressRet = CKeyID(hash);
         return true;
     }
-    if (whichType == TX_SCRIPTHASH) {
-        addressRet = CScriptID(uint160(vSolutions[0]));
+    if (solution.type == TX_SCRIPTHASH) {
+        uint160 hash;
+        std::copy(data.begin(), data.end(), hash.begin());
+        addressRet = CScriptID(hash);
         return true;
     }
     // Multisig txns have more than one address...
@@ -198,9 +279,10 @@ bool ExtractDestinations(const CScript &scriptPubKey, txnouttype &typeRet,
                          std::vector<CTxDestination> &addressRet,
                          int &nRequiredRet) {
     addressRet.clear();
-    typeRet = TX_NONSTANDARD;
-    std::vector<valtype> vSolutions;
-    if (!Solver(scriptPubKey, typeRet, vSolutions)) {
+    CScriptSolution solution;
+    const bool fSolved = SolveScript(scriptPubKey, solution);
+    typeRet = solution.type;
+    if (!fSolved) {
         return false;
     }
     if (typeRet == TX_NULL_DATA) {
@@ -209,9 +291,9 @@ bool ExtractDestinations(const CScript &scriptPubKey, txnouttype &typeRet,
     }
 
     if (typeRet == TX_MULTISIG) {
-        nRequiredRet = vSolutions.front()[0];
-        for (size_t i = 1; i < vSolutions.size() - 1; i++) {
-            CPubKey pubKey(vSolutions[i]);
+        nRequiredRet = solution.nRequired;
+        for (size_t i = 0; i < solution.nData; i++) {
+            CPubKey pubKey(solution.data[i].begin(), solution.data[i].end());
             if (!pubKey.IsValid()) {
                 continue;
             }
@@ -53,6 +53,47 @@ enum txnouttype {
     TX_NULL_DATA,
 };
 
+/**
+ * A range of the bytes of a script, only valid for as long as the script it
+ * points into is alive and unmodified.
+ */
+class CScriptSlice {
+private:
+    const uint8_t *pbegin;
+    const uint8_t *pend;
+
+public:
+    CScriptSlice() : pbegin(nullptr), pend(nullptr) {}
+    CScriptSlice(const uint8_t *pbeginIn, const uint8_t *pendIn)
+        : pbegin(pbeginIn), pend(pendIn) {}
+
+    const uint8_t *begin() const { return pbegin; }
+    const uint8_t *end() const { return pend; }
+    size_t size() const { return pend - pbegin; }
+    uint8_t operator[](size_t pos) const { return pbegin[pos]; }
+};
+
+/**
+ * What SolveScript() found in a script: its type, and the public keys or
+ * hashes it pays to as slices of the script.
+ */
+class CScriptSolution {
+public:
+    //! Multisig scripts have at most 16 keys, as n is a small integer.
+    static const size_t MAX_KEYS = 16;
+
+    txnouttype type;
+    //! Signatures required by a TX_MULTISIG script, 1 for the single key and
+    //! hash types.
+    int nRequired;
+    //! The public keys of a TX_PUBKEY or TX_MULTISIG script, or the hash of a
+    //! TX_PUBKEYHASH or TX_SCRIPTHASH one.
+    size_t nData;
+    CScriptSlice data[MAX_KEYS];
+
+    CScriptSolution() : type(TX_NONSTANDARD), nRequired(0), nData(0) {}
+};
+
 class CNoDestination {
 public:
     friend bool operator==(const CNoDestination &a, const CNoDestination &b) {
@@ -75,6 +116,12 @@ typedef boost::variant<CNoDestination, CKeyID, CScriptID> CTxDestination;
 const char *GetTxnOutputType(txnouttype t);
 bool IsValidDestination(const CTxDestination &dest);
 
+/**
+ * Match a script against the standard templates without copying anything out
+ * of it. Returns false if the script is nonstandard, or is a multisig script
+ * with an invalid key count, in which case the type is still TX_MULTISIG.
+ */
+bool SolveScript(const CScript &scriptPubKey, CScriptSolution &solutionRet);
 bool Solver(const CScript &scriptPubKey, txnouttype &typeRet,
             std::vector<std::vector<uint8_t>> &vSolutionsRet);
 bool ExtractDestination(const CScript &scriptPubKey,
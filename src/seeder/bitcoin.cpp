@@ -6,8 +6,16 @@
 #include "serialize.h"
 #include "streams.h"
 #include "uint256.h"
+#include "utiltime.h"
 
 #include <algorithm>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
 
 // Weither we are on testnet or mainnet.
 bool fTestNet;
@@ -76,22 +84,6 @@ class CSeederNode {
         nMessageStart = allones;
     }
 
-    void Send() {
-        if (sock == INVALID_SOCKET) {
-            return;
-        }
-        if (vSend.empty()) {
-            return;
-        }
-        int nBytes = send(sock, &vSend[0], vSend.size(), 0);
-        if (nBytes > 0) {
-            vSend.erase(vSend.begin(), vSend.begin() + nBytes);
-        } else {
-            close(sock);
-            sock = INVALID_SOCKET;
-        }
-    }
-
     void PushVersion() {
         int64_t nTime = time(nullptr);
         uint64_t nLocalNonce = BITCOIN_SEED_NONCE;
@@ -242,8 +234,9 @@ class CSeederNode {
 
 public:
     CSeederNode(const CService &ip, std::vector<CAddress> *vAddrIn)
-        : vSend(SER_NETWORK, 0), vRecv(SER_NETWORK, 0), nHeaderStart(-1),
-          nMessageStart(-1), nVersion(0), vAddr(vAddrIn), ban(0), doneAfter(0),
+        : sock(INVALID_SOCKET), vSend(SER_NETWORK, 0), vRecv(SER_NETWORK, 0),
+          nHeaderStart(-1), nMessageStart(-1), nVersion(0),
+          nStartingHeight(0), vAddr(vAddrIn), ban(0), doneAfter(0),
           you(ip, ServiceFlags(NODE_NETWORK | NODE_BITCOIN_CASH)) {
         if (time(nullptr) > 1329696000) {
             vSend.SetVersion(209);
@@ -251,57 +244,72 @@ public:
         }
     }
 
-    bool Run() {
-        bool proxyConnectionFailed = false;
-        if (!ConnectSocket(you, sock, nConnectTimeout,
-                           &proxyConnectionFailed)) {
-            return false;
+    /**
+     * Driven by CCrawler. Start takes over a connected socket and queues our
+     * version message, after which the caller calls Send and Receive as the
+     * socket becomes ready, until IsDone.
+     */
+    void Start(SOCKET sockIn) {
+        sock = sockIn;
+        PushVersion();
+    }
+
+    void Send() {
+        if (sock == INVALID_SOCKET) {
+            return;
+        }
+        if (vSend.empty()) {
+            return;
+        }
+        int nBytes = send(sock, &vSend[0], vSend.size(), 0);
+        if (nBytes > 0) {
+            vSend.erase(vSend.begin(), vSend.begin() + nBytes);
+        } else if (nBytes < 0 && WSAGetLastError() == WSAEWOULDBLOCK) {
+            // Try again once the socket is writable.
+        } else {
+            close(sock);
+            sock = INVALID_SOCKET;
         }
+    }
 
-        PushVersion();
-        Send();
-
-        bool res = true;
-        int64_t now;
-        while (now = time(nullptr),
-               ban == 0 && (doneAfter == 0 || doneAfter > now) &&
-                   sock != INVALID_SOCKET) {
-            char pchBuf[0x10000];
-            fd_set set;
-            FD_ZERO(&set);
-            FD_SET(sock, &set);
-            struct timeval wa;
-            if (doneAfter) {
-                wa.tv_sec = doneAfter - now;
-                wa.tv_usec = 0;
-            } else {
-                wa.tv_sec = GetTimeout();
-                wa.tv_usec = 0;
-            }
-            int ret = select(sock + 1, &set, nullptr, &set, &wa);
-            if (ret != 1) {
-                if (!doneAfter) res = false;
-                break;
-            }
-            int nBytes = recv(sock, pchBuf, sizeof(pchBuf), 0);
-            int nPos = vRecv.size();
-            if (nBytes > 0) {
-                vRecv.resize(nPos + nBytes);
-                memcpy(&vRecv[nPos], pchBuf, nBytes);
-            } else if (nBytes == 0) {
-                // printf("%s: BAD (connection closed prematurely)\n",
-                // ToString(you).c_str());
-                res = false;
-                break;
-            } else {
-                // printf("%s: BAD (connection error)\n",
-                // ToString(you).c_str());
-                res = false;
-                break;
-            }
-            ProcessMessages();
-            Send();
+    bool HasDataToSend() const { return !vSend.empty(); }
+
+    // Read what the peer sent and process it. Returns false if the
+    // connection was closed or failed.
+    bool Receive() {
+        char pchBuf[0x10000];
+        int nBytes = recv(sock, pchBuf, sizeof(pchBuf), 0);
+        if (nBytes < 0 && WSAGetLastError() == WSAEWOULDBLOCK) {
+            return true;
+        }
+        if (nBytes <= 0) {
+            // printf("%s: BAD (connection closed or error)\n",
+            // ToString(you).c_str());
+            return false;
         }
+        int nPos = vRecv.size();
+        vRecv.resize(nPos + nBytes);
+        memcpy(&vRecv[nPos], pchBuf, nBytes);
+        ProcessMessages();
+        return true;
+    }
+
+    bool IsDone(int64_t now) const {
+        return ban != 0 || (doneAfter != 0 && doneAfter <= now) ||
+               sock == INVALID_SOCKET;
+    }
+
+    // Time after which the test ends if the peer stays silent, counting from
+    // the last data received.
+    int64_t GetDeadline(int64_t nLastReceived) {
+        return doneAfter ? doneAfter : nLastReceived + GetTimeout();
+    }
+
+    // Whether the test succeeds if the peer goes quiet now.
+    bool HasEnough() const { return doneAfter != 0; }
+
+    // Close the connection and return the result of the test.
+    bool Finish(bool res) {
         if (sock == INVALID_SOCKET) res = false;
         close(sock);
         sock = INVALID_SOCKET;
@@ -317,24 +325,370 @@ public:
     int GetStartingHeight() { return nStartingHeight; }
 };
 
-bool TestNode(const CService &cip, int &ban, int &clientV,
-              std::string &clientSV, int &blocks,
-              std::vector<CAddress> *vAddr) {
-    try {
-        CSeederNode node(cip, vAddr);
-        bool ret = node.Run();
-        if (!ret) {
-            ban = node.GetBan();
-        } else {
-            ban = 0;
+// How long the proxy gets to answer each SOCKS5 request, in ms
+static const int SOCKS5_TIMEOUT = 20 * 1000;
+// How often connections are checked against their deadline, in ms
+static const int CRAWLER_TIMEOUT_INTERVAL = 250;
+
+static bool SendAll(SOCKET sock, const uint8_t *data, size_t size) {
+    return send(sock, (const char *)data, size, MSG_NOSIGNAL) == ssize_t(size);
+}
+
+struct CCrawler::Connection {
+    enum State {
+        CONNECTING,
+        // Waiting for the proxy to accept our authentication method
+        PROXY_METHOD,
+        // Waiting for the proxy to connect to the node
+        PROXY_CONNECT,
+        // Talking to the node, which owns the socket from here on
+        HANDSHAKE,
+    };
+
+    CServiceResult result;
+    std::vector<CAddress> vAddr;
+    CSeederNode node;
+    SOCKET sock;
+    State state;
+    bool fProxy;
+    bool fWantWrite;
+    // Result of the test so far, see CSeederNode::Finish
+    bool fGood;
+    // The node sent something we could not deserialize
+    bool fMalformed;
+    std::vector<uint8_t> vProxyRecv;
+    // In ms
+    int64_t nLastReceived;
+    int64_t nDeadline;
+
+    Connection(const CServiceResult &res, bool fGetAddr)
+        : result(res), node(res.service, fGetAddr ? &vAddr : nullptr),
+          sock(INVALID_SOCKET), state(CONNECTING), fProxy(false),
+          fWantWrite(true), fGood(false), fMalformed(false), nLastReceived(0),
+          nDeadline(0) {}
+
+    bool StartHandshake(int64_t now) {
+        node.Start(sock);
+        state = HANDSHAKE;
+        fGood = true;
+        nLastReceived = now;
+        node.Send();
+        return UpdateHandshake(now);
+    }
+
+    bool UpdateHandshake(int64_t now) {
+        if (node.IsDone(now / 1000)) {
+            return false;
         }
-        clientV = node.GetClientVersion();
-        clientSV = node.GetClientSubVersion();
-        blocks = node.GetStartingHeight();
-        //  printf("%s: %s!!!\n", cip.ToString().c_str(), ret ? "GOOD" : "BAD");
-        return ret;
-    } catch (std::ios_base::failure &e) {
-        ban = 0;
+        nDeadline = node.GetDeadline(nLastReceived / 1000) * 1000;
+        return true;
+    }
+
+    bool ReceiveFromProxy() {
+        uint8_t pchBuf[512];
+        ssize_t nBytes = recv(sock, (char *)pchBuf, sizeof(pchBuf), 0);
+        if (nBytes < 0 && WSAGetLastError() == WSAEWOULDBLOCK) {
+            return true;
+        }
+        if (nBytes <= 0) {
+            return false;
+        }
+        vProxyRecv.insert(vProxyRecv.end(), pchBuf, pchBuf + nBytes);
+        return true;
+    }
+
+    // Advance the connection. Returns false once the test is over.
+    bool Step(bool fReadable, bool fWritable, int64_t now) {
+        switch (state) {
+            case CONNECTING: {
+                int nErr = 0;
+                socklen_t nErrLen = sizeof(nErr);
+                if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&nErr,
+                               &nErrLen) == SOCKET_ERROR ||
+                    nErr != 0) {
+                    return false;
+                }
+                if (!fProxy) {
+                    return StartHandshake(now);
+                }
+                // Version 5, one method: no authentication.
+                static const uint8_t method[] = {0x05, 0x01, 0x00};
+                if (!SendAll(sock, method, sizeof(method))) {
+                    return false;
+                }
+                state = PROXY_METHOD;
+                nDeadline = now + SOCKS5_TIMEOUT;
+                return true;
+            }
+
+            case PROXY_METHOD: {
+                if (!ReceiveFromProxy()) {
+                    return false;
+                }
+                if (vProxyRecv.size() < 2) {
+                    return true;
+                }
+                if (vProxyRecv[0] != 0x05 || vProxyRecv[1] != 0x00) {
+                    return false;
+                }
+                vProxyRecv.clear();
+                // Connect to the node by name, as ConnectThroughProxy does.
+                std::string strDest = result.service.ToStringIP();
+                int port = result.service.GetPort();
+                std::vector<uint8_t> vConnect = {0x05, 0x01, 0x00, 0x03,
+                                                 uint8_t(strDest.size())};
+                vConnect.insert(vConnect.end(), strDest.begin(), strDest.end());
+                vConnect.push_back((port >> 8) & 0xFF);
+                vConnect.push_back(port & 0xFF);
+                if (!SendAll(sock, vConnect.data(), vConnect.size())) {
+                    return false;
+                }
+                state = PROXY_CONNECT;
+                nDeadline = now + SOCKS5_TIMEOUT;
+                return true;
+            }
+
+            case PROXY_CONNECT: {
+                if (!ReceiveFromProxy()) {
+                    return false;
+                }
+                if (vProxyRecv.size() < 5) {
+                    return true;
+                }
+                if (vProxyRecv[0] != 0x05 || vProxyRecv[1] != 0x00 ||
+                    vProxyRecv[2] != 0x00) {
+                    return false;
+                }
+                // The reply ends with the address the proxy bound to.
+                size_t nSize;
+                switch (vProxyRecv[3]) {
+                    case 0x01:
+                        nSize = 4 + 4 + 2;
+                        break;
+                    case 0x04:
+                        nSize = 4 + 16 + 2;
+                        break;
+                    case 0x03:
+                        nSize = 4 + 1 + vProxyRecv[4] + 2;
+                        break;
+                    default:
+                        return false;
+                }
+                if (vProxyRecv.size() < nSize) {
+                    return true;
+                }
+                std::vector<uint8_t>().swap(vProxyRecv);
+                return StartHandshake(now);
+            }
+
+            case HANDSHAKE: {
+                if (fReadable) {
+                    if (!node.Receive()) {
+                        fGood = false;
+                        return false;
+                    }
+                    nLastReceived = now;
+                }
+                if (fWritable || node.HasDataToSend()) {
+                    node.Send();
+                }
+                return UpdateHandshake(now);
+            }
+        }
+        return false;
+    }
+};
+
+CCrawler::CCrawler(size_t nMaxConnectionsIn)
+    : nMaxConnections(nMaxConnectionsIn), nNextTimeoutCheck(0) {
+#ifdef __linux__
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollfd == -1) {
+        throw std::runtime_error("CCrawler: epoll_create1 failed");
+    }
+#endif
+}
+
+CCrawler::~CCrawler() {
+    std::vector<CServiceResult> results;
+    std::vector<CAddress> addrs;
+    while (!connections.empty()) {
+        Finish(connections.begin(), results, addrs);
+    }
+#ifdef __linux__
+    close(epollfd);
+#endif
+}
+
+void CCrawler::Watch(Connection &conn, bool fAdd) {
+#ifdef __linux__
+    struct epoll_event event = {};
+    event.events = conn.fWantWrite ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    event.data.fd = conn.sock;
+    epoll_ctl(epollfd, fAdd ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, conn.sock,
+              &event);
+#endif
+}
+
+bool CCrawler::Add(const CServiceResult &res, bool fGetAddr) {
+    std::unique_ptr<Connection> conn(new Connection(res, fGetAddr));
+
+    CService dest = res.service;
+    proxyType proxy;
+    if (GetProxy(res.service.GetNetwork(), proxy)) {
+        conn->fProxy = true;
+        dest = proxy.proxy;
+    }
+
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    if (!dest.GetSockAddr((struct sockaddr *)&sockaddr, &len)) {
+        // Unsupported network, this node cannot be reached.
+        vFailed.push_back(res);
+        vFailed.back().fGood = false;
+        return true;
+    }
+
+    SOCKET sock = socket(((struct sockaddr *)&sockaddr)->sa_family,
+                         SOCK_STREAM, IPPROTO_TCP);
+    if (sock == INVALID_SOCKET) {
+        return false;
+    }
+    if (!SetSocketNonBlocking(sock, true)) {
+        CloseSocket(sock);
         return false;
     }
+    if (connect(sock, (struct sockaddr *)&sockaddr, len) == SOCKET_ERROR) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINPROGRESS && nErr != WSAEWOULDBLOCK) {
+            CloseSocket(sock);
+            vFailed.push_back(res);
+            vFailed.back().fGood = false;
+            return true;
+        }
+    }
+
+    conn->sock = sock;
+    conn->nDeadline = GetTimeMillis() + nConnectTimeout;
+    Connection &c = *conn;
+    connections[sock] = std::move(conn);
+    Watch(c, true);
+    return true;
+}
+
+void CCrawler::Poll(int nTimeout, std::vector<CServiceResult> &results,
+                    std::vector<CAddress> &addrs) {
+    if (!vFailed.empty()) {
+        results.insert(results.end(), vFailed.begin(), vFailed.end());
+        vFailed.clear();
+        nTimeout = 0;
+    }
+
+    int64_t now = GetTimeMillis();
+    if (nNextTimeoutCheck - now < nTimeout) {
+        nTimeout = std::max<int64_t>(0, nNextTimeoutCheck - now);
+    }
+
+    // Sockets that are ready, with whether they are readable and writable.
+    std::vector<std::pair<SOCKET, std::pair<bool, bool>>> vReady;
+#ifdef __linux__
+    struct epoll_event events[256];
+    int nEvents = epoll_wait(epollfd, events, 256, nTimeout);
+    for (int i = 0; i < nEvents; i++) {
+        uint32_t ev = events[i].events;
+        vReady.push_back(std::make_pair(
+            SOCKET(events[i].data.fd),
+            std::make_pair((ev & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0,
+                           (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP)) != 0)));
+    }
+#else
+    std::vector<struct pollfd> vPoll;
+    vPoll.reserve(connections.size());
+    for (const auto &it : connections) {
+        struct pollfd pfd = {};
+        pfd.fd = it.first;
+        pfd.events = it.second->fWantWrite ? (POLLIN | POLLOUT) : POLLIN;
+        vPoll.push_back(pfd);
+    }
+    if (poll(vPoll.data(), vPoll.size(), nTimeout) > 0) {
+        for (const struct pollfd &pfd : vPoll) {
+            if (pfd.revents) {
+                vReady.push_back(std::make_pair(
+                    SOCKET(pfd.fd),
+                    std::make_pair(
+                        (pfd.revents & (POLLIN | POLLERR | POLLHUP)) != 0,
+                        (pfd.revents & (POLLOUT | POLLERR | POLLHUP)) != 0)));
+            }
+        }
+    }
+#endif
+
+    now = GetTimeMillis();
+    for (const auto &ready : vReady) {
+        ConnectionMap::iterator it = connections.find(ready.first);
+        if (it == connections.end()) {
+            continue;
+        }
+        Connection &conn = *it->second;
+        bool fRunning;
+        try {
+            fRunning = conn.Step(ready.second.first, ready.second.second, now);
+        } catch (std::ios_base::failure &e) {
+            conn.fGood = false;
+            conn.fMalformed = true;
+            fRunning = false;
+        }
+        if (!fRunning) {
+            Finish(it, results, addrs);
+            continue;
+        }
+        bool fWantWrite = conn.state == Connection::CONNECTING ||
+                          (conn.state == Connection::HANDSHAKE &&
+                           conn.node.HasDataToSend());
+        if (fWantWrite != conn.fWantWrite) {
+            conn.fWantWrite = fWantWrite;
+            Watch(conn, false);
+        }
+    }
+
+    if (now >= nNextTimeoutCheck) {
+        nNextTimeoutCheck = now + CRAWLER_TIMEOUT_INTERVAL;
+        for (ConnectionMap::iterator it = connections.begin();
+             it != connections.end();) {
+            ConnectionMap::iterator cur = it++;
+            Connection &conn = *cur->second;
+            if (conn.nDeadline <= now) {
+                // A silent peer is only a failure if we still expected
+                // something from it.
+                conn.fGood = conn.state == Connection::HANDSHAKE &&
+                             conn.node.HasEnough();
+                Finish(cur, results, addrs);
+            }
+        }
+    }
+}
+
+void CCrawler::Finish(ConnectionMap::iterator it,
+                      std::vector<CServiceResult> &results,
+                      std::vector<CAddress> &addrs) {
+    Connection &conn = *it->second;
+#ifdef __linux__
+    epoll_ctl(epollfd, EPOLL_CTL_DEL, it->first, nullptr);
+#endif
+    CServiceResult &res = conn.result;
+    if (conn.state == Connection::HANDSHAKE) {
+        res.fGood = conn.node.Finish(conn.fGood);
+        res.nBanTime =
+            (res.fGood || conn.fMalformed) ? 0 : conn.node.GetBan();
+        res.nClientV = conn.node.GetClientVersion();
+        res.strClientV = conn.node.GetClientSubVersion();
+        res.nHeight = conn.node.GetStartingHeight();
+    } else {
+        CloseSocket(conn.sock);
+        res.fGood = false;
+        res.nBanTime = 0;
+    }
+    results.push_back(res);
+    addrs.insert(addrs.end(), conn.vAddr.begin(), conn.vAddr.end());
+    connections.erase(it);
 }
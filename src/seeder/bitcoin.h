@@ -3,6 +3,8 @@
 
 #include "protocol.h"
 
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -19,7 +21,57 @@ static inline unsigned short GetDefaultPort(const bool testnet = fTestNet) {
 // The network magic to use.
 extern CMessageHeader::MessageMagic netMagic;
 
-bool TestNode(const CService &cip, int &ban, int &client, std::string &clientSV,
-              int &blocks, std::vector<CAddress> *vAddr);
+struct CServiceResult;
+
+/**
+ * Tests many nodes concurrently from a single thread.
+ *
+ * Every node gets a non-blocking connection, optionally through the SOCKS5
+ * proxy configured for its network, which is driven through the connect,
+ * proxy and version handshake states as epoll (poll where epoll is not
+ * available) reports it ready. Each connection has its own deadline.
+ */
+class CCrawler {
+public:
+    explicit CCrawler(size_t nMaxConnectionsIn);
+    ~CCrawler();
+
+    size_t GetCount() const { return connections.size(); }
+    size_t GetMaxConnections() const { return nMaxConnections; }
+
+    /**
+     * Start testing a node, asking it for addresses if fGetAddr is set.
+     * Returns false if no connection could be started, e.g. because we ran
+     * out of file descriptors.
+     */
+    bool Add(const CServiceResult &res, bool fGetAddr);
+
+    /**
+     * Wait up to nTimeout milliseconds for network activity, then append the
+     * results of the tests that finished to results and the addresses the
+     * nodes sent us to addrs.
+     */
+    void Poll(int nTimeout, std::vector<CServiceResult> &results,
+              std::vector<CAddress> &addrs);
+
+private:
+    struct Connection;
+
+    typedef std::map<SOCKET, std::unique_ptr<Connection>> ConnectionMap;
+
+    const size_t nMaxConnections;
+    ConnectionMap connections;
+    // Nodes we could not even start connecting to
+    std::vector<CServiceResult> vFailed;
+    int64_t nNextTimeoutCheck;
+#ifdef __linux__
+    int epollfd;
+#endif
+
+    void Watch(Connection &conn, bool fAdd);
+    void Finish(ConnectionMap::iterator it,
+                std::vector<CServiceResult> &results,
+                std::vector<CAddress> &addrs);
+};
 
 #endif
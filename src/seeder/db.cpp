@@ -34,7 +34,7 @@ void CAddrInfo::Update(bool good) {
     //  stat1W.weight), stat1W.count);
 }
 
-bool CAddrDb::Get_(CServiceResult &ip, int &wait) {
+bool CAddrDbShard::Get_(CServiceResult &ip, int &wait) {
     int64_t now = time(nullptr);
     size_t tot = unkId.size() + ourId.size();
     if (tot == 0) {
@@ -72,13 +72,13 @@ bool CAddrDb::Get_(CServiceResult &ip, int &wait) {
     return true;
 }
 
-int CAddrDb::Lookup_(const CService &ip) {
+int CAddrDbShard::Lookup_(const CService &ip) {
     if (ipToId.count(ip)) return ipToId[ip];
     return -1;
 }
 
-void CAddrDb::Good_(const CService &addr, int clientV, std::string clientSV,
-                    int blocks) {
+void CAddrDbShard::Good_(const CService &addr, int clientV,
+                         std::string clientSV, int blocks) {
     int id = Lookup_(addr);
     if (id == -1) return;
     unkId.erase(id);
@@ -97,7 +97,7 @@ void CAddrDb::Good_(const CService &addr, int clientV, std::string clientSV,
     ourId.push_back(id);
 }
 
-void CAddrDb::Bad_(const CService &addr, int ban) {
+void CAddrDbShard::Bad_(const CService &addr, int ban) {
     int id = Lookup_(addr);
     if (id == -1) return;
     unkId.erase(id);
@@ -126,7 +126,7 @@ void CAddrDb::Bad_(const CService &addr, int ban) {
     nDirty++;
 }
 
-void CAddrDb::Skipped_(const CService &addr) {
+void CAddrDbShard::Skipped_(const CService &addr) {
     int id = Lookup_(addr);
     if (id == -1) return;
     unkId.erase(id);
@@ -135,7 +135,7 @@ void CAddrDb::Skipped_(const CService &addr) {
     nDirty++;
 }
 
-void CAddrDb::Add_(const CAddress &addr, bool force) {
+void CAddrDbShard::Add_(const CAddress &addr, bool force) {
     if (!force && !addr.IsRoutable()) {
         return;
     }
@@ -176,39 +176,108 @@ void CAddrDb::Add_(const CAddress &addr, bool force) {
     nDirty++;
 }
 
-void CAddrDb::GetIPs_(std::set<CNetAddr> &ips, uint64_t requestedFlags,
-                      uint32_t max, const bool *nets) {
-    if (goodId.size() == 0) {
-        int id = -1;
-        if (ourId.size() == 0) {
-            if (unkId.size() == 0) {
-                return;
-            }
-            id = *unkId.begin();
-        } else {
-            id = *ourId.begin();
+void CAddrDbShard::Load_(const CAddrInfo &info) {
+    int id = nId++;
+    idToInfo[id] = info;
+    ipToId[info.ip] = id;
+    if (info.ourLastTry) {
+        ourId.push_back(id);
+        if (info.IsGood()) goodId.insert(id);
+    } else {
+        unkId.insert(id);
+    }
+    nDirty++;
+}
+
+void CAddrDbShard::GetGood_(std::vector<CService> &ips,
+                            uint64_t requestedFlags) {
+    for (int id : goodId) {
+        const CAddrInfo &info = idToInfo[id];
+        if ((info.services & requestedFlags) == requestedFlags) {
+            ips.push_back(info.ip);
         }
+    }
+}
 
-        if (id >= 0 &&
-            (idToInfo[id].services & requestedFlags) == requestedFlags) {
-            ips.insert(idToInfo[id].ip);
+bool CAddrDbShard::GetFirst_(CService &ip, uint64_t requestedFlags) {
+    int id;
+    if (!ourId.empty()) {
+        id = ourId.front();
+    } else if (!unkId.empty()) {
+        id = *unkId.begin();
+    } else {
+        return false;
+    }
+    const CAddrInfo &info = idToInfo[id];
+    if ((info.services & requestedFlags) != requestedFlags) {
+        return false;
+    }
+    ip = info.ip;
+    return true;
+}
+
+void CAddrDbShard::GetStats_(CAddrDbStats &stats, int64_t &oldestTry) {
+    stats.nBanned += banned.size();
+    stats.nAvail += idToInfo.size();
+    stats.nTracked += ourId.size();
+    stats.nGood += goodId.size();
+    stats.nNew += unkId.size();
+    if (!ourId.empty()) {
+        int64_t lastTry = idToInfo[ourId.front()].ourLastTry;
+        if (oldestTry == 0 || lastTry < oldestTry) {
+            oldestTry = lastTry;
         }
-        return;
     }
+}
 
-    std::vector<int> goodIdFiltered;
-    for (auto &id : goodId) {
-        if ((idToInfo[id].services & requestedFlags) == requestedFlags) {
-            goodIdFiltered.push_back(id);
+void CAddrDbShard::ResetIgnores_() {
+    for (auto &it : idToInfo) {
+        it.second.ignoreTill = 0;
+    }
+}
+
+void CAddrDbShard::GetAll_(std::vector<CAddrReport> &reports) {
+    for (int id : ourId) {
+        const CAddrInfo &info = idToInfo[id];
+        if (info.success > 0) {
+            reports.push_back(info.GetReport());
         }
     }
+}
+
+void CAddrDb::GetIPs(std::set<CNetAddr> &ips, uint64_t requestedFlags,
+                     uint32_t max, const bool *nets) {
+    // Only copy the candidates under the shard locks; pick from them after.
+    std::vector<CService> goodFiltered;
+    bool fAnyGood = false;
+    for (auto &shard : shards) {
+        LOCK(shard->cs);
+        fAnyGood |= shard->HasGood_();
+        shard->GetGood_(goodFiltered, requestedFlags);
+    }
+
+    if (!fAnyGood) {
+        for (auto &shard : shards) {
+            CService ip;
+            bool fFound;
+            {
+                LOCK(shard->cs);
+                fFound = shard->GetFirst_(ip, requestedFlags);
+            }
+            if (fFound) {
+                ips.insert(ip);
+                return;
+            }
+        }
+        return;
+    }
 
-    if (!goodIdFiltered.size()) {
+    if (!goodFiltered.size()) {
         return;
     }
 
-    if (max > goodIdFiltered.size() / 2) {
-        max = goodIdFiltered.size() / 2;
+    if (max > goodFiltered.size() / 2) {
+        max = goodFiltered.size() / 2;
     }
 
     if (max < 1) {
@@ -217,11 +286,11 @@ void CAddrDb::GetIPs_(std::set<CNetAddr> &ips, uint64_t requestedFlags,
 
     std::set<int> ids;
     while (ids.size() < max) {
-        ids.insert(goodIdFiltered[rand() % goodIdFiltered.size()]);
+        ids.insert(rand() % goodFiltered.size());
     }
 
     for (auto &id : ids) {
-        CService &ip = idToInfo[id].ip;
+        const CService &ip = goodFiltered[id];
         if (nets[ip.GetNetwork()]) {
             ips.insert(ip);
         }
@@ -2,21 +2,32 @@
 #define BITCOIN_SEEDER_DB_H
 
 #include "bitcoin.h"
+#include "hash.h"
 #include "netbase.h"
 #include "protocol.h"
+#include "random.h"
+#include "streams.h"
 #include "sync.h"
 #include "util.h"
 #include "version.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
 #include <deque>
 #include <map>
+#include <memory>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #define MIN_RETRY 1000
 
+// Number of independently locked parts of the address database
+#define ADDRDB_SHARDS 16
+
 #define REQUIRE_VERSION 70001
 
 static inline int GetRequireHeight(const bool testnet = fTestNet) {
@@ -178,6 +189,7 @@ public:
     void Update(bool good);
 
     friend class CAddrDb;
+    friend class CAddrDbShard;
 
     ADD_SERIALIZE_METHODS;
 
@@ -235,6 +247,27 @@ struct CServiceResult {
 };
 
 /**
+ * Salted hash of a node's address and port. Picks the shard of CAddrDb an
+ * address lives in, and indexes it within that shard.
+ */
+class CServiceHasher {
+private:
+    uint64_t k0, k1;
+
+public:
+    CServiceHasher()
+        : k0(GetRand(std::numeric_limits<uint64_t>::max())),
+          k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+    size_t operator()(const CService &ip) const {
+        std::vector<uint8_t> key = ip.GetKey();
+        return CSipHasher(k0, k1).Write(key.data(), key.size()).Finalize();
+    }
+};
+
+/**
+ * The addresses of one CAddrDb shard, with their own lock.
+ *
  *             seen nodes
  *            /          \
  * (a) banned nodes       available nodes--------------
@@ -243,31 +276,38 @@ struct CServiceResult {
  *              /           \
  *     (d) good nodes   (c) non-good nodes
  */
-class CAddrDb {
+class CAddrDbShard {
 private:
-    mutable CCriticalSection cs;
     // number of address id's
     int nId;
     // map address id to address info (b,c,d,e)
-    std::map<int, CAddrInfo> idToInfo;
+    std::unordered_map<int, CAddrInfo> idToInfo;
     // map ip to id (b,c,d,e)
-    std::map<CService, int> ipToId;
+    std::unordered_map<CService, int, CServiceHasher> ipToId;
     // sequence of tried nodes, in order we have tried connecting to them (c,d)
     std::deque<int> ourId;
     // set of nodes not yet tried (b)
     std::set<int> unkId;
     // set of good nodes  (d, good e)
-    std::set<int> goodId;
+    std::unordered_set<int> goodId;
     int nDirty;
 
-protected:
-    // internal routines that assume proper locks are acquired
+public:
+    mutable CCriticalSection cs;
+    // nodes that are banned, with their unban time (a)
+    std::map<CService, int64_t> banned;
+
+    explicit CAddrDbShard(const CServiceHasher &hasher)
+        : nId(0), ipToId(0, hasher), nDirty(0) {}
+
+    // internal routines that assume cs is held
     // add an address
     void Add_(const CAddress &addr, bool force);
+    // add an address read from disk
+    void Load_(const CAddrInfo &info);
     // get an IP to test (must call Good_, Bad_, or Skipped_ on result
     // afterwards)
     bool Get_(CServiceResult &ip, int &wait);
-    bool GetMany_(std::vector<CServiceResult> &ips, int max, int &wait);
     // mark an IP as good (must have been returned by Get_)
     void Good_(const CService &ip, int clientV, std::string clientSV,
                int blocks);
@@ -278,40 +318,83 @@ protected:
     void Skipped_(const CService &ip);
     // look up id of an IP
     int Lookup_(const CService &ip);
-    // get a random set of IPs (shared lock only)
-    void GetIPs_(std::set<CNetAddr> &ips, uint64_t requestedFlags, uint32_t max,
-                 const bool *nets);
+    // append the good IPs that offer requestedFlags
+    void GetGood_(std::vector<CService> &ips, uint64_t requestedFlags);
+    // get the first tried (or else untried) IP, if it offers requestedFlags
+    bool GetFirst_(CService &ip, uint64_t requestedFlags);
+    void GetStats_(CAddrDbStats &stats, int64_t &oldestTry);
+    void ResetIgnores_();
+    void GetAll_(std::vector<CAddrReport> &reports);
+    bool HasGood_() const { return !goodId.empty(); }
+
+    // serialize the tried and then the untried addresses, returning how many
+    template <typename Stream> int SerializeInfo_(Stream &s) const {
+        for (int id : ourId) {
+            s << idToInfo.at(id);
+        }
+        for (int id : unkId) {
+            s << idToInfo.at(id);
+        }
+        return ourId.size() + unkId.size();
+    }
+};
+
+/**
+ * The addresses we know about, split over ADDRDB_SHARDS shards by the hash of
+ * the address so that crawler results, DNS cache refreshes and dumps only
+ * contend when they touch the same shard.
+ */
+class CAddrDb {
+private:
+    CServiceHasher hasher;
+    std::vector<std::unique_ptr<CAddrDbShard>> shards;
+    // shard GetMany starts at, to spread the crawl over all shards
+    std::atomic<size_t> nNextShard;
+
+    size_t GetShardIndex(const CService &ip) const {
+        return hasher(ip) % shards.size();
+    }
+
+    CAddrDbShard &GetShard(const CService &ip) {
+        return *shards[GetShardIndex(ip)];
+    }
 
 public:
-    // nodes that are banned, with their unban time (a)
-    std::map<CService, int64_t> banned;
+    CAddrDb() : nNextShard(0) {
+        for (int i = 0; i < ADDRDB_SHARDS; i++) {
+            shards.emplace_back(new CAddrDbShard(hasher));
+        }
+    }
 
     void GetStats(CAddrDbStats &stats) {
-        LOCK(cs);
-        stats.nBanned = banned.size();
-        stats.nAvail = idToInfo.size();
-        stats.nTracked = ourId.size();
-        stats.nGood = goodId.size();
-        stats.nNew = unkId.size();
-        stats.nAge = time(nullptr) - idToInfo[ourId[0]].ourLastTry;
+        stats = CAddrDbStats();
+        int64_t oldestTry = 0;
+        for (auto &shard : shards) {
+            LOCK(shard->cs);
+            shard->GetStats_(stats, oldestTry);
+        }
+        stats.nAge = oldestTry ? time(nullptr) - oldestTry : 0;
     }
 
     void ResetIgnores() {
-        for (std::map<int, CAddrInfo>::iterator it = idToInfo.begin();
-             it != idToInfo.end(); it++) {
-            (*it).second.ignoreTill = 0;
+        for (auto &shard : shards) {
+            LOCK(shard->cs);
+            shard->ResetIgnores_();
+        }
+    }
+
+    void ClearBanned() {
+        for (auto &shard : shards) {
+            LOCK(shard->cs);
+            shard->banned.clear();
         }
     }
 
     std::vector<CAddrReport> GetAll() {
         std::vector<CAddrReport> ret;
-        LOCK(cs);
-        for (std::deque<int>::const_iterator it = ourId.begin();
-             it != ourId.end(); it++) {
-            const CAddrInfo &info = idToInfo[*it];
-            if (info.success > 0) {
-                ret.push_back(info.GetReport());
-            }
+        for (auto &shard : shards) {
+            LOCK(shard->cs);
+            shard->GetAll_(ret);
         }
         return ret;
     }
@@ -322,100 +405,127 @@ public:
     //   n (number of ips in (b,c,d))
     //   CAddrInfo[n]
     //   banned
-    // acquires a shared lock (this does not suffice for read mode, but we
-    // assume that only happens at startup, single-threaded) this way, dumping
-    // does not interfere with GetIPs_, which is called from the DNS thread
+    // Shards are copied into memory one at a time, so writing the result out
+    // only ever holds up users of the shard currently being copied.
     template <typename Stream> void Serialize(Stream &s) const {
-        LOCK(cs);
+        CDataStream records(s.GetType(), s.GetVersion());
+        std::map<CService, int64_t> allBanned;
+        int n = 0;
+        for (auto &shard : shards) {
+            LOCK(shard->cs);
+            n += shard->SerializeInfo_(records);
+            allBanned.insert(shard->banned.begin(), shard->banned.end());
+        }
 
         int nVersion = 0;
         s << nVersion;
-
-        CAddrDb *db = const_cast<CAddrDb *>(this);
-        int n = ourId.size() + unkId.size();
         s << n;
-        for (std::deque<int>::const_iterator it = ourId.begin();
-             it != ourId.end(); it++) {
-            std::map<int, CAddrInfo>::iterator ci = db->idToInfo.find(*it);
-            s << (*ci).second;
+        if (!records.empty()) {
+            s.write(records.data(), records.size());
         }
-        for (std::set<int>::const_iterator it = unkId.begin();
-             it != unkId.end(); it++) {
-            std::map<int, CAddrInfo>::iterator ci = db->idToInfo.find(*it);
-            s << (*ci).second;
-        }
-        s << banned;
+        s << allBanned;
     }
 
+    // only used at startup, before other threads run
     template <typename Stream> void Unserialize(Stream &s) {
-        LOCK(cs);
-
         int nVersion;
         s >> nVersion;
 
-        CAddrDb *db = const_cast<CAddrDb *>(this);
-        db->nId = 0;
         int n;
         s >> n;
         for (int i = 0; i < n; i++) {
             CAddrInfo info;
             s >> info;
             if (!info.GetBanTime()) {
-                int id = db->nId++;
-                db->idToInfo[id] = info;
-                db->ipToId[info.ip] = id;
-                if (info.ourLastTry) {
-                    db->ourId.push_back(id);
-                    if (info.IsGood()) db->goodId.insert(id);
-                } else {
-                    db->unkId.insert(id);
-                }
+                CAddrDbShard &shard = GetShard(info.ip);
+                LOCK(shard.cs);
+                shard.Load_(info);
             }
         }
-        db->nDirty++;
 
-        s >> banned;
+        std::map<CService, int64_t> allBanned;
+        s >> allBanned;
+        for (const auto &ban : allBanned) {
+            CAddrDbShard &shard = GetShard(ban.first);
+            LOCK(shard.cs);
+            shard.banned.insert(ban);
+        }
     }
 
     void Add(const CAddress &addr, bool fForce = false) {
-        LOCK(cs);
-        Add_(addr, fForce);
+        CAddrDbShard &shard = GetShard(addr);
+        LOCK(shard.cs);
+        shard.Add_(addr, fForce);
     }
 
     void Add(const std::vector<CAddress> &vAddr, bool fForce = false) {
-        LOCK(cs);
+        std::vector<size_t> vShard(vAddr.size());
         for (size_t i = 0; i < vAddr.size(); i++) {
-            Add_(vAddr[i], fForce);
+            vShard[i] = GetShardIndex(vAddr[i]);
+        }
+        for (size_t s = 0; s < shards.size(); s++) {
+            if (std::find(vShard.begin(), vShard.end(), s) == vShard.end()) {
+                continue;
+            }
+            LOCK(shards[s]->cs);
+            for (size_t i = 0; i < vAddr.size(); i++) {
+                if (vShard[i] == s) {
+                    shards[s]->Add_(vAddr[i], fForce);
+                }
+            }
         }
     }
 
     void Good(const CService &addr, int clientVersion,
               std::string clientSubVersion, int blocks) {
-        LOCK(cs);
-        Good_(addr, clientVersion, clientSubVersion, blocks);
+        CAddrDbShard &shard = GetShard(addr);
+        LOCK(shard.cs);
+        shard.Good_(addr, clientVersion, clientSubVersion, blocks);
     }
 
     void Skipped(const CService &addr) {
-        LOCK(cs);
-        Skipped_(addr);
+        CAddrDbShard &shard = GetShard(addr);
+        LOCK(shard.cs);
+        shard.Skipped_(addr);
     }
 
     void Bad(const CService &addr, int ban = 0) {
-        LOCK(cs);
-        Bad_(addr, ban);
+        CAddrDbShard &shard = GetShard(addr);
+        LOCK(shard.cs);
+        shard.Bad_(addr, ban);
     }
 
     bool Get(CServiceResult &ip, int &wait) {
-        LOCK(cs);
-        return Get_(ip, wait);
+        std::vector<CServiceResult> ips;
+        GetMany(ips, 1, wait);
+        if (ips.empty()) {
+            return false;
+        }
+        ip = ips[0];
+        return true;
     }
 
+    // Take IPs to test from the shards in turn, until max is reached or no
+    // shard has anything left to test.
     void GetMany(std::vector<CServiceResult> &ips, int max, int &wait) {
-        LOCK(cs);
-        while (max > 0) {
+        std::vector<bool> vExhausted(shards.size(), false);
+        size_t nExhausted = 0;
+        size_t s = nNextShard++;
+        while (max > 0 && nExhausted < shards.size()) {
+            s = (s + 1) % shards.size();
+            if (vExhausted[s]) {
+                continue;
+            }
             CServiceResult ip = {};
-            if (!Get_(ip, wait)) {
-                return;
+            bool fGot;
+            {
+                LOCK(shards[s]->cs);
+                fGot = shards[s]->Get_(ip, wait);
+            }
+            if (!fGot) {
+                vExhausted[s] = true;
+                nExhausted++;
+                continue;
             }
             ips.push_back(ip);
             max--;
@@ -423,22 +533,32 @@ public:
     }
 
     void ResultMany(const std::vector<CServiceResult> &ips) {
-        LOCK(cs);
+        std::vector<size_t> vShard(ips.size());
         for (size_t i = 0; i < ips.size(); i++) {
-            if (ips[i].fGood) {
-                Good_(ips[i].service, ips[i].nClientV, ips[i].strClientV,
-                      ips[i].nHeight);
-            } else {
-                Bad_(ips[i].service, ips[i].nBanTime);
+            vShard[i] = GetShardIndex(ips[i].service);
+        }
+        for (size_t s = 0; s < shards.size(); s++) {
+            if (std::find(vShard.begin(), vShard.end(), s) == vShard.end()) {
+                continue;
+            }
+            LOCK(shards[s]->cs);
+            for (size_t i = 0; i < ips.size(); i++) {
+                if (vShard[i] != s) {
+                    continue;
+                }
+                if (ips[i].fGood) {
+                    shards[s]->Good_(ips[i].service, ips[i].nClientV,
+                                     ips[i].strClientV, ips[i].nHeight);
+                } else {
+                    shards[s]->Bad_(ips[i].service, ips[i].nBanTime);
+                }
             }
         }
     }
 
+    // get a random set of IPs
     void GetIPs(std::set<CNetAddr> &ips, uint64_t requestedFlags, uint32_t max,
-                const bool *nets) {
-        LOCK(cs);
-        GetIPs_(ips, requestedFlags, max, nets);
-    }
+                const bool *nets);
 };
 
 #endif
@@ -1,11 +1,13 @@
 #include "dns.h"
 
 #include <cctype>
+#include <cerrno>
 #include <cstdbool>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <mutex>
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -15,6 +17,8 @@
 #include <unistd.h>
 
 #define BUFLEN 512
+// Number of queries received and answered per system call
+#define DNS_BATCH 64
 
 #if defined IP_RECVDSTADDR
 #define DSTADDR_SOCKOPT IP_RECVDSTADDR
@@ -185,7 +189,7 @@ static int write_record_aaaa(uint8_t **outpos, const uint8_t *outend,
     int error = 0;
     int ret = write_record(outpos, outend, name, offset, TYPE_AAAA, cls, ttl);
     if (ret) return ret;
-    if (outend - *outpos < 6) {
+    if (outend - *outpos < 18) {
         error = -5;
         goto error;
     }
@@ -304,6 +308,24 @@ error:
     return error;
 }
 
+// The question always directly follows the 12 byte header, so every answer
+// can refer to its name with the same pointer.
+#define QUESTION_OFFSET 12
+
+size_t dns_encode_answer(uint8_t *outbuf, size_t outsize, const addr_t *addr,
+                         int ttl) {
+    uint8_t *outpos = outbuf;
+    int ret = -6;
+    if (addr->v == 4) {
+        ret = write_record_a(&outpos, outbuf + outsize, "", QUESTION_OFFSET,
+                             CLASS_IN, ttl, addr);
+    } else if (addr->v == 6) {
+        ret = write_record_aaaa(&outpos, outbuf + outsize, "", QUESTION_OFFSET,
+                                CLASS_IN, ttl, addr);
+    }
+    return ret ? 0 : outpos - outbuf;
+}
+
 static ssize_t dnshandle(dns_opt_t *opt, const uint8_t *inbuf, size_t insize,
                          uint8_t *outbuf) {
     int error = 0;
@@ -459,31 +481,15 @@ static ssize_t dnshandle(dns_opt_t *opt, const uint8_t *inbuf, size_t insize,
         // A/AAAA records
         if ((typ == TYPE_A || typ == TYPE_AAAA || typ == QTYPE_ANY) &&
             (cls == CLASS_IN || cls == QCLASS_ANY)) {
-            addr_t addr[32];
-            int naddr = opt->cb((void *)opt, name, addr, 32,
-                                typ == TYPE_A || typ == QTYPE_ANY,
-                                typ == TYPE_AAAA || typ == QTYPE_ANY);
-            int n = 0;
-            while (n < naddr) {
-                int ret = 1;
-                if (addr[n].v == 4) {
-                    ret = write_record_a(&outpos, outend - max_auth_size, "",
-                                         offset, CLASS_IN, opt->datattl,
-                                         &addr[n]);
-                } else if (addr[n].v == 6) {
-                    ret = write_record_aaaa(&outpos, outend - max_auth_size, "",
-                                            offset, CLASS_IN, opt->datattl,
-                                            &addr[n]);
-                }
-
-                //      printf("wrote A record: %i\n", ret);
-                if (ret) {
-                    break;
-                }
-
-                n++;
-                outbuf[7]++;
+            uint8_t *answerend = outend - max_auth_size;
+            size_t written = 0;
+            if (answerend > outpos) {
+                outbuf[7] += opt->cb((void *)opt, name, outpos,
+                                     answerend - outpos, &written, 32,
+                                     typ == TYPE_A || typ == QTYPE_ANY,
+                                     typ == TYPE_AAAA || typ == QTYPE_ANY);
             }
+            outpos += written;
         }
 
         // Authority section
@@ -529,37 +535,129 @@ error:
     return 12;
 }
 
-static int listenSocket = -1;
-
-int dnsserver(dns_opt_t *opt) {
-    struct sockaddr_in6 si_other;
-    int senderSocket = -1;
-    senderSocket = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
-    if (senderSocket == -1) return -3;
-
-    int replySocket;
-    if (listenSocket == -1) {
-        struct sockaddr_in6 si_me;
-        if ((listenSocket = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP)) == -1) {
-            listenSocket = -1;
-            return -1;
+// Whether a received message carries the destination address it was sent to,
+// in which case the reply is sent back with the same control data.
+static bool has_dstaddr(struct msghdr *msg) {
+    for (struct cmsghdr *hdr = CMSG_FIRSTHDR(msg); hdr;
+         hdr = CMSG_NXTHDR(msg, hdr)) {
+        if (hdr->cmsg_level == IPPROTO_IP &&
+            hdr->cmsg_type == DSTADDR_SOCKOPT) {
+            return true;
         }
-        replySocket = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
-        if (replySocket == -1) {
-            close(listenSocket);
+    }
+    return false;
+}
+
+// >=0: socket
+//  -1: could not create the socket (or SO_REUSEPORT is not supported)
+//  -2: could not bind
+static int open_listen_socket(int port, bool reuseport) {
+    int sock = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == -1) return -1;
+
+    int sockopt = 1;
+    if (reuseport) {
+#ifdef SO_REUSEPORT
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &sockopt,
+                       sizeof sockopt) == -1) {
+            close(sock);
             return -1;
         }
-        int sockopt = 1;
-        setsockopt(listenSocket, IPPROTO_IPV6, DSTADDR_SOCKOPT, &sockopt,
-                   sizeof sockopt);
-        memset((char *)&si_me, 0, sizeof(si_me));
-        si_me.sin6_family = AF_INET6;
-        si_me.sin6_port = htons(opt->port);
-        si_me.sin6_addr = in6addr_any;
-        if (bind(listenSocket, (struct sockaddr *)&si_me, sizeof(si_me)) == -1)
-            return -2;
+#else
+        close(sock);
+        return -1;
+#endif
+    }
+    setsockopt(sock, IPPROTO_IPV6, DSTADDR_SOCKOPT, &sockopt, sizeof sockopt);
+
+    struct sockaddr_in6 si_me;
+    memset((char *)&si_me, 0, sizeof(si_me));
+    si_me.sin6_family = AF_INET6;
+    si_me.sin6_port = htons(port);
+    si_me.sin6_addr = in6addr_any;
+    if (bind(sock, (struct sockaddr *)&si_me, sizeof(si_me)) == -1) {
+        close(sock);
+        return -2;
     }
+    return sock;
+}
+
+#ifdef MSG_WAITFORONE
+// Receive up to DNS_BATCH queries per system call, answer them all, and send
+// the replies back with a single sendmmsg.
+static int dns_serve_batched(dns_opt_t *opt, int sock) {
+    uint8_t inbuf[DNS_BATCH][BUFLEN], outbuf[DNS_BATCH][BUFLEN];
+    struct sockaddr_in6 si_other[DNS_BATCH];
+    union control_data cmsg[DNS_BATCH];
+    struct iovec iniov[DNS_BATCH], outiov[DNS_BATCH];
+    struct mmsghdr inmsg[DNS_BATCH], outmsg[DNS_BATCH];
+
+    memset(inmsg, 0, sizeof(inmsg));
+    memset(outmsg, 0, sizeof(outmsg));
+    for (int i = 0; i < DNS_BATCH; i++) {
+        iniov[i].iov_base = inbuf[i];
+        iniov[i].iov_len = sizeof(inbuf[i]);
+        inmsg[i].msg_hdr.msg_name = &si_other[i];
+        inmsg[i].msg_hdr.msg_iov = &iniov[i];
+        inmsg[i].msg_hdr.msg_iovlen = 1;
+        inmsg[i].msg_hdr.msg_control = &cmsg[i];
+        outmsg[i].msg_hdr.msg_iov = &outiov[i];
+        outmsg[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (1) {
+        for (int i = 0; i < DNS_BATCH; i++) {
+            inmsg[i].msg_hdr.msg_namelen = sizeof(si_other[i]);
+            inmsg[i].msg_hdr.msg_controllen = sizeof(cmsg[i]);
+            inmsg[i].msg_hdr.msg_flags = 0;
+        }
+        int nin = recvmmsg(sock, inmsg, DNS_BATCH, MSG_WAITFORONE, nullptr);
+        if (nin <= 0) continue;
+        opt->nBatches++;
+        opt->nRequests += nin;
+
+        int nout = 0;
+        for (int i = 0; i < nin; i++) {
+            struct msghdr *in = &inmsg[i].msg_hdr;
+            if (inmsg[i].msg_len == 0) continue;
+            ssize_t ret =
+                dnshandle(opt, inbuf[i], inmsg[i].msg_len, outbuf[nout]);
+            if (ret <= 0) continue;
+
+            struct msghdr *out = &outmsg[nout].msg_hdr;
+            outiov[nout].iov_base = outbuf[nout];
+            outiov[nout].iov_len = ret;
+            out->msg_name = in->msg_name;
+            out->msg_namelen = in->msg_namelen;
+            if (has_dstaddr(in)) {
+                out->msg_control = in->msg_control;
+                out->msg_controllen = in->msg_controllen;
+            } else {
+                out->msg_control = nullptr;
+                out->msg_controllen = 0;
+            }
+            nout++;
+        }
 
+        int nsent = 0;
+        while (nsent < nout) {
+            int ret = sendmmsg(sock, outmsg + nsent, nout - nsent, 0);
+            if (ret > 0) {
+                nsent += ret;
+            } else if (ret == -1 && errno == EINTR) {
+                continue;
+            } else {
+                // The first remaining reply was refused, skip it.
+                opt->nDropped++;
+                nsent++;
+            }
+        }
+    }
+    return 0;
+}
+#else
+static int dns_serve(dns_opt_t *opt, int sock) {
+    struct sockaddr_in6 si_other;
     uint8_t inbuf[BUFLEN], outbuf[BUFLEN];
     struct iovec iov[1] = {
         {
@@ -570,39 +668,61 @@ int dnsserver(dns_opt_t *opt) {
     union control_data cmsg;
     msghdr msg;
     msg.msg_name = &si_other;
-    msg.msg_namelen = sizeof(si_other);
     msg.msg_iov = iov;
     msg.msg_iovlen = 1;
     msg.msg_control = &cmsg;
-    msg.msg_controllen = sizeof(cmsg);
-
-    for (; 1; ++(opt->nRequests)) {
-        ssize_t insize = recvmsg(listenSocket, &msg, 0);
-        //    uint8_t *addr = (uint8_t*)&si_other.sin_addr.s_addr;
-        //    printf("DNS: Request %llu from %i.%i.%i.%i:%i of %i bytes\n",
-        //    (unsigned long long)(opt->nRequests), addr[0], addr[1], addr[2],
-        //    addr[3], ntohs(si_other.sin_port), (int)insize);
+
+    while (1) {
+        msg.msg_namelen = sizeof(si_other);
+        msg.msg_controllen = sizeof(cmsg);
+        msg.msg_flags = 0;
+        ssize_t insize = recvmsg(sock, &msg, 0);
         if (insize <= 0) continue;
+        opt->nBatches++;
+        opt->nRequests++;
 
         ssize_t ret = dnshandle(opt, inbuf, insize, outbuf);
         if (ret <= 0) continue;
 
-        bool handled = false;
-        for (struct cmsghdr *hdr = CMSG_FIRSTHDR(&msg); hdr;
-             hdr = CMSG_NXTHDR(&msg, hdr)) {
-            if (hdr->cmsg_level == IPPROTO_IP &&
-                hdr->cmsg_type == DSTADDR_SOCKOPT) {
-                msg.msg_iov[0].iov_base = outbuf;
-                msg.msg_iov[0].iov_len = ret;
-                sendmsg(listenSocket, &msg, 0);
-                msg.msg_iov[0].iov_base = inbuf;
-                msg.msg_iov[0].iov_len = sizeof(inbuf);
-                handled = true;
-            }
+        ssize_t sent;
+        if (has_dstaddr(&msg)) {
+            msg.msg_iov[0].iov_base = outbuf;
+            msg.msg_iov[0].iov_len = ret;
+            sent = sendmsg(sock, &msg, 0);
+            msg.msg_iov[0].iov_base = inbuf;
+            msg.msg_iov[0].iov_len = sizeof(inbuf);
+        } else {
+            sent = sendto(sock, outbuf, ret, 0, (struct sockaddr *)&si_other,
+                          sizeof(si_other));
         }
-        if (!handled)
-            sendto(listenSocket, outbuf, ret, 0, (struct sockaddr *)&si_other,
-                   sizeof(si_other));
+        if (sent < 0) opt->nDropped++;
     }
     return 0;
 }
+#endif
+
+// Used by all server threads when they cannot each bind their own socket.
+static std::mutex cs_sharedSocket;
+static int sharedSocket = -1;
+
+int dnsserver(dns_opt_t *opt) {
+    // Give every thread its own socket so the kernel spreads incoming queries
+    // over them, instead of all threads contending for one receive queue.
+    int sock = open_listen_socket(opt->port, true);
+    if (sock == -2) return -2;
+    if (sock == -1) {
+        std::lock_guard<std::mutex> lock(cs_sharedSocket);
+        if (sharedSocket == -1) {
+            sock = open_listen_socket(opt->port, false);
+            if (sock < 0) return sock;
+            sharedSocket = sock;
+        }
+        sock = sharedSocket;
+    }
+
+#ifdef MSG_WAITFORONE
+    return dns_serve_batched(opt, sock);
+#else
+    return dns_serve(opt, sock);
+#endif
+}
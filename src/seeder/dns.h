@@ -1,6 +1,7 @@
 #ifndef BITCOIN_SEEDER_DNS_H
 #define BITCOIN_SEEDER_DNS_H 1
 
+#include <cstddef>
 #include <cstdint>
 
 struct addr_t {
@@ -18,12 +19,30 @@ struct dns_opt_t {
     const char *host;
     const char *ns;
     const char *mbox;
-    uint32_t (*cb)(void *opt, char *requested_hostname, addr_t *addr,
-                   uint32_t max, uint32_t ipv4, uint32_t ipv6);
+    // Copy at most max pre-encoded A (if ipv4) and AAAA (if ipv6) answer
+    // records for requested_hostname into outbuf, without exceeding outsize
+    // bytes. Returns the number of records and sets *written to their size.
+    uint32_t (*cb)(void *opt, char *requested_hostname, uint8_t *outbuf,
+                   size_t outsize, size_t *written, uint32_t max,
+                   uint32_t ipv4, uint32_t ipv6);
     // stats
     uint64_t nRequests;
+    // receive calls that returned at least one query
+    uint64_t nBatches;
+    // replies the kernel refused to send
+    uint64_t nDropped;
 };
 
+// Size of an encoded A and AAAA answer record
+#define DNS_RECORD_A_SIZE 16
+#define DNS_RECORD_AAAA_SIZE 28
+
+// Encode an A or AAAA answer record for addr, whose name refers back to the
+// question of the response it gets copied into. Returns the number of bytes
+// written, or 0 if the record does not fit in outsize.
+size_t dns_encode_answer(uint8_t *outbuf, size_t outsize, const addr_t *addr,
+                         int ttl);
+
 int dnsserver(dns_opt_t *opt);
 
 #endif
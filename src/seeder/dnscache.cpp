@@ -0,0 +1,52 @@
+#include "dnscache.h"
+
+#include "db.h"
+#include "dns.h"
+
+#include <cstdlib>
+#include <cstring>
+
+void CDnsCache::Refresh(const std::set<uint64_t> &flagSets) {
+    bool nets[NET_MAX] = {};
+    nets[NET_IPV4] = true;
+    nets[NET_IPV6] = true;
+
+    DnsAnswerMap fresh;
+    for (uint64_t flags : flagSets) {
+        std::set<CNetAddr> ips;
+        db.GetIPs(ips, flags, 1000, nets);
+        dbQueries++;
+
+        // Shuffle, as queries are answered with consecutive records.
+        std::vector<CNetAddr> order(ips.begin(), ips.end());
+        for (size_t i = order.size(); i > 1; i--) {
+            std::swap(order[i - 1], order[rand() % i]);
+        }
+
+        std::shared_ptr<CDnsAnswers> entry = std::make_shared<CDnsAnswers>();
+        for (const CNetAddr &ip : order) {
+            struct in_addr addr;
+            struct in6_addr addr6;
+            addr_t a;
+            if (ip.GetInAddr(&addr)) {
+                a.v = 4;
+                memcpy(&a.data.v4, &addr, 4);
+            } else if (ip.GetIn6Addr(&addr6)) {
+                a.v = 6;
+                memcpy(&a.data.v6, &addr6, 16);
+            } else {
+                continue;
+            }
+            uint8_t record[DNS_RECORD_AAAA_SIZE];
+            size_t size =
+                dns_encode_answer(record, sizeof(record), &a, DNS_DATA_TTL);
+            std::vector<uint8_t> &records = a.v == 4 ? entry->v4 : entry->v6;
+            records.insert(records.end(), record, record + size);
+        }
+        fresh[flags] = entry;
+    }
+
+    LOCK(cs);
+    answers.swap(fresh);
+    nGeneration++;
+}
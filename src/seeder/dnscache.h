@@ -0,0 +1,55 @@
+#ifndef BITCOIN_SEEDER_DNSCACHE_H
+#define BITCOIN_SEEDER_DNSCACHE_H
+
+#include "sync.h"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+class CAddrDb;
+
+// TTL of the A and AAAA records we serve
+const static int DNS_DATA_TTL = 3600;
+
+// Encoded answer records for one set of requested service flags. Never
+// modified once published, so DNS threads read it without locking.
+struct CDnsAnswers {
+    // DNS_RECORD_A_SIZE bytes per record
+    std::vector<uint8_t> v4;
+    // DNS_RECORD_AAAA_SIZE bytes per record
+    std::vector<uint8_t> v6;
+};
+
+typedef std::map<uint64_t, std::shared_ptr<const CDnsAnswers>> DnsAnswerMap;
+
+// Answers for every supported flag set, rebuilt in the background by
+// ThreadDnsCache so that DNS threads never have to wait on the database.
+class CDnsCache {
+private:
+    CAddrDb &db;
+    mutable CCriticalSection cs;
+    DnsAnswerMap answers;
+    std::atomic<uint64_t> nGeneration;
+
+public:
+    std::atomic<uint64_t> dbQueries;
+
+    explicit CDnsCache(CAddrDb &dbIn)
+        : db(dbIn), nGeneration(0), dbQueries(0) {}
+
+    uint64_t GetGeneration() const { return nGeneration; }
+
+    void Get(DnsAnswerMap &answersOut, uint64_t &generationOut) const {
+        LOCK(cs);
+        answersOut = answers;
+        generationOut = nGeneration;
+    }
+
+    void Refresh(const std::set<uint64_t> &flagSets);
+};
+
+#endif
@@ -2,6 +2,7 @@
 #include "clientversion.h"
 #include "db.h"
 #include "dns.h"
+#include "dnscache.h"
 #include "protocol.h"
 #include "streams.h"
 
@@ -11,12 +12,14 @@
 #include <cstdio>
 #include <cstdlib>
 #include <getopt.h>
+#include <memory>
 #include <pthread.h>
 #include <signal.h>
+#include <sys/resource.h>
 
 class CDnsSeedOpts {
 public:
-    int nThreads;
+    int nConnections;
     int nPort;
     int nDnsThreads;
     int fUseTestNet;
@@ -31,7 +34,7 @@ public:
     std::set<uint64_t> filter_whitelist;
 
     CDnsSeedOpts()
-        : nThreads(96), nPort(53), nDnsThreads(4), fUseTestNet(false),
+        : nConnections(1000), nPort(53), nDnsThreads(4), fUseTestNet(false),
           fWipeBan(false), fWipeIgnore(false), mbox(nullptr), ns(nullptr),
           host(nullptr), tor(nullptr), ipv4_proxy(nullptr),
           ipv6_proxy(nullptr) {}
@@ -39,15 +42,15 @@ public:
     void ParseCommandLine(int argc, char **argv) {
         static const char *help =
             "Bitcoin-cash-seeder\n"
-            "Usage: %s -h <host> -n <ns> [-m <mbox>] [-t <threads>] [-p "
+            "Usage: %s -h <host> -n <ns> [-m <mbox>] [-t <nodes>] [-p "
             "<port>]\n"
             "\n"
             "Options:\n"
             "-h <host>       Hostname of the DNS seed\n"
             "-n <ns>         Hostname of the nameserver\n"
             "-m <mbox>       E-Mail address reported in SOA records\n"
-            "-t <threads>    Number of crawlers to run in parallel (default "
-            "96)\n"
+            "-t <nodes>      Number of nodes to crawl in parallel (default "
+            "1000)\n"
             "-d <threads>    Number of DNS server threads (default 4)\n"
             "-p <port>       UDP port to listen on (default 53)\n"
             "-o <ip:port>    Tor proxy IP/Port\n"
@@ -101,7 +104,7 @@ public:
 
                 case 't': {
                     int n = strtol(optarg, nullptr, 10);
-                    if (n > 0 && n < 1000) nThreads = n;
+                    if (n > 0 && n < 100000) nConnections = n;
                     break;
                 }
 
@@ -169,123 +172,122 @@ extern "C" {
 
 CAddrDb db;
 
+// Crawl results are handed to the database in batches of this size, or at
+// least once per second.
+const static size_t CRAWLER_RESULT_BATCH = 100;
+
 extern "C" void *ThreadCrawler(void *data) {
-    int *nThreads = (int *)data;
+    CCrawler crawler(*(int *)data);
+    std::vector<CServiceResult> results;
+    std::vector<CAddress> addr;
+    int64_t nNextGet = 0;
+    int64_t nLastReport = time(nullptr);
     do {
-        std::vector<CServiceResult> ips;
-        int wait = 5;
-        db.GetMany(ips, 16, wait);
         int64_t now = time(nullptr);
-        if (ips.empty()) {
-            wait *= 1000;
-            wait += rand() % (500 * *nThreads);
-            Sleep(wait);
-            continue;
+        if (crawler.GetCount() < crawler.GetMaxConnections() &&
+            now >= nNextGet) {
+            std::vector<CServiceResult> ips;
+            int wait = 5;
+            int max = crawler.GetMaxConnections() - crawler.GetCount();
+            db.GetMany(ips, max, wait);
+            if (ips.empty()) {
+                nNextGet = now + wait;
+            } else if (int(ips.size()) < max) {
+                nNextGet = now + 1;
+            }
+            for (size_t i = 0; i < ips.size(); i++) {
+                CServiceResult &res = ips[i];
+                res.nBanTime = 0;
+                res.nClientV = 0;
+                res.nHeight = 0;
+                res.strClientV = "";
+                bool getaddr = res.ourLastSuccess + 86400 < now;
+                if (!crawler.Add(res, getaddr)) {
+                    // Out of sockets, try this node again later.
+                    db.Skipped(res.service);
+                    nNextGet = now + 1;
+                }
+            }
         }
 
-        std::vector<CAddress> addr;
-        for (size_t i = 0; i < ips.size(); i++) {
-            CServiceResult &res = ips[i];
-            res.nBanTime = 0;
-            res.nClientV = 0;
-            res.nHeight = 0;
-            res.strClientV = "";
-            bool getaddr = res.ourLastSuccess + 86400 < now;
-            res.fGood = TestNode(res.service, res.nBanTime, res.nClientV,
-                                 res.strClientV, res.nHeight,
-                                 getaddr ? &addr : nullptr);
-        }
+        crawler.Poll(crawler.GetCount() ? 100 : 1000, results, addr);
 
-        db.ResultMany(ips);
-        db.Add(addr);
+        now = time(nullptr);
+        if (results.size() >= CRAWLER_RESULT_BATCH ||
+            (!results.empty() && now > nLastReport)) {
+            db.ResultMany(results);
+            db.Add(addr);
+            results.clear();
+            addr.clear();
+            nLastReport = now;
+        }
     } while (1);
     return nullptr;
 }
 
-extern "C" uint32_t GetIPList(void *thread, char *requestedHostname,
-                              addr_t *addr, uint32_t max, uint32_t ipv4,
-                              uint32_t ipv6);
+// How often the encoded answers are rebuilt from the database, in ms
+const static int DNS_CACHE_REFRESH_INTERVAL = 5000;
+
+CDnsCache dnsCache(db);
+
+extern "C" uint32_t GetAnswers(void *thread, char *requestedHostname,
+                               uint8_t *outbuf, size_t outsize,
+                               size_t *written, uint32_t max, uint32_t ipv4,
+                               uint32_t ipv6);
 
 class CDnsThread {
 public:
-    struct FlagSpecificData {
-        int nIPv4, nIPv6;
-        std::vector<addr_t> cache;
-        time_t cacheTime;
-        unsigned int cacheHits;
-        FlagSpecificData() : nIPv4(0), nIPv6(0), cacheTime(0), cacheHits(0) {}
-    };
-
     dns_opt_t dns_opt; // must be first
     const int id;
-    std::map<uint64_t, FlagSpecificData> perflag;
-    std::atomic<uint64_t> dbQueries;
     std::set<uint64_t> filterWhitelist;
+    // This thread's copy of the dnsCache answers, updated when the cache
+    // generation changes.
+    DnsAnswerMap answers;
+    uint64_t nAnswersGeneration;
 
-    void cacheHit(uint64_t requestedFlags, bool force = false) {
-        static bool nets[NET_MAX] = {};
-        if (!nets[NET_IPV4]) {
-            nets[NET_IPV4] = true;
-            nets[NET_IPV6] = true;
-        }
-        time_t now = time(nullptr);
-        FlagSpecificData &thisflag = perflag[requestedFlags];
-        thisflag.cacheHits++;
-        if (force ||
-            thisflag.cacheHits * 400 >
-                (thisflag.cache.size() * thisflag.cache.size()) ||
-            (thisflag.cacheHits * thisflag.cacheHits * 20 >
-                 thisflag.cache.size() &&
-             (now - thisflag.cacheTime > 5))) {
-            std::set<CNetAddr> ips;
-            db.GetIPs(ips, requestedFlags, 1000, nets);
-            dbQueries++;
-            thisflag.cache.clear();
-            thisflag.nIPv4 = 0;
-            thisflag.nIPv6 = 0;
-            thisflag.cache.reserve(ips.size());
-            for (auto &ip : ips) {
-                struct in_addr addr;
-                struct in6_addr addr6;
-                if (ip.GetInAddr(&addr)) {
-                    addr_t a;
-                    a.v = 4;
-                    memcpy(&a.data.v4, &addr, 4);
-                    thisflag.cache.push_back(a);
-                    thisflag.nIPv4++;
-                } else if (ip.GetIn6Addr(&addr6)) {
-                    addr_t a;
-                    a.v = 6;
-                    memcpy(&a.data.v6, &addr6, 16);
-                    thisflag.cache.push_back(a);
-                    thisflag.nIPv6++;
-                }
-            }
-            thisflag.cacheHits = 0;
-            thisflag.cacheTime = now;
-        }
-    }
-
-    CDnsThread(CDnsSeedOpts *opts, int idIn) : id(idIn) {
+    CDnsThread(CDnsSeedOpts *opts, int idIn)
+        : id(idIn), nAnswersGeneration(0) {
         dns_opt.host = opts->host;
         dns_opt.ns = opts->ns;
         dns_opt.mbox = opts->mbox;
-        dns_opt.datattl = 3600;
+        dns_opt.datattl = DNS_DATA_TTL;
         dns_opt.nsttl = 40000;
-        dns_opt.cb = GetIPList;
+        dns_opt.cb = GetAnswers;
         dns_opt.port = opts->nPort;
         dns_opt.nRequests = 0;
-        dbQueries = 0;
-        perflag.clear();
+        dns_opt.nBatches = 0;
+        dns_opt.nDropped = 0;
         filterWhitelist = opts->filter_whitelist;
     }
 
     void run() { dnsserver(&dns_opt); }
 };
 
-extern "C" uint32_t GetIPList(void *data, char *requestedHostname, addr_t *addr,
-                              uint32_t max, uint32_t ipv4, uint32_t ipv6) {
+// Copy max records of recordSize bytes, starting at a random record and
+// wrapping around at the end.
+static size_t CopyRecords(const std::vector<uint8_t> &records,
+                          size_t recordSize, size_t max, uint8_t *outbuf) {
+    size_t size = records.size() / recordSize;
+    if (max > size) {
+        max = size;
+    }
+    if (max == 0) {
+        return 0;
+    }
+    size_t start = rand() % size;
+    size_t first = std::min(max, size - start);
+    memcpy(outbuf, &records[start * recordSize], first * recordSize);
+    memcpy(outbuf + first * recordSize, &records[0],
+           (max - first) * recordSize);
+    return max;
+}
+
+extern "C" uint32_t GetAnswers(void *data, char *requestedHostname,
+                               uint8_t *outbuf, size_t outsize,
+                               size_t *written, uint32_t max, uint32_t ipv4,
+                               uint32_t ipv6) {
     CDnsThread *thread = (CDnsThread *)data;
+    *written = 0;
 
     uint64_t requestedFlags = 0;
     int hostlen = strlen(requestedHostname);
@@ -304,40 +306,46 @@ extern "C" uint32_t GetIPList(void *data, char *requestedHostname, addr_t *addr,
     } else if (strcasecmp(requestedHostname, thread->dns_opt.host)) {
         return 0;
     }
-    thread->cacheHit(requestedFlags);
-    auto &thisflag = thread->perflag[requestedFlags];
-    uint32_t size = thisflag.cache.size();
-    uint32_t maxmax = (ipv4 ? thisflag.nIPv4 : 0) + (ipv6 ? thisflag.nIPv6 : 0);
-    if (max > size) {
-        max = size;
-    }
-    if (max > maxmax) {
-        max = maxmax;
+
+    if (dnsCache.GetGeneration() != thread->nAnswersGeneration) {
+        dnsCache.Get(thread->answers, thread->nAnswersGeneration);
     }
-    uint32_t i = 0;
-    while (i < max) {
-        uint32_t j = i + (rand() % (size - i));
-        do {
-            bool ok = (ipv4 && thisflag.cache[j].v == 4) ||
-                      (ipv6 && thisflag.cache[j].v == 6);
-            if (ok) {
-                break;
-            }
-            j++;
-            if (j == size) {
-                j = i;
-            }
-        } while (1);
-        addr[i] = thisflag.cache[j];
-        thisflag.cache[j] = thisflag.cache[i];
-        thisflag.cache[i] = addr[i];
-        i++;
+    auto it = thread->answers.find(requestedFlags);
+    if (it == thread->answers.end()) {
+        return 0;
     }
-    return max;
+    const CDnsAnswers &answers = *it->second;
+
+    size_t nIPv4 = ipv4 ? answers.v4.size() / DNS_RECORD_A_SIZE : 0;
+    size_t nIPv6 = ipv6 ? answers.v6.size() / DNS_RECORD_AAAA_SIZE : 0;
+    // If both are requested, AAAA records get at most half of the records and
+    // of the space, and A records fill up the rest.
+    size_t n6 = std::min<size_t>(nIPv6, max / (nIPv4 ? 2 : 1));
+    n6 = std::min(n6, outsize / (nIPv4 ? 2 : 1) / DNS_RECORD_AAAA_SIZE);
+    size_t n4 = std::min<size_t>(nIPv4, max - n6);
+    n4 = std::min(n4,
+                  (outsize - n6 * DNS_RECORD_AAAA_SIZE) / DNS_RECORD_A_SIZE);
+
+    n4 = CopyRecords(answers.v4, DNS_RECORD_A_SIZE, n4, outbuf);
+    n6 = CopyRecords(answers.v6, DNS_RECORD_AAAA_SIZE, n6,
+                     outbuf + n4 * DNS_RECORD_A_SIZE);
+    *written = n4 * DNS_RECORD_A_SIZE + n6 * DNS_RECORD_AAAA_SIZE;
+    return n4 + n6;
 }
 
 std::vector<CDnsThread *> dnsThread;
 
+extern "C" void *ThreadDnsCache(void *arg) {
+    std::set<uint64_t> flagSets = ((CDnsSeedOpts *)arg)->filter_whitelist;
+    // Queries for the plain hostname do not filter on service flags.
+    flagSets.insert(0);
+    do {
+        dnsCache.Refresh(flagSets);
+        Sleep(DNS_CACHE_REFRESH_INTERVAL);
+    } while (1);
+    return nullptr;
+}
+
 extern "C" void *ThreadDNS(void *arg) {
     CDnsThread *thread = (CDnsThread *)arg;
     thread->run();
@@ -425,17 +433,23 @@ extern "C" void *ThreadStats(void *) {
             printf("\x1b[2K\x1b[u");
         printf("\x1b[s");
         uint64_t requests = 0;
+        uint64_t batches = 0;
+        uint64_t dropped = 0;
         uint64_t queries = 0;
         for (unsigned int i = 0; i < dnsThread.size(); i++) {
             requests += dnsThread[i]->dns_opt.nRequests;
-            queries += dnsThread[i]->dbQueries;
+            batches += dnsThread[i]->dns_opt.nBatches;
+            dropped += dnsThread[i]->dns_opt.nDropped;
         }
+        queries = dnsCache.dbQueries;
         printf("%s %i/%i available (%i tried in %is, %i new, %i active), %i "
-               "banned; %llu DNS requests, %llu db queries",
+               "banned; %llu DNS requests (%.1f per batch, %llu dropped), "
+               "%llu db queries",
                c, stats.nGood, stats.nAvail, stats.nTracked, stats.nAge,
                stats.nNew, stats.nAvail - stats.nTracked - stats.nNew,
                stats.nBanned, (unsigned long long)requests,
-               (unsigned long long)queries);
+               batches ? (double)requests / batches : 0.0,
+               (unsigned long long)dropped, (unsigned long long)queries);
         Sleep(1000);
     } while (1);
     return nullptr;
@@ -472,6 +486,13 @@ int main(int argc, char **argv) {
     setbuf(stdout, nullptr);
     CDnsSeedOpts opts;
     opts.ParseCommandLine(argc, argv);
+    // The crawler needs a socket for every node it tests at the same time.
+    struct rlimit fileLimit;
+    if (getrlimit(RLIMIT_NOFILE, &fileLimit) == 0 &&
+        fileLimit.rlim_cur < fileLimit.rlim_max) {
+        fileLimit.rlim_cur = fileLimit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &fileLimit);
+    }
     printf("Supporting whitelisted filters: ");
     for (std::set<uint64_t>::const_iterator it = opts.filter_whitelist.begin();
          it != opts.filter_whitelist.end(); it++) {
@@ -531,12 +552,13 @@ int main(int argc, char **argv) {
         printf("Loading dnsseed.dat...");
         CAutoFile cf(f, SER_DISK, CLIENT_VERSION);
         cf >> db;
-        if (opts.fWipeBan) db.banned.clear();
+        if (opts.fWipeBan) db.ClearBanned();
         if (opts.fWipeIgnore) db.ResetIgnores();
         printf("done\n");
     }
-    pthread_t threadDns, threadSeed, threadDump, threadStats;
+    pthread_t threadDns, threadDnsCache, threadSeed, threadDump, threadStats;
     if (fDNS) {
+        pthread_create(&threadDnsCache, nullptr, ThreadDnsCache, &opts);
         printf("Starting %i DNS threads for %s on %s (port %i)...",
                opts.nDnsThreads, opts.host, opts.ns, opts.nPort);
         dnsThread.clear();
@@ -551,15 +573,9 @@ int main(int argc, char **argv) {
     printf("Starting seeder...");
     pthread_create(&threadSeed, nullptr, ThreadSeeder, nullptr);
     printf("done\n");
-    printf("Starting %i crawler threads...", opts.nThreads);
-    pthread_attr_t attr_crawler;
-    pthread_attr_init(&attr_crawler);
-    pthread_attr_setstacksize(&attr_crawler, 0x20000);
-    for (int i = 0; i < opts.nThreads; i++) {
-        pthread_t thread;
-        pthread_create(&thread, &attr_crawler, ThreadCrawler, &opts.nThreads);
-    }
-    pthread_attr_destroy(&attr_crawler);
+    printf("Starting crawler for %i nodes at a time...", opts.nConnections);
+    pthread_t threadCrawler;
+    pthread_create(&threadCrawler, nullptr, ThreadCrawler, &opts.nConnections);
     printf("done\n");
     pthread_create(&threadStats, nullptr, ThreadStats, nullptr);
     pthread_create(&threadDump, nullptr, ThreadDumper, nullptr);
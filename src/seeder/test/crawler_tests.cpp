@@ -0,0 +1,453 @@
+// Copyright (c) 2018 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "seeder/bitcoin.h"
+#include "seeder/db.h"
+
+#include "hash.h"
+#include "netbase.h"
+#include "protocol.h"
+#include "streams.h"
+#include "tinyformat.h"
+#include "utiltime.h"
+#include "version.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <poll.h>
+
+#include <cstring>
+#include <functional>
+#include <vector>
+
+namespace {
+
+/** A socket listening on the loopback interface, standing in for a node. */
+class Listener {
+private:
+    SOCKET sock;
+    CService service;
+
+public:
+    explicit Listener(int nBacklog = 5) {
+        sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        BOOST_REQUIRE(sock != INVALID_SOCKET);
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        BOOST_REQUIRE(bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+        BOOST_REQUIRE(listen(sock, nBacklog) == 0);
+        socklen_t len = sizeof(addr);
+        BOOST_REQUIRE(getsockname(sock, (struct sockaddr *)&addr, &len) == 0);
+        BOOST_REQUIRE(service.SetSockAddr((struct sockaddr *)&addr));
+    }
+
+    ~Listener() { CloseSocket(sock); }
+
+    const CService &GetService() const { return service; }
+
+    // Wait up to a second for a connection and accept it.
+    SOCKET Accept() {
+        struct pollfd pfd = {};
+        pfd.fd = sock;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, 1000) != 1) {
+            return INVALID_SOCKET;
+        }
+        return accept(sock, nullptr, nullptr);
+    }
+};
+
+/** The other end of a crawler connection, speaking raw bytes. */
+class Peer {
+private:
+    SOCKET sock;
+    std::vector<uint8_t> vRecv;
+
+public:
+    explicit Peer(SOCKET sockIn) : sock(sockIn) {}
+    ~Peer() { CloseSocket(sock); }
+
+    // Read whatever is available without blocking. Returns false once the
+    // crawler closed the connection.
+    bool Receive() {
+        uint8_t pchBuf[0x1000];
+        ssize_t nBytes = recv(sock, (char *)pchBuf, sizeof(pchBuf),
+                              MSG_DONTWAIT);
+        if (nBytes > 0) {
+            vRecv.insert(vRecv.end(), pchBuf, pchBuf + nBytes);
+            return true;
+        }
+        return nBytes < 0 && WSAGetLastError() == WSAEWOULDBLOCK;
+    }
+
+    // Take n bytes off the receive buffer, if we have that many.
+    bool PopBytes(size_t n, std::vector<uint8_t> &out) {
+        Receive();
+        if (vRecv.size() < n) {
+            return false;
+        }
+        out.assign(vRecv.begin(), vRecv.begin() + n);
+        vRecv.erase(vRecv.begin(), vRecv.begin() + n);
+        return true;
+    }
+
+    // Take a complete message off the receive buffer, if there is one.
+    bool PopMessage(std::string &strCommand) {
+        Receive();
+        if (vRecv.size() < CMessageHeader::HEADER_SIZE) {
+            return false;
+        }
+        CDataStream s(std::vector<uint8_t>(vRecv.begin(),
+                                           vRecv.begin() +
+                                               CMessageHeader::HEADER_SIZE),
+                      SER_NETWORK, PROTOCOL_VERSION);
+        CMessageHeader hdr(netMagic);
+        s >> hdr;
+        size_t nSize = CMessageHeader::HEADER_SIZE + hdr.nMessageSize;
+        if (vRecv.size() < nSize) {
+            return false;
+        }
+        strCommand = hdr.GetCommand();
+        vRecv.erase(vRecv.begin(), vRecv.begin() + nSize);
+        return true;
+    }
+
+    void SendBytes(const std::vector<uint8_t> &data) {
+        BOOST_REQUIRE(send(sock, (const char *)data.data(), data.size(),
+                           MSG_NOSIGNAL) == ssize_t(data.size()));
+    }
+
+    void SendMessage(const std::string &strCommand,
+                     const CDataStream &payload) {
+        CMessageHeader hdr(netMagic, strCommand.c_str(), payload.size());
+        uint256 hash = Hash(payload.begin(), payload.end());
+        memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+        CDataStream s(SER_NETWORK, PROTOCOL_VERSION);
+        s << hdr;
+        std::vector<uint8_t> data(s.begin(), s.end());
+        data.insert(data.end(), payload.begin(), payload.end());
+        SendBytes(data);
+    }
+
+    void SendVersion(const std::string &strSubVer, int nHeight) {
+        // Addresses in a version message carry no timestamp, which the
+        // crawler expects by reading it with the pre-31402 format.
+        CDataStream s(SER_NETWORK, 209);
+        CAddress addr(CService(), NODE_NONE);
+        int64_t nTime = time(nullptr);
+        s << PROTOCOL_VERSION << uint64_t(NODE_NETWORK) << nTime << addr
+          << addr << uint64_t(42) << strSubVer << nHeight;
+        SendMessage("version", s);
+    }
+};
+
+CServiceResult MakeResult(const CService &service) {
+    CServiceResult res;
+    res.service = service;
+    res.fGood = false;
+    res.nBanTime = 0;
+    res.nHeight = 0;
+    res.nClientV = 0;
+    res.ourLastSuccess = 0;
+    return res;
+}
+
+// Poll the crawler until fDone holds, for at most five seconds.
+bool PollUntil(CCrawler &crawler, std::vector<CServiceResult> &results,
+               std::vector<CAddress> &addrs, std::function<bool()> fDone) {
+    for (int i = 0; i < 100; i++) {
+        if (fDone()) {
+            return true;
+        }
+        crawler.Poll(50, results, addrs);
+    }
+    return fDone();
+}
+
+// Walk the peer through the handshake, answering getaddr with vAddr.
+void Handshake(CCrawler &crawler, Peer &peer, std::vector<CAddress> &vAddr,
+               std::vector<CServiceResult> &results,
+               std::vector<CAddress> &addrs) {
+    std::string strCommand;
+    BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                            [&] { return peer.PopMessage(strCommand); }));
+    BOOST_CHECK_EQUAL(strCommand, "version");
+
+    peer.SendVersion("/fake:1.0/", 123456);
+    peer.SendMessage("verack", CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+    BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                            [&] { return peer.PopMessage(strCommand); }));
+    BOOST_CHECK_EQUAL(strCommand, "verack");
+    BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                            [&] { return peer.PopMessage(strCommand); }));
+    BOOST_CHECK_EQUAL(strCommand, "getaddr");
+
+    CDataStream s(SER_NETWORK, PROTOCOL_VERSION);
+    s << vAddr;
+    peer.SendMessage("addr", s);
+}
+
+std::vector<CAddress> MakeAddresses() {
+    std::vector<CAddress> vAddr;
+    for (int i = 1; i <= 2; i++) {
+        CAddress addr(CService(LookupNumeric(strprintf("10.0.0.%d", i).c_str(),
+                                             8333)),
+                      NODE_NETWORK);
+        addr.nTime = time(nullptr) - 60;
+        vAddr.push_back(addr);
+    }
+    return vAddr;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(crawler_tests)
+
+BOOST_AUTO_TEST_CASE(crawler_handshake) {
+    Listener listener;
+    CCrawler crawler(16);
+    std::vector<CServiceResult> results;
+    std::vector<CAddress> addrs;
+
+    BOOST_REQUIRE(crawler.Add(MakeResult(listener.GetService()), true));
+    BOOST_CHECK_EQUAL(crawler.GetCount(), 1U);
+    Peer peer(listener.Accept());
+
+    std::vector<CAddress> vAddr = MakeAddresses();
+    Handshake(crawler, peer, vAddr, results, addrs);
+
+    // With more than one address in hand the crawler only waits a second for
+    // more, then counts the quiet node as good.
+    BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                            [&] { return !results.empty(); }));
+    BOOST_CHECK_EQUAL(crawler.GetCount(), 0U);
+    BOOST_REQUIRE_EQUAL(results.size(), 1U);
+    BOOST_CHECK(results[0].service == listener.GetService());
+    BOOST_CHECK(results[0].fGood);
+    BOOST_CHECK_EQUAL(results[0].nBanTime, 0);
+    BOOST_CHECK_EQUAL(results[0].nClientV, PROTOCOL_VERSION);
+    BOOST_CHECK_EQUAL(results[0].strClientV, "/fake:1.0/");
+    BOOST_CHECK_EQUAL(results[0].nHeight, 123456);
+    BOOST_REQUIRE_EQUAL(addrs.size(), vAddr.size());
+    for (size_t i = 0; i < vAddr.size(); i++) {
+        BOOST_CHECK(addrs[i] == vAddr[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(crawler_peer_disconnects) {
+    Listener listener;
+    CCrawler crawler(16);
+    std::vector<CServiceResult> results;
+    std::vector<CAddress> addrs;
+
+    BOOST_REQUIRE(crawler.Add(MakeResult(listener.GetService()), true));
+    {
+        Peer peer(listener.Accept());
+        std::string strCommand;
+        BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                                [&] { return peer.PopMessage(strCommand); }));
+        BOOST_CHECK_EQUAL(strCommand, "version");
+    }
+
+    BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                            [&] { return !results.empty(); }));
+    BOOST_REQUIRE_EQUAL(results.size(), 1U);
+    BOOST_CHECK(!results[0].fGood);
+    BOOST_CHECK(addrs.empty());
+}
+
+BOOST_AUTO_TEST_CASE(crawler_connect_refused) {
+    CService service;
+    {
+        // Nothing listens on the port once the listener is gone.
+        Listener listener;
+        service = listener.GetService();
+    }
+    CCrawler crawler(16);
+    std::vector<CServiceResult> results;
+    std::vector<CAddress> addrs;
+
+    BOOST_REQUIRE(crawler.Add(MakeResult(service), true));
+    BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                            [&] { return !results.empty(); }));
+    BOOST_CHECK_EQUAL(crawler.GetCount(), 0U);
+    BOOST_REQUIRE_EQUAL(results.size(), 1U);
+    BOOST_CHECK(results[0].service == service);
+    BOOST_CHECK(!results[0].fGood);
+    BOOST_CHECK_EQUAL(results[0].nBanTime, 0);
+}
+
+BOOST_AUTO_TEST_CASE(crawler_connect_timeout) {
+    // With its accept queue full the listener drops further connection
+    // attempts, so the crawler's connect never completes.
+    Listener listener(0);
+    SOCKET filler = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    BOOST_REQUIRE(listener.GetService().GetSockAddr(
+        (struct sockaddr *)&sockaddr, &len));
+    BOOST_REQUIRE(connect(filler, (struct sockaddr *)&sockaddr, len) == 0);
+
+    int nOldTimeout = nConnectTimeout;
+    nConnectTimeout = 500;
+    CCrawler crawler(16);
+    std::vector<CServiceResult> results;
+    std::vector<CAddress> addrs;
+    BOOST_REQUIRE(crawler.Add(MakeResult(listener.GetService()), true));
+    nConnectTimeout = nOldTimeout;
+
+    int64_t nStart = GetTimeMillis();
+    crawler.Poll(100, results, addrs);
+    BOOST_CHECK(results.empty());
+    BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                            [&] { return !results.empty(); }));
+    BOOST_CHECK(GetTimeMillis() - nStart >= 400);
+    BOOST_CHECK_EQUAL(crawler.GetCount(), 0U);
+    BOOST_REQUIRE_EQUAL(results.size(), 1U);
+    BOOST_CHECK(!results[0].fGood);
+    BOOST_CHECK_EQUAL(results[0].nBanTime, 0);
+
+    CloseSocket(filler);
+}
+
+BOOST_AUTO_TEST_CASE(crawler_batches_results) {
+    Listener listener;
+    CService refused;
+    {
+        Listener closed;
+        refused = closed.GetService();
+    }
+    // Without a proxy there is no way to reach an onion address.
+    CService onion;
+    BOOST_REQUIRE(onion.SetSpecial("5wyqrzbvrdsumnok.onion"));
+    onion = CService(onion, 8333);
+
+    CCrawler crawler(16);
+    std::vector<CServiceResult> results;
+    std::vector<CAddress> addrs;
+    BOOST_REQUIRE(crawler.Add(MakeResult(onion), true));
+    BOOST_REQUIRE(crawler.Add(MakeResult(refused), true));
+    BOOST_REQUIRE(crawler.Add(MakeResult(listener.GetService()), true));
+    BOOST_CHECK_EQUAL(crawler.GetCount(), 2U);
+
+    // Nodes that could not even be connected to are reported right away.
+    crawler.Poll(0, results, addrs);
+    BOOST_REQUIRE(!results.empty());
+    BOOST_CHECK(results[0].service == onion);
+    BOOST_CHECK(!results[0].fGood);
+
+    Peer peer(listener.Accept());
+    std::vector<CAddress> vAddr = MakeAddresses();
+    Handshake(crawler, peer, vAddr, results, addrs);
+    BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                            [&] { return results.size() == 3; }));
+    BOOST_CHECK_EQUAL(crawler.GetCount(), 0U);
+
+    // One result per node, and only the good node's addresses.
+    int nGood = 0;
+    for (const CServiceResult &res : results) {
+        if (res.fGood) {
+            nGood++;
+            BOOST_CHECK(res.service == listener.GetService());
+        }
+    }
+    BOOST_CHECK_EQUAL(nGood, 1);
+    BOOST_CHECK_EQUAL(addrs.size(), vAddr.size());
+}
+
+// A proxy cannot be unset again, so the SOCKS5 tests only proxy IPv6, which no
+// other test connects to.
+BOOST_AUTO_TEST_CASE(crawler_socks5) {
+    Listener proxy;
+    BOOST_REQUIRE(SetProxy(NET_IPV6, proxyType(proxy.GetService())));
+    CService service = LookupNumeric("1:2:3:4:5:6:7:8", 8333);
+
+    CCrawler crawler(16);
+    std::vector<CServiceResult> results;
+    std::vector<CAddress> addrs;
+    BOOST_REQUIRE(crawler.Add(MakeResult(service), true));
+    Peer peer(proxy.Accept());
+
+    // The crawler offers no authentication only.
+    std::vector<uint8_t> data;
+    BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                            [&] { return peer.PopBytes(3, data); }));
+    BOOST_CHECK(data == std::vector<uint8_t>({0x05, 0x01, 0x00}));
+    // Answer in two pieces to check partial replies are buffered.
+    peer.SendBytes({0x05});
+    crawler.Poll(50, results, addrs);
+    peer.SendBytes({0x00});
+
+    // Then asks for the node by name.
+    std::string strDest = service.ToStringIP();
+    std::vector<uint8_t> expected = {0x05, 0x01, 0x00, 0x03,
+                                     uint8_t(strDest.size())};
+    expected.insert(expected.end(), strDest.begin(), strDest.end());
+    expected.push_back(8333 >> 8);
+    expected.push_back(8333 & 0xFF);
+    BOOST_REQUIRE(PollUntil(crawler, results, addrs, [&] {
+        return peer.PopBytes(expected.size(), data);
+    }));
+    BOOST_CHECK(data == expected);
+    // Succeeded, bound to a domain name.
+    peer.SendBytes({0x05, 0x00, 0x00, 0x03, 0x04, 'n', 'o', 'd', 'e', 0x20,
+                    0x8d});
+
+    // From here on the proxy relays the node.
+    std::vector<CAddress> vAddr = MakeAddresses();
+    Handshake(crawler, peer, vAddr, results, addrs);
+    BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                            [&] { return !results.empty(); }));
+    BOOST_REQUIRE_EQUAL(results.size(), 1U);
+    BOOST_CHECK(results[0].service == service);
+    BOOST_CHECK(results[0].fGood);
+    BOOST_CHECK_EQUAL(addrs.size(), vAddr.size());
+
+}
+
+BOOST_AUTO_TEST_CASE(crawler_socks5_refused) {
+    Listener proxy;
+    BOOST_REQUIRE(SetProxy(NET_IPV6, proxyType(proxy.GetService())));
+    CService service = LookupNumeric("1:2:3:4:5:6:7:8", 8333);
+
+    CCrawler crawler(16);
+    std::vector<CServiceResult> results;
+    std::vector<CAddress> addrs;
+
+    // The proxy turns down our authentication method.
+    BOOST_REQUIRE(crawler.Add(MakeResult(service), true));
+    {
+        Peer peer(proxy.Accept());
+        std::vector<uint8_t> data;
+        BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                                [&] { return peer.PopBytes(3, data); }));
+        peer.SendBytes({0x05, 0xff});
+        BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                                [&] { return !results.empty(); }));
+        BOOST_CHECK(!results[0].fGood);
+    }
+
+    // The proxy cannot reach the node.
+    BOOST_REQUIRE(crawler.Add(MakeResult(service), true));
+    {
+        Peer peer(proxy.Accept());
+        std::vector<uint8_t> data;
+        BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                                [&] { return peer.PopBytes(3, data); }));
+        peer.SendBytes({0x05, 0x00});
+        BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                                [&] { return peer.PopBytes(5, data); }));
+        // Host unreachable
+        peer.SendBytes({0x05, 0x04, 0x00, 0x01, 0, 0, 0, 0, 0, 0});
+        BOOST_REQUIRE(PollUntil(crawler, results, addrs,
+                                [&] { return results.size() == 2; }));
+        BOOST_CHECK(!results[1].fGood);
+        BOOST_CHECK_EQUAL(results[1].nBanTime, 0);
+    }
+    BOOST_CHECK(addrs.empty());
+
+}
+
+BOOST_AUTO_TEST_SUITE_END()
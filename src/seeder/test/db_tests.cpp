@@ -0,0 +1,137 @@
+// Copyright (c) 2018 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "seeder/db.h"
+
+#include "clientversion.h"
+#include "tinyformat.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(db_tests)
+
+static std::vector<CAddress> MakeAddresses(int n) {
+    std::vector<CAddress> vAddr;
+    for (int i = 0; i < n; i++) {
+        vAddr.emplace_back(
+            LookupNumeric(strprintf("8.8.%d.%d", i / 256, i % 256).c_str(),
+                          GetDefaultPort()),
+            NODE_NETWORK);
+    }
+    return vAddr;
+}
+
+/**
+ * Take every address to test from db and report the first nGood as good, the
+ * next nBanned as banned and the others as bad.
+ */
+static std::vector<CService> CrawlAll(CAddrDb &db, size_t nGood,
+                                      size_t nBanned) {
+    std::vector<CServiceResult> ips;
+    int wait;
+    db.GetMany(ips, std::numeric_limits<int>::max(), wait);
+    std::vector<CService> ret;
+    for (size_t i = 0; i < ips.size(); i++) {
+        ips[i].fGood = i < nGood;
+        ips[i].nBanTime = i >= nGood && i < nGood + nBanned ? 3600 : 0;
+        ips[i].nClientV = PROTOCOL_VERSION;
+        ips[i].nHeight = GetRequireHeight();
+        ret.push_back(ips[i].service);
+    }
+    db.ResultMany(ips);
+    return ret;
+}
+
+static void CheckStats(CAddrDb &db, int nBanned, int nAvail, int nTracked,
+                       int nNew, int nGood) {
+    CAddrDbStats stats;
+    db.GetStats(stats);
+    BOOST_CHECK_EQUAL(stats.nBanned, nBanned);
+    BOOST_CHECK_EQUAL(stats.nAvail, nAvail);
+    BOOST_CHECK_EQUAL(stats.nTracked, nTracked);
+    BOOST_CHECK_EQUAL(stats.nNew, nNew);
+    BOOST_CHECK_EQUAL(stats.nGood, nGood);
+}
+
+BOOST_AUTO_TEST_CASE(addrdb_shards) {
+    CAddrDb db;
+    const std::vector<CAddress> vAddr = MakeAddresses(100);
+    db.Add(vAddr);
+    CheckStats(db, 0, 100, 0, 100, 0);
+
+    // Every address is found again in the shard it was put in
+    for (const CAddress &addr : vAddr) {
+        db.Add(addr);
+    }
+    db.Add(std::vector<CAddress>(vAddr.begin(), vAddr.begin() + 10));
+    CheckStats(db, 0, 100, 0, 100, 0);
+
+    // The crawl takes from all shards until every address was handed out
+    const std::vector<CService> crawled = CrawlAll(db, 30, 10);
+    BOOST_CHECK_EQUAL(crawled.size(), 100);
+    BOOST_CHECK_EQUAL(
+        std::set<CService>(crawled.begin(), crawled.end()).size(), 100);
+    CheckStats(db, 10, 90, 90, 0, 30);
+
+    // Nothing is left to test until MIN_RETRY has passed
+    std::vector<CServiceResult> ips;
+    int wait;
+    db.GetMany(ips, 100, wait);
+    BOOST_CHECK(ips.empty());
+
+    // Banned addresses are only added back when forced
+    db.Add(CAddress(crawled[30], NODE_NETWORK));
+    CheckStats(db, 10, 90, 90, 0, 30);
+    db.Add(CAddress(crawled[30], NODE_NETWORK), true);
+    CheckStats(db, 9, 91, 90, 1, 30);
+
+    std::vector<CAddrReport> reports = db.GetAll();
+    BOOST_CHECK_EQUAL(reports.size(), 30);
+    for (const CAddrReport &report : reports) {
+        BOOST_CHECK(report.fGood);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(addrdb_serialization) {
+    CAddrDb db;
+    db.Add(MakeAddresses(100));
+    const std::vector<CService> crawled = CrawlAll(db, 30, 10);
+    db.Add(MakeAddresses(120));
+    CheckStats(db, 10, 110, 90, 20, 30);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << db;
+
+    // The copy uses a different salt, so addresses move to other shards
+    CAddrDb copy;
+    ss >> copy;
+    BOOST_CHECK(ss.empty());
+    CheckStats(copy, 10, 110, 90, 20, 30);
+
+    std::set<CService> good, goodCopy;
+    for (const CAddrReport &report : db.GetAll()) {
+        good.insert(report.ip);
+    }
+    for (const CAddrReport &report : copy.GetAll()) {
+        BOOST_CHECK(report.fGood);
+        goodCopy.insert(report.ip);
+    }
+    BOOST_CHECK(good == goodCopy);
+    BOOST_CHECK_EQUAL(goodCopy.size(), 30);
+
+    // Loaded addresses are found in their new shard, bans are kept
+    copy.Add(MakeAddresses(120));
+    CheckStats(copy, 10, 110, 90, 20, 30);
+    copy.Add(CAddress(crawled[30], NODE_NETWORK), true);
+    CheckStats(copy, 9, 111, 90, 21, 30);
+
+    // And round trip again
+    CDataStream ss2(SER_DISK, CLIENT_VERSION);
+    ss2 << copy;
+    CAddrDb copy2;
+    ss2 >> copy2;
+    CheckStats(copy2, 9, 111, 90, 21, 30);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,130 @@
+// Copyright (c) 2018 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "seeder/db.h"
+#include "seeder/dns.h"
+#include "seeder/dnscache.h"
+
+#include "tinyformat.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+
+BOOST_AUTO_TEST_SUITE(dns_tests)
+
+BOOST_AUTO_TEST_CASE(dns_encode_answer_records) {
+    uint8_t out[DNS_RECORD_AAAA_SIZE];
+
+    addr_t a;
+    a.v = 4;
+    const uint8_t v4[] = {1, 2, 3, 4};
+    memcpy(a.data.v4, v4, sizeof(v4));
+    BOOST_CHECK_EQUAL(dns_encode_answer(out, sizeof(out), &a, 3600),
+                      DNS_RECORD_A_SIZE);
+    // Name pointer to the question, type A, class IN, TTL, rdlength, rdata
+    const uint8_t expectedA[] = {0xc0, 12, 0, 1, 0, 1, 0, 0,
+                                 0x0e, 0x10, 0, 4, 1, 2, 3, 4};
+    BOOST_CHECK(memcmp(out, expectedA, sizeof(expectedA)) == 0);
+
+    a.v = 6;
+    for (int i = 0; i < 16; i++) {
+        a.data.v6[i] = i;
+    }
+    BOOST_CHECK_EQUAL(dns_encode_answer(out, sizeof(out), &a, 60),
+                      DNS_RECORD_AAAA_SIZE);
+    const uint8_t expectedAAAAHeader[] = {0xc0, 12, 0, 28, 0,  1,
+                                          0,    0,  0, 60, 0, 16};
+    BOOST_CHECK(memcmp(out, expectedAAAAHeader, sizeof(expectedAAAAHeader)) ==
+                0);
+    BOOST_CHECK(memcmp(out + sizeof(expectedAAAAHeader), a.data.v6, 16) == 0);
+
+    // Nothing is written when the record does not fit
+    BOOST_CHECK_EQUAL(
+        dns_encode_answer(out, DNS_RECORD_AAAA_SIZE - 1, &a, 60), 0);
+    a.v = 4;
+    BOOST_CHECK_EQUAL(dns_encode_answer(out, DNS_RECORD_A_SIZE - 1, &a, 60),
+                      0);
+    a.v = 5;
+    BOOST_CHECK_EQUAL(dns_encode_answer(out, sizeof(out), &a, 60), 0);
+}
+
+static CService AddGoodNode(CAddrDb &db, const std::string &ip) {
+    CService service = LookupNumeric(ip.c_str(), GetDefaultPort());
+    db.Add(CAddress(service, NODE_NETWORK));
+    db.Good(service, PROTOCOL_VERSION, "/test/", GetRequireHeight());
+    return service;
+}
+
+/** Decode the addresses of consecutive records of the given size */
+static std::set<CNetAddr> DecodeAnswers(const std::vector<uint8_t> &records,
+                                        size_t nRecordSize) {
+    BOOST_CHECK_EQUAL(records.size() % nRecordSize, 0);
+    std::set<CNetAddr> ret;
+    const size_t nAddrSize = nRecordSize == DNS_RECORD_A_SIZE ? 4 : 16;
+    for (size_t i = 0; i + nRecordSize <= records.size(); i += nRecordSize) {
+        // Every record refers to the question and carries our TTL
+        BOOST_CHECK_EQUAL(records[i], 0xc0);
+        BOOST_CHECK_EQUAL(records[i + 1], 12);
+        BOOST_CHECK_EQUAL((records[i + 6] << 24) | (records[i + 7] << 16) |
+                              (records[i + 8] << 8) | records[i + 9],
+                          DNS_DATA_TTL);
+        const uint8_t *pdata = &records[i + nRecordSize - nAddrSize];
+        CNetAddr addr;
+        if (nAddrSize == 4) {
+            struct in_addr ipv4;
+            memcpy(&ipv4, pdata, 4);
+            addr = CNetAddr(ipv4);
+        } else {
+            struct in6_addr ipv6;
+            memcpy(&ipv6, pdata, 16);
+            addr = CNetAddr(ipv6);
+        }
+        ret.insert(addr);
+    }
+    return ret;
+}
+
+BOOST_AUTO_TEST_CASE(dns_cache_refresh) {
+    CAddrDb db;
+    std::set<CNetAddr> good;
+    for (int i = 1; i <= 4; i++) {
+        good.insert(AddGoodNode(db, strprintf("8.8.4.%d", i)));
+        good.insert(AddGoodNode(db, strprintf("2a00:1450::%d", i)));
+    }
+
+    CDnsCache cache(db);
+    BOOST_CHECK_EQUAL(cache.GetGeneration(), 0);
+    cache.Refresh({NODE_NETWORK, NODE_NETWORK | NODE_BLOOM});
+    BOOST_CHECK_EQUAL(cache.GetGeneration(), 1);
+    BOOST_CHECK_EQUAL(cache.dbQueries.load(), 2);
+
+    DnsAnswerMap answers;
+    uint64_t nGeneration;
+    cache.Get(answers, nGeneration);
+    BOOST_CHECK_EQUAL(nGeneration, 1);
+    BOOST_CHECK_EQUAL(answers.size(), 2);
+
+    // Half of the good nodes are picked, each answered by a single record
+    const CDnsAnswers &network = *answers.at(NODE_NETWORK);
+    std::set<CNetAddr> v4 = DecodeAnswers(network.v4, DNS_RECORD_A_SIZE);
+    std::set<CNetAddr> v6 = DecodeAnswers(network.v6, DNS_RECORD_AAAA_SIZE);
+    BOOST_CHECK_EQUAL(v4.size() + v6.size(), good.size() / 2);
+    BOOST_CHECK_EQUAL(network.v4.size() / DNS_RECORD_A_SIZE +
+                          network.v6.size() / DNS_RECORD_AAAA_SIZE,
+                      good.size() / 2);
+    for (const CNetAddr &addr : v4) {
+        BOOST_CHECK(addr.IsIPv4() && good.count(addr));
+    }
+    for (const CNetAddr &addr : v6) {
+        BOOST_CHECK(addr.IsIPv6() && good.count(addr));
+    }
+
+    // No good node offers bloom filters
+    const CDnsAnswers &bloom = *answers.at(NODE_NETWORK | NODE_BLOOM);
+    BOOST_CHECK(bloom.v4.empty());
+    BOOST_CHECK(bloom.v6.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -11,6 +11,8 @@
 
 #include <boost/thread.hpp>
 
+thread_local LockWaitTimer *LockWaitTimer::current = nullptr;
+
 #ifdef DEBUG_LOCKCONTENTION
 void PrintLockContention(const char *pszName, const char *pszFile, int nLine) {
     LogPrintf("LOCKCONTENTION: %s\n", pszName);
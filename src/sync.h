@@ -13,6 +13,9 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 
+#include <chrono>
+#include <cstdint>
+
 /////////////////////////////////////////////////
 //                                             //
 // THE SIMPLE DEFINITION, EXCLUDING DEBUG CODE //
@@ -102,6 +105,40 @@ typedef boost::condition_variable CConditionVariable;
 void PrintLockContention(const char *pszName, const char *pszFile, int nLine);
 #endif
 
+/**
+ * Measures how long the current thread is blocked on one particular lock
+ * while the timer is in scope, e.g. the time an RPC call spends waiting for
+ * cs_main. Only the innermost timer of a thread is active.
+ */
+class LockWaitTimer {
+public:
+    explicit LockWaitTimer(const void *_cs)
+        : cs(_cs), nWaitMicros(0), prev(current) {
+        current = this;
+    }
+    ~LockWaitTimer() { current = prev; }
+
+    int64_t GetWaitMicros() const { return nWaitMicros; }
+
+    /** Timer of the lock being acquired by this thread, if any */
+    static LockWaitTimer *Get(const void *cs) {
+        return current && current->cs == cs ? current : nullptr;
+    }
+
+    void AddWait(std::chrono::steady_clock::duration wait) {
+        nWaitMicros +=
+            std::chrono::duration_cast<std::chrono::microseconds>(wait)
+                .count();
+    }
+
+private:
+    const void *cs;
+    int64_t nWaitMicros;
+    LockWaitTimer *prev;
+
+    static thread_local LockWaitTimer *current;
+};
+
 /** Wrapper around boost::unique_lock<Mutex> */
 template <typename Mutex> class SCOPED_LOCKABLE CMutexLock {
 private:
@@ -109,14 +146,20 @@ private:
 
     void Enter(const char *pszName, const char *pszFile, int nLine) {
         EnterCritical(pszName, pszFile, nLine, (void *)(lock.mutex()));
+        if (lock.try_lock()) {
+            return;
+        }
 #ifdef DEBUG_LOCKCONTENTION
-        if (!lock.try_lock()) {
-            PrintLockContention(pszName, pszFile, nLine);
+        PrintLockContention(pszName, pszFile, nLine);
 #endif
+        LockWaitTimer *timer = LockWaitTimer::Get(lock.mutex());
+        if (!timer) {
             lock.lock();
-#ifdef DEBUG_LOCKCONTENTION
+            return;
         }
-#endif
+        const auto start = std::chrono::steady_clock::now();
+        lock.lock();
+        timer->AddWait(std::chrono::steady_clock::now() - start);
     }
 
     bool TryEnter(const char *pszName, const char *pszFile, int nLine) {
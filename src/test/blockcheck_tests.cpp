@@ -6,6 +6,7 @@
 #include "config.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "streams.h"
 #include "validation.h"
 
 #include "test/test_bitcoin.h"
@@ -96,4 +97,47 @@ BOOST_AUTO_TEST_CASE(blockfail) {
     RunCheckOnBlock(config, block, "bad-blk-length");
 }
 
+BOOST_AUTO_TEST_CASE(block_arena_deserialization) {
+    CBlock block;
+    block.nVersion = 42;
+    block.nTime = 1234567;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = Amount(42);
+    for (size_t i = 0; i < 100; i++) {
+        tx.vin[0].prevout = COutPoint(InsecureRand256(), i);
+        // Make some of the scripts big enough to leave the prevector's
+        // inline storage.
+        tx.vin[0].scriptSig.resize(i);
+        block.vtx.push_back(MakeTransactionRef(tx));
+    }
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+
+    CBlock arenaBlock;
+    UnserializeBlockInArena(ss, arenaBlock);
+    BOOST_CHECK(ss.empty());
+    BOOST_CHECK(arenaBlock.GetHash() == block.GetHash());
+    BOOST_CHECK_EQUAL(arenaBlock.vtx.size(), block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        BOOST_CHECK(*arenaBlock.vtx[i] == *block.vtx[i]);
+        BOOST_CHECK(arenaBlock.vtx[i]->vin[0] == block.vtx[i]->vin[0]);
+    }
+
+    // Transactions keep the arena alive after the block is gone.
+    CTransactionRef ptx = arenaBlock.vtx[50];
+    arenaBlock.SetNull();
+    BOOST_CHECK(*ptx == *block.vtx[50]);
+    BOOST_CHECK(ptx->vin[0].scriptSig == block.vtx[50]->vin[0].scriptSig);
+
+    // Truncated blocks are rejected.
+    ss << block;
+    ss.resize(ss.size() - 1);
+    BOOST_CHECK_THROW(UnserializeBlockInArena(ss, arenaBlock),
+                      std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,7 @@
 #include "script/sigcache.h"
 #include "test/test_bitcoin.h"
 
+#include <set>
 #include <thread>
 
 #include <boost/test/unit_test.hpp>
@@ -370,4 +371,38 @@ BOOST_AUTO_TEST_CASE(cuckoocache_generations) {
     test_cache_generations<CuckooCache::cache<uint256, SignatureCacheHasher>>();
 }
 
+/** Check that for_each_element returns exactly the elements which can still be
+ * found in the cache, so that a reloaded copy has the same hits */
+BOOST_AUTO_TEST_CASE(cuckoocache_for_each_element) {
+    local_rand_ctx = FastRandomContext(true);
+    CuckooCache::cache<uint256, SignatureCacheHasher> cc{};
+    cc.setup_bytes(1 << 20);
+    std::vector<uint256> hashes(1000);
+    for (uint256 &h : hashes) {
+        insecure_GetRandHash(h);
+        cc.insert(h);
+    }
+    // Erase half of them.
+    for (size_t i = 0; i < hashes.size(); i += 2) {
+        BOOST_CHECK(cc.contains(hashes[i], true));
+    }
+
+    std::set<uint256> elements;
+    cc.for_each_element(
+        [&elements](const uint256 &e) { elements.insert(e); });
+    BOOST_CHECK_EQUAL(elements.size(), hashes.size() / 2);
+    for (size_t i = 0; i < hashes.size(); i++) {
+        BOOST_CHECK_EQUAL(elements.count(hashes[i]), i % 2);
+    }
+
+    CuckooCache::cache<uint256, SignatureCacheHasher> reloaded{};
+    reloaded.setup_bytes(1 << 20);
+    for (const uint256 &e : elements) {
+        reloaded.insert(e);
+    }
+    for (size_t i = 1; i < hashes.size(); i += 2) {
+        BOOST_CHECK(reloaded.contains(hashes[i], false));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,127 @@
+// Copyright (c) 2018 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "rpc/jsonwriter.h"
+#include "utilstrencodings.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+#include <univalue.h>
+
+BOOST_FIXTURE_TEST_SUITE(jsonwriter_tests, BasicTestingSetup)
+
+/** Write value with the given flush size and return all output */
+static std::string WriteJSON(const UniValue &value, size_t nFlushSize,
+                             size_t *pnChunks = nullptr) {
+    std::string out;
+    size_t nChunks = 0;
+    JSONWriter writer(
+        [&](const std::string &chunk) {
+            out += chunk;
+            nChunks++;
+        },
+        nFlushSize);
+    writer.Value(value);
+    writer.Flush();
+    if (pnChunks) {
+        *pnChunks = nChunks;
+    }
+    return out;
+}
+
+BOOST_AUTO_TEST_CASE(jsonwriter_matches_univalue) {
+    std::string strAllChars;
+    for (int i = 0; i < 256; i++) {
+        strAllChars += char(i);
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("null", NullUniValue));
+    obj.push_back(Pair("true", true));
+    obj.push_back(Pair("false", false));
+    obj.push_back(Pair("int", -42));
+    obj.push_back(Pair("uint64", uint64_t(18446744073709551615ULL)));
+    obj.push_back(Pair("double", 0.1));
+    obj.push_back(Pair("empty", ""));
+    obj.push_back(Pair("all \"chars\"", strAllChars));
+    obj.push_back(Pair("emptyobj", UniValue(UniValue::VOBJ)));
+    obj.push_back(Pair("emptyarr", UniValue(UniValue::VARR)));
+
+    UniValue arr(UniValue::VARR);
+    arr.push_back(obj);
+    arr.push_back(UniValue(UniValue::VARR));
+    arr.push_back("\xe2\x82\xac");
+    UniValue nested(UniValue::VARR);
+    nested.push_back(arr);
+    nested.push_back(1);
+    arr.push_back(nested);
+    obj.push_back(Pair("arr", arr));
+
+    for (const UniValue &value : {obj, arr, nested, UniValue(strAllChars),
+                                  UniValue(3.5), NullUniValue}) {
+        BOOST_CHECK_EQUAL(WriteJSON(value, DEFAULT_JSON_FLUSH_SIZE),
+                          value.write());
+        // Chunk boundaries must not affect the output
+        BOOST_CHECK_EQUAL(WriteJSON(value, 1), value.write());
+        BOOST_CHECK_EQUAL(WriteJSON(value, 7), value.write());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(jsonwriter_incremental) {
+    std::string out;
+    JSONWriter writer([&](const std::string &chunk) { out += chunk; });
+    const std::vector<uint8_t> data = ParseHex("00ff10ab");
+
+    writer.BeginObject();
+    writer.Key("hex");
+    writer.HexString(data.data(), data.data() + data.size());
+    writer.Key("list");
+    writer.BeginArray();
+    writer.String("a\nb");
+    writer.BeginObject();
+    writer.EndObject();
+    writer.Value(UniValue(2));
+    writer.EndArray();
+    writer.EndObject();
+    writer.Raw("\n");
+
+    // Nothing reaches the sink until the buffer fills up or is flushed
+    BOOST_CHECK(out.empty());
+    writer.Flush();
+
+    UniValue list(UniValue::VARR);
+    list.push_back("a\nb");
+    list.push_back(UniValue(UniValue::VOBJ));
+    list.push_back(2);
+    UniValue expected(UniValue::VOBJ);
+    expected.push_back(Pair("hex", HexStr(data)));
+    expected.push_back(Pair("list", list));
+    BOOST_CHECK_EQUAL(out, expected.write() + "\n");
+}
+
+BOOST_AUTO_TEST_CASE(jsonwriter_flush_size) {
+    UniValue arr(UniValue::VARR);
+    for (int i = 0; i < 1000; i++) {
+        arr.push_back(std::string(100, 'x'));
+    }
+
+    // Output is handed over in chunks of about the flush size
+    size_t nChunks;
+    std::string out = WriteJSON(arr, 1000, &nChunks);
+    BOOST_CHECK_EQUAL(out, arr.write());
+    BOOST_CHECK(nChunks >= out.size() / 1200);
+    BOOST_CHECK(nChunks <= out.size() / 1000 + 1);
+
+    // The sink may abort the document by throwing
+    JSONWriter writer(
+        [](const std::string &) { throw std::runtime_error("closed"); }, 10);
+    BOOST_CHECK_THROW(writer.Value(arr), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
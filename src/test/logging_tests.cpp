@@ -0,0 +1,138 @@
+// Copyright (c) 2018 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "logging.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+BOOST_FIXTURE_TEST_SUITE(logging_tests, TestingSetup)
+
+static fs::path DebugLogPath() {
+    return GetDataDir() / "debug.log";
+}
+
+static std::string ReadDebugLog() {
+    std::ifstream file(DebugLogPath().string());
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+/** A logger writing untimestamped lines to a fresh debug.log */
+struct TestLogger : public BCLog::Logger {
+    TestLogger(bool fSync = false) {
+        fs::remove(DebugLogPath());
+        fLogTimestamps = false;
+        fWriteSynchronously = fSync;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(logging_flush_order) {
+    TestLogger logger;
+    logger.LogPrintStr("before open\n");
+    logger.OpenDebugLog();
+
+    std::string expected = "before open\n";
+    for (int i = 0; i < 1000; i++) {
+        const std::string line = strprintf("line %d\n", i);
+        logger.LogPrintStr(line);
+        expected += line;
+    }
+    logger.Flush();
+    BOOST_CHECK_EQUAL(ReadDebugLog(), expected);
+
+    // Lines split over several calls stay together
+    logger.LogPrintStr("partial ");
+    logger.LogPrintStr("line\n");
+    logger.Flush();
+    BOOST_CHECK_EQUAL(ReadDebugLog(), expected + "partial line\n");
+}
+
+BOOST_AUTO_TEST_CASE(logging_backlog) {
+    TestLogger logger;
+    // Far less than the lines below, so the logging threads keep waiting
+    // for the writer to catch up.
+    logger.nMaxBacklog = 64;
+    logger.OpenDebugLog();
+
+    const int nThreads = 4;
+    const int nLines = 500;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nThreads; t++) {
+        threads.emplace_back([&logger, t] {
+            for (int i = 0; i < nLines; i++) {
+                logger.LogPrintStr(strprintf("%d %d\n", t, i));
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    logger.Flush();
+
+    // Nothing is lost, and the lines of every thread are in order
+    std::istringstream log(ReadDebugLog());
+    std::vector<int> vNext(nThreads, 0);
+    int t, i, nTotal = 0;
+    while (log >> t >> i) {
+        BOOST_REQUIRE(t >= 0 && t < nThreads);
+        BOOST_CHECK_EQUAL(i, vNext[t]++);
+        nTotal++;
+    }
+    BOOST_CHECK_EQUAL(nTotal, nThreads * nLines);
+}
+
+BOOST_AUTO_TEST_CASE(logging_rate_limit) {
+    TestLogger logger;
+    logger.nMaxCategoryRate = 2;
+    logger.OpenDebugLog();
+
+    SetMockTime(1000);
+    for (int i = 0; i < 5; i++) {
+        logger.LogPrintStr(strprintf("net %d\n", i), BCLog::NET);
+    }
+    // Other categories and uncategorized messages have their own budget
+    logger.LogPrintStr("mempool\n", BCLog::MEMPOOL);
+    logger.LogPrintStr("always\n");
+    logger.LogPrintStr("always\n");
+    logger.LogPrintStr("always\n");
+
+    // The next second reports what was dropped before its first message
+    SetMockTime(1001);
+    logger.LogPrintStr("net 5\n", BCLog::NET);
+    SetMockTime(0);
+    logger.Flush();
+
+    BOOST_CHECK_EQUAL(ReadDebugLog(),
+                      "net 0\n"
+                      "net 1\n"
+                      "mempool\n"
+                      "always\n"
+                      "always\n"
+                      "always\n"
+                      "Suppressed 3 net messages over -logratelimit=2\n"
+                      "net 5\n");
+}
+
+BOOST_AUTO_TEST_CASE(logging_sync) {
+    TestLogger logger(true);
+    logger.OpenDebugLog();
+
+    // Every line is on disk as soon as it was logged
+    logger.LogPrintStr("first\n");
+    BOOST_CHECK_EQUAL(ReadDebugLog(), "first\n");
+    logger.LogPrintStr("second\n");
+    BOOST_CHECK_EQUAL(ReadDebugLog(), "first\nsecond\n");
+    logger.Flush();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
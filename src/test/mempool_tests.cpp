@@ -10,6 +10,7 @@
 
 #include <boost/test/unit_test.hpp>
 #include <list>
+#include <tuple>
 #include <vector>
 
 BOOST_FIXTURE_TEST_SUITE(mempool_tests, TestingSetup)
@@ -134,6 +135,62 @@ BOOST_AUTO_TEST_CASE(MempoolClearTest) {
     BOOST_CHECK_EQUAL(testPool.vTxHashes.size(), 0UL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolSequenceTest) {
+    // Test the mempool sequence numbers passed to the entry signals
+
+    TestMemPoolEntryHelper entry;
+    CMutableTransaction txParent;
+    txParent.vin.resize(1);
+    txParent.vin[0].scriptSig = CScript() << OP_11;
+    txParent.vout.resize(1);
+    txParent.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txParent.vout[0].nValue = Amount(33000LL);
+    CMutableTransaction txChild;
+    txChild.vin.resize(1);
+    txChild.vin[0].scriptSig = CScript() << OP_11;
+    txChild.vin[0].prevout = COutPoint(txParent.GetId(), 0);
+    txChild.vout.resize(1);
+    txChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txChild.vout[0].nValue = Amount(11000LL);
+
+    CTxMemPool testPool;
+
+    // (txid, removal reason or -1 for additions, mempool sequence)
+    std::vector<std::tuple<uint256, int, uint64_t>> events;
+    testPool.NotifyEntryAdded.connect(
+        [&](CTransactionRef tx, uint64_t nMempoolSequence) {
+            events.emplace_back(tx->GetId(), -1, nMempoolSequence);
+        });
+    testPool.NotifyEntryRemoved.connect([&](CTransactionRef tx,
+                                            MemPoolRemovalReason reason,
+                                            uint64_t nMempoolSequence) {
+        events.emplace_back(tx->GetId(), int(reason), nMempoolSequence);
+    });
+
+    testPool.addUnchecked(txParent.GetId(), entry.FromTx(txParent));
+    testPool.addUnchecked(txChild.GetId(), entry.FromTx(txChild));
+    testPool.removeForBlock({MakeTransactionRef(txParent)}, 1);
+    testPool.removeRecursive(CTransaction(txChild),
+                             MemPoolRemovalReason::CONFLICT);
+    testPool.addUnchecked(txParent.GetId(), entry.FromTx(txParent));
+    // Nothing is removed silently, not even by clear
+    testPool.clear();
+
+    const std::vector<std::tuple<uint256, int, uint64_t>> expected = {
+        std::make_tuple(txParent.GetId(), -1, 1),
+        std::make_tuple(txChild.GetId(), -1, 2),
+        std::make_tuple(txParent.GetId(), int(MemPoolRemovalReason::BLOCK), 3),
+        std::make_tuple(txChild.GetId(), int(MemPoolRemovalReason::CONFLICT),
+                        4),
+        std::make_tuple(txParent.GetId(), -1, 5),
+        std::make_tuple(txParent.GetId(), int(MemPoolRemovalReason::UNKNOWN),
+                        6)};
+    BOOST_CHECK(events == expected);
+
+    LOCK(testPool.cs);
+    BOOST_CHECK_EQUAL(testPool.GetSequence(), 7UL);
+}
+
 template <typename name>
 void CheckSort(CTxMemPool &pool, std::vector<std::string> &sortedOrder) {
     BOOST_CHECK_EQUAL(pool.size(), sortedOrder.size());
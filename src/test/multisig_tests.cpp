@@ -310,6 +310,65 @@ BOOST_AUTO_TEST_CASE(multisig_Solver1) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(multisig_SolveScript) {
+    // Tests SolveScript() finds the same as Solver(), as slices of the script.
+    CKey key[2];
+    for (int i = 0; i < 2; i++) {
+        key[i].MakeNewKey(true);
+    }
+
+    {
+        CScript s;
+        s << OP_1 << ToByteVector(key[0].GetPubKey())
+          << ToByteVector(key[1].GetPubKey()) << OP_2 << OP_CHECKMULTISIG;
+        CScriptSolution solution;
+        BOOST_CHECK(SolveScript(s, solution));
+        BOOST_CHECK_EQUAL(solution.type, TX_MULTISIG);
+        BOOST_CHECK_EQUAL(solution.nRequired, 1);
+        BOOST_CHECK_EQUAL(solution.nData, 2U);
+        BOOST_CHECK(solution.data[0].begin() == s.data() + 2);
+        BOOST_CHECK(CPubKey(solution.data[1].begin(), solution.data[1].end()) ==
+                    key[1].GetPubKey());
+    }
+    {
+        // Pushes don't have to be minimal.
+        const uint160 hash = key[0].GetPubKey().GetID();
+        std::vector<uint8_t> script{OP_DUP, OP_HASH160, OP_PUSHDATA1, 20};
+        script.insert(script.end(), hash.begin(), hash.end());
+        script.push_back(OP_EQUALVERIFY);
+        script.push_back(OP_CHECKSIG);
+        CScript s(script.begin(), script.end());
+        CScriptSolution solution;
+        BOOST_CHECK(SolveScript(s, solution));
+        BOOST_CHECK_EQUAL(solution.type, TX_PUBKEYHASH);
+        BOOST_CHECK(std::equal(hash.begin(), hash.end(),
+                               solution.data[0].begin()));
+    }
+    {
+        // Multisig with a wrong key count keeps its type, and Solver() still
+        // returns M, the keys and N.
+        CScript s;
+        s << OP_1 << ToByteVector(key[0].GetPubKey()) << OP_2
+          << OP_CHECKMULTISIG;
+        CScriptSolution solution;
+        BOOST_CHECK(!SolveScript(s, solution));
+        BOOST_CHECK_EQUAL(solution.type, TX_MULTISIG);
+
+        std::vector<valtype> solutions;
+        txnouttype whichType;
+        BOOST_CHECK(!Solver(s, whichType, solutions));
+        BOOST_CHECK_EQUAL(whichType, TX_MULTISIG);
+        BOOST_CHECK_EQUAL(solutions.size(), 3U);
+    }
+    {
+        CScript s;
+        s << ToByteVector(key[0].GetPubKey()) << OP_CHECKSIG << OP_NOP;
+        CScriptSolution solution;
+        BOOST_CHECK(!SolveScript(s, solution));
+        BOOST_CHECK_EQUAL(solution.type, TX_NONSTANDARD);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(multisig_Sign) {
     // Test SignSignature() (and therefore the version of Solver() that signs
     // transactions)
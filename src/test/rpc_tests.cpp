@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "rpc/client.h"
+#include "rpc/metrics.h"
 #include "rpc/server.h"
 
 #include "base58.h"
@@ -14,6 +15,9 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/test/unit_test.hpp>
 
+#include <mutex>
+#include <thread>
+
 #include <univalue.h>
 
 UniValue CallRPC(std::string args) {
@@ -516,4 +520,117 @@ BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress) {
     BOOST_CHECK_EQUAL(result[2].get_int(), 9);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_batch_parallel) {
+    GlobalConfig config;
+    JSONRPCRequest jreq;
+    if (RPCIsInWarmup(nullptr)) {
+        SetRPCWarmupFinished();
+    }
+
+    // Runs of parallel-safe calls, split up by calls that must run on their
+    // own and by malformed requests.
+    UniValue batch(UniValue::VARR);
+    for (int i = 0; i < 100; i++) {
+        UniValue req(UniValue::VOBJ);
+        UniValue params(UniValue::VARR);
+        if (i % 25 == 24) {
+            req.push_back(Pair("method", "help"));
+            params.push_back("getblockcount");
+        } else if (i % 10 == 3) {
+            req.push_back(Pair("method", "getblockhash"));
+            params.push_back(i);
+        } else {
+            req.push_back(Pair("method", "getblockhash"));
+            params.push_back(0);
+        }
+        req.push_back(Pair("params", params));
+        req.push_back(Pair("id", i));
+        batch.push_back(req);
+    }
+    batch.push_back("not an object");
+
+    const std::string strSerial = JSONRPCExecBatch(config, jreq, batch);
+
+    std::vector<std::thread> threads;
+    std::mutex cs;
+    const std::string strParallel = JSONRPCExecBatch(
+        config, jreq, batch, [&](const std::function<void()> &task) {
+            std::lock_guard<std::mutex> lock(cs);
+            threads.emplace_back(task);
+            return true;
+        });
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    BOOST_CHECK(!threads.empty());
+    BOOST_CHECK_EQUAL(strParallel, strSerial);
+
+    // Replies are in request order, errors included
+    UniValue replies;
+    BOOST_CHECK(replies.read(strParallel));
+    BOOST_CHECK_EQUAL(replies.size(), batch.size());
+    for (int i = 0; i < 100; i++) {
+        BOOST_CHECK_EQUAL(find_value(replies[i], "id").get_int(), i);
+        BOOST_CHECK_EQUAL(find_value(replies[i], "error").isNull(),
+                          i % 10 != 3);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(rpc_metrics) {
+    LatencyHistogram histogram;
+    histogram.Add(0);
+    histogram.Add(100);
+    histogram.Add(101);
+    histogram.Add(20000000);
+    BOOST_CHECK_EQUAL(histogram.nCount, 4);
+    BOOST_CHECK_EQUAL(histogram.nSumMicros, 20000201);
+    BOOST_CHECK_EQUAL(histogram.nMaxMicros, 20000000);
+    BOOST_CHECK_EQUAL(histogram.vCounts[0], 2);
+    BOOST_CHECK_EQUAL(histogram.vCounts[1], 1);
+    BOOST_CHECK_EQUAL(histogram.vCounts[NUM_LATENCY_BUCKETS - 1], 1);
+
+    // Calls are accounted by method, unknown methods are not
+    GlobalConfig config;
+    if (RPCIsInWarmup(nullptr)) {
+        SetRPCWarmupFinished();
+    }
+    const std::map<std::string, RPCMethodStats> before = GetRPCMethodStats();
+    JSONRPCRequest request;
+    request.params = UniValue(UniValue::VARR);
+    request.strMethod = "getblockcount";
+    tableRPC.execute(config, request);
+    request.strMethod = "nosuchmethod";
+    BOOST_CHECK_THROW(tableRPC.execute(config, request), UniValue);
+    request.strMethod = "getblockhash";
+    request.params.push_back(1000);
+    BOOST_CHECK_THROW(tableRPC.execute(config, request), UniValue);
+
+    const std::map<std::string, RPCMethodStats> after = GetRPCMethodStats();
+    BOOST_CHECK(!after.count("nosuchmethod"));
+    BOOST_CHECK_EQUAL(after.at("getblockcount").latency.nCount,
+                      before.count("getblockcount")
+                          ? before.at("getblockcount").latency.nCount + 1
+                          : 1);
+    BOOST_CHECK_EQUAL(after.at("getblockcount").nErrors, 0);
+    BOOST_CHECK_EQUAL(after.at("getblockhash").nErrors,
+                      before.count("getblockhash")
+                          ? before.at("getblockhash").nErrors + 1
+                          : 1);
+
+    const std::string text = FormatMetricsText();
+    BOOST_CHECK(text.find("# TYPE bitcoin_rpc_duration_seconds histogram\n") !=
+                std::string::npos);
+    BOOST_CHECK(text.find("bitcoin_rpc_duration_seconds_bucket{method="
+                          "\"getblockcount\",le=\"+Inf\"} ") !=
+                std::string::npos);
+    BOOST_CHECK(text.find("bitcoin_http_workqueue_wait_seconds_count 0\n") !=
+                std::string::npos);
+
+    UniValue metrics = CallRPC("getrpcmetrics");
+    BOOST_CHECK(find_value(metrics, "methods").exists("getblockhash"));
+    BOOST_CHECK_EQUAL(
+        find_value(find_value(metrics, "workqueue"), "rejected").get_int(), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
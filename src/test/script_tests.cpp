@@ -144,6 +144,53 @@ BuildSpendingTransaction(const CScript &scriptSig,
     return txSpend;
 }
 
+/**
+ * Differential test of the VerifyScript fast paths against the generic
+ * interpreter, using the flags of the test vector as well as random flags and
+ * random single byte mutations of the scripts.
+ */
+static void CheckFastPathMatchesGeneric(const CScript &scriptPubKey,
+                                        const CScript &scriptSig,
+                                        uint32_t testFlags,
+                                        const CMutableTransaction &txCredit,
+                                        const CMutableTransaction &tx,
+                                        const std::string &message) {
+    const uint32_t allFlags = (SCRIPT_ENABLE_MONOLITH_OPCODES << 1) - 1;
+    MutableTransactionSignatureChecker checker(&tx, 0,
+                                               txCredit.vout[0].nValue);
+
+    for (int i = 0; i < 8; i++) {
+        uint32_t verifyFlags =
+            i == 0 ? testFlags : InsecureRandBits(32) & allFlags;
+        if (verifyFlags & SCRIPT_VERIFY_CLEANSTACK) {
+            verifyFlags |= SCRIPT_VERIFY_P2SH;
+        }
+
+        CScript mutatedScriptSig = scriptSig;
+        CScript mutatedScriptPubKey = scriptPubKey;
+        if (i >= 4 && i < 6 && !scriptSig.empty()) {
+            mutatedScriptSig[InsecureRandRange(scriptSig.size())] ^=
+                1 << InsecureRandBits(3);
+        }
+        if (i >= 6 && !scriptPubKey.empty()) {
+            mutatedScriptPubKey[InsecureRandRange(scriptPubKey.size())] ^=
+                1 << InsecureRandBits(3);
+        }
+
+        ScriptError err, genericErr;
+        bool fSuccess = VerifyScript(mutatedScriptSig, mutatedScriptPubKey,
+                                     verifyFlags, checker, &err);
+        bool fGenericSuccess =
+            VerifyScriptGeneric(mutatedScriptSig, mutatedScriptPubKey,
+                                verifyFlags, checker, &genericErr);
+        BOOST_CHECK_MESSAGE(fSuccess == fGenericSuccess && err == genericErr,
+                            std::string(ScriptErrorString(err)) + " where " +
+                                std::string(ScriptErrorString(genericErr)) +
+                                " expected by the generic interpreter: " +
+                                message);
+    }
+}
+
 static void DoTest(const CScript &scriptPubKey, const CScript &scriptSig,
                    int flags, const std::string &message, int scriptError,
                    const Amount nValue) {
@@ -167,6 +214,8 @@ static void DoTest(const CScript &scriptPubKey, const CScript &scriptSig,
         std::string(FormatScriptError(err)) + " where " +
             std::string(FormatScriptError((ScriptError_t)scriptError)) +
             " expected: " + message);
+    CheckFastPathMatchesGeneric(scriptPubKey, scriptSig, flags, txCredit, tx,
+                                message);
 #if defined(HAVE_CONSENSUS_LIB)
     CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
     stream << tx2;
@@ -1419,6 +1468,68 @@ BOOST_AUTO_TEST_CASE(script_CHECKMULTISIG23) {
                         ScriptErrorString(err));
 }
 
+static void CheckFastPath(const CScript &scriptSig,
+                          const CScript &scriptPubKey,
+                          const CMutableTransaction &txTo,
+                          const CMutableTransaction &txFrom) {
+    MutableTransactionSignatureChecker checker(&txTo, 0,
+                                               txFrom.vout[0].nValue);
+    ScriptError err;
+    bool fSuccess = false;
+    BOOST_CHECK(VerifyScriptFastPath(scriptSig, scriptPubKey, flags, checker,
+                                     fSuccess, &err));
+    BOOST_CHECK(fSuccess);
+    BOOST_CHECK_MESSAGE(err == SCRIPT_ERR_OK, ScriptErrorString(err));
+}
+
+BOOST_AUTO_TEST_CASE(script_fastpath_templates) {
+    CKey key1, key2;
+    key1.MakeNewKey(true);
+    key2.MakeNewKey(false);
+    const CScript multisig = CScript() << OP_1 << ToByteVector(key1.GetPubKey())
+                                       << ToByteVector(key2.GetPubKey())
+                                       << OP_2 << OP_CHECKMULTISIG;
+
+    // Bare multisig.
+    CMutableTransaction txFrom = BuildCreditingTransaction(multisig, Amount(0));
+    CMutableTransaction txTo = BuildSpendingTransaction(CScript(), txFrom);
+    CScript scriptSig = sign_multisig(multisig, key2, CTransaction(txTo));
+    CheckFastPath(scriptSig, multisig, txTo, txFrom);
+
+    // P2SH multisig.
+    CScript scriptPubKey = GetScriptForDestination(CScriptID(multisig));
+    txFrom = BuildCreditingTransaction(scriptPubKey, Amount(0));
+    txTo = BuildSpendingTransaction(CScript(), txFrom);
+    scriptSig = sign_multisig(multisig, key1, CTransaction(txTo));
+    scriptSig << ToByteVector(multisig);
+    CheckFastPath(scriptSig, scriptPubKey, txTo, txFrom);
+
+    // P2PK and P2PKH, which sign the same way as a 1-of-1 multisig, except for
+    // the dummy element.
+    for (const CScript &script :
+         {CScript() << ToByteVector(key2.GetPubKey()) << OP_CHECKSIG,
+          GetScriptForDestination(key1.GetPubKey().GetID())}) {
+        txFrom = BuildCreditingTransaction(script, Amount(0));
+        txTo = BuildSpendingTransaction(CScript(), txFrom);
+        const CKey &key = script.size() == 25 ? key1 : key2;
+        scriptSig = sign_multisig(script, key, CTransaction(txTo));
+        scriptSig = CScript(scriptSig.begin() + 1, scriptSig.end());
+        if (script.size() == 25) {
+            scriptSig << ToByteVector(key1.GetPubKey());
+        }
+        CheckFastPath(scriptSig, script, txTo, txFrom);
+    }
+
+    // Anything else goes through the generic interpreter.
+    bool fSuccess;
+    BOOST_CHECK(!VerifyScriptFastPath(CScript() << OP_1, CScript() << OP_1,
+                                      flags, BaseSignatureChecker(),
+                                      fSuccess));
+    BOOST_CHECK(!VerifyScriptFastPath(CScript() << OP_0 << OP_0 << OP_0,
+                                      multisig, flags, BaseSignatureChecker(),
+                                      fSuccess));
+}
+
 BOOST_AUTO_TEST_CASE(script_combineSigs) {
     // Test the CombineSignatures function
     Amount amount(0);
@@ -0,0 +1,83 @@
+// Copyright (c) 2018 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "script/scriptcache.h"
+#include "clientversion.h"
+#include "key.h"
+#include "primitives/transaction.h"
+#include "random.h"
+#include "script/sigcache.h"
+#include "streams.h"
+#include "util.h"
+#include "validation.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(scriptcache_tests, TestingSetup)
+
+/** Make a cache dump look like it was written by another client version */
+static void BumpClientVersion(const fs::path &path) {
+    CAutoFile file(fsbridge::fopen(path, "r+b"), SER_DISK, CLIENT_VERSION);
+    BOOST_REQUIRE(!file.IsNull());
+    // The client version follows the 8 byte dump format version
+    BOOST_REQUIRE_EQUAL(fseek(file.Get(), 8, SEEK_SET), 0);
+    file << int(CLIENT_VERSION + 1);
+}
+
+BOOST_AUTO_TEST_CASE(script_cache_dump_version) {
+    const fs::path path = GetDataDir() / "scriptcache.dat";
+    const uint256 key = GetRandHash();
+    {
+        LOCK(cs_main);
+        AddKeyInScriptCache(key);
+    }
+
+    DumpScriptExecutionCache();
+    BOOST_CHECK(LoadScriptExecutionCache());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(IsKeyInScriptCache(key, false));
+    }
+
+    // A dump from any other version is never trusted, and thrown away
+    DumpScriptExecutionCache();
+    BumpClientVersion(path);
+    BOOST_CHECK(!LoadScriptExecutionCache());
+    BOOST_CHECK(!fs::exists(path));
+}
+
+BOOST_AUTO_TEST_CASE(signature_cache_dump_version) {
+    const fs::path path = GetDataDir() / "sigcache.dat";
+
+    CKey key;
+    key.MakeNewKey(true);
+    const uint256 sighash = GetRandHash();
+    std::vector<uint8_t> vchSig;
+    BOOST_REQUIRE(key.Sign(sighash, vchSig));
+
+    const CTransaction tx{CMutableTransaction()};
+    PrecomputedTransactionData txdata(tx);
+    CachingTransactionSignatureChecker checker(&tx, 0, Amount(0), true,
+                                               txdata);
+    BOOST_CHECK(!checker.IsCached(vchSig, key.GetPubKey(), sighash));
+    BOOST_CHECK(checker.VerifySignature(vchSig, key.GetPubKey(), sighash));
+    BOOST_CHECK(checker.IsCached(vchSig, key.GetPubKey(), sighash));
+
+    // Starting over picks a new nonce, as a restart would, so the entry is
+    // only found again if the dump restores the old nonce along with it.
+    DumpSignatureCache();
+    InitSignatureCache();
+    BOOST_CHECK(!checker.IsCached(vchSig, key.GetPubKey(), sighash));
+    BOOST_CHECK(LoadSignatureCache());
+    BOOST_CHECK(checker.IsCached(vchSig, key.GetPubKey(), sighash));
+
+    DumpSignatureCache();
+    BumpClientVersion(path);
+    BOOST_CHECK(!LoadSignatureCache());
+    BOOST_CHECK(!fs::exists(path));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
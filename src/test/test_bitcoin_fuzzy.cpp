@@ -15,6 +15,7 @@
 #include "primitives/block.h"
 #include "protocol.h"
 #include "pubkey.h"
+#include "script/interpreter.h"
 #include "script/script.h"
 #include "streams.h"
 #include "undo.h"
@@ -45,6 +46,7 @@ enum TEST_ID {
     CBLOOMFILTER_DESERIALIZE,
     CDISKBLOCKINDEX_DESERIALIZE,
     CTXOUTCOMPRESSOR_DESERIALIZE,
+    SCRIPT_VERIFY_FASTPATH,
     TEST_ID_END
 };
 
@@ -252,6 +254,33 @@ int main(int argc, char **argv) {
 
             break;
         }
+        case SCRIPT_VERIFY_FASTPATH: {
+            uint32_t flags;
+            CScript scriptSig, scriptPubKey;
+            try {
+                ds >> flags >> scriptSig >> scriptPubKey;
+            } catch (const std::ios_base::failure &e) {
+                return 0;
+            }
+
+            if (flags & SCRIPT_VERIFY_CLEANSTACK) {
+                flags |= SCRIPT_VERIFY_P2SH;
+            }
+
+            CMutableTransaction tx;
+            tx.vin.resize(1);
+            tx.vin[0].scriptSig = scriptSig;
+            MutableTransactionSignatureChecker checker(&tx, 0, Amount(0));
+
+            ScriptError err, genericErr;
+            bool fSuccess =
+                VerifyScript(scriptSig, scriptPubKey, flags, checker, &err);
+            bool fGenericSuccess = VerifyScriptGeneric(
+                scriptSig, scriptPubKey, flags, checker, &genericErr);
+            assert(fSuccess == fGenericSuccess);
+            assert(err == genericErr);
+            break;
+        }
         default:
             return 0;
     }
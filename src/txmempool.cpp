@@ -380,7 +380,7 @@ void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, Amount modifyFee,
     assert(int(nSigOpCountWithAncestors) >= 0);
 }
 
-CTxMemPool::CTxMemPool() : nTransactionsUpdated(0) {
+CTxMemPool::CTxMemPool() : nTransactionsUpdated(0), nSequenceNumber(1) {
     // lock free clear
     _clear();
 
@@ -413,10 +413,10 @@ void CTxMemPool::AddTransactionsUpdated(unsigned int n) {
 
 bool CTxMemPool::addUnchecked(const uint256 &hash, const CTxMemPoolEntry &entry,
                               setEntries &setAncestors, bool validFeeEstimate) {
-    NotifyEntryAdded(entry.GetSharedTx());
     // Add to memory pool without checking anything.
     // Used by AcceptToMemoryPool(), which DOES do all the appropriate checks.
     LOCK(cs);
+    NotifyEntryAdded(entry.GetSharedTx(), nSequenceNumber++);
     indexed_transaction_set::iterator newit = mapTx.insert(entry).first;
     mapLinks.insert(make_pair(newit, TxLinks()));
 
@@ -471,7 +471,7 @@ bool CTxMemPool::addUnchecked(const uint256 &hash, const CTxMemPoolEntry &entry,
 }
 
 void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason) {
-    NotifyEntryRemoved(it->GetSharedTx(), reason);
+    NotifyEntryRemoved(it->GetSharedTx(), reason, nSequenceNumber++);
     const uint256 txid = it->GetTx().GetId();
     for (const CTxIn &txin : it->GetTx().vin) {
         mapNextTx.erase(txin.prevout);
@@ -679,6 +679,11 @@ void CTxMemPool::_clear() {
 
 void CTxMemPool::clear() {
     LOCK(cs);
+    // Let listeners following the mempool sequence see the entries go
+    for (const CTxMemPoolEntry &entry : mapTx) {
+        NotifyEntryRemoved(entry.GetSharedTx(), MemPoolRemovalReason::UNKNOWN,
+                           nSequenceNumber++);
+    }
     _clear();
 }
 
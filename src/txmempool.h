@@ -475,6 +475,8 @@ private:
     //!< Value n means that n times in 2^32 we check.
     uint32_t nCheckFrequency;
     unsigned int nTransactionsUpdated;
+    //!< Sequence number of the next entry added or removed, never reset
+    uint64_t nSequenceNumber;
     CBlockPolicyEstimator *minerPolicyEstimator;
 
     //!< sum of all mempool tx's virtual sizes.
@@ -601,6 +603,15 @@ public:
     bool isSpent(const COutPoint &outpoint);
     unsigned int GetTransactionsUpdated() const;
     void AddTransactionsUpdated(unsigned int n);
+    /**
+     * Sequence number that the next addition or removal of an entry will be
+     * notified with. Requires cs, so that it can be read together with the
+     * mempool contents it describes.
+     */
+    uint64_t GetSequence() const {
+        AssertLockHeld(cs);
+        return nSequenceNumber;
+    }
     /**
      * Check that none of this transactions inputs are in the mempool, and thus
      * the tx is not dependent on other mempool transactions to be included in a
@@ -733,8 +744,14 @@ public:
 
     size_t DynamicMemoryUsage() const;
 
-    boost::signals2::signal<void(CTransactionRef)> NotifyEntryAdded;
-    boost::signals2::signal<void(CTransactionRef, MemPoolRemovalReason)>
+    /**
+     * Signals fired with cs held whenever an entry enters or leaves the
+     * mempool, along with the mempool sequence number of the change.
+     */
+    boost::signals2::signal<void(CTransactionRef, uint64_t nMempoolSequence)>
+        NotifyEntryAdded;
+    boost::signals2::signal<void(CTransactionRef, MemPoolRemovalReason,
+                                 uint64_t nMempoolSequence)>
         NotifyEntryRemoved;
 
 private:
@@ -301,6 +301,7 @@ static std::string FormatException(const std::exception *pex,
 void PrintExceptionContinue(const std::exception *pex, const char *pszThread) {
     std::string message = FormatException(pex, pszThread);
     LogPrintf("\n\n************************\n%s\n", message);
+    GetLogger().Flush();
     fprintf(stderr, "\n\n************************\n%s\n", message.c_str());
 }
 
@@ -1231,7 +1231,7 @@ static bool WriteBlockToDisk(const CBlock &block, CDiskBlockPos &pos,
 }
 
 bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos,
-                       const Config &config) {
+                       const Config &config, bool fArena) {
     block.SetNull();
 
     // Open history file to read
@@ -1243,7 +1243,11 @@ bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos,
 
     // Read block
     try {
-        filein >> block;
+        if (fArena) {
+            UnserializeBlockInArena(filein, block);
+        } else {
+            filein >> block;
+        }
     } catch (const std::exception &e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__,
                      e.what(), pos.ToString());
@@ -1259,8 +1263,8 @@ bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos,
 }
 
 bool ReadBlockFromDisk(CBlock &block, const CBlockIndex *pindex,
-                       const Config &config) {
-    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), config)) {
+                       const Config &config, bool fArena) {
+    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), config, fArena)) {
         return false;
     }
 
@@ -1273,6 +1277,67 @@ bool ReadBlockFromDisk(CBlock &block, const CBlockIndex *pindex,
     return true;
 }
 
+/**
+ * Read the record at pos of a block or undo file. Records are preceded by the
+ * network magic and their size, so the file is opened at the record header.
+ */
+static bool ReadRawFromDisk(std::vector<uint8_t> &data,
+                            const CDiskBlockPos &pos,
+                            const CMessageHeader::MessageMagic &messageStart,
+                            bool fUndo) {
+    CMessageHeader::MessageMagic diskMagic;
+    unsigned int nSize;
+    if (pos.nPos < sizeof(diskMagic) + sizeof(nSize)) {
+        return error("%s: Invalid position %s", __func__, pos.ToString());
+    }
+
+    const CDiskBlockPos posHeader(pos.nFile,
+                                  pos.nPos - sizeof(diskMagic) - sizeof(nSize));
+    CAutoFile filein(fUndo ? OpenUndoFile(posHeader, true)
+                           : OpenBlockFile(posHeader, true),
+                     SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        return error("%s: Unable to open file for %s", __func__,
+                     pos.ToString());
+    }
+
+    try {
+        filein >> FLATDATA(diskMagic) >> nSize;
+        if (diskMagic != messageStart) {
+            return error("%s: Invalid record header at %s", __func__,
+                         pos.ToString());
+        }
+
+        // Do not trust the size before checking the file holds that much
+        const long nFileSize = fseek(filein.Get(), 0, SEEK_END) == 0
+                                   ? ftell(filein.Get())
+                                   : -1;
+        if (nFileSize < 0 || uint64_t(nFileSize) < uint64_t(pos.nPos) + nSize ||
+            fseek(filein.Get(), pos.nPos, SEEK_SET)) {
+            return error("%s: Truncated record at %s", __func__,
+                         pos.ToString());
+        }
+
+        data.resize(nSize);
+        filein.read((char *)data.data(), nSize);
+    } catch (const std::exception &e) {
+        return error("%s: I/O error - %s at %s", __func__, e.what(),
+                     pos.ToString());
+    }
+
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<uint8_t> &data, const CDiskBlockPos &pos,
+                          const CMessageHeader::MessageMagic &messageStart) {
+    return ReadRawFromDisk(data, pos, messageStart, false);
+}
+
+bool ReadRawUndoFromDisk(std::vector<uint8_t> &data, const CDiskBlockPos &pos,
+                         const CMessageHeader::MessageMagic &messageStart) {
+    return ReadRawFromDisk(data, pos, messageStart, true);
+}
+
 Amount GetBlockSubsidy(int nHeight, const Consensus::Params &consensusParams) {
     int halvings = nHeight / consensusParams.nSubsidyHalvingInterval;
     // Force block reward to zero when right shift is undefined.
@@ -615,11 +615,24 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
-/** Functions for disk access for blocks */
+/**
+ * Functions for disk access for blocks. When fArena is set, the transactions
+ * are allocated in a single block-owned arena (see UnserializeBlockInArena).
+ */
 bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos,
-                       const Config &config);
+                       const Config &config, bool fArena = false);
 bool ReadBlockFromDisk(CBlock &block, const CBlockIndex *pindex,
-                       const Config &config);
+                       const Config &config, bool fArena = false);
+
+/**
+ * Read the serialized block, or undo data, stored at pos without
+ * deserializing it. The record header written in front of it must carry
+ * messageStart.
+ */
+bool ReadRawBlockFromDisk(std::vector<uint8_t> &data, const CDiskBlockPos &pos,
+                          const CMessageHeader::MessageMagic &messageStart);
+bool ReadRawUndoFromDisk(std::vector<uint8_t> &data, const CDiskBlockPos &pos,
+                         const CMessageHeader::MessageMagic &messageStart);
 
 /** Functions for validating blocks and updating the block tree */
 
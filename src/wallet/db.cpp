@@ -374,7 +374,7 @@ void CDBEnv::CheckpointLSN(const std::string &strFile) {
 }
 
 CDB::CDB(CWalletDBWrapper &dbw, const char *pszMode, bool fFlushOnCloseIn)
-    : pdb(nullptr), activeTxn(nullptr) {
+    : pdb(nullptr), activeTxn(nullptr), dbw(dbw) {
     int ret;
     fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
     fFlushOnClose = fFlushOnCloseIn;
@@ -446,7 +446,7 @@ CDB::CDB(CWalletDBWrapper &dbw, const char *pszMode, bool fFlushOnCloseIn)
 }
 
 void CDB::Flush() {
-    if (activeTxn) {
+    if (GetTxn()) {
         return;
     }
 
@@ -462,6 +462,40 @@ void CDB::Flush() {
         nMinutes, 0);
 }
 
+bool CDB::BatchBegin() {
+    std::thread::id none;
+    if (!pdb ||
+        !dbw.batchThread.compare_exchange_strong(none,
+                                                 std::this_thread::get_id())) {
+        return false;
+    }
+
+    dbw.batchTxn = bitdb.TxnBegin();
+    dbw.fBatchFailed = false;
+    if (!dbw.batchTxn) {
+        dbw.batchThread = std::thread::id();
+        return false;
+    }
+    return true;
+}
+
+bool CDB::BatchCommit() {
+    if (!pdb || !dbw.GetBatchTxn()) {
+        return false;
+    }
+
+    int ret;
+    if (dbw.fBatchFailed) {
+        dbw.batchTxn->abort();
+        ret = -1;
+    } else {
+        ret = dbw.batchTxn->commit(0);
+    }
+    dbw.batchTxn = nullptr;
+    dbw.batchThread = std::thread::id();
+    return ret == 0;
+}
+
 void CWalletDBWrapper::IncrementUpdateCounter() {
     ++nUpdateCounter;
 }
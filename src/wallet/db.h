@@ -16,6 +16,7 @@
 #include <atomic>
 #include <map>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <db_cxx.h>
@@ -79,9 +80,10 @@ public:
 
     void CloseDb(const std::string &strFile);
 
-    DbTxn *TxnBegin(int flags = DB_TXN_WRITE_NOSYNC) {
+    DbTxn *TxnBegin(int flags = DB_TXN_WRITE_NOSYNC,
+                    DbTxn *parent = nullptr) {
         DbTxn *ptxn = nullptr;
-        int ret = dbenv->txn_begin(nullptr, &ptxn, flags);
+        int ret = dbenv->txn_begin(parent, &ptxn, flags);
         if (!ptxn || ret != 0) return nullptr;
         return ptxn;
     }
@@ -99,12 +101,13 @@ class CWalletDBWrapper {
 public:
     /** Create dummy DB handle */
     CWalletDBWrapper()
-        : nLastSeen(0), nLastFlushed(0), nLastWalletUpdate(0), env(nullptr) {}
+        : nLastSeen(0), nLastFlushed(0), nLastWalletUpdate(0), env(nullptr),
+          batchTxn(nullptr), fBatchFailed(false) {}
 
     /** Create DB handle to real database */
     CWalletDBWrapper(CDBEnv *env_in, const std::string &strFile_in)
         : nLastSeen(0), nLastFlushed(0), nLastWalletUpdate(0), env(env_in),
-          strFile(strFile_in) {}
+          strFile(strFile_in), batchTxn(nullptr), fBatchFailed(false) {}
 
     /** Rewrite the entire database on disk, with the exception of key pszSkip
      * if non-zero
@@ -135,6 +138,22 @@ private:
     CDBEnv *env;
     std::string strFile;
 
+    /**
+     * Transaction of the batch started with CDB::BatchBegin(), which the
+     * handles opened by the thread that started it read and write in until it
+     * is committed. Handles on other threads keep out of it. Only that thread
+     * touches batchTxn and fBatchFailed.
+     */
+    std::atomic<std::thread::id> batchThread;
+    DbTxn *batchTxn;
+    //! An operation failed in the batch, so it must not be committed.
+    bool fBatchFailed;
+
+    DbTxn *GetBatchTxn() const {
+        return batchThread.load() == std::this_thread::get_id() ? batchTxn
+                                                                : nullptr;
+    }
+
     /**
      * Return whether this database handle is a dummy for testing.
      * Only to be used at a low level, application should ideally not care
@@ -152,6 +171,25 @@ protected:
     bool fReadOnly;
     bool fFlushOnClose;
     CDBEnv *env;
+    CWalletDBWrapper &dbw;
+
+    /**
+     * The transaction operations run in: the one from TxnBegin(), or else
+     * the batch this thread started on the database, if there is one.
+     */
+    DbTxn *GetTxn() const {
+        return activeTxn ? activeTxn : dbw.GetBatchTxn();
+    }
+
+    /**
+     * An operation that fails in the batch itself, rather than in a
+     * transaction nested in it, dooms the batch to be aborted.
+     */
+    void CheckBatchOperation(bool fSuccess) {
+        if (!fSuccess && !activeTxn && dbw.GetBatchTxn()) {
+            dbw.fBatchFailed = true;
+        }
+    }
 
 public:
     explicit CDB(CWalletDBWrapper &dbw, const char *pszMode = "r+",
@@ -199,7 +237,7 @@ public:
         // Read
         Dbt datValue;
         datValue.set_flags(DB_DBT_MALLOC);
-        int ret = pdb->get(activeTxn, &datKey, &datValue, 0);
+        int ret = pdb->get(GetTxn(), &datKey, &datValue, 0);
         memset(datKey.get_data(), 0, datKey.get_size());
         if (datValue.get_data() == nullptr) {
             return false;
@@ -244,8 +282,9 @@ public:
         Dbt datValue(ssValue.data(), ssValue.size());
 
         // Write
-        int ret = pdb->put(activeTxn, &datKey, &datValue,
+        int ret = pdb->put(GetTxn(), &datKey, &datValue,
                            (fOverwrite ? 0 : DB_NOOVERWRITE));
+        CheckBatchOperation(ret == 0 || ret == DB_KEYEXIST);
 
         // Clear memory in case it was a private key
         memset(datKey.get_data(), 0, datKey.get_size());
@@ -268,7 +307,8 @@ public:
         Dbt datKey(ssKey.data(), ssKey.size());
 
         // Erase
-        int ret = pdb->del(activeTxn, &datKey, 0);
+        int ret = pdb->del(GetTxn(), &datKey, 0);
+        CheckBatchOperation(ret == 0 || ret == DB_NOTFOUND);
 
         // Clear memory
         memset(datKey.get_data(), 0, datKey.get_size());
@@ -287,7 +327,7 @@ public:
         Dbt datKey(ssKey.data(), ssKey.size());
 
         // Exists
-        int ret = pdb->exists(activeTxn, &datKey, 0);
+        int ret = pdb->exists(GetTxn(), &datKey, 0);
 
         // Clear memory
         memset(datKey.get_data(), 0, datKey.get_size());
@@ -299,7 +339,7 @@ public:
             return nullptr;
         }
         Dbc *pcursor = nullptr;
-        int ret = pdb->cursor(nullptr, &pcursor, 0);
+        int ret = pdb->cursor(GetTxn(), &pcursor, 0);
         if (ret != 0) {
             return nullptr;
         }
@@ -348,7 +388,8 @@ public:
         if (!pdb || activeTxn) {
             return false;
         }
-        DbTxn *ptxn = bitdb.TxnBegin();
+        // Nest in the batch, if any, as its locks would block us otherwise.
+        DbTxn *ptxn = bitdb.TxnBegin(DB_TXN_WRITE_NOSYNC, dbw.GetBatchTxn());
         if (!ptxn) {
             return false;
         }
@@ -374,6 +415,18 @@ public:
         return (ret == 0);
     }
 
+    /**
+     * Make the handles this thread has on this database run their operations
+     * in a single transaction, until BatchCommit() is called on this handle.
+     * Returns false if there already is a batch.
+     */
+    bool BatchBegin();
+    /**
+     * Commit the batch, or abort it if one of its operations failed. Returns
+     * whether it was committed.
+     */
+    bool BatchCommit();
+
     bool ReadVersion(int &nVersion) {
         nVersion = 0;
         return Read(std::string("version"), nVersion);
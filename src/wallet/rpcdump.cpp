@@ -104,16 +104,6 @@ UniValue importprivkey(const Config &config, const JSONRPCRequest &request) {
             "\nAs a JSON-RPC call\n" +
             HelpExampleRpc("importprivkey", "\"mykey\", \"testing\", false"));
 
-    LOCK2(cs_main, pwallet->cs_wallet);
-
-    EnsureWalletIsUnlocked(pwallet);
-
-    std::string strSecret = request.params[0].get_str();
-    std::string strLabel = "";
-    if (request.params.size() > 1) {
-        strLabel = request.params[1].get_str();
-    }
-
     // Whether to perform rescan after import
     bool fRescan = true;
     if (request.params.size() > 2) {
@@ -125,24 +115,36 @@ UniValue importprivkey(const Config &config, const JSONRPCRequest &request) {
                            "Rescan is disabled in pruned mode");
     }
 
-    CBitcoinSecret vchSecret;
-    bool fGood = vchSecret.SetString(strSecret);
+    CBlockIndex *pindexGenesis;
+    {
+        LOCK2(cs_main, pwallet->cs_wallet);
 
-    if (!fGood) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
-                           "Invalid private key encoding");
-    }
+        EnsureWalletIsUnlocked(pwallet);
 
-    CKey key = vchSecret.GetKey();
-    if (!key.IsValid()) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
-                           "Private key outside allowed range");
-    }
+        std::string strSecret = request.params[0].get_str();
+        std::string strLabel = "";
+        if (request.params.size() > 1) {
+            strLabel = request.params[1].get_str();
+        }
+
+        CBitcoinSecret vchSecret;
+        bool fGood = vchSecret.SetString(strSecret);
+
+        if (!fGood) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
+                               "Invalid private key encoding");
+        }
+
+        CKey key = vchSecret.GetKey();
+        if (!key.IsValid()) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
+                               "Private key outside allowed range");
+        }
+
+        CPubKey pubkey = key.GetPubKey();
+        assert(key.VerifyPubKey(pubkey));
+        CKeyID vchAddress = pubkey.GetID();
 
-    CPubKey pubkey = key.GetPubKey();
-    assert(key.VerifyPubKey(pubkey));
-    CKeyID vchAddress = pubkey.GetID();
-    {
         pwallet->MarkDirty();
         pwallet->SetAddressBook(vchAddress, strLabel, "receive");
 
@@ -159,15 +161,45 @@ UniValue importprivkey(const Config &config, const JSONRPCRequest &request) {
 
         // whenever a key is imported, we need to scan the whole chain
         pwallet->UpdateTimeFirstKey(1);
+        pindexGenesis = chainActive.Genesis();
+    }
 
-        if (fRescan) {
-            pwallet->ScanForWalletTransactions(chainActive.Genesis(), true);
-        }
+    // The rescan takes the locks as it needs them.
+    if (fRescan) {
+        pwallet->ScanForWalletTransactions(pindexGenesis, true);
     }
 
     return NullUniValue;
 }
 
+UniValue abortrescan(const Config &config, const JSONRPCRequest &request) {
+    CWallet *const pwallet = GetWalletForJSONRPCRequest(request);
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp)) {
+        return NullUniValue;
+    }
+
+    if (request.fHelp || request.params.size() > 0) {
+        throw std::runtime_error(
+            "abortrescan\n"
+            "\nStops current wallet rescan triggered e.g. by an importprivkey "
+            "call.\n"
+            "\nExamples:\n"
+            "\nImport a private key\n" +
+            HelpExampleCli("importprivkey", "\"mykey\"") +
+            "\nAbort the running wallet rescan\n" +
+            HelpExampleCli("abortrescan", "") + "\nAs a JSON-RPC call\n" +
+            HelpExampleRpc("abortrescan", ""));
+    }
+
+    // The rescan holds cs_main and cs_wallet, don't wait for them.
+    if (!pwallet->IsScanning() || pwallet->IsAbortingRescan()) {
+        return false;
+    }
+
+    pwallet->AbortRescan();
+    return true;
+}
+
 void ImportAddress(CWallet *, const CTxDestination &dest,
                    const std::string &strLabel);
 void ImportScript(CWallet *const pwallet, const CScript &script,
@@ -269,28 +301,33 @@ UniValue importaddress(const Config &config, const JSONRPCRequest &request) {
         fP2SH = request.params[3].get_bool();
     }
 
-    LOCK2(cs_main, pwallet->cs_wallet);
+    CBlockIndex *pindexGenesis;
+    {
+        LOCK2(cs_main, pwallet->cs_wallet);
 
-    CTxDestination dest =
-        DecodeDestination(request.params[0].get_str(), config.GetChainParams());
-    if (IsValidDestination(dest)) {
-        if (fP2SH) {
+        CTxDestination dest = DecodeDestination(request.params[0].get_str(),
+                                                config.GetChainParams());
+        if (IsValidDestination(dest)) {
+            if (fP2SH) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
+                                   "Cannot use the p2sh flag with an address "
+                                   "- use a script instead");
+            }
+            ImportAddress(pwallet, dest, strLabel);
+        } else if (IsHex(request.params[0].get_str())) {
+            std::vector<uint8_t> data(ParseHex(request.params[0].get_str()));
+            ImportScript(pwallet, CScript(data.begin(), data.end()), strLabel,
+                         fP2SH);
+        } else {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
-                               "Cannot use the p2sh flag with an address - use "
-                               "a script instead");
+                               "Invalid Bitcoin address or script");
         }
-        ImportAddress(pwallet, dest, strLabel);
-    } else if (IsHex(request.params[0].get_str())) {
-        std::vector<uint8_t> data(ParseHex(request.params[0].get_str()));
-        ImportScript(pwallet, CScript(data.begin(), data.end()), strLabel,
-                     fP2SH);
-    } else {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
-                           "Invalid Bitcoin address or script");
+        pindexGenesis = chainActive.Genesis();
     }
 
+    // The rescan takes the locks as it needs them.
     if (fRescan) {
-        pwallet->ScanForWalletTransactions(chainActive.Genesis(), true);
+        pwallet->ScanForWalletTransactions(pindexGenesis, true);
         pwallet->ReacceptWalletTransactions();
     }
 
@@ -482,13 +519,18 @@ UniValue importpubkey(const Config &config, const JSONRPCRequest &request) {
                            "Pubkey is not a valid public key");
     }
 
-    LOCK2(cs_main, pwallet->cs_wallet);
+    CBlockIndex *pindexGenesis;
+    {
+        LOCK2(cs_main, pwallet->cs_wallet);
 
-    ImportAddress(pwallet, pubKey.GetID(), strLabel);
-    ImportScript(pwallet, GetScriptForRawPubKey(pubKey), strLabel, false);
+        ImportAddress(pwallet, pubKey.GetID(), strLabel);
+        ImportScript(pwallet, GetScriptForRawPubKey(pubKey), strLabel, false);
+        pindexGenesis = chainActive.Genesis();
+    }
 
+    // The rescan takes the locks as it needs them.
     if (fRescan) {
-        pwallet->ScanForWalletTransactions(chainActive.Genesis(), true);
+        pwallet->ScanForWalletTransactions(pindexGenesis, true);
         pwallet->ReacceptWalletTransactions();
     }
 
@@ -520,96 +562,105 @@ UniValue importwallet(const Config &config, const JSONRPCRequest &request) {
                            "Importing wallets is disabled in pruned mode");
     }
 
-    LOCK2(cs_main, pwallet->cs_wallet);
-
-    EnsureWalletIsUnlocked(pwallet);
-
-    std::ifstream file;
-    file.open(request.params[0].get_str().c_str(),
-              std::ios::in | std::ios::ate);
-    if (!file.is_open()) {
-        throw JSONRPCError(RPC_INVALID_PARAMETER,
-                           "Cannot open wallet dump file");
-    }
-
-    int64_t nTimeBegin = chainActive.Tip()->GetBlockTime();
-
     bool fGood = true;
+    CBlockIndex *pindex;
+    {
+        LOCK2(cs_main, pwallet->cs_wallet);
 
-    int64_t nFilesize = std::max((int64_t)1, (int64_t)file.tellg());
-    file.seekg(0, file.beg);
-
-    // show progress dialog in GUI
-    pwallet->ShowProgress(_("Importing..."), 0);
-    while (file.good()) {
-        pwallet->ShowProgress(
-            "", std::max(1, std::min(99, (int)(((double)file.tellg() /
-                                                (double)nFilesize) *
-                                               100))));
-        std::string line;
-        std::getline(file, line);
-        if (line.empty() || line[0] == '#') {
-            continue;
-        }
+        EnsureWalletIsUnlocked(pwallet);
 
-        std::vector<std::string> vstr;
-        boost::split(vstr, line, boost::is_any_of(" "));
-        if (vstr.size() < 2) {
-            continue;
-        }
-        CBitcoinSecret vchSecret;
-        if (!vchSecret.SetString(vstr[0])) {
-            continue;
-        }
-        CKey key = vchSecret.GetKey();
-        CPubKey pubkey = key.GetPubKey();
-        assert(key.VerifyPubKey(pubkey));
-        CKeyID keyid = pubkey.GetID();
-        if (pwallet->HaveKey(keyid)) {
-            LogPrintf("Skipping import of %s (key already present)\n",
-                      EncodeDestination(keyid));
-            continue;
+        std::ifstream file;
+        file.open(request.params[0].get_str().c_str(),
+                  std::ios::in | std::ios::ate);
+        if (!file.is_open()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER,
+                               "Cannot open wallet dump file");
         }
-        int64_t nTime = DecodeDumpTime(vstr[1]);
-        std::string strLabel;
-        bool fLabel = true;
-        for (unsigned int nStr = 2; nStr < vstr.size(); nStr++) {
-            if (boost::algorithm::starts_with(vstr[nStr], "#")) {
-                break;
-            }
-            if (vstr[nStr] == "change=1") {
-                fLabel = false;
-            }
-            if (vstr[nStr] == "reserve=1") {
-                fLabel = false;
-            }
-            if (boost::algorithm::starts_with(vstr[nStr], "label=")) {
-                strLabel = DecodeDumpString(vstr[nStr].substr(6));
-                fLabel = true;
+
+        int64_t nTimeBegin = chainActive.Tip()->GetBlockTime();
+
+        int64_t nFilesize = std::max((int64_t)1, (int64_t)file.tellg());
+        file.seekg(0, file.beg);
+
+        // show progress dialog in GUI
+        pwallet->ShowProgress(_("Importing..."), 0);
+        {
+            // Write all the imported keys in a single transaction.
+            CWalletDBBatch batch(*pwallet);
+            while (file.good()) {
+                batch.CommitIfFull();
+                pwallet->ShowProgress(
+                    "", std::max(1, std::min(99, (int)(((double)file.tellg() /
+                                                        (double)nFilesize) *
+                                                       100))));
+                std::string line;
+                std::getline(file, line);
+                if (line.empty() || line[0] == '#') {
+                    continue;
+                }
+
+                std::vector<std::string> vstr;
+                boost::split(vstr, line, boost::is_any_of(" "));
+                if (vstr.size() < 2) {
+                    continue;
+                }
+                CBitcoinSecret vchSecret;
+                if (!vchSecret.SetString(vstr[0])) {
+                    continue;
+                }
+                CKey key = vchSecret.GetKey();
+                CPubKey pubkey = key.GetPubKey();
+                assert(key.VerifyPubKey(pubkey));
+                CKeyID keyid = pubkey.GetID();
+                if (pwallet->HaveKey(keyid)) {
+                    LogPrintf("Skipping import of %s (key already present)\n",
+                              EncodeDestination(keyid));
+                    continue;
+                }
+                int64_t nTime = DecodeDumpTime(vstr[1]);
+                std::string strLabel;
+                bool fLabel = true;
+                for (unsigned int nStr = 2; nStr < vstr.size(); nStr++) {
+                    if (boost::algorithm::starts_with(vstr[nStr], "#")) {
+                        break;
+                    }
+                    if (vstr[nStr] == "change=1") {
+                        fLabel = false;
+                    }
+                    if (vstr[nStr] == "reserve=1") {
+                        fLabel = false;
+                    }
+                    if (boost::algorithm::starts_with(vstr[nStr], "label=")) {
+                        strLabel = DecodeDumpString(vstr[nStr].substr(6));
+                        fLabel = true;
+                    }
+                }
+                LogPrintf("Importing %s...\n", EncodeDestination(keyid));
+                if (!pwallet->AddKeyPubKey(key, pubkey)) {
+                    fGood = false;
+                    continue;
+                }
+                pwallet->mapKeyMetadata[keyid].nCreateTime = nTime;
+                if (fLabel) {
+                    pwallet->SetAddressBook(keyid, strLabel, "receive");
+                }
+                nTimeBegin = std::min(nTimeBegin, nTime);
             }
         }
-        LogPrintf("Importing %s...\n", EncodeDestination(keyid));
-        if (!pwallet->AddKeyPubKey(key, pubkey)) {
-            fGood = false;
-            continue;
-        }
-        pwallet->mapKeyMetadata[keyid].nCreateTime = nTime;
-        if (fLabel) {
-            pwallet->SetAddressBook(keyid, strLabel, "receive");
-        }
-        nTimeBegin = std::min(nTimeBegin, nTime);
-    }
-    file.close();
+        file.close();
+
+        // hide progress dialog in GUI
+        pwallet->ShowProgress("", 100);
+        pwallet->UpdateTimeFirstKey(nTimeBegin);
 
-    // hide progress dialog in GUI
-    pwallet->ShowProgress("", 100);
-    pwallet->UpdateTimeFirstKey(nTimeBegin);
+        pindex =
+            chainActive.FindEarliestAtLeast(nTimeBegin - TIMESTAMP_WINDOW);
 
-    CBlockIndex *pindex =
-        chainActive.FindEarliestAtLeast(nTimeBegin - TIMESTAMP_WINDOW);
+        LogPrintf("Rescanning last %i blocks\n",
+                  chainActive.Height() - pindex->nHeight + 1);
+    }
 
-    LogPrintf("Rescanning last %i blocks\n",
-              chainActive.Height() - pindex->nHeight + 1);
+    // The rescan takes the locks as it needs them.
     pwallet->ScanForWalletTransactions(pindex);
     pwallet->MarkDirty();
 
@@ -1245,55 +1296,64 @@ UniValue importmulti(const Config &config, const JSONRPCRequest &mainRequest) {
         }
     }
 
-    LOCK2(cs_main, pwallet->cs_wallet);
-    EnsureWalletIsUnlocked(pwallet);
-
-    // Verify all timestamps are present before importing any keys.
-    const int64_t now =
-        chainActive.Tip() ? chainActive.Tip()->GetMedianTimePast() : 0;
-    for (const UniValue &data : requests.getValues()) {
-        GetImportTimestamp(data, now);
-    }
-
+    int64_t now;
     bool fRunScan = false;
-    const int64_t minimumTimestamp = 1;
-    int64_t nLowestTimestamp = 0;
-
-    if (fRescan && chainActive.Tip()) {
-        nLowestTimestamp = chainActive.Tip()->GetBlockTime();
-    } else {
-        fRescan = false;
-    }
-
+    CBlockIndex *pindex = nullptr;
     UniValue response(UniValue::VARR);
+    {
+        LOCK2(cs_main, pwallet->cs_wallet);
+        EnsureWalletIsUnlocked(pwallet);
+
+        // Verify all timestamps are present before importing any keys.
+        now = chainActive.Tip() ? chainActive.Tip()->GetMedianTimePast() : 0;
+        for (const UniValue &data : requests.getValues()) {
+            GetImportTimestamp(data, now);
+        }
 
-    for (const UniValue &data : requests.getValues()) {
-        const int64_t timestamp =
-            std::max(GetImportTimestamp(data, now), minimumTimestamp);
-        const UniValue result = ProcessImport(pwallet, data, timestamp);
-        response.push_back(result);
+        const int64_t minimumTimestamp = 1;
+        int64_t nLowestTimestamp = 0;
 
-        if (!fRescan) {
-            continue;
+        if (fRescan && chainActive.Tip()) {
+            nLowestTimestamp = chainActive.Tip()->GetBlockTime();
+        } else {
+            fRescan = false;
         }
 
-        // If at least one request was successful then allow rescan.
-        if (result["success"].get_bool()) {
-            fRunScan = true;
+        {
+            CWalletDBBatch batch(*pwallet);
+            for (const UniValue &data : requests.getValues()) {
+                batch.CommitIfFull();
+                const int64_t timestamp =
+                    std::max(GetImportTimestamp(data, now), minimumTimestamp);
+                const UniValue result = ProcessImport(pwallet, data, timestamp);
+                response.push_back(result);
+
+                if (!fRescan) {
+                    continue;
+                }
+
+                // If at least one request was successful then allow rescan.
+                if (result["success"].get_bool()) {
+                    fRunScan = true;
+                }
+
+                // Get the lowest timestamp.
+                if (timestamp < nLowestTimestamp) {
+                    nLowestTimestamp = timestamp;
+                }
+            }
         }
 
-        // Get the lowest timestamp.
-        if (timestamp < nLowestTimestamp) {
-            nLowestTimestamp = timestamp;
+        if (fRescan && fRunScan && requests.size()) {
+            pindex = nLowestTimestamp > minimumTimestamp
+                         ? chainActive.FindEarliestAtLeast(std::max<int64_t>(
+                               nLowestTimestamp - TIMESTAMP_WINDOW, 0))
+                         : chainActive.Genesis();
         }
     }
 
+    // The rescan takes the locks as it needs them.
     if (fRescan && fRunScan && requests.size()) {
-        CBlockIndex *pindex =
-            nLowestTimestamp > minimumTimestamp
-                ? chainActive.FindEarliestAtLeast(
-                      std::max<int64_t>(nLowestTimestamp - TIMESTAMP_WINDOW, 0))
-                : chainActive.Genesis();
         CBlockIndex *scannedRange = nullptr;
         if (pindex) {
             scannedRange = pwallet->ScanForWalletTransactions(pindex, true);
@@ -1338,6 +1398,7 @@ UniValue importmulti(const Config &config, const JSONRPCRequest &mainRequest) {
 static const CRPCCommand commands[] = {
     //  category            name                        actor (function)          okSafeMode
     //  ------------------- ------------------------    ----------------------    ----------
+    { "wallet",             "abortrescan",              abortrescan,              false,  {} },
     { "wallet",             "dumpprivkey",              dumpprivkey,              true,   {"address"}  },
     { "wallet",             "dumpwallet",               dumpwallet,               true,   {"filename"} },
     { "wallet",             "importmulti",              importmulti,              true,   {"requests","options"} },
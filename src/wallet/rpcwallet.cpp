@@ -1695,6 +1695,44 @@ void ListTransactions(CWallet *const pwallet, const CWalletTx &wtx,
     }
 }
 
+/**
+ * The number of entries ListTransactions() adds for wtx, without formatting
+ * them.
+ */
+static int CountTransactionEntries(CWallet *const pwallet,
+                                   const CWalletTx &wtx,
+                                   const std::string &strAccount,
+                                   int nMinDepth, const isminefilter &filter) {
+    Amount nFee;
+    std::string strSentAccount;
+    std::list<COutputEntry> listReceived;
+    std::list<COutputEntry> listSent;
+
+    wtx.GetAmounts(listReceived, listSent, nFee, strSentAccount, filter);
+
+    bool fAllAccounts = (strAccount == std::string("*"));
+    int nEntries = 0;
+
+    if ((!listSent.empty() || nFee != Amount(0)) &&
+        (fAllAccounts || strAccount == strSentAccount)) {
+        nEntries += listSent.size();
+    }
+
+    if (listReceived.size() > 0 && wtx.GetDepthInMainChain() >= nMinDepth) {
+        for (const COutputEntry &r : listReceived) {
+            std::string account;
+            if (pwallet->mapAddressBook.count(r.destination)) {
+                account = pwallet->mapAddressBook[r.destination].name;
+            }
+            if (fAllAccounts || (account == strAccount)) {
+                nEntries++;
+            }
+        }
+    }
+
+    return nEntries;
+}
+
 void AcentryToJSON(const CAccountingEntry &acentry,
                    const std::string &strAccount, UniValue &ret) {
     bool fAllAccounts = (strAccount == std::string("*"));
@@ -1718,9 +1756,10 @@ static UniValue listtransactions(const Config &config,
         return NullUniValue;
     }
 
-    if (request.fHelp || request.params.size() > 4) {
+    if (request.fHelp || request.params.size() > 5) {
         throw std::runtime_error(
-            "listtransactions ( \"account\" count skip include_watchonly)\n"
+            "listtransactions ( \"account\" count skip include_watchonly "
+            "cursor )\n"
             "\nReturns up to 'count' most recent transactions skipping the "
             "first 'from' transactions for account 'account'.\n"
             "\nArguments:\n"
@@ -1732,6 +1771,15 @@ static UniValue listtransactions(const Config &config,
             "transactions to skip\n"
             "4. include_watchonly (bool, optional, default=false) Include "
             "transactions to watch-only addresses (see 'importaddress')\n"
+            "5. cursor         (numeric, optional) Only list transactions "
+            "older than this cursor, as returned by a previous call, or -1 to "
+            "start from the most recent ones. Cannot be combined with skip "
+            "and needs a positive count.\n"
+            "                  When given, the result is an object with the "
+            "list of transactions under \"transactions\" and the cursor of "
+            "the next page under \"cursor\",\n"
+            "                  if any. Transactions are not split across "
+            "pages, so a page may hold a few more than 'count' entries.\n"
             "\nResult:\n"
             "[\n"
             "  {\n"
@@ -1814,6 +1862,9 @@ static UniValue listtransactions(const Config &config,
             HelpExampleCli("listtransactions", "") +
             "\nList transactions 100 to 120\n" +
             HelpExampleCli("listtransactions", "\"*\" 20 100") +
+            "\nList the most recent 20 transactions and get a cursor to the "
+            "previous ones\n" +
+            HelpExampleCli("listtransactions", "\"*\" 20 0 false -1") +
             "\nAs a json rpc call\n" +
             HelpExampleRpc("listtransactions", "\"*\", 20, 100"));
     }
@@ -1840,34 +1891,93 @@ static UniValue listtransactions(const Config &config,
         filter = filter | ISMINE_WATCH_ONLY;
     }
 
+    // Only the transactions with an order position lower than the cursor are
+    // listed, which lets clients page through the wallet without it having to
+    // format the transactions they skip.
+    bool fCursor = false;
+    int64_t nCursor = -1;
+    if (request.params.size() > 4 && !request.params[4].isNull()) {
+        fCursor = true;
+        nCursor = request.params[4].get_int64();
+    }
+
     if (nCount < 0) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
     }
     if (nFrom < 0) {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative from");
     }
+    if (fCursor && nFrom > 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER,
+                           "Cannot combine skip with cursor");
+    }
+    // An empty page would hand back the cursor it was given.
+    if (fCursor && nCount == 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER,
+                           "Count must be positive with cursor");
+    }
     UniValue ret(UniValue::VARR);
 
     const CWallet::TxItems &txOrdered = pwallet->wtxOrdered;
 
     // iterate backwards until we have nCount items to return:
-    for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin();
-         it != txOrdered.rend(); ++it) {
+    CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin();
+    if (nCursor >= 0) {
+        it = CWallet::TxItems::const_reverse_iterator(
+            txOrdered.lower_bound(nCursor));
+    }
+
+    int64_t nNextCursor = nCursor;
+    int nSkip = nFrom;
+    for (; it != txOrdered.rend(); ++it) {
+        // Pages end between order positions, lest the next one misses the
+        // rest of the entries sharing the last one.
+        if (fCursor && (int)ret.size() >= nCount &&
+            (*it).first != nNextCursor) {
+            break;
+        }
+
         CWalletTx *const pwtx = (*it).second.first;
+        CAccountingEntry *const pacentry = (*it).second.second;
+        nNextCursor = (*it).first;
+
+        // Transactions that are skipped whole are only counted, not
+        // formatted. Once one is formatted, the rest of nSkip falls within it.
+        if (nSkip > 0 && ret.empty()) {
+            int nEntries = 0;
+            if (pwtx != 0) {
+                nEntries += CountTransactionEntries(pwallet, *pwtx,
+                                                    strAccount, 0, filter);
+            }
+            if (pacentry != 0 && (strAccount == std::string("*") ||
+                                  pacentry->strAccount == strAccount)) {
+                nEntries++;
+            }
+            if (nEntries <= nSkip) {
+                nSkip -= nEntries;
+                continue;
+            }
+        }
+
         if (pwtx != 0) {
             ListTransactions(pwallet, *pwtx, strAccount, 0, true, ret, filter);
         }
-        CAccountingEntry *const pacentry = (*it).second.second;
         if (pacentry != 0) {
             AcentryToJSON(*pacentry, strAccount, ret);
         }
 
-        if ((int)ret.size() >= (nCount + nFrom)) {
+        if (!fCursor && (int)ret.size() >= (nCount + nSkip)) {
             break;
         }
     }
 
-    // ret is newest to oldest
+    // ret is newest to oldest, and starts with the nSkip entries that are
+    // still to be skipped from the last transaction counted.
+    nFrom = nSkip;
+
+    if (fCursor) {
+        nCount = ret.size();
+    }
 
     if (nFrom > (int)ret.size()) {
         nFrom = ret.size();
@@ -1897,7 +2007,17 @@ static UniValue listtransactions(const Config &config,
     ret.setArray();
     ret.push_backV(arrTmp);
 
-    return ret;
+    if (!fCursor) {
+        return ret;
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("transactions", ret));
+    if (it != txOrdered.rend()) {
+        result.push_back(Pair("cursor", nNextCursor));
+    }
+
+    return result;
 }
 
 static UniValue listaccounts(const Config &config,
@@ -2008,7 +2128,7 @@ static UniValue listsinceblock(const Config &config,
     if (request.fHelp) {
         throw std::runtime_error(
             "listsinceblock ( \"blockhash\" target_confirmations "
-            "include_watchonly)\n"
+            "include_watchonly count \"cursor\" )\n"
             "\nGet all transactions in blocks since block [blockhash], or all "
             "transactions if omitted\n"
             "\nArguments:\n"
@@ -2018,6 +2138,13 @@ static UniValue listsinceblock(const Config &config,
             "required, must be 1 or more\n"
             "3. include_watchonly:       (bool, optional, default=false) "
             "Include transactions to watch-only addresses (see 'importaddress')"
+            "\n"
+            "4. count:                   (numeric, optional) The number of "
+            "entries to return at most, transactions not being split across "
+            "calls. All of them by default\n"
+            "5. \"cursor\":                (string, optional) Continue after "
+            "the transactions returned by a previous call, as given by its "
+            "\"cursor\"\n"
             "\nResult:\n"
             "{\n"
             "  \"transactions\": [\n"
@@ -2075,6 +2202,8 @@ static UniValue listsinceblock(const Config &config,
             "  ],\n"
             "  \"lastblock\": \"lastblockhash\"     (string) The hash of the "
             "last block\n"
+            "  \"cursor\": \"...\"     (string) Only present when count cut "
+            "the list short, to get the following transactions with\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("listsinceblock", "") +
@@ -2120,18 +2249,58 @@ static UniValue listsinceblock(const Config &config,
         filter = filter | ISMINE_WATCH_ONLY;
     }
 
-    int depth = pindex ? (1 + chainActive.Height() - pindex->nHeight) : -1;
+    int nCount = std::numeric_limits<int>::max();
+    if (request.params.size() > 3 && !request.params[3].isNull()) {
+        nCount = request.params[3].get_int();
+        if (nCount < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+        }
+    }
+
+    // The cursor is the position of the last transaction returned in the
+    // wallet's index by height, as "height:txid".
+    int nHeightAfter = 0;
+    uint256 txidAfter;
+    if (request.params.size() > 4 && !request.params[4].isNull()) {
+        const std::string &strCursor = request.params[4].get_str();
+        size_t nSep = strCursor.find(':');
+        if (nSep == std::string::npos ||
+            !ParseInt32(strCursor.substr(0, nSep), &nHeightAfter) ||
+            !IsHex(strCursor.substr(nSep + 1)) ||
+            strCursor.size() - nSep - 1 != 64) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        }
+        txidAfter.SetHex(strCursor.substr(nSep + 1));
+    }
+
+    // Only the transactions not buried at or below the requested block are
+    // visited.
+    int nHeight = pindex ? pindex->nHeight : -1;
 
     UniValue transactions(UniValue::VARR);
 
-    for (const std::pair<uint256, CWalletTx> &pairWtx : pwallet->mapWallet) {
-        CWalletTx tx = pairWtx.second;
+    while ((int)transactions.size() < nCount) {
+        // Transactions yield at least one entry each, unless filtered out.
+        std::vector<const CWalletTx *> vTxs = pwallet->GetTxsAboveHeight(
+            nHeight, nHeightAfter, txidAfter, nCount - transactions.size());
+        if (vTxs.empty()) {
+            break;
+        }
 
-        if (depth == -1 || tx.GetDepthInMainChain() < depth) {
-            ListTransactions(pwallet, tx, "*", 0, true, transactions, filter);
+        for (const CWalletTx *pwtx : vTxs) {
+            ListTransactions(pwallet, *pwtx, "*", 0, true, transactions,
+                             filter);
         }
+
+        txidAfter = vTxs.back()->GetId();
+        nHeightAfter = pwallet->GetTxHeight(txidAfter);
     }
 
+    bool fMore =
+        (int)transactions.size() >= nCount &&
+        !pwallet->GetTxsAboveHeight(nHeight, nHeightAfter, txidAfter, 1)
+             .empty();
+
     CBlockIndex *pblockLast =
         chainActive[chainActive.Height() + 1 - target_confirms];
     uint256 lastblock = pblockLast ? pblockLast->GetBlockHash() : uint256();
@@ -2139,6 +2308,10 @@ static UniValue listsinceblock(const Config &config,
     UniValue ret(UniValue::VOBJ);
     ret.push_back(Pair("transactions", transactions));
     ret.push_back(Pair("lastblock", lastblock.GetHex()));
+    if (fMore) {
+        ret.push_back(Pair("cursor", strprintf("%d:%s", nHeightAfter,
+                                               txidAfter.GetHex())));
+    }
 
     return ret;
 }
@@ -2922,6 +3095,14 @@ static UniValue getwalletinfo(const Config &config,
             CURRENCY_UNIT + "/kB\n"
                             "  \"hdmasterkeyid\": \"<hash160>\"     (string) "
                             "the Hash160 of the HD master pubkey\n"
+                            "  \"scanning\":                      (json "
+                            "object) current rescan, or false if none\n"
+                            "    {\n"
+                            "      \"duration\" : xxxx           (numeric) "
+                            "elapsed seconds since the rescan started\n"
+                            "      \"progress\" : x.xxxx,        (numeric) "
+                            "fraction of the rescan that is done\n"
+                            "    }\n"
                             "}\n"
                             "\nExamples:\n" +
             HelpExampleCli("getwalletinfo", "") +
@@ -2956,6 +3137,15 @@ static UniValue getwalletinfo(const Config &config,
     if (!masterKeyID.IsNull()) {
         obj.push_back(Pair("hdmasterkeyid", masterKeyID.GetHex()));
     }
+    if (pwallet->IsScanning()) {
+        UniValue scanning(UniValue::VOBJ);
+        scanning.push_back(
+            Pair("duration", pwallet->ScanningDuration() / 1000));
+        scanning.push_back(Pair("progress", pwallet->ScanningProgress()));
+        obj.push_back(Pair("scanning", scanning));
+    } else {
+        obj.push_back(Pair("scanning", false));
+    }
     return obj;
 }
 
@@ -3500,8 +3690,8 @@ static const CRPCCommand commands[] = {
     { "wallet",             "listlockunspent",          listlockunspent,          false,  {} },
     { "wallet",             "listreceivedbyaccount",    listreceivedbyaccount,    false,  {"minconf","include_empty","include_watchonly"} },
     { "wallet",             "listreceivedbyaddress",    listreceivedbyaddress,    false,  {"minconf","include_empty","include_watchonly"} },
-    { "wallet",             "listsinceblock",           listsinceblock,           false,  {"blockhash","target_confirmations","include_watchonly"} },
-    { "wallet",             "listtransactions",         listtransactions,         false,  {"account","count","skip","include_watchonly"} },
+    { "wallet",             "listsinceblock",           listsinceblock,           false,  {"blockhash","target_confirmations","include_watchonly","count","cursor"} },
+    { "wallet",             "listtransactions",         listtransactions,         false,  {"account","count","skip","include_watchonly","cursor"} },
     { "wallet",             "listunspent",              listunspent,              false,  {"minconf","maxconf","addresses","include_unsafe"} },
     { "wallet",             "listwallets",              listwallets,              true,   {} },
     { "wallet",             "lockunspent",              lockunspent,              true,   {"unlock","transactions"} },
@@ -7,6 +7,8 @@
 #include "chainparams.h"
 #include "config.h"
 #include "rpc/server.h"
+#include "script/interpreter.h"
+#include "script/sighashtype.h"
 #include "test/test_bitcoin.h"
 #include "validation.h"
 #include "wallet/rpcdump.h"
@@ -17,6 +19,7 @@
 #include <univalue.h>
 
 #include <cstdint>
+#include <limits>
 #include <set>
 #include <utility>
 #include <vector>
@@ -448,35 +451,87 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset) {
     empty_wallet();
 }
 
-BOOST_FIXTURE_TEST_CASE(rescan, TestChain100Setup) {
-    LOCK(cs_main);
+BOOST_AUTO_TEST_CASE(coin_selection_large_wallet) {
+    CoinSet setCoinsRet;
+    Amount nValueRet;
+
+    const CWallet wallet(Params());
+    LOCK(walletCriticalSection);
+
+    empty_wallet();
+    // Many more coins than ApproximateBestSubset() gets to see.
+    for (int i = 0; i < 10000; i++) {
+        add_coin(wallet, (i % 100 + 1) * CENT);
+    }
+
+    // An exact match is found, even if it takes a lot of coins.
+    BOOST_CHECK(wallet.SelectCoinsMinConf(12345 * CENT, 1, 6, 0, vCoins,
+                                          setCoinsRet, nValueRet));
+    BOOST_CHECK_EQUAL(nValueRet, 12345 * CENT);
+
+    // There is no exact match for this one, but the closest coin is found.
+    const Amount nTarget = 50 * CENT + Amount(1);
+    BOOST_CHECK(wallet.SelectCoinsMinConf(nTarget, 1, 6, 0, vCoins,
+                                          setCoinsRet, nValueRet));
+    BOOST_CHECK(nValueRet >= nTarget);
+    BOOST_CHECK(nValueRet <= 52 * CENT);
+
+    empty_wallet();
+    // The first sample of small coins falls short of the target, so it has to
+    // be grown rather than given up on.
+    for (int i = 0; i < 3000; i++) {
+        add_coin(wallet, 1 * CENT);
+    }
+    const Amount nLargeTarget = 1500 * CENT + Amount(1);
+    BOOST_CHECK(wallet.SelectCoinsMinConf(nLargeTarget, 1, 6, 0, vCoins,
+                                          setCoinsRet, nValueRet));
+    BOOST_CHECK(nValueRet >= nLargeTarget);
+    BOOST_CHECK(setCoinsRet.size() <= 2 * MAX_APPROXIMATE_BEST_SUBSET_COINS);
 
+    empty_wallet();
+}
+
+BOOST_FIXTURE_TEST_CASE(rescan, TestChain100Setup) {
     // Cap last block file size, and mine new block in a new block file.
-    CBlockIndex *oldTip = chainActive.Tip();
-    GetBlockFileInfo(oldTip->GetBlockPos().nFile)->nSize = MAX_BLOCKFILE_SIZE;
-    CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
-    CBlockIndex *newTip = chainActive.Tip();
+    CBlockIndex *oldTip;
+    CBlockIndex *newTip;
+    {
+        LOCK(cs_main);
+        oldTip = chainActive.Tip();
+        GetBlockFileInfo(oldTip->GetBlockPos().nFile)->nSize =
+            MAX_BLOCKFILE_SIZE;
+        CreateAndProcessBlock({},
+                              GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+        newTip = chainActive.Tip();
+    }
 
     // Verify ScanForWalletTransactions picks up transactions in both the old
-    // and new block files.
+    // and new block files. It takes the locks itself, so they mustn't be held.
     {
         CWallet wallet(Params());
-        LOCK(wallet.cs_wallet);
-        wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        {
+            LOCK(wallet.cs_wallet);
+            wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        }
         BOOST_CHECK_EQUAL(oldTip, wallet.ScanForWalletTransactions(oldTip));
         BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), 100 * COIN);
     }
 
     // Prune the older block file.
-    PruneOneBlockFile(oldTip->GetBlockPos().nFile);
-    UnlinkPrunedFiles({oldTip->GetBlockPos().nFile});
+    {
+        LOCK(cs_main);
+        PruneOneBlockFile(oldTip->GetBlockPos().nFile);
+        UnlinkPrunedFiles({oldTip->GetBlockPos().nFile});
+    }
 
     // Verify ScanForWalletTransactions only picks transactions in the new block
     // file.
     {
         CWallet wallet(Params());
-        LOCK(wallet.cs_wallet);
-        wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        {
+            LOCK(wallet.cs_wallet);
+            wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        }
         BOOST_CHECK_EQUAL(newTip, wallet.ScanForWalletTransactions(oldTip));
         BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), 50 * COIN);
     }
@@ -531,42 +586,84 @@ BOOST_FIXTURE_TEST_CASE(rescan, TestChain100Setup) {
     }
 }
 
+// Verify ScanForWalletTransactions picks up transactions spending outputs that
+// were only found earlier in the same rescan.
+BOOST_FIXTURE_TEST_CASE(rescan_spends, TestChain100Setup) {
+    const CScript scriptPubKey = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+
+    // The signature below doesn't use the replay protected sighash.
+    gArgs.ForceSetArg("-replayprotectionactivationtime",
+                      std::to_string(std::numeric_limits<int64_t>::max()));
+
+    // Spend the first coinbase to a script the wallet doesn't know about.
+    CMutableTransaction spend;
+    spend.vin.emplace_back(COutPoint(coinbaseTxns[0].GetId(), 0));
+    spend.vout.emplace_back(49 * COIN, CScript() << OP_TRUE);
+    std::vector<uint8_t> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, CTransaction(spend), 0,
+                                 SigHashType().withForkId(),
+                                 coinbaseTxns[0].vout[0].nValue);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back(uint8_t(SIGHASH_ALL | SIGHASH_FORKID));
+    spend.vin[0].scriptSig << vchSig;
+    CBlock block = CreateAndProcessBlock({spend}, scriptPubKey);
+    gArgs.ClearArg("-replayprotectionactivationtime");
+    BOOST_REQUIRE(chainActive.Tip()->GetBlockHash() == block.GetHash());
+
+    CWallet wallet(Params());
+    {
+        LOCK(wallet.cs_wallet);
+        wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+    }
+    BOOST_CHECK_EQUAL(chainActive.Genesis(),
+                      wallet.ScanForWalletTransactions(chainActive.Genesis()));
+    LOCK(wallet.cs_wallet);
+
+    // All 101 coinbases and the spend.
+    BOOST_CHECK_EQUAL(wallet.mapWallet.size(), 102U);
+    BOOST_CHECK(wallet.mapWallet.count(spend.GetId()));
+    BOOST_CHECK(!wallet.IsScanning());
+}
+
 // Verify importwallet RPC starts rescan at earliest block with timestamp
 // greater or equal than key birthday. Previously there was a bug where
 // importwallet RPC would start the scan at the latest block with timestamp less
 // than or equal to key birthday.
 BOOST_FIXTURE_TEST_CASE(importwallet_rescan, TestChain100Setup) {
-    LOCK(cs_main);
-
-    // Create two blocks with same timestamp to verify that importwallet rescan
-    // will pick up both blocks, not just the first.
-    const int64_t BLOCK_TIME = chainActive.Tip()->GetBlockTimeMax() + 5;
-    SetMockTime(BLOCK_TIME);
-    coinbaseTxns.emplace_back(
-        *CreateAndProcessBlock({},
-                               GetScriptForRawPubKey(coinbaseKey.GetPubKey()))
-             .vtx[0]);
-    coinbaseTxns.emplace_back(
-        *CreateAndProcessBlock({},
-                               GetScriptForRawPubKey(coinbaseKey.GetPubKey()))
-             .vtx[0]);
-
-    // Set key birthday to block time increased by the timestamp window, so
-    // rescan will start at the block time.
-    const int64_t KEY_TIME = BLOCK_TIME + TIMESTAMP_WINDOW;
-    SetMockTime(KEY_TIME);
-    coinbaseTxns.emplace_back(
-        *CreateAndProcessBlock({},
-                               GetScriptForRawPubKey(coinbaseKey.GetPubKey()))
-             .vtx[0]);
+    // The RPCs below take the locks themselves, so they mustn't be held.
+    int64_t BLOCK_TIME;
+    int64_t KEY_TIME;
+    {
+        LOCK(cs_main);
+        const CScript scriptPubKey =
+            GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+
+        // Create two blocks with same timestamp to verify that importwallet
+        // rescan will pick up both blocks, not just the first.
+        BLOCK_TIME = chainActive.Tip()->GetBlockTimeMax() + 5;
+        SetMockTime(BLOCK_TIME);
+        coinbaseTxns.emplace_back(
+            *CreateAndProcessBlock({}, scriptPubKey).vtx[0]);
+        coinbaseTxns.emplace_back(
+            *CreateAndProcessBlock({}, scriptPubKey).vtx[0]);
+
+        // Set key birthday to block time increased by the timestamp window, so
+        // rescan will start at the block time.
+        KEY_TIME = BLOCK_TIME + TIMESTAMP_WINDOW;
+        SetMockTime(KEY_TIME);
+        coinbaseTxns.emplace_back(
+            *CreateAndProcessBlock({}, scriptPubKey).vtx[0]);
+    }
 
     // Import key into wallet and call dumpwallet to create backup file.
     {
         CWallet wallet(Params());
-        LOCK(wallet.cs_wallet);
-        wallet.mapKeyMetadata[coinbaseKey.GetPubKey().GetID()].nCreateTime =
-            KEY_TIME;
-        wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        {
+            LOCK(wallet.cs_wallet);
+            wallet.mapKeyMetadata[coinbaseKey.GetPubKey().GetID()]
+                .nCreateTime = KEY_TIME;
+            wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        }
 
         JSONRPCRequest request;
         request.params.setArray();
@@ -623,6 +720,261 @@ BOOST_FIXTURE_TEST_CASE(coin_mark_dirty_immature_credit, TestChain100Setup) {
     BOOST_CHECK_EQUAL(wtx.GetImmatureCredit(), 50 * COIN);
 }
 
+// Check that AvailableCoins() and GetBalance(), which only look at the
+// wallet's index of unspent outputs, follow spends, abandons and key imports.
+BOOST_FIXTURE_TEST_CASE(unspent_outputs_index, TestChain100Setup) {
+    // Mine one more block so the first coinbase is mature.
+    CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+
+    CWallet wallet(Params());
+    LOCK2(cs_main, wallet.cs_wallet);
+    CWalletTx wtxCoinbase(&wallet, MakeTransactionRef(coinbaseTxns.front()));
+    wtxCoinbase.SetMerkleBranch(chainActive[1], 0);
+    wallet.AddToWallet(wtxCoinbase);
+
+    std::vector<COutput> vCoins;
+    wallet.AvailableCoins(vCoins);
+    BOOST_CHECK(vCoins.empty());
+
+    // Importing the key must be picked up once the wallet is marked dirty.
+    wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+    wallet.MarkDirty();
+    wallet.AvailableCoins(vCoins);
+    BOOST_CHECK_EQUAL(vCoins.size(), 1U);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 50 * COIN);
+
+    // Spend the coin in a transaction that never makes it to the mempool.
+    CMutableTransaction spend;
+    spend.vin.emplace_back(COutPoint(wtxCoinbase.GetId(), 0));
+    spend.vout.emplace_back(49 * COIN, CScript() << OP_TRUE);
+    CWalletTx wtxSpend(&wallet, MakeTransactionRef(spend));
+    wallet.AddToWallet(wtxSpend);
+    wallet.AvailableCoins(vCoins);
+    BOOST_CHECK(vCoins.empty());
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), Amount(0));
+
+    // Abandoning the spend makes the coin available again.
+    BOOST_CHECK(wallet.AbandonTransaction(wtxSpend.GetId()));
+    wallet.AvailableCoins(vCoins);
+    BOOST_CHECK_EQUAL(vCoins.size(), 1U);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 50 * COIN);
+}
+
+// Check that topping up the keypool picks up outputs already in the wallet
+// which pay to the new keys, as when an HD wallet is restored.
+BOOST_FIXTURE_TEST_CASE(unspent_outputs_keypool_topup, TestChain100Setup) {
+    CWallet wallet(Params());
+    CKeyID keyid;
+    {
+        LOCK(wallet.cs_wallet);
+        wallet.SetMinVersion(FEATURE_HD_SPLIT);
+        BOOST_CHECK(wallet.SetHDMasterKey(wallet.GenerateNewHDMasterKey()));
+
+        // The first external key the keypool will derive.
+        const uint32_t nHardened = 0x80000000;
+        CKey masterKey;
+        BOOST_CHECK(wallet.GetKey(wallet.GetHDChain().masterKeyID, masterKey));
+        CExtKey master, account, chain, child;
+        master.SetMaster(masterKey.begin(), masterKey.size());
+        master.Derive(account, nHardened);
+        account.Derive(chain, nHardened);
+        chain.Derive(child, nHardened);
+        keyid = child.key.GetPubKey().GetID();
+    }
+
+    CBlock block = CreateAndProcessBlock({}, GetScriptForDestination(keyid));
+
+    LOCK2(cs_main, wallet.cs_wallet);
+    CWalletTx wtx(&wallet, block.vtx[0]);
+    wtx.SetMerkleBranch(chainActive.Tip(), 0);
+    wallet.AddToWallet(wtx);
+    BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), Amount(0));
+
+    BOOST_CHECK(wallet.TopUpKeyPool(1));
+    BOOST_CHECK(wallet.HaveKey(keyid));
+    BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), 50 * COIN);
+}
+
+// Check that the wallet's running balance totals follow new transactions,
+// abandons and coinbases maturing without the wallet being told.
+BOOST_FIXTURE_TEST_CASE(balance_totals, TestChain100Setup) {
+    // Mine one more block so the first coinbase is mature.
+    CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+
+    CWallet wallet(Params());
+    CMutableTransaction spend;
+    {
+        LOCK2(cs_main, wallet.cs_wallet);
+        wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        for (int i = 0; i < 2; i++) {
+            CWalletTx wtx(&wallet, MakeTransactionRef(coinbaseTxns[i]));
+            wtx.SetMerkleBranch(chainActive[i + 1], 0);
+            wallet.AddToWallet(wtx);
+        }
+        BOOST_CHECK_EQUAL(wallet.GetBalance(), 50 * COIN);
+        BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), 50 * COIN);
+
+        // Spend the mature coin in a transaction that never makes it to the
+        // mempool.
+        spend.vin.emplace_back(COutPoint(coinbaseTxns[0].GetId(), 0));
+        spend.vout.emplace_back(49 * COIN, CScript() << OP_TRUE);
+        wallet.AddToWallet(CWalletTx(&wallet, MakeTransactionRef(spend)));
+        BOOST_CHECK_EQUAL(wallet.GetBalance(), Amount(0));
+        BOOST_CHECK_EQUAL(wallet.GetUnconfirmedBalance(), Amount(0));
+    }
+
+    // The second coinbase matures with the next block.
+    CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    {
+        LOCK2(cs_main, wallet.cs_wallet);
+        BOOST_CHECK_EQUAL(wallet.GetBalance(), 50 * COIN);
+        BOOST_CHECK_EQUAL(wallet.GetImmatureBalance(), Amount(0));
+
+        // Abandoning the spend makes the first coin count again.
+        BOOST_CHECK(wallet.AbandonTransaction(spend.GetId()));
+        BOOST_CHECK_EQUAL(wallet.GetBalance(), 100 * COIN);
+    }
+}
+
+// Check that the wallet's index of transactions by height, which
+// listsinceblock seeks into, follows new and abandoned transactions.
+BOOST_FIXTURE_TEST_CASE(tx_height_index, TestChain100Setup) {
+    CWallet wallet(Params());
+    LOCK2(cs_main, wallet.cs_wallet);
+    for (int i = 0; i < 3; i++) {
+        CWalletTx wtx(&wallet, MakeTransactionRef(coinbaseTxns[i]));
+        wtx.SetMerkleBranch(chainActive[i + 1], 0);
+        wallet.AddToWallet(wtx);
+    }
+
+    // The index is built on first use.
+    std::vector<const CWalletTx *> vTxs = wallet.GetTxsAboveHeight(-1);
+    BOOST_CHECK_EQUAL(vTxs.size(), 3U);
+    BOOST_CHECK_EQUAL(wallet.GetTxHeight(coinbaseTxns[1].GetId()), 2);
+
+    // And updated for transactions added afterwards.
+    CMutableTransaction spend;
+    spend.vin.emplace_back(COutPoint(coinbaseTxns[0].GetId(), 0));
+    spend.vout.emplace_back(49 * COIN, CScript() << OP_TRUE);
+    CWalletTx wtxSpend(&wallet, MakeTransactionRef(spend));
+    wallet.AddToWallet(wtxSpend);
+    BOOST_CHECK_EQUAL(wallet.GetTxHeight(wtxSpend.GetId()),
+                      TX_HEIGHT_UNCONFIRMED);
+
+    // Only the transactions above the given height are returned, unconfirmed
+    // ones last.
+    vTxs = wallet.GetTxsAboveHeight(1);
+    BOOST_CHECK_EQUAL(vTxs.size(), 3U);
+    BOOST_CHECK(vTxs[0]->GetId() == coinbaseTxns[1].GetId());
+    BOOST_CHECK(vTxs[1]->GetId() == coinbaseTxns[2].GetId());
+    BOOST_CHECK(vTxs[2]->GetId() == wtxSpend.GetId());
+
+    // Pages continue after the last transaction returned.
+    vTxs = wallet.GetTxsAboveHeight(1, 2, coinbaseTxns[1].GetId(), 1);
+    BOOST_CHECK_EQUAL(vTxs.size(), 1U);
+    BOOST_CHECK(vTxs[0]->GetId() == coinbaseTxns[2].GetId());
+
+    // Abandoned transactions stay listed as unconfirmed.
+    BOOST_CHECK(wallet.AbandonTransaction(wtxSpend.GetId()));
+    BOOST_CHECK_EQUAL(wallet.GetTxHeight(wtxSpend.GetId()),
+                      TX_HEIGHT_UNCONFIRMED);
+    BOOST_CHECK_EQUAL(wallet.GetTxsAboveHeight(3).size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(tx_prefilter_false_positives) {
+    CWalletTxPrefilter filter(10000);
+    std::vector<CScript> vScripts;
+    for (int i = 0; i < 10000; i++) {
+        CKeyID keyid(uint160(InsecureRandBytes(20)));
+        filter.Insert(keyid);
+        vScripts.push_back(GetScriptForDestination(keyid));
+    }
+    BOOST_CHECK(!filter.IsFull());
+
+    int nMissed = 0;
+    for (const CScript &script : vScripts) {
+        nMissed += !filter.MatchScript(script);
+    }
+    BOOST_CHECK_EQUAL(nMissed, 0);
+
+    // About one in a thousand is expected to get through.
+    int nFalsePositives = 0;
+    for (int i = 0; i < 10000; i++) {
+        CKeyID keyid(uint160(InsecureRandBytes(20)));
+        nFalsePositives += filter.MatchScript(GetScriptForDestination(keyid));
+    }
+    BOOST_CHECK(nFalsePositives < 100);
+}
+
+// Check that the prefilter in front of AddToWalletIfInvolvingMe() follows the
+// keys, scripts and transactions added after it got built.
+BOOST_FIXTURE_TEST_CASE(tx_prefilter, TestChain100Setup) {
+    CWallet wallet(Params());
+    LOCK2(cs_main, wallet.cs_wallet);
+
+    // Running a transaction through builds the prefilter.
+    CTransactionRef coinbase = MakeTransactionRef(coinbaseTxns[0]);
+    BOOST_CHECK(
+        !wallet.AddToWalletIfInvolvingMe(coinbase, chainActive[1], 0, true));
+    wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+    BOOST_CHECK(
+        wallet.AddToWalletIfInvolvingMe(coinbase, chainActive[1], 0, true));
+
+    // Spending our coin is from us, wherever it goes.
+    CMutableTransaction spend;
+    spend.vin.emplace_back(COutPoint(coinbaseTxns[0].GetId(), 0));
+    spend.vout.emplace_back(49 * COIN, CScript() << OP_TRUE);
+    BOOST_CHECK(wallet.AddToWalletIfInvolvingMe(MakeTransactionRef(spend),
+                                                nullptr, 0, true));
+
+    CMutableTransaction watched;
+    watched.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    watched.vout.emplace_back(COIN, CScript() << OP_2);
+    CTransactionRef watchedRef = MakeTransactionRef(watched);
+    BOOST_CHECK(!wallet.AddToWalletIfInvolvingMe(watchedRef, nullptr, 0, true));
+    wallet.AddWatchOnly(CScript() << OP_2, 0);
+    BOOST_CHECK(wallet.AddToWalletIfInvolvingMe(watchedRef, nullptr, 0, true));
+}
+
+BOOST_AUTO_TEST_CASE(keypool_topup_hd) {
+    std::unique_ptr<CWalletDBWrapper> dbw(
+        new CWalletDBWrapper(&bitdb, "wallet_keypool_test.dat"));
+    CWallet wallet(Params(), std::move(dbw));
+    bool fFirstRun;
+    BOOST_CHECK_EQUAL(wallet.LoadWallet(fFirstRun), DB_LOAD_OK);
+
+    LOCK(wallet.cs_wallet);
+    wallet.SetMinVersion(FEATURE_HD_SPLIT);
+    BOOST_CHECK(wallet.SetHDMasterKey(wallet.GenerateNewHDMasterKey()));
+
+    // Enough keys to be derived on several threads, written in one batch.
+    const unsigned int nKeys = 100;
+    BOOST_CHECK(wallet.TopUpKeyPool(nKeys));
+    BOOST_CHECK_EQUAL(wallet.GetKeyPoolSize(), 2 * nKeys);
+    BOOST_CHECK_EQUAL(wallet.GetHDChain().nExternalChainCounter, nKeys);
+    BOOST_CHECK_EQUAL(wallet.GetHDChain().nInternalChainCounter, nKeys);
+
+    // The keys are the same as those derived one at a time.
+    const uint32_t nHardened = 0x80000000;
+    CKey masterKey;
+    BOOST_CHECK(wallet.GetKey(wallet.GetHDChain().masterKeyID, masterKey));
+    CExtKey master, account;
+    master.SetMaster(masterKey.begin(), masterKey.size());
+    master.Derive(account, nHardened);
+    for (uint32_t nChain = 0; nChain < 2; nChain++) {
+        CExtKey chain;
+        account.Derive(chain, nChain | nHardened);
+        for (uint32_t i = 0; i < nKeys; i++) {
+            CExtKey child;
+            chain.Derive(child, i | nHardened);
+            const CKeyID keyid = child.key.GetPubKey().GetID();
+            BOOST_CHECK(wallet.HaveKey(keyid));
+            BOOST_CHECK_EQUAL(wallet.mapKeyMetadata[keyid].hdKeypath,
+                              strprintf("m/0'/%d'/%d'", nChain, i));
+        }
+    }
+}
+
 static int64_t AddTx(CWallet &wallet, uint32_t lockTime, int64_t mockTime,
                      int64_t blockTime) {
     CMutableTransaction tx;
@@ -12,6 +12,7 @@
 #include "consensus/validation.h"
 #include "dstencode.h"
 #include "fs.h"
+#include "hash.h"
 #include "init.h"
 #include "key.h"
 #include "keystore.h"
@@ -19,6 +20,7 @@
 #include "policy/policy.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
+#include "random.h"
 #include "scheduler.h"
 #include "script/script.h"
 #include "script/sighashtype.h"
@@ -36,6 +38,11 @@
 #include <boost/thread.hpp>
 
 #include <cassert>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
 
 std::vector<CWalletRef> vpwallets;
 
@@ -131,46 +138,132 @@ const CWalletTx *CWallet::GetWalletTx(const uint256 &hash) const {
 }
 
 CPubKey CWallet::GenerateNewKey(CWalletDB &walletdb, bool internal) {
+    return GenerateNewKeys(walletdb, 1, internal).front();
+}
+
+/**
+ * Run f(i) for each i in [0, n), spread over as many threads as there are
+ * cores when n is large enough to be worth it, that is when each thread gets
+ * at least nMinItemsPerThread items. If f throws, the thread it ran on stops
+ * and the first exception is rethrown once all threads are done.
+ */
+template <typename F>
+static void ParallelFor(size_t n, const F &f, size_t nMinItemsPerThread = 16) {
+    const size_t nThreads = std::max<size_t>(
+        1, std::min<size_t>(GetNumCores(), n / nMinItemsPerThread));
+    std::vector<std::exception_ptr> vErrors(nThreads);
+    auto run = [&f, &vErrors, n, nThreads](size_t t) {
+        try {
+            for (size_t i = t; i < n; i += nThreads) {
+                f(i);
+            }
+        } catch (...) {
+            vErrors[t] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> vThreads;
+    for (size_t t = 1; t < nThreads; t++) {
+        vThreads.emplace_back(run, t);
+    }
+    run(0);
+    for (std::thread &thread : vThreads) {
+        thread.join();
+    }
+    for (const std::exception_ptr &error : vErrors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+std::vector<CPubKey> CWallet::GenerateNewKeys(CWalletDB &walletdb,
+                                              size_t nKeys, bool internal) {
     // mapKeyMetadata
     AssertLockHeld(cs_wallet);
     // default to compressed public keys if we want 0.6.0 wallets
     bool fCompressed = CanSupportFeature(FEATURE_COMPRPUBKEY);
 
-    CKey secret;
-
     // Create new metadata
     int64_t nCreationTime = GetTime();
-    CKeyMetadata metadata(nCreationTime);
 
     // use HD key derivation if HD was enabled during wallet creation
-    if (IsHDEnabled()) {
-        DeriveNewChildKey(
-            walletdb, metadata, secret,
-            (CanSupportFeature(FEATURE_HD_SPLIT) ? internal : false));
-    } else {
-        secret.MakeNewKey(fCompressed);
+    const bool fHD = IsHDEnabled();
+    internal = internal && fHD && CanSupportFeature(FEATURE_HD_SPLIT);
+    CExtKey chainChildKey;
+    if (fHD) {
+        DeriveChainChildKey(chainChildKey, internal);
     }
+    uint32_t &nChainCounter = internal ? hdChain.nInternalChainCounter
+                                       : hdChain.nExternalChainCounter;
 
     // Compressed public keys were introduced in version 0.6.0
     if (fCompressed) {
         SetMinVersion(FEATURE_COMPRPUBKEY);
     }
 
-    CPubKey pubkey = secret.GetPubKey();
-    assert(secret.VerifyPubKey(pubkey));
+    std::vector<CPubKey> vPubKeys;
+    vPubKeys.reserve(nKeys);
+    std::vector<CKey> vSecrets;
+    std::vector<CPubKey> vCandidates;
+    while (vPubKeys.size() < nKeys) {
+        // Deriving the keys and their public keys is what takes time, so do
+        // that in parallel and only add them to the wallet in order.
+        vSecrets.assign(nKeys - vPubKeys.size(), CKey());
+        vCandidates.assign(vSecrets.size(), CPubKey());
+        const uint32_t nFirstChild = nChainCounter;
+        ParallelFor(vSecrets.size(), [&](size_t i) {
+            if (fHD) {
+                // always derive hardened keys
+                // childIndex | BIP32_HARDENED_KEY_LIMIT = derive childIndex
+                // in hardened child-index-range
+                // example: 1 | BIP32_HARDENED_KEY_LIMIT == 0x80000001 ==
+                // 2147483649
+                CExtKey childKey;
+                chainChildKey.Derive(childKey, (nFirstChild + i) |
+                                                   BIP32_HARDENED_KEY_LIMIT);
+                vSecrets[i] = childKey.key;
+            } else {
+                vSecrets[i].MakeNewKey(fCompressed);
+            }
+            vCandidates[i] = vSecrets[i].GetPubKey();
+            assert(vSecrets[i].VerifyPubKey(vCandidates[i]));
+        });
+
+        for (size_t i = 0; i < vSecrets.size(); i++) {
+            const CPubKey &pubkey = vCandidates[i];
+            CKeyMetadata metadata(nCreationTime);
+            if (fHD) {
+                metadata.hdKeypath = strprintf(
+                    "m/0'/%d'/%d'", internal ? 1 : 0, nChainCounter);
+                metadata.hdMasterKeyID = hdChain.masterKeyID;
+                nChainCounter++;
+                // skip keys already known to the wallet
+                if (HaveKey(pubkey.GetID())) {
+                    continue;
+                }
+            }
+
+            mapKeyMetadata[pubkey.GetID()] = metadata;
+            UpdateTimeFirstKey(nCreationTime);
 
-    mapKeyMetadata[pubkey.GetID()] = metadata;
-    UpdateTimeFirstKey(nCreationTime);
+            if (!AddKeyPubKeyWithDB(walletdb, vSecrets[i], pubkey)) {
+                throw std::runtime_error(std::string(__func__) +
+                                         ": AddKey failed");
+            }
+            vPubKeys.push_back(pubkey);
+        }
 
-    if (!AddKeyPubKeyWithDB(walletdb, secret, pubkey)) {
-        throw std::runtime_error(std::string(__func__) + ": AddKey failed");
+        // update the chain model in the database
+        if (fHD && !walletdb.WriteHDChain(hdChain)) {
+            throw std::runtime_error(std::string(__func__) +
+                                     ": Writing HD chain model failed");
+        }
     }
 
-    return pubkey;
+    return vPubKeys;
 }
 
-void CWallet::DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata &metadata,
-                                CKey &secret, bool internal) {
+void CWallet::DeriveChainChildKey(CExtKey &chainChildKey, bool internal) {
     // for now we use a fixed keypath scheme of m/0'/0'/k
     // master key seed (256bit)
     CKey key;
@@ -178,10 +271,6 @@ void CWallet::DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata &metadata,
     CExtKey masterKey;
     // key at m/0'
     CExtKey accountKey;
-    // key at m/0'/0' (external) or m/0'/1' (internal)
-    CExtKey chainChildKey;
-    // key at m/0'/0'/<n>'
-    CExtKey childKey;
 
     // try to get the master key
     if (!GetKey(hdChain.masterKeyID, key)) {
@@ -200,38 +289,6 @@ void CWallet::DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata &metadata,
     assert(internal ? CanSupportFeature(FEATURE_HD_SPLIT) : true);
     accountKey.Derive(chainChildKey,
                       BIP32_HARDENED_KEY_LIMIT + (internal ? 1 : 0));
-
-    // derive child key at next index, skip keys already known to the wallet
-    do {
-        // always derive hardened keys
-        // childIndex | BIP32_HARDENED_KEY_LIMIT = derive childIndex in hardened
-        // child-index-range
-        // example: 1 | BIP32_HARDENED_KEY_LIMIT == 0x80000001 == 2147483649
-        if (internal) {
-            chainChildKey.Derive(childKey,
-                                 hdChain.nInternalChainCounter |
-                                     BIP32_HARDENED_KEY_LIMIT);
-            metadata.hdKeypath = "m/0'/1'/" +
-                                 std::to_string(hdChain.nInternalChainCounter) +
-                                 "'";
-            hdChain.nInternalChainCounter++;
-        } else {
-            chainChildKey.Derive(childKey,
-                                 hdChain.nExternalChainCounter |
-                                     BIP32_HARDENED_KEY_LIMIT);
-            metadata.hdKeypath = "m/0'/0'/" +
-                                 std::to_string(hdChain.nExternalChainCounter) +
-                                 "'";
-            hdChain.nExternalChainCounter++;
-        }
-    } while (HaveKey(childKey.key.GetPubKey().GetID()));
-    secret = childKey.key;
-    metadata.hdMasterKeyID = hdChain.masterKeyID;
-    // update the chain model in the database
-    if (!walletdb.WriteHDChain(hdChain)) {
-        throw std::runtime_error(std::string(__func__) +
-                                 ": Writing HD chain model failed");
-    }
 }
 
 bool CWallet::AddKeyPubKeyWithDB(CWalletDB &walletdb, const CKey &secret,
@@ -254,6 +311,8 @@ bool CWallet::AddKeyPubKeyWithDB(CWalletDB &walletdb, const CKey &secret,
         return false;
     }
 
+    AddToTxPrefilter(pubkey.GetID());
+
     if (needsDB) {
         pwalletdbEncryption = nullptr;
     }
@@ -290,6 +349,7 @@ bool CWallet::AddCryptedKey(const CPubKey &vchPubKey,
     }
 
     LOCK(cs_wallet);
+    AddToTxPrefilter(vchPubKey.GetID());
     if (pwalletdbEncryption) {
         return pwalletdbEncryption->WriteCryptedKey(
             vchPubKey, vchCryptedSecret, mapKeyMetadata[vchPubKey.GetID()]);
@@ -310,7 +370,12 @@ bool CWallet::LoadKeyMetadata(const CTxDestination &keyID,
 
 bool CWallet::LoadCryptedKey(const CPubKey &vchPubKey,
                              const std::vector<uint8_t> &vchCryptedSecret) {
-    return CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret);
+    if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret)) {
+        return false;
+    }
+
+    AddToTxPrefilter(vchPubKey.GetID());
+    return true;
 }
 
 void CWallet::UpdateTimeFirstKey(int64_t nCreateTime) {
@@ -329,6 +394,7 @@ bool CWallet::AddCScript(const CScript &redeemScript) {
         return false;
     }
 
+    AddToTxPrefilter(CScriptID(redeemScript));
     return CWalletDB(*dbw).WriteCScript(Hash160(redeemScript), redeemScript);
 }
 
@@ -348,7 +414,12 @@ bool CWallet::LoadCScript(const CScript &redeemScript) {
         return true;
     }
 
-    return CCryptoKeyStore::AddCScript(redeemScript);
+    if (!CCryptoKeyStore::AddCScript(redeemScript)) {
+        return false;
+    }
+
+    AddToTxPrefilter(CScriptID(redeemScript));
+    return true;
 }
 
 bool CWallet::AddWatchOnly(const CScript &dest) {
@@ -356,6 +427,7 @@ bool CWallet::AddWatchOnly(const CScript &dest) {
         return false;
     }
 
+    AddToTxPrefilter(dest);
     const CKeyMetadata &meta = mapKeyMetadata[CScriptID(dest)];
     UpdateTimeFirstKey(meta.nCreateTime);
     NotifyWatchonlyChanged(true);
@@ -381,7 +453,12 @@ bool CWallet::RemoveWatchOnly(const CScript &dest) {
 }
 
 bool CWallet::LoadWatchOnly(const CScript &dest) {
-    return CCryptoKeyStore::AddWatchOnly(dest);
+    if (!CCryptoKeyStore::AddWatchOnly(dest)) {
+        return false;
+    }
+
+    AddToTxPrefilter(dest);
+    return true;
 }
 
 bool CWallet::Unlock(const SecureString &strWalletPassphrase) {
@@ -711,10 +788,13 @@ bool CWallet::IsSpent(const uint256 &hash, unsigned int n) const {
 
 void CWallet::AddToSpends(const COutPoint &outpoint, const uint256 &wtxid) {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
+    AddToTxPrefilter(outpoint.GetTxId());
 
     std::pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
     SyncMetaData(range);
+
+    UpdateUnspentOutput(outpoint);
 }
 
 void CWallet::AddToSpends(const uint256 &wtxid) {
@@ -730,6 +810,222 @@ void CWallet::AddToSpends(const uint256 &wtxid) {
     }
 }
 
+void CWallet::UpdateUnspentOutput(const COutPoint &outpoint) const {
+    AssertLockHeld(cs_wallet);
+    if (fUnspentOutputsStale) {
+        // Will be picked up when the index is rebuilt.
+        return;
+    }
+
+    std::map<uint256, CWalletTx>::const_iterator it =
+        mapWallet.find(outpoint.GetTxId());
+    if (it != mapWallet.end() &&
+        outpoint.GetN() < it->second.tx->vout.size()) {
+        isminetype mine = IsMine(it->second.tx->vout[outpoint.GetN()]);
+        if (mine != ISMINE_NO &&
+            !IsSpent(outpoint.GetTxId(), outpoint.GetN())) {
+            mapUnspentOutputs[outpoint] = mine;
+            return;
+        }
+    }
+
+    mapUnspentOutputs.erase(outpoint);
+}
+
+void CWallet::UpdateUnspentOutputs(const CWalletTx &wtx) const {
+    // A transaction changing state affects both its own outputs and the ones
+    // it spends.
+    const uint256 &txid = wtx.GetId();
+    for (size_t i = 0; i < wtx.tx->vout.size(); i++) {
+        UpdateUnspentOutput(COutPoint(txid, i));
+    }
+
+    if (wtx.IsCoinBase()) {
+        return;
+    }
+
+    for (const CTxIn &txin : wtx.tx->vin) {
+        UpdateUnspentOutput(txin.prevout);
+    }
+}
+
+const std::map<COutPoint, isminetype> &CWallet::GetUnspentOutputs() const {
+    AssertLockHeld(cs_wallet);
+    if (fUnspentOutputsStale) {
+        mapUnspentOutputs.clear();
+        fUnspentOutputsStale = false;
+        for (const std::pair<const uint256, CWalletTx> &item : mapWallet) {
+            for (size_t i = 0; i < item.second.tx->vout.size(); i++) {
+                UpdateUnspentOutput(COutPoint(item.first, i));
+            }
+        }
+    }
+
+    return mapUnspentOutputs;
+}
+
+void CWallet::UpdateTxHeight(const CWalletTx &wtx) const {
+    AssertLockHeld(cs_wallet);
+    if (fTxHeightsStale) {
+        // Will be picked up when the index is rebuilt.
+        return;
+    }
+
+    // Same as GetDepthInMainChain() > 0, but for the height.
+    int nHeight = TX_HEIGHT_UNCONFIRMED;
+    if (!wtx.hashUnset() && wtx.nIndex != -1) {
+        BlockMap::const_iterator mi = mapBlockIndex.find(wtx.hashBlock);
+        if (mi != mapBlockIndex.end() && chainActive.Contains(mi->second)) {
+            nHeight = mi->second->nHeight;
+        }
+    }
+
+    const uint256 &txid = wtx.GetId();
+    std::pair<std::map<uint256, int>::iterator, bool> ret =
+        mapTxHeight.insert(std::make_pair(txid, nHeight));
+    if (!ret.second) {
+        if (ret.first->second == nHeight) {
+            return;
+        }
+
+        setTxByHeight.erase(std::make_pair(ret.first->second, txid));
+        ret.first->second = nHeight;
+    }
+
+    setTxByHeight.insert(std::make_pair(nHeight, txid));
+}
+
+const std::set<std::pair<int, uint256>> &CWallet::GetTxHeights() const {
+    AssertLockHeld(cs_wallet);
+    if (fTxHeightsStale) {
+        setTxByHeight.clear();
+        mapTxHeight.clear();
+        fTxHeightsStale = false;
+        for (const std::pair<const uint256, CWalletTx> &item : mapWallet) {
+            UpdateTxHeight(item.second);
+        }
+    }
+
+    return setTxByHeight;
+}
+
+std::vector<const CWalletTx *>
+CWallet::GetTxsAboveHeight(int nHeight, int nHeightAfter,
+                           const uint256 &txidAfter, size_t nMaxTxs) const {
+    AssertLockHeld(cs_wallet);
+    const std::set<std::pair<int, uint256>> &setTxs = GetTxHeights();
+
+    std::pair<int, uint256> start(nHeight + 1, uint256());
+    std::set<std::pair<int, uint256>>::const_iterator it =
+        setTxs.lower_bound(start);
+    if (!txidAfter.IsNull() &&
+        std::make_pair(nHeightAfter, txidAfter) >= start) {
+        it = setTxs.upper_bound(std::make_pair(nHeightAfter, txidAfter));
+    }
+
+    std::vector<const CWalletTx *> vTxs;
+    for (; it != setTxs.end() && vTxs.size() < nMaxTxs; ++it) {
+        vTxs.push_back(&mapWallet.at(it->second));
+    }
+
+    return vTxs;
+}
+
+int CWallet::GetTxHeight(const uint256 &txid) const {
+    AssertLockHeld(cs_wallet);
+    GetTxHeights();
+    std::map<uint256, int>::const_iterator it = mapTxHeight.find(txid);
+    return it == mapTxHeight.end() ? TX_HEIGHT_UNCONFIRMED : it->second;
+}
+
+void CWallet::UpdateTxBalances(const CWalletTx &wtx) const {
+    AssertLockHeld(cs_wallet);
+    if (fBalancesStale) {
+        // Will be picked up when the totals are recomputed.
+        return;
+    }
+
+    // A transaction changing state affects the balance of the outputs it
+    // spends too.
+    setBalanceTxsToUpdate.insert(wtx.GetId());
+    if (wtx.IsCoinBase()) {
+        return;
+    }
+
+    for (const CTxIn &txin : wtx.tx->vin) {
+        if (mapWallet.count(txin.prevout.GetTxId())) {
+            setBalanceTxsToUpdate.insert(txin.prevout.GetTxId());
+        }
+    }
+}
+
+void CWallet::UpdateTxBalance(const uint256 &txid) const {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    std::map<uint256, Balances>::iterator it = mapTxBalances.find(txid);
+    if (it != mapTxBalances.end()) {
+        balancesTotal -= it->second;
+        mapTxBalances.erase(it);
+    }
+
+    // Only the transactions with outputs in the unspent outputs index count,
+    // as when going through the index.
+    const std::map<COutPoint, isminetype> &mapUnspent = GetUnspentOutputs();
+    std::map<COutPoint, isminetype>::const_iterator mi =
+        mapUnspent.lower_bound(COutPoint(txid, 0));
+    if (mi == mapUnspent.end() || mi->first.GetTxId() != txid) {
+        setBalanceTxsToUpdate.erase(txid);
+        return;
+    }
+
+    const CWalletTx &wtx = mapWallet.at(txid);
+    const int nDepth = wtx.GetDepthInMainChain();
+    Balances balances;
+    if (wtx.IsTrusted()) {
+        balances.nTrusted = wtx.GetAvailableCredit(false);
+        balances.nWatchOnlyTrusted = wtx.GetAvailableWatchOnlyCredit(false);
+    } else if (nDepth == 0 && wtx.InMempool()) {
+        balances.nUnconfirmed = wtx.GetAvailableCredit(false);
+        balances.nWatchOnlyUnconfirmed = wtx.GetAvailableWatchOnlyCredit(false);
+    }
+    balances.nImmature = wtx.GetImmatureCredit(false);
+    balances.nWatchOnlyImmature = wtx.GetImmatureWatchOnlyCredit(false);
+
+    if (!balances.IsNull()) {
+        balancesTotal += balances;
+        mapTxBalances[txid] = balances;
+    }
+
+    if (nDepth < 1 || wtx.GetBlocksToMaturity() > 0) {
+        setBalanceTxsToUpdate.insert(txid);
+    } else {
+        setBalanceTxsToUpdate.erase(txid);
+    }
+}
+
+const CWallet::Balances &CWallet::GetBalances() const {
+    AssertLockHeld(cs_wallet);
+    if (fBalancesStale) {
+        balancesTotal = Balances();
+        mapTxBalances.clear();
+        setBalanceTxsToUpdate.clear();
+        fBalancesStale = false;
+        for (const CWalletTx *pcoin : GetUnspentOutputTxs()) {
+            setBalanceTxsToUpdate.insert(pcoin->GetId());
+        }
+    }
+
+    // Updating a transaction may drop it from the set.
+    const std::vector<uint256> vTxs(setBalanceTxsToUpdate.begin(),
+                                    setBalanceTxsToUpdate.end());
+    for (const uint256 &txid : vTxs) {
+        UpdateTxBalance(txid);
+    }
+
+    return balancesTotal;
+}
+
 bool CWallet::EncryptWallet(const SecureString &strWalletPassphrase) {
     if (IsCrypted()) {
         return false;
@@ -1009,6 +1305,11 @@ void CWallet::MarkDirty() {
     for (std::pair<const uint256, CWalletTx> &item : mapWallet) {
         item.second.MarkDirty();
     }
+
+    // Whatever invalidated the balances may also have changed which outputs
+    // are ours.
+    fUnspentOutputsStale = true;
+    fBalancesStale = true;
 }
 
 bool CWallet::AddToWallet(const CWalletTx &wtxIn, bool fFlushOnClose) {
@@ -1025,6 +1326,7 @@ bool CWallet::AddToWallet(const CWalletTx &wtxIn, bool fFlushOnClose) {
     wtx.BindWallet(this);
     bool fInsertedNew = ret.second;
     if (fInsertedNew) {
+        AddToTxPrefilter(hash);
         wtx.nTimeReceived = GetAdjustedTime();
         wtx.nOrderPos = IncOrderPosNext(&walletdb);
         wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, nullptr)));
@@ -1068,6 +1370,9 @@ bool CWallet::AddToWallet(const CWalletTx &wtxIn, bool fFlushOnClose) {
 
     // Break debit/credit balance caches:
     wtx.MarkDirty();
+    UpdateUnspentOutputs(wtx);
+    UpdateTxHeight(wtx);
+    UpdateTxBalances(wtx);
 
     // Notify UI of new or updated transaction.
     NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -1089,6 +1394,7 @@ bool CWallet::LoadToWallet(const CWalletTx &wtxIn) {
     uint256 txid = wtxIn.GetId();
 
     mapWallet[txid] = wtxIn;
+    AddToTxPrefilter(txid);
     CWalletTx &wtx = mapWallet[txid];
     wtx.BindWallet(this);
     wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, nullptr)));
@@ -1124,8 +1430,14 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef &ptx,
     const CTransaction &tx = *ptx;
     AssertLockHeld(cs_wallet);
 
+    const CWalletTxPrefilter &prefilter = GetTxPrefilter();
     if (pIndex != nullptr) {
         for (const CTxIn &txin : tx.vin) {
+            if (!prefilter.MatchTxId(txin.prevout.GetTxId())) {
+                // Not spending anything a wallet transaction spends.
+                continue;
+            }
+
             std::pair<TxSpends::const_iterator, TxSpends::const_iterator>
                 range = mapTxSpends.equal_range(txin.prevout);
             while (range.first != range.second) {
@@ -1148,7 +1460,10 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef &ptx,
     if (fExisted && !fUpdate) {
         return false;
     }
-    if (fExisted || IsMine(tx) || IsFromMe(tx)) {
+    // Most transactions are not ours, the prefilter rejects them without
+    // going through the keystore.
+    if (fExisted ||
+        (prefilter.Match(tx) && (IsMine(tx) || IsFromMe(tx)))) {
         /**
          * Check if any keys in the wallet keypool that were supposed to be
          * unused have appeared in a new transaction. If so, remove those keys
@@ -1250,6 +1565,9 @@ bool CWallet::AbandonTransaction(const uint256 &hashTx) {
                     mapWallet[txin.prevout.GetTxId()].MarkDirty();
                 }
             }
+            UpdateUnspentOutputs(wtx);
+            UpdateTxHeight(wtx);
+            UpdateTxBalances(wtx);
         }
     }
 
@@ -1315,6 +1633,9 @@ void CWallet::MarkConflicted(const uint256 &hashBlock, const uint256 &hashTx) {
                     mapWallet[txin.prevout.GetTxId()].MarkDirty();
                 }
             }
+            UpdateUnspentOutputs(wtx);
+            UpdateTxHeight(wtx);
+            UpdateTxBalances(wtx);
         }
     }
 }
@@ -1645,116 +1966,664 @@ void CWalletTx::GetAmounts(std::list<COutputEntry> &listReceived,
     listSent.clear();
     strSentAccount = strFromAccount;
 
-    // Compute fee:
-    Amount nDebit = GetDebit(filter);
-    // debit>0 means we signed/sent this transaction.
-    if (nDebit > Amount(0)) {
-        Amount nValueOut = tx->GetValueOut();
-        nFee = (nDebit - nValueOut);
+    // Compute fee:
+    Amount nDebit = GetDebit(filter);
+    // debit>0 means we signed/sent this transaction.
+    if (nDebit > Amount(0)) {
+        Amount nValueOut = tx->GetValueOut();
+        nFee = (nDebit - nValueOut);
+    }
+
+    // Sent/received.
+    for (unsigned int i = 0; i < tx->vout.size(); ++i) {
+        const CTxOut &txout = tx->vout[i];
+        isminetype fIsMine = pwallet->IsMine(txout);
+        // Only need to handle txouts if AT LEAST one of these is true:
+        //   1) they debit from us (sent)
+        //   2) the output is to us (received)
+        if (nDebit > Amount(0)) {
+            // Don't report 'change' txouts
+            if (pwallet->IsChange(txout)) {
+                continue;
+            }
+        } else if (!(fIsMine & filter)) {
+            continue;
+        }
+
+        // In either case, we need to get the destination address.
+        CTxDestination address;
+
+        if (!ExtractDestination(txout.scriptPubKey, address) &&
+            !txout.scriptPubKey.IsUnspendable()) {
+            LogPrintf("CWalletTx::GetAmounts: Unknown transaction type found, "
+                      "txid %s\n",
+                      this->GetId().ToString());
+            address = CNoDestination();
+        }
+
+        COutputEntry output = {address, txout.nValue, (int)i};
+
+        // If we are debited by the transaction, add the output as a "sent"
+        // entry.
+        if (nDebit > Amount(0)) {
+            listSent.push_back(output);
+        }
+
+        // If we are receiving the output, add it as a "received" entry.
+        if (fIsMine & filter) {
+            listReceived.push_back(output);
+        }
+    }
+}
+
+/**
+ * Whether a script pays to a key id or script id accepted by the given
+ * predicates, in one of the templates ::IsMine() recognizes. Bare multisig
+ * matches on any one of its keys, where IsMine() wants all of them. Watch-only
+ * scripts are left to the caller.
+ */
+template <typename KeyIdPredicate, typename ScriptIdPredicate>
+static bool MatchScriptIds(const CScript &script, KeyIdPredicate haveKeyId,
+                           ScriptIdPredicate haveScriptId) {
+    const size_t size = script.size();
+    if (size == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 &&
+        script[2] == 20 && script[23] == OP_EQUALVERIFY &&
+        script[24] == OP_CHECKSIG) {
+        // Pay to pubkey hash, by far the most common.
+        uint160 hash;
+        std::copy(script.begin() + 3, script.begin() + 23, hash.begin());
+        return haveKeyId(hash);
+    }
+
+    if (script.IsPayToScriptHash()) {
+        uint160 hash;
+        std::copy(script.begin() + 2, script.begin() + 22, hash.begin());
+        return haveScriptId(hash);
+    }
+
+    if (size >= 35 && size <= 67 && script[0] == size - 2 &&
+        script[size - 1] == OP_CHECKSIG) {
+        // Pay to pubkey.
+        const CPubKey pubkey(script.begin() + 1, script.end() - 1);
+        return haveKeyId(pubkey.GetID());
+    }
+
+    if (size > 0 && script[size - 1] == OP_CHECKMULTISIG) {
+        CScriptSolution solution;
+        if (SolveScript(script, solution) && solution.type == TX_MULTISIG) {
+            for (size_t i = 0; i < solution.nData; i++) {
+                const CScriptSlice &key = solution.data[i];
+                if (haveKeyId(CPubKey(key.begin(), key.end()).GetID())) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+CWalletTxPrefilter::CWalletTxPrefilter(size_t nMaxEntriesIn)
+    : vData(std::max<size_t>(1, (nMaxEntriesIn * BITS_PER_ENTRY +
+                                 BLOCK_WORDS * 64 - 1) /
+                                    (BLOCK_WORDS * 64)) *
+            BLOCK_WORDS),
+      k0(GetRand(std::numeric_limits<uint64_t>::max())),
+      k1(GetRand(std::numeric_limits<uint64_t>::max())), nEntries(0),
+      nMaxEntries(nMaxEntriesIn), fHaveWatchOnly(false) {}
+
+uint64_t CWalletTxPrefilter::HashId(const uint160 &id) const {
+    return CSipHasher(k0, k1).Write(id.begin(), id.size()).Finalize();
+}
+
+uint64_t CWalletTxPrefilter::HashScript(const CScript &script) const {
+    return CSipHasher(k0, k1).Write(script.data(), script.size()).Finalize();
+}
+
+size_t CWalletTxPrefilter::GetBlockOffset(uint64_t hash) const {
+    // The high half of the hash picks the block, the low bits the positions
+    // within it.
+    const uint64_t nBlocks = vData.size() / BLOCK_WORDS;
+    return ((hash >> 32) * nBlocks >> 32) * BLOCK_WORDS;
+}
+
+void CWalletTxPrefilter::InsertHash(uint64_t hash) {
+    uint64_t *block = &vData[GetBlockOffset(hash)];
+    const uint32_t nStep = uint32_t(hash >> 9) | 1;
+    uint32_t nBit = uint32_t(hash);
+    for (unsigned int i = 0; i < HASH_FUNCS; i++, nBit += nStep) {
+        block[(nBit >> 6) % BLOCK_WORDS] |= uint64_t(1) << (nBit & 63);
+    }
+}
+
+bool CWalletTxPrefilter::ContainsHash(uint64_t hash) const {
+    const uint64_t *block = &vData[GetBlockOffset(hash)];
+    const uint32_t nStep = uint32_t(hash >> 9) | 1;
+    uint32_t nBit = uint32_t(hash);
+    for (unsigned int i = 0; i < HASH_FUNCS; i++, nBit += nStep) {
+        const uint64_t mask = uint64_t(1) << (nBit & 63);
+        if (!(block[(nBit >> 6) % BLOCK_WORDS] & mask)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void CWalletTxPrefilter::Insert(const uint160 &id) {
+    InsertHash(HashId(id));
+    nEntries++;
+}
+
+void CWalletTxPrefilter::Insert(const CScript &script) {
+    InsertHash(HashScript(script));
+    fHaveWatchOnly = true;
+    nEntries++;
+}
+
+void CWalletTxPrefilter::Insert(const uint256 &txid) {
+    InsertHash(SipHashUint256(k0, k1, txid));
+    nEntries++;
+}
+
+bool CWalletTxPrefilter::MatchScript(const CScript &script) const {
+    auto haveId = [this](const uint160 &id) {
+        return ContainsHash(HashId(id));
+    };
+    if (MatchScriptIds(script, haveId, haveId)) {
+        return true;
+    }
+
+    // Hashing every script is only worth it if there is something to find.
+    return fHaveWatchOnly && ContainsHash(HashScript(script));
+}
+
+bool CWalletTxPrefilter::MatchTxId(const uint256 &txid) const {
+    return ContainsHash(SipHashUint256(k0, k1, txid));
+}
+
+bool CWalletTxPrefilter::Match(const CTransaction &tx) const {
+    for (const CTxOut &txout : tx.vout) {
+        if (MatchScript(txout.scriptPubKey)) {
+            return true;
+        }
+    }
+
+    if (tx.IsCoinBase()) {
+        return false;
+    }
+
+    for (const CTxIn &txin : tx.vin) {
+        if (MatchTxId(txin.prevout.GetTxId())) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const CWalletTxPrefilter &CWallet::GetTxPrefilter() {
+    AssertLockHeld(cs_wallet);
+    if (!fTxPrefilterStale) {
+        return txPrefilter;
+    }
+
+    LOCK(cs_KeyStore);
+    const size_t nEntries = mapKeys.size() + mapCryptedKeys.size() +
+                            mapScripts.size() + setWatchOnly.size() +
+                            mapWallet.size() + mapTxSpends.size();
+    // Leave room for the wallet to double before it has to be rebuilt.
+    txPrefilter = CWalletTxPrefilter(std::max<size_t>(2 * nEntries, 1000));
+    for (const auto &entry : mapKeys) {
+        txPrefilter.Insert(entry.first);
+    }
+    for (const auto &entry : mapCryptedKeys) {
+        txPrefilter.Insert(entry.first);
+    }
+    for (const auto &entry : mapScripts) {
+        txPrefilter.Insert(entry.first);
+    }
+    for (const CScript &script : setWatchOnly) {
+        txPrefilter.Insert(script);
+    }
+    for (const auto &entry : mapWallet) {
+        txPrefilter.Insert(entry.first);
+    }
+    // Anything spending the same outputs as a wallet transaction conflicts
+    // with it.
+    for (const auto &entry : mapTxSpends) {
+        txPrefilter.Insert(entry.first.GetTxId());
+    }
+
+    fTxPrefilterStale = false;
+    return txPrefilter;
+}
+
+/**
+ * Snapshot of what may make a transaction relevant to a wallet, which the
+ * ScanForWalletTransactions() workers test blocks against without holding
+ * cs_wallet. It accepts a superset of what IsMine() and IsFromMe() do, so the
+ * candidates it finds still have to go through AddToWalletIfInvolvingMe().
+ *
+ * The key and script part has to be rebuilt whenever the keystore changes
+ * (the keypool gets topped up as the rescan finds used keys), see IsStale().
+ * The transaction ids are shared between rebuilds and only cover the wallet
+ * as it was when the rescan started.
+ */
+class CWalletScanFilter {
+private:
+    class SaltedHash160Hasher {
+    private:
+        const uint64_t k0, k1;
+
+    public:
+        SaltedHash160Hasher()
+            : k0(GetRand(std::numeric_limits<uint64_t>::max())),
+              k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+        size_t operator()(const uint160 &hash) const {
+            return CSipHasher(k0, k1)
+                .Write(hash.begin(), hash.size())
+                .Finalize();
+        }
+    };
+
+    typedef std::unordered_set<uint160, SaltedHash160Hasher> Hash160Set;
+    typedef std::unordered_set<uint256, SaltedTxidHasher> TxIdSet;
+
+    Hash160Set setKeyIds;
+    Hash160Set setScriptIds;
+    std::set<CScript> setWatchOnly;
+    std::shared_ptr<const TxIdSet> pTxIds;
+
+    //! Keystore sizes at the time of the snapshot.
+    size_t nKeys;
+    size_t nScripts;
+
+    static size_t CountKeys(const CWallet &wallet) {
+        return wallet.mapKeys.size() + wallet.mapCryptedKeys.size();
+    }
+
+    static size_t CountScripts(const CWallet &wallet) {
+        return wallet.mapScripts.size() + wallet.setWatchOnly.size();
+    }
+
+    bool MatchScript(const CScript &script) const {
+        if (MatchScriptIds(script,
+                           [this](const uint160 &id) {
+                               return setKeyIds.count(id) != 0;
+                           },
+                           [this](const uint160 &id) {
+                               return setScriptIds.count(id) != 0;
+                           })) {
+            return true;
+        }
+
+        return !setWatchOnly.empty() && setWatchOnly.count(script);
+    }
+
+    void SnapshotKeyStore(const CWallet &wallet) {
+        LOCK(wallet.cs_KeyStore);
+        for (const auto &entry : wallet.mapKeys) {
+            setKeyIds.insert(entry.first);
+        }
+        for (const auto &entry : wallet.mapCryptedKeys) {
+            setKeyIds.insert(entry.first);
+        }
+        for (const auto &entry : wallet.mapScripts) {
+            setScriptIds.insert(entry.first);
+        }
+        setWatchOnly = wallet.setWatchOnly;
+        nKeys = CountKeys(wallet);
+        nScripts = CountScripts(wallet);
+    }
+
+public:
+    explicit CWalletScanFilter(const CWallet &wallet) {
+        AssertLockHeld(wallet.cs_wallet);
+        SnapshotKeyStore(wallet);
+
+        // Transactions already in the wallet get updated, and anything
+        // spending the same outputs as them might be a conflict.
+        std::shared_ptr<TxIdSet> txids = std::make_shared<TxIdSet>();
+        txids->reserve(wallet.mapWallet.size());
+        for (const auto &entry : wallet.mapWallet) {
+            txids->insert(entry.first);
+        }
+        for (const auto &entry : wallet.mapTxSpends) {
+            txids->insert(entry.first.GetTxId());
+        }
+        pTxIds = txids;
+    }
+
+    CWalletScanFilter(const CWallet &wallet, const CWalletScanFilter &prev)
+        : pTxIds(prev.pTxIds) {
+        AssertLockHeld(wallet.cs_wallet);
+        SnapshotKeyStore(wallet);
+    }
+
+    bool IsStale(const CWallet &wallet) const {
+        LOCK(wallet.cs_KeyStore);
+        return CountKeys(wallet) != nKeys || CountScripts(wallet) != nScripts;
+    }
+
+    bool Match(const CTransaction &tx) const {
+        if (pTxIds->count(tx.GetId())) {
+            return true;
+        }
+
+        for (const CTxOut &txout : tx.vout) {
+            if (MatchScript(txout.scriptPubKey)) {
+                return true;
+            }
+        }
+
+        if (tx.IsCoinBase()) {
+            return false;
+        }
+
+        for (const CTxIn &txin : tx.vin) {
+            if (pTxIds->count(txin.prevout.GetTxId())) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+namespace {
+
+/**
+ * Reads and matches blocks for ScanForWalletTransactions() on worker threads,
+ * running a bounded number of blocks ahead of the caller which consumes them
+ * in chain order.
+ */
+class CWalletRescanPipeline {
+public:
+    struct Result {
+        CBlock block;
+        bool fRead;
+        //! The filter vMatches was computed with.
+        std::shared_ptr<const CWalletScanFilter> filter;
+        //! Positions in the block of the transactions the filter matched.
+        std::vector<size_t> vMatches;
+    };
+
+private:
+    const std::vector<CBlockIndex *> &vBlocks;
+    std::vector<CDiskBlockPos> vBlockPos;
+
+    std::mutex cs;
+    std::condition_variable cond;
+    std::shared_ptr<const CWalletScanFilter> filter;
+    //! Ring of results, indexed by position in vBlocks.
+    std::vector<std::unique_ptr<Result>> vResults;
+    size_t nNextRead;
+    size_t nNextConsume;
+    bool fStop;
+
+    std::vector<std::thread> vThreads;
+
+    void ThreadWorker() {
+        RenameThread("bitcoin-rescan");
+        std::unique_lock<std::mutex> lock(cs);
+        while (true) {
+            cond.wait(lock, [this] {
+                return fStop || nNextRead >= vBlocks.size() ||
+                       nNextRead < nNextConsume + vResults.size();
+            });
+            if (fStop || nNextRead >= vBlocks.size()) {
+                return;
+            }
+
+            const size_t i = nNextRead++;
+            std::unique_ptr<Result> result(new Result);
+            result->filter = filter;
+            lock.unlock();
+
+            result->fRead =
+                ReadBlockFromDisk(result->block, vBlockPos[i], GetConfig());
+            if (result->fRead &&
+                result->block.GetHash() != vBlocks[i]->GetBlockHash()) {
+                result->fRead =
+                    error("%s: GetHash() doesn't match index for %s at %s",
+                          __func__, vBlocks[i]->ToString(),
+                          vBlockPos[i].ToString());
+            }
+            if (result->fRead) {
+                const std::vector<CTransactionRef> &vtx = result->block.vtx;
+                for (size_t pos = 0; pos < vtx.size(); pos++) {
+                    if (result->filter->Match(*vtx[pos])) {
+                        result->vMatches.push_back(pos);
+                    }
+                }
+            }
+
+            lock.lock();
+            vResults[i % vResults.size()] = std::move(result);
+            cond.notify_all();
+        }
     }
 
-    // Sent/received.
-    for (unsigned int i = 0; i < tx->vout.size(); ++i) {
-        const CTxOut &txout = tx->vout[i];
-        isminetype fIsMine = pwallet->IsMine(txout);
-        // Only need to handle txouts if AT LEAST one of these is true:
-        //   1) they debit from us (sent)
-        //   2) the output is to us (received)
-        if (nDebit > Amount(0)) {
-            // Don't report 'change' txouts
-            if (pwallet->IsChange(txout)) {
-                continue;
-            }
-        } else if (!(fIsMine & filter)) {
-            continue;
+public:
+    /**
+     * Start reading vBlocksIn. Must be called with cs_main held, and the
+     * blocks must stay valid until the pipeline is destroyed.
+     */
+    CWalletRescanPipeline(const std::vector<CBlockIndex *> &vBlocksIn,
+                          std::shared_ptr<const CWalletScanFilter> filterIn)
+        : vBlocks(vBlocksIn), filter(std::move(filterIn)), nNextRead(0),
+          nNextConsume(0), fStop(false) {
+        AssertLockHeld(cs_main);
+        vBlockPos.reserve(vBlocks.size());
+        for (const CBlockIndex *pindex : vBlocks) {
+            vBlockPos.push_back(pindex->GetBlockPos());
         }
 
-        // In either case, we need to get the destination address.
-        CTxDestination address;
+        const int nThreads = std::max(
+            1, std::min<int>(GetNumCores(), MAX_RESCAN_THREADS));
+        vResults.resize(2 * nThreads);
+        for (int i = 0; i < nThreads; i++) {
+            vThreads.emplace_back(&CWalletRescanPipeline::ThreadWorker, this);
+        }
+    }
 
-        if (!ExtractDestination(txout.scriptPubKey, address) &&
-            !txout.scriptPubKey.IsUnspendable()) {
-            LogPrintf("CWalletTx::GetAmounts: Unknown transaction type found, "
-                      "txid %s\n",
-                      this->GetId().ToString());
-            address = CNoDestination();
+    ~CWalletRescanPipeline() {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fStop = true;
         }
+        cond.notify_all();
+        for (std::thread &thread : vThreads) {
+            thread.join();
+        }
+    }
 
-        COutputEntry output = {address, txout.nValue, (int)i};
+    /** Wait for the next block, in the order of vBlocks. */
+    std::unique_ptr<Result> Next() {
+        std::unique_lock<std::mutex> lock(cs);
+        std::unique_ptr<Result> &slot =
+            vResults[nNextConsume % vResults.size()];
+        cond.wait(lock, [&slot] { return slot != nullptr; });
+        std::unique_ptr<Result> result = std::move(slot);
+        nNextConsume++;
+        cond.notify_all();
+        return result;
+    }
 
-        // If we are debited by the transaction, add the output as a "sent"
-        // entry.
-        if (nDebit > Amount(0)) {
-            listSent.push_back(output);
-        }
+    /** Match blocks which aren't being worked on yet against filterIn. */
+    void SetFilter(std::shared_ptr<const CWalletScanFilter> filterIn) {
+        std::lock_guard<std::mutex> lock(cs);
+        filter = std::move(filterIn);
+    }
+};
 
-        // If we are receiving the output, add it as a "received" entry.
-        if (fIsMine & filter) {
-            listReceived.push_back(output);
+bool SpendsAnyOf(const CTransaction &tx,
+                 const std::unordered_set<uint256, SaltedTxidHasher> &txids) {
+    if (tx.IsCoinBase()) {
+        return false;
+    }
+
+    for (const CTxIn &txin : tx.vin) {
+        if (txids.count(txin.prevout.GetTxId())) {
+            return true;
         }
     }
+
+    return false;
 }
 
+} // namespace
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions from or to
  * us. If fUpdate is true, found transactions that already exist in the wallet
  * will be updated.
  *
+ * Blocks are read and matched against a CWalletScanFilter by worker threads
+ * ahead of this one, which hands the candidate transactions to
+ * AddToWalletIfInvolvingMe in chain order. cs_main and cs_wallet are only
+ * taken to snapshot the chain and to add the candidates of each block, so
+ * this must be called without them held. Blocks connected after the snapshot
+ * are left to the BlockConnected notifications.
+ *
  * Returns pointer to the first block in the last contiguous range that was
  * successfully scanned or elided (elided if pIndexStart points at a block
  * before CWallet::nTimeFirstKey). Returns null if there is no such range, or
- * the range doesn't include chainActive.Tip().
+ * the range doesn't include chainActive.Tip() (e.g. the scan was aborted).
  */
 CBlockIndex *CWallet::ScanForWalletTransactions(CBlockIndex *pindexStart,
                                                 bool fUpdate) {
-    LOCK2(cs_main, cs_wallet);
+    LOCK(cs_rescan);
+    fAbortRescan = false;
+    nScanningStart = GetTimeMillis();
+    dScanningProgress = 0;
+    fScanningWallet = true;
 
     int64_t nNow = GetTime();
 
     CBlockIndex *pindex = pindexStart;
     CBlockIndex *ret = pindexStart;
 
-    // No need to read and scan block, if block was created before our wallet
-    // birthday (as adjusted for block time variability)
-    while (pindex && nTimeFirstKey &&
-           (pindex->GetBlockTime() < (nTimeFirstKey - 7200))) {
-        pindex = chainActive.Next(pindex);
-    }
-
-    // Show rescan progress in GUI as dialog or on splashscreen, if -rescan on
-    // startup.
-    ShowProgress(_("Rescanning..."), 0);
-    double dProgressStart =
-        GuessVerificationProgress(chainParams.TxData(), pindex);
-    double dProgressTip =
-        GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
-    while (pindex) {
-        if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0) {
-            ShowProgress(
-                _("Rescanning..."),
-                std::max(1,
-                         std::min(99, (int)((GuessVerificationProgress(
-                                                 chainParams.TxData(), pindex) -
-                                             dProgressStart) /
-                                            (dProgressTip - dProgressStart) *
-                                            100))));
+    std::vector<CBlockIndex *> vBlocks;
+    double dProgressStart;
+    double dProgressTip;
+    std::shared_ptr<const CWalletScanFilter> filter;
+    std::unique_ptr<CWalletRescanPipeline> pipeline;
+    {
+        LOCK2(cs_main, cs_wallet);
+
+        // No need to read and scan block, if block was created before our
+        // wallet birthday (as adjusted for block time variability)
+        while (pindex && nTimeFirstKey &&
+               (pindex->GetBlockTime() < (nTimeFirstKey - 7200))) {
+            pindex = chainActive.Next(pindex);
+        }
+
+        for (; pindex; pindex = chainActive.Next(pindex)) {
+            vBlocks.push_back(pindex);
+        }
+
+        // Show rescan progress in GUI as dialog or on splashscreen, if -rescan
+        // on startup.
+        ShowProgress(_("Rescanning..."), 0);
+        dProgressStart = GuessVerificationProgress(
+            chainParams.TxData(), vBlocks.empty() ? nullptr : vBlocks.front());
+        dProgressTip =
+            GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
+
+        filter = std::make_shared<const CWalletScanFilter>(*this);
+        pipeline.reset(new CWalletRescanPipeline(vBlocks, filter));
+    }
+
+    // Transactions added by this scan, which the filter doesn't know about.
+    std::unordered_set<uint256, SaltedTxidHasher> setScannedTxIds;
+    std::vector<bool> vMatch;
+    size_t i = 0;
+    for (; i < vBlocks.size() && !fAbortRescan; i++) {
+        pindex = vBlocks[i];
+        if (dProgressTip - dProgressStart > 0.0) {
+            dScanningProgress =
+                (GuessVerificationProgress(chainParams.TxData(), pindex) -
+                 dProgressStart) /
+                (dProgressTip - dProgressStart);
+            if (pindex->nHeight % 100 == 0) {
+                ShowProgress(
+                    _("Rescanning..."),
+                    std::max(1, std::min(99, (int)(dScanningProgress * 100))));
+            }
         }
 
-        CBlock block;
-        if (ReadBlockFromDisk(block, pindex, GetConfig())) {
-            for (size_t posInBlock = 0; posInBlock < block.vtx.size();
-                 ++posInBlock) {
-                AddToWalletIfInvolvingMe(block.vtx[posInBlock], pindex,
-                                         posInBlock, fUpdate);
+        std::unique_ptr<CWalletRescanPipeline::Result> result =
+            pipeline->Next();
+        if (!result->fRead) {
+            ret = nullptr;
+            continue;
+        }
+
+        // The keystore may have changed since the worker matched the block,
+        // in which case it has to be done again.
+        if (filter->IsStale(*this)) {
+            LOCK(cs_wallet);
+            filter =
+                std::make_shared<const CWalletScanFilter>(*this, *filter);
+            pipeline->SetFilter(filter);
+        }
+
+        // Only take the locks for blocks with candidates in them.
+        const std::vector<CTransactionRef> &vtx = result->block.vtx;
+        bool fCommit = result->filter == filter && !result->vMatches.empty();
+        for (size_t pos = 0; pos < vtx.size() && !fCommit; pos++) {
+            fCommit = (result->filter != filter && filter->Match(*vtx[pos])) ||
+                      (!setScannedTxIds.empty() &&
+                       SpendsAnyOf(*vtx[pos], setScannedTxIds));
+        }
+
+        if (fCommit) {
+            LOCK2(cs_main, cs_wallet);
+            // A block disconnected since the snapshot was taken is left to
+            // the BlockDisconnected and BlockConnected notifications.
+            if (!chainActive.Contains(pindex)) {
+                continue;
+            }
+
+            vMatch.assign(vtx.size(), false);
+            for (size_t pos : result->vMatches) {
+                vMatch[pos] = true;
             }
-            if (!ret) {
-                ret = pindex;
+
+            CWalletDBBatch batch(*this);
+            for (size_t posInBlock = 0; posInBlock < vtx.size();
+                 ++posInBlock) {
+                const CTransaction &tx = *vtx[posInBlock];
+                const bool fMatch = result->filter == filter
+                                        ? vMatch[posInBlock]
+                                        : filter->Match(tx);
+                if (!fMatch &&
+                    (setScannedTxIds.empty() ||
+                     !SpendsAnyOf(tx, setScannedTxIds))) {
+                    continue;
+                }
+
+                if (!AddToWalletIfInvolvingMe(vtx[posInBlock], pindex,
+                                              posInBlock, fUpdate)) {
+                    continue;
+                }
+                setScannedTxIds.insert(tx.GetId());
+
+                if (filter->IsStale(*this)) {
+                    filter = std::make_shared<const CWalletScanFilter>(
+                        *this, *filter);
+                    pipeline->SetFilter(filter);
+                }
             }
-        } else {
-            ret = nullptr;
         }
 
-        pindex = chainActive.Next(pindex);
+        if (!ret) {
+            ret = pindex;
+        }
+
         if (GetTime() >= nNow + 60) {
             nNow = GetTime();
             LogPrintf("Still rescanning. At block %d. Progress=%f\n",
@@ -1763,8 +2632,16 @@ CBlockIndex *CWallet::ScanForWalletTransactions(CBlockIndex *pindexStart,
         }
     }
 
+    if (i < vBlocks.size()) {
+        LogPrintf("Rescan aborted at block %d. Progress=%f\n",
+                  vBlocks[i]->nHeight,
+                  GuessVerificationProgress(chainParams.TxData(), vBlocks[i]));
+        ret = nullptr;
+    }
+
     // Hide progress dialog in GUI.
     ShowProgress(_("Rescanning..."), 100);
+    fScanningWallet = false;
 
     return ret;
 }
@@ -2127,92 +3004,51 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime,
  *
  * @{
  */
-Amount CWallet::GetBalance() const {
-    LOCK2(cs_main, cs_wallet);
-
-    Amount nTotal(0);
-    for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin();
-         it != mapWallet.end(); ++it) {
-        const CWalletTx *pcoin = &(*it).second;
-        if (pcoin->IsTrusted()) {
-            nTotal += pcoin->GetAvailableCredit();
+std::vector<const CWalletTx *> CWallet::GetUnspentOutputTxs() const {
+    AssertLockHeld(cs_wallet);
+    std::vector<const CWalletTx *> vTxs;
+    const uint256 *plast = nullptr;
+    for (const std::pair<const COutPoint, isminetype> &item :
+         GetUnspentOutputs()) {
+        // The outputs of a transaction are adjacent in the index.
+        if (plast && *plast == item.first.GetTxId()) {
+            continue;
         }
+        plast = &item.first.GetTxId();
+        vTxs.push_back(&mapWallet.at(*plast));
     }
 
-    return nTotal;
+    return vTxs;
 }
 
-Amount CWallet::GetUnconfirmedBalance() const {
+Amount CWallet::GetBalance() const {
     LOCK2(cs_main, cs_wallet);
+    return GetBalances().nTrusted;
+}
 
-    Amount nTotal(0);
-    for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin();
-         it != mapWallet.end(); ++it) {
-        const CWalletTx *pcoin = &(*it).second;
-        if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 &&
-            pcoin->InMempool()) {
-            nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-
-    return nTotal;
+Amount CWallet::GetUnconfirmedBalance() const {
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nUnconfirmed;
 }
 
 Amount CWallet::GetImmatureBalance() const {
     LOCK2(cs_main, cs_wallet);
-
-    Amount nTotal(0);
-    for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin();
-         it != mapWallet.end(); ++it) {
-        const CWalletTx *pcoin = &(*it).second;
-        nTotal += pcoin->GetImmatureCredit();
-    }
-
-    return nTotal;
+    return GetBalances().nImmature;
 }
 
 Amount CWallet::GetWatchOnlyBalance() const {
     LOCK2(cs_main, cs_wallet);
-
-    Amount nTotal(0);
-    for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin();
-         it != mapWallet.end(); ++it) {
-        const CWalletTx *pcoin = &(*it).second;
-        if (pcoin->IsTrusted()) {
-            nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nWatchOnlyTrusted;
 }
 
 Amount CWallet::GetUnconfirmedWatchOnlyBalance() const {
     LOCK2(cs_main, cs_wallet);
-
-    Amount nTotal(0);
-    for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin();
-         it != mapWallet.end(); ++it) {
-        const CWalletTx *pcoin = &(*it).second;
-        if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 &&
-            pcoin->InMempool()) {
-            nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nWatchOnlyUnconfirmed;
 }
 
 Amount CWallet::GetImmatureWatchOnlyBalance() const {
     LOCK2(cs_main, cs_wallet);
-
-    Amount nTotal(0);
-    for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin();
-         it != mapWallet.end(); ++it) {
-        const CWalletTx *pcoin = &(*it).second;
-        nTotal += pcoin->GetImmatureWatchOnlyCredit();
-    }
-
-    return nTotal;
+    return GetBalances().nWatchOnlyImmature;
 }
 
 // Calculate total balance in a different way from GetBalance. The biggest
@@ -2267,10 +3103,17 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe,
     vCoins.clear();
 
     LOCK2(cs_main, cs_wallet);
-    for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin();
-         it != mapWallet.end(); ++it) {
-        const uint256 &wtxid = it->first;
-        const CWalletTx *pcoin = &(*it).second;
+    const std::map<COutPoint, isminetype> &unspent = GetUnspentOutputs();
+    std::map<COutPoint, isminetype>::const_iterator it = unspent.begin();
+    while (it != unspent.end()) {
+        const uint256 &wtxid = it->first.GetTxId();
+        const CWalletTx *pcoin = &mapWallet.at(wtxid);
+
+        // The outputs of a transaction are adjacent in the index.
+        std::map<COutPoint, isminetype>::const_iterator itOut = it;
+        while (it != unspent.end() && it->first.GetTxId() == wtxid) {
+            ++it;
+        }
 
         if (!CheckFinalTx(*pcoin)) {
             continue;
@@ -2318,14 +3161,14 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe,
             continue;
         }
 
-        for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
-            isminetype mine = IsMine(pcoin->tx->vout[i]);
-            if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                !IsLockedCoin((*it).first, i) &&
+        for (; itOut != it; ++itOut) {
+            const unsigned int i = itOut->first.GetN();
+            const isminetype mine = itOut->second;
+            if (!(IsSpent(wtxid, i)) && !IsLockedCoin(wtxid, i) &&
                 (pcoin->tx->vout[i].nValue > Amount(0) || fIncludeZeroValue) &&
                 (!coinControl || !coinControl->HasSelected() ||
                  coinControl->fAllowOtherInputs ||
-                 coinControl->IsSelected(COutPoint((*it).first, i)))) {
+                 coinControl->IsSelected(itOut->first))) {
                 vCoins.push_back(COutput(
                     pcoin, i, nDepth,
                     ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
@@ -2381,6 +3224,124 @@ static void ApproximateBestSubset(
     }
 }
 
+/**
+ * Deterministic depth-first search for a subset of vValue, which must be
+ * sorted by decreasing value, adding up to exactly nTargetValue. Branches
+ * that can no longer reach the target, or that overshoot it, are cut, as are
+ * those which only differ from an already explored one by swapping coins of
+ * equal value. Gives up after nMaxTries steps.
+ */
+static bool SelectCoinsBnB(
+    const std::vector<
+        std::pair<Amount, std::pair<const CWalletTx *, unsigned int>>> &vValue,
+    const Amount nTotalLower, const Amount nTargetValue,
+    std::vector<char> &vfBest, size_t nMaxTries = 100000) {
+    std::vector<char> vfSelected;
+    vfSelected.reserve(vValue.size());
+    Amount nSelected(0);
+    // Value of the coins which haven't been decided on yet.
+    Amount nAvailable = nTotalLower;
+
+    for (size_t nTries = 0; nTries < nMaxTries; nTries++) {
+        if (nSelected == nTargetValue) {
+            vfBest = vfSelected;
+            vfBest.resize(vValue.size(), false);
+            return true;
+        }
+
+        if (nSelected > nTargetValue ||
+            nSelected + nAvailable < nTargetValue) {
+            // Backtrack to the last coin included and explore the branch
+            // without it.
+            while (!vfSelected.empty() && !vfSelected.back()) {
+                vfSelected.pop_back();
+                nAvailable += vValue[vfSelected.size()].first;
+            }
+
+            if (vfSelected.empty()) {
+                // The whole tree has been explored.
+                return false;
+            }
+
+            vfSelected.back() = false;
+            nSelected -= vValue[vfSelected.size() - 1].first;
+            continue;
+        }
+
+        const size_t i = vfSelected.size();
+        nAvailable -= vValue[i].first;
+        // Including this coin when the previous one, of the same value, was
+        // left out would only lead to solutions already tried.
+        if (i > 0 && !vfSelected.back() &&
+            vValue[i].first == vValue[i - 1].first) {
+            vfSelected.push_back(false);
+        } else {
+            vfSelected.push_back(true);
+            nSelected += vValue[i].first;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Pick at most nMaxCoins of the coins in vValue, which must be sorted by
+ * decreasing value, for ApproximateBestSubset() to work on. The coins are
+ * grouped by order of magnitude of their value, and each group gets an even
+ * share of the picks, spread over its range of values from a random offset.
+ * The order of vValue is preserved.
+ */
+static void SampleCoinsByValue(
+    const std::vector<
+        std::pair<Amount, std::pair<const CWalletTx *, unsigned int>>> &vValue,
+    size_t nMaxCoins,
+    std::vector<std::pair<Amount, std::pair<const CWalletTx *, unsigned int>>>
+        &vSample) {
+    // Start of each group of coins with values of the same bit length, and
+    // the end of the last one.
+    std::vector<size_t> vBuckets;
+    int nLastBits = -1;
+    for (size_t i = 0; i < vValue.size(); i++) {
+        int nBits = 0;
+        for (int64_t n = vValue[i].first.GetSatoshis(); n > 0; n >>= 1) {
+            nBits++;
+        }
+        if (nBits != nLastBits) {
+            vBuckets.push_back(i);
+            nLastBits = nBits;
+        }
+    }
+    vBuckets.push_back(vValue.size());
+    const size_t nBuckets = vBuckets.size() - 1;
+
+    // Give each bucket an even share, handing what small value ones don't use
+    // over to the larger value ones.
+    std::vector<size_t> vShares(nBuckets);
+    size_t nLeft = nMaxCoins;
+    for (size_t b = nBuckets; b--;) {
+        vShares[b] =
+            std::min(vBuckets[b + 1] - vBuckets[b], nLeft / (b + 1));
+        nLeft -= vShares[b];
+    }
+
+    FastRandomContext insecure_rand;
+    vSample.clear();
+    vSample.reserve(nMaxCoins);
+    for (size_t b = 0; b < nBuckets; b++) {
+        if (vShares[b] == 0) {
+            continue;
+        }
+
+        const size_t nSize = vBuckets[b + 1] - vBuckets[b];
+        const size_t nStride = nSize / vShares[b];
+        size_t i = vBuckets[b] +
+                   insecure_rand.randrange(nSize - (vShares[b] - 1) * nStride);
+        for (size_t n = 0; n < vShares[b]; n++, i += nStride) {
+            vSample.push_back(vValue[i]);
+        }
+    }
+}
+
 bool CWallet::SelectCoinsMinConf(
     const Amount nTargetValue, const int nConfMine, const int nConfTheirs,
     const uint64_t nMaxAncestors, std::vector<COutput> vCoins,
@@ -2454,16 +3415,45 @@ bool CWallet::SelectCoinsMinConf(
         return true;
     }
 
-    // Solve subset sum by stochastic approximation
     std::sort(vValue.begin(), vValue.end(), CompareValueOnly());
     std::reverse(vValue.begin(), vValue.end());
     std::vector<char> vfBest;
     Amount nBest;
 
-    ApproximateBestSubset(vValue, nTotalLower, nTargetValue, vfBest, nBest);
-    if (nBest != nTargetValue && nTotalLower >= nTargetValue + MIN_CHANGE) {
-        ApproximateBestSubset(vValue, nTotalLower, nTargetValue + MIN_CHANGE,
-                              vfBest, nBest);
+    // Look for an exact match first, then solve subset sum by stochastic
+    // approximation. The cost of the latter grows with the number of coins, so
+    // it only gets to see a sample of them in large wallets.
+    if (SelectCoinsBnB(vValue, nTotalLower, nTargetValue, vfBest)) {
+        nBest = nTargetValue;
+    } else {
+        if (vValue.size() > MAX_APPROXIMATE_BEST_SUBSET_COINS) {
+            // The sample has to be able to make the target, so keep doubling
+            // it until it does. The coins all together always can, as
+            // nTotalLower >= nTargetValue here.
+            std::vector<
+                std::pair<Amount, std::pair<const CWalletTx *, unsigned int>>>
+                vSample;
+            for (size_t nSampleSize = MAX_APPROXIMATE_BEST_SUBSET_COINS;
+                 nSampleSize < vValue.size(); nSampleSize *= 2) {
+                SampleCoinsByValue(vValue, nSampleSize, vSample);
+                Amount nTotalSample(0);
+                for (const auto &coin : vSample) {
+                    nTotalSample += coin.first;
+                }
+                if (nTotalSample >= nTargetValue) {
+                    vValue.swap(vSample);
+                    nTotalLower = nTotalSample;
+                    break;
+                }
+            }
+        }
+
+        ApproximateBestSubset(vValue, nTotalLower, nTargetValue, vfBest, nBest);
+        if (nBest != nTargetValue &&
+            nTotalLower >= nTargetValue + MIN_CHANGE) {
+            ApproximateBestSubset(vValue, nTotalLower,
+                                  nTargetValue + MIN_CHANGE, vfBest, nBest);
+        }
     }
 
     // If we have a bigger coin and (either the stochastic approximation didn't
@@ -3186,13 +4176,7 @@ DBErrors CWallet::LoadWallet(bool &fFirstRunRet) {
                    mapWatchKeys.empty() && setWatchOnly.empty() &&
                    mapScripts.empty();
 
-    if (nLoadWalletRet != DB_LOAD_OK) {
-        return nLoadWalletRet;
-    }
-
-    uiInterface.LoadWallet(this);
-
-    return DB_LOAD_OK;
+    return nLoadWalletRet;
 }
 
 DBErrors CWallet::ZapSelectTx(std::vector<uint256> &vHashIn,
@@ -3203,6 +4187,9 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256> &vHashIn,
     for (uint256 hash : vHashOut) {
         mapWallet.erase(hash);
     }
+    fUnspentOutputsStale = true;
+    fTxHeightsStale = true;
+    fBalancesStale = true;
 
     if (nZapSelectTxRet == DB_NEED_REWRITE) {
         if (dbw->Rewrite("\x04pool")) {
@@ -3391,31 +4378,43 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize) {
         // don't create extra internal keys
         missingInternal = 0;
     }
-    bool internal = false;
+    // Large refills are written in as few database transactions as possible
+    // and generate their keys in chunks, to derive those in parallel.
+    static const int64_t KEYPOOL_CHUNK_SIZE = 1000;
+    CWalletDBBatch batch(*this);
     CWalletDB walletdb(*dbw);
-    for (int64_t i = missingInternal + missingExternal; i--;) {
-        if (i < missingInternal) {
-            internal = true;
-        }
-
-        // How in the hell did you use so many keys?
-        assert(m_max_keypool_index < std::numeric_limits<int64_t>::max());
-        int64_t index = ++m_max_keypool_index;
-
-        CPubKey pubkey(GenerateNewKey(walletdb, internal));
-        if (!walletdb.WritePool(index, CKeyPool(pubkey, internal))) {
-            throw std::runtime_error(std::string(__func__) +
-                                     ": writing generated key failed");
-        }
+    for (bool internal : {false, true}) {
+        int64_t missing = internal ? missingInternal : missingExternal;
+        while (missing > 0) {
+            const int64_t nKeys = std::min(missing, KEYPOOL_CHUNK_SIZE);
+            missing -= nKeys;
+            for (const CPubKey &pubkey :
+                 GenerateNewKeys(walletdb, nKeys, internal)) {
+                // How in the hell did you use so many keys?
+                assert(m_max_keypool_index <
+                       std::numeric_limits<int64_t>::max());
+                int64_t index = ++m_max_keypool_index;
+
+                if (!walletdb.WritePool(index, CKeyPool(pubkey, internal))) {
+                    throw std::runtime_error(std::string(__func__) +
+                                             ": writing generated key failed");
+                }
 
-        if (internal) {
-            setInternalKeyPool.insert(index);
-        } else {
-            setExternalKeyPool.insert(index);
+                if (internal) {
+                    setInternalKeyPool.insert(index);
+                } else {
+                    setExternalKeyPool.insert(index);
+                }
+                m_pool_key_to_index[pubkey.GetID()] = index;
+            }
+            batch.CommitIfFull();
         }
-        m_pool_key_to_index[pubkey.GetID()] = index;
     }
     if (missingInternal + missingExternal > 0) {
+        // Outputs already in the wallet may pay to the new keys, e.g. when
+        // an HD wallet is restored ahead of its keypool.
+        fUnspentOutputsStale = true;
+        fBalancesStale = true;
         LogPrintf(
             "keypool added %d keys (%d internal), size=%u (%u internal)\n",
             missingInternal + missingExternal, missingInternal,
@@ -4092,36 +5091,60 @@ std::string CWallet::GetWalletHelpString(bool showDebug) {
     return strUsage;
 }
 
-CWallet *CWallet::CreateWalletFromFile(const CChainParams &chainParams,
-                                       const std::string walletFile) {
+namespace {
+
+/** What ReadWalletFile() got out of a wallet file. */
+struct CWalletFileRead {
+    std::unique_ptr<CWallet> wallet;
+    DBErrors nZapRet = DB_LOAD_OK;
+    DBErrors nLoadRet = DB_LOAD_OK;
+    bool fFirstRun = true;
     // Needed to restore wallet transaction meta data after -zapwallettxes
     std::vector<CWalletTx> vWtx;
+};
 
-    if (gArgs.GetBoolArg("-zapwallettxes", false)) {
-        uiInterface.InitMessage(_("Zapping all transactions from wallet..."));
-
+/**
+ * Read a wallet file, after removing its transactions if fZap. Besides the
+ * wallet itself, this only touches the database environment and, on a bad
+ * transaction record, -rescan, which both have their own lock. So it can run
+ * for several wallets at once off the init thread. Errors are left for
+ * FinishLoadingWallet() to report.
+ */
+void ReadWalletFile(const CChainParams &chainParams,
+                    const std::string &walletFile, bool fZap,
+                    CWalletFileRead &read) {
+    if (fZap) {
         std::unique_ptr<CWalletDBWrapper> dbw(
             new CWalletDBWrapper(&bitdb, walletFile));
-        CWallet *tempWallet = new CWallet(chainParams, std::move(dbw));
-        DBErrors nZapWalletRet = tempWallet->ZapWalletTx(vWtx);
-        if (nZapWalletRet != DB_LOAD_OK) {
-            InitError(
-                strprintf(_("Error loading %s: Wallet corrupted"), walletFile));
-            return nullptr;
+        CWallet tempWallet(chainParams, std::move(dbw));
+        read.nZapRet = tempWallet.ZapWalletTx(read.vWtx);
+        if (read.nZapRet != DB_LOAD_OK) {
+            return;
         }
-
-        delete tempWallet;
-        tempWallet = nullptr;
     }
 
-    uiInterface.InitMessage(_("Loading wallet..."));
-
     int64_t nStart = GetTimeMillis();
-    bool fFirstRun = true;
     std::unique_ptr<CWalletDBWrapper> dbw(
         new CWalletDBWrapper(&bitdb, walletFile));
-    CWallet *walletInstance = new CWallet(chainParams, std::move(dbw));
-    DBErrors nLoadWalletRet = walletInstance->LoadWallet(fFirstRun);
+    read.wallet.reset(new CWallet(chainParams, std::move(dbw)));
+    read.nLoadRet = read.wallet->LoadWallet(read.fFirstRun);
+    LogPrintf(" wallet      %15dms\n", GetTimeMillis() - nStart);
+}
+
+/**
+ * The part of loading a wallet that comes after ReadWalletFile(), which
+ * reports its errors, upgrades the wallet and sets up new ones. Returns the
+ * wallet, or a null pointer in case of an error.
+ */
+CWallet *FinishLoadingWallet(const std::string &walletFile,
+                             CWalletFileRead &read) {
+    if (read.nZapRet != DB_LOAD_OK) {
+        InitError(
+            strprintf(_("Error loading %s: Wallet corrupted"), walletFile));
+        return nullptr;
+    }
+
+    const DBErrors nLoadWalletRet = read.nLoadRet;
     if (nLoadWalletRet != DB_LOAD_OK) {
         if (nLoadWalletRet == DB_CORRUPT) {
             InitError(
@@ -4149,8 +5172,12 @@ CWallet *CWallet::CreateWalletFromFile(const CChainParams &chainParams,
             InitError(strprintf(_("Error loading %s"), walletFile));
             return nullptr;
         }
+    } else {
+        uiInterface.LoadWallet(read.wallet.get());
     }
 
+    CWallet *const walletInstance = read.wallet.get();
+    const bool fFirstRun = read.fFirstRun;
     if (gArgs.GetBoolArg("-upgradewallet", fFirstRun)) {
         int nMaxVersion = gArgs.GetArg("-upgradewallet", 0);
         // The -upgradewallet without argument case
@@ -4194,6 +5221,7 @@ CWallet *CWallet::CreateWalletFromFile(const CChainParams &chainParams,
             return nullptr;
         }
 
+        LOCK(cs_main);
         walletInstance->SetBestChain(chainActive.GetLocator());
     } else if (gArgs.IsArgSet("-usehd")) {
         bool useHD = gArgs.GetBoolArg("-usehd", DEFAULT_USE_HD_WALLET);
@@ -4212,16 +5240,20 @@ CWallet *CWallet::CreateWalletFromFile(const CChainParams &chainParams,
         }
     }
 
-    LogPrintf(" wallet      %15dms\n", GetTimeMillis() - nStart);
+    return read.wallet.release();
+}
 
-    RegisterValidationInterface(walletInstance);
+} // namespace
+
+bool CWallet::CatchUpWithChain(const std::vector<CWalletTx> &vWtx) {
+    RegisterValidationInterface(this);
 
     // Try to top up keypool. No-op if the wallet is locked.
-    walletInstance->TopUpKeyPool();
+    TopUpKeyPool();
 
     CBlockIndex *pindexRescan = chainActive.Genesis();
     if (!gArgs.GetBoolArg("-rescan", false)) {
-        CWalletDB walletdb(*walletInstance->dbw);
+        CWalletDB walletdb(*dbw);
         CBlockLocator locator;
         if (walletdb.ReadBestBlock(locator)) {
             pindexRescan = FindForkInGlobalIndex(chainActive, locator);
@@ -4244,7 +5276,7 @@ CWallet *CWallet::CreateWalletFromFile(const CChainParams &chainParams,
                 InitError(_("Prune: last wallet synchronisation goes beyond "
                             "pruned data. You need to -reindex (download the "
                             "whole blockchain again in case of pruned node)"));
-                return nullptr;
+                return false;
             }
         }
 
@@ -4252,22 +5284,22 @@ CWallet *CWallet::CreateWalletFromFile(const CChainParams &chainParams,
         LogPrintf("Rescanning last %i blocks (from block %i)...\n",
                   chainActive.Height() - pindexRescan->nHeight,
                   pindexRescan->nHeight);
-        nStart = GetTimeMillis();
-        walletInstance->ScanForWalletTransactions(pindexRescan, true);
+        int64_t nStart = GetTimeMillis();
+        ScanForWalletTransactions(pindexRescan, true);
         LogPrintf(" rescan      %15dms\n", GetTimeMillis() - nStart);
-        walletInstance->SetBestChain(chainActive.GetLocator());
-        walletInstance->dbw->IncrementUpdateCounter();
+        SetBestChain(chainActive.GetLocator());
+        dbw->IncrementUpdateCounter();
 
         // Restore wallet transaction metadata after -zapwallettxes=1
         if (gArgs.GetBoolArg("-zapwallettxes", false) &&
             gArgs.GetArg("-zapwallettxes", "1") != "2") {
-            CWalletDB walletdb(*walletInstance->dbw);
+            CWalletDB walletdb(*dbw);
 
             for (const CWalletTx &wtxOld : vWtx) {
                 uint256 txid = wtxOld.GetId();
                 std::map<uint256, CWalletTx>::iterator mi =
-                    walletInstance->mapWallet.find(txid);
-                if (mi != walletInstance->mapWallet.end()) {
+                    mapWallet.find(txid);
+                if (mi != mapWallet.end()) {
                     const CWalletTx *copyFrom = &wtxOld;
                     CWalletTx *copyTo = &mi->second;
                     copyTo->mapValue = copyFrom->mapValue;
@@ -4283,16 +5315,39 @@ CWallet *CWallet::CreateWalletFromFile(const CChainParams &chainParams,
         }
     }
 
-    walletInstance->SetBroadcastTransactions(
+    SetBroadcastTransactions(
         gArgs.GetBoolArg("-walletbroadcast", DEFAULT_WALLETBROADCAST));
 
-    LOCK(walletInstance->cs_wallet);
-    LogPrintf("setKeyPool.size() = %u\n", walletInstance->GetKeyPoolSize());
-    LogPrintf("mapWallet.size() = %u\n", walletInstance->mapWallet.size());
-    LogPrintf("mapAddressBook.size() = %u\n",
-              walletInstance->mapAddressBook.size());
+    LOCK(cs_wallet);
+    LogPrintf("setKeyPool.size() = %u\n", GetKeyPoolSize());
+    LogPrintf("mapWallet.size() = %u\n", mapWallet.size());
+    LogPrintf("mapAddressBook.size() = %u\n", mapAddressBook.size());
+
+    return true;
+}
+
+CWallet *CWallet::CreateWalletFromFile(const CChainParams &chainParams,
+                                       const std::string walletFile) {
+    const bool fZap = gArgs.GetBoolArg("-zapwallettxes", false);
+    if (fZap) {
+        uiInterface.InitMessage(_("Zapping all transactions from wallet..."));
+    }
+    uiInterface.InitMessage(_("Loading wallet..."));
+
+    CWalletFileRead read;
+    ReadWalletFile(chainParams, walletFile, fZap, read);
+    std::unique_ptr<CWallet> walletInstance(
+        FinishLoadingWallet(walletFile, read));
+    if (!walletInstance) {
+        return nullptr;
+    }
+
+    if (!walletInstance->CatchUpWithChain(read.vWtx)) {
+        UnregisterValidationInterface(walletInstance.get());
+        return nullptr;
+    }
 
-    return walletInstance;
+    return walletInstance.release();
 }
 
 bool CWallet::InitLoadWallet(const CChainParams &chainParams) {
@@ -4301,12 +5356,47 @@ bool CWallet::InitLoadWallet(const CChainParams &chainParams) {
         return true;
     }
 
-    for (const std::string &walletFile : gArgs.GetArgs("-wallet")) {
-        CWallet *const pwallet = CreateWalletFromFile(chainParams, walletFile);
-        if (!pwallet) {
+    const bool fZap = gArgs.GetBoolArg("-zapwallettxes", false);
+    if (fZap) {
+        uiInterface.InitMessage(_("Zapping all transactions from wallet..."));
+    }
+    uiInterface.InitMessage(_("Loading wallet..."));
+
+    // Reading the wallet files, which is what takes most of the time for big
+    // wallets, doesn't depend on the chain, so they are all read at once.
+    // Everything else, from reporting errors to catching up with the chain,
+    // happens on this thread afterwards, one wallet after the other, as a
+    // rescan holds cs_main and uses all cores already. The wallets are only
+    // published in vpwallets once they have all caught up, as RPC reads it
+    // without a lock.
+    const std::vector<std::string> vWalletFiles = gArgs.GetArgs("-wallet");
+    std::vector<CWalletFileRead> vRead(vWalletFiles.size());
+    ParallelFor(vWalletFiles.size(),
+                [&](size_t i) {
+                    ReadWalletFile(chainParams, vWalletFiles[i], fZap,
+                                   vRead[i]);
+                },
+                1);
+
+    std::vector<std::unique_ptr<CWallet>> vLoaded;
+    for (size_t i = 0; i < vWalletFiles.size(); i++) {
+        vLoaded.emplace_back(FinishLoadingWallet(vWalletFiles[i], vRead[i]));
+        if (!vLoaded.back()) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < vLoaded.size(); i++) {
+        if (!vLoaded[i]->CatchUpWithChain(vRead[i].vWtx)) {
+            for (size_t j = 0; j <= i; j++) {
+                UnregisterValidationInterface(vLoaded[j].get());
+            }
             return false;
         }
-        vpwallets.push_back(pwallet);
+    }
+
+    for (std::unique_ptr<CWallet> &pwallet : vLoaded) {
+        vpwallets.push_back(pwallet.release());
     }
 
     return true;
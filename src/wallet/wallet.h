@@ -13,6 +13,7 @@
 #include "tinyformat.h"
 #include "ui_interface.h"
 #include "utilstrencodings.h"
+#include "utiltime.h"
 #include "validationinterface.h"
 #include "wallet/crypter.h"
 #include "wallet/rpcwallet.h"
@@ -23,6 +24,7 @@
 #include <algorithm>
 #include <atomic>
 #include <cstdint>
+#include <limits>
 #include <map>
 #include <set>
 #include <stdexcept>
@@ -51,6 +53,8 @@ static const Amount DEFAULT_TRANSACTION_MINFEE(1000);
 static const Amount WALLET_INCREMENTAL_RELAY_FEE(5000);
 //! target minimum change amount
 static const Amount MIN_CHANGE = CENT;
+//! Coins ApproximateBestSubset() is run on at most when selecting coins
+static const size_t MAX_APPROXIMATE_BEST_SUBSET_COINS = 1000;
 //! final minimum change amount after paying for fees
 static const Amount MIN_FINAL_CHANGE = MIN_CHANGE / 2;
 //! Default for -spendzeroconfchange
@@ -65,6 +69,10 @@ static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
 //! if set, all keys will be derived by using BIP32
 static const bool DEFAULT_USE_HD_WALLET = true;
+//! Maximum number of threads reading and matching blocks during a rescan
+static const int MAX_RESCAN_THREADS = 8;
+//! Height index key of the wallet transactions not confirmed in the chain
+static const int TX_HEIGHT_UNCONFIRMED = std::numeric_limits<int>::max();
 
 extern const char *DEFAULT_WALLET_DAT;
 
@@ -76,6 +84,7 @@ class CReserveKey;
 class CScript;
 class CScheduler;
 class CTxMemPool;
+class CWalletScanFilter;
 class CWalletTx;
 
 /** (client) version numbers for particular wallet features */
@@ -585,6 +594,53 @@ private:
     std::vector<char> _ssExtra;
 };
 
+/**
+ * Compact probabilistic filter over the key ids, script ids, watch-only
+ * scripts and transaction ids of a wallet. Match() never rejects a transaction
+ * that IsMine() or IsFromMe() accept, or that spends the same outputs as a
+ * wallet transaction, but lets through about one in a thousand of the others.
+ *
+ * This is a blocked bloom filter: all the bits of an entry are in the same 512
+ * bit block, so a lookup costs a single cache miss however large the wallet.
+ */
+class CWalletTxPrefilter {
+private:
+    static const unsigned int BLOCK_WORDS = 8;
+    static const unsigned int BITS_PER_ENTRY = 16;
+    static const unsigned int HASH_FUNCS = 8;
+
+    std::vector<uint64_t> vData;
+    uint64_t k0, k1;
+    size_t nEntries;
+    size_t nMaxEntries;
+    bool fHaveWatchOnly;
+
+    uint64_t HashId(const uint160 &id) const;
+    uint64_t HashScript(const CScript &script) const;
+    size_t GetBlockOffset(uint64_t hash) const;
+    void InsertHash(uint64_t hash);
+    bool ContainsHash(uint64_t hash) const;
+
+public:
+    //! Sized for nMaxEntriesIn entries, see IsFull().
+    explicit CWalletTxPrefilter(size_t nMaxEntriesIn = 0);
+
+    //! Insert a key id or script id.
+    void Insert(const uint160 &id);
+    //! Insert a watch-only script.
+    void Insert(const CScript &script);
+    //! Insert a transaction id.
+    void Insert(const uint256 &txid);
+
+    //! Whether the filter holds more entries than it was sized for, past
+    //! which its false positive rate degrades.
+    bool IsFull() const { return nEntries > nMaxEntries; }
+
+    bool MatchScript(const CScript &script) const;
+    bool MatchTxId(const uint256 &txid) const;
+    bool Match(const CTransaction &tx) const;
+};
+
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of
  * transactions and balances, and provides the ability to create new
@@ -592,7 +648,16 @@ private:
  */
 class CWallet final : public CCryptoKeyStore, public CValidationInterface {
 private:
+    friend class CWalletScanFilter;
+
     static std::atomic<bool> fFlushScheduled;
+    std::atomic<bool> fAbortRescan;
+    //! Serializes ScanForWalletTransactions(), which doesn't hold cs_wallet.
+    CCriticalSection cs_rescan;
+    // controlled by ScanForWalletTransactions
+    std::atomic<bool> fScanningWallet;
+    std::atomic<int64_t> nScanningStart;
+    std::atomic<double> dScanningProgress;
 
     /**
      * Select a set of coins such that nValueRet >= nTargetValue and at least
@@ -633,6 +698,126 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /**
+     * Index of the wallet outputs that are mine and were unspent when last
+     * looked at, with their cached IsMine() result. Every unspent output of
+     * ours is in there, so AvailableCoins() and the balance queries only need
+     * to visit these instead of all of mapWallet. The reverse does not hold:
+     * an output whose conflicted spend gets reorged back in stays listed, so
+     * readers must still check IsSpent().
+     *
+     * The index is rebuilt from scratch on first use after MarkDirty(), which
+     * is what callers changing the keystore already invoke, or after
+     * TopUpKeyPool() added keys.
+     */
+    mutable std::map<COutPoint, isminetype> mapUnspentOutputs;
+    mutable bool fUnspentOutputsStale;
+    void UpdateUnspentOutput(const COutPoint &outpoint) const;
+    void UpdateUnspentOutputs(const CWalletTx &wtx) const;
+    const std::map<COutPoint, isminetype> &GetUnspentOutputs() const;
+    //! The distinct transactions having an output in mapUnspentOutputs.
+    std::vector<const CWalletTx *> GetUnspentOutputTxs() const;
+
+    /**
+     * Index of the wallet transactions by the height of the active chain block
+     * they are confirmed in, or TX_HEIGHT_UNCONFIRMED for those that are not
+     * (unconfirmed, conflicted, abandoned or in a block that got
+     * disconnected), so listsinceblock can seek to the transactions above a
+     * given block. mapTxHeight holds the key each transaction is indexed
+     * under.
+     *
+     * Like mapUnspentOutputs, the index is rebuilt from scratch on first use
+     * after it got marked stale, which is the case after loading the wallet.
+     */
+    mutable std::set<std::pair<int, uint256>> setTxByHeight;
+    mutable std::map<uint256, int> mapTxHeight;
+    mutable bool fTxHeightsStale;
+    void UpdateTxHeight(const CWalletTx &wtx) const;
+    const std::set<std::pair<int, uint256>> &GetTxHeights() const;
+
+    //! The balances of the wallet, or a transaction's share of them.
+    struct Balances {
+        Amount nTrusted;
+        Amount nUnconfirmed;
+        Amount nImmature;
+        Amount nWatchOnlyTrusted;
+        Amount nWatchOnlyUnconfirmed;
+        Amount nWatchOnlyImmature;
+
+        Balances()
+            : nTrusted(0), nUnconfirmed(0), nImmature(0), nWatchOnlyTrusted(0),
+              nWatchOnlyUnconfirmed(0), nWatchOnlyImmature(0) {}
+
+        bool IsNull() const {
+            return nTrusted == Amount(0) && nUnconfirmed == Amount(0) &&
+                   nImmature == Amount(0) && nWatchOnlyTrusted == Amount(0) &&
+                   nWatchOnlyUnconfirmed == Amount(0) &&
+                   nWatchOnlyImmature == Amount(0);
+        }
+
+        Balances &operator+=(const Balances &b) {
+            nTrusted += b.nTrusted;
+            nUnconfirmed += b.nUnconfirmed;
+            nImmature += b.nImmature;
+            nWatchOnlyTrusted += b.nWatchOnlyTrusted;
+            nWatchOnlyUnconfirmed += b.nWatchOnlyUnconfirmed;
+            nWatchOnlyImmature += b.nWatchOnlyImmature;
+            return *this;
+        }
+
+        Balances &operator-=(const Balances &b) {
+            nTrusted -= b.nTrusted;
+            nUnconfirmed -= b.nUnconfirmed;
+            nImmature -= b.nImmature;
+            nWatchOnlyTrusted -= b.nWatchOnlyTrusted;
+            nWatchOnlyUnconfirmed -= b.nWatchOnlyUnconfirmed;
+            nWatchOnlyImmature -= b.nWatchOnlyImmature;
+            return *this;
+        }
+    };
+
+    /**
+     * Running totals of the balances of the wallet, and the share of each
+     * transaction in them, so the balance queries don't need to visit every
+     * transaction. setBalanceTxsToUpdate holds the transactions whose share
+     * is recomputed on the next query: those that changed state since the
+     * last one, and those whose share can change without the wallet being
+     * told, that is unconfirmed and conflicted transactions, as their mempool
+     * and lock time status follow the chain, and immature coinbases.
+     *
+     * Like mapUnspentOutputs, the totals are recomputed from scratch on first
+     * use after MarkDirty().
+     */
+    mutable Balances balancesTotal;
+    mutable std::map<uint256, Balances> mapTxBalances;
+    mutable std::set<uint256> setBalanceTxsToUpdate;
+    mutable bool fBalancesStale;
+    void UpdateTxBalances(const CWalletTx &wtx) const;
+    void UpdateTxBalance(const uint256 &txid) const;
+    const Balances &GetBalances() const;
+
+    /**
+     * Prefilter letting AddToWalletIfInvolvingMe() reject the transactions of
+     * the blocks and the mempool that are not ours without running IsMine()
+     * and IsFromMe() on them. Keys, scripts and transactions are added to it
+     * as the wallet gets them, and never removed.
+     *
+     * It is rebuilt from scratch on first use after it got marked stale,
+     * which is the case after loading the wallet and once it is full.
+     */
+    CWalletTxPrefilter txPrefilter;
+    bool fTxPrefilterStale;
+    const CWalletTxPrefilter &GetTxPrefilter();
+
+    template <typename T> void AddToTxPrefilter(const T &entry) {
+        LOCK(cs_wallet);
+        if (fTxPrefilterStale) {
+            return;
+        }
+        txPrefilter.Insert(entry);
+        fTxPrefilterStale = txPrefilter.IsFull();
+    }
+
     /**
      * Used by TransactionAddedToMemorypool/BlockConnected/Disconnected.
      * Should be called with pindexBlock and posInBlock if this is for a
@@ -645,9 +830,8 @@ private:
     /* the HD chain data model (external chain counters) */
     CHDChain hdChain;
 
-    /* HD derive new child key (on internal or external chain) */
-    void DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata &metadata,
-                           CKey &secret, bool internal = false);
+    /* HD derive the key at m/0'/0' (external) or m/0'/1' (internal chain) */
+    void DeriveChainChildKey(CExtKey &chainChildKey, bool internal);
 
     std::set<int64_t> setInternalKeyPool;
     std::set<int64_t> setExternalKeyPool;
@@ -738,6 +922,14 @@ public:
         m_max_keypool_index = 0;
         nTimeFirstKey = 0;
         fBroadcastTransactions = false;
+        fUnspentOutputsStale = true;
+        fTxHeightsStale = true;
+        fBalancesStale = true;
+        fTxPrefilterStale = true;
+        fAbortRescan = false;
+        fScanningWallet = false;
+        nScanningStart = 0;
+        dScanningProgress = 0;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -757,6 +949,18 @@ public:
 
     const CWalletTx *GetWalletTx(const uint256 &hash) const;
 
+    /**
+     * The transactions that are not confirmed in the active chain at or below
+     * nHeight, ordered by the height of the block they are in, unconfirmed
+     * ones last, then by txid. Starts after (nHeightAfter, txidAfter) if
+     * txidAfter is set, and stops after nMaxTxs transactions.
+     */
+    std::vector<const CWalletTx *> GetTxsAboveHeight(
+        int nHeight, int nHeightAfter = 0, const uint256 &txidAfter = uint256(),
+        size_t nMaxTxs = std::numeric_limits<size_t>::max()) const;
+    //! The key a transaction is indexed under by GetTxsAboveHeight().
+    int GetTxHeight(const uint256 &txid) const;
+
     //! check whether we are allowed to upgrade (or already support) to the
     //! named feature
     bool CanSupportFeature(enum WalletFeature wf) const {
@@ -796,13 +1000,24 @@ public:
      * Generate a new key
      */
     CPubKey GenerateNewKey(CWalletDB &walletdb, bool internal = false);
+    /**
+     * Generate nKeys new keys at once, deriving them and their public keys on
+     * several threads.
+     */
+    std::vector<CPubKey> GenerateNewKeys(CWalletDB &walletdb, size_t nKeys,
+                                         bool internal = false);
     //! Adds a key to the store, and saves it to disk.
     bool AddKeyPubKey(const CKey &key, const CPubKey &pubkey) override;
     bool AddKeyPubKeyWithDB(CWalletDB &walletdb, const CKey &key,
                             const CPubKey &pubkey);
     //! Adds a key to the store, without saving it to disk (used by LoadWallet)
     bool LoadKey(const CKey &key, const CPubKey &pubkey) {
-        return CCryptoKeyStore::AddKeyPubKey(key, pubkey);
+        if (!CCryptoKeyStore::AddKeyPubKey(key, pubkey)) {
+            return false;
+        }
+
+        AddToTxPrefilter(pubkey.GetID());
+        return true;
     }
 
     //! Load metadata (used by LoadWallet)
@@ -886,6 +1101,17 @@ public:
                                   bool fUpdate);
     CBlockIndex *ScanForWalletTransactions(CBlockIndex *pindexStart,
                                            bool fUpdate = false);
+    void AbortRescan() { fAbortRescan = true; }
+    bool IsAbortingRescan() { return fAbortRescan; }
+    bool IsScanning() { return fScanningWallet; }
+    /** Milliseconds the running rescan has taken so far, if any. */
+    int64_t ScanningDuration() const {
+        return fScanningWallet ? GetTimeMillis() - nScanningStart : 0;
+    }
+    /** Fraction of the running rescan that is done, if any. */
+    double ScanningProgress() const {
+        return fScanningWallet ? (double)dScanningProgress : 0;
+    }
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime,
                                   CConnman *connman) override;
@@ -1004,6 +1230,10 @@ public:
     Amount GetChange(const CTransaction &tx) const;
     void SetBestChain(const CBlockLocator &loc) override;
 
+    /**
+     * Read the wallet from its database. Safe to call off the init thread,
+     * so it leaves signalling uiInterface.LoadWallet to the caller.
+     */
     DBErrors LoadWallet(bool &fFirstRunRet);
     DBErrors ZapWalletTx(std::vector<CWalletTx> &vWtx);
     DBErrors ZapSelectTx(std::vector<uint256> &vHashIn,
@@ -1112,6 +1342,13 @@ public:
      */
     static CWallet *CreateWalletFromFile(const CChainParams &chainParams,
                                          const std::string walletFile);
+    /**
+     * The part of CreateWalletFromFile() that depends on the chain: registers
+     * the wallet for validation notifications and rescans the blocks it
+     * missed. vWtx holds the transactions removed by -zapwallettxes. Returns
+     * false in case of an error.
+     */
+    bool CatchUpWithChain(const std::vector<CWalletTx> &vWtx);
     static bool InitLoadWallet(const CChainParams &chainParams);
 
     /**
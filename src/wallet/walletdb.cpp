@@ -894,3 +894,33 @@ bool CWalletDB::ReadVersion(int &nVersion) {
 bool CWalletDB::WriteVersion(int nVersion) {
     return batch.WriteVersion(nVersion);
 }
+
+CWalletDBBatch::CWalletDBBatch(CWallet &wallet)
+    : db(wallet.GetDBHandle()), m_dbw(wallet.GetDBHandle()), fActive(false),
+      nCommittedCounter(m_dbw.nUpdateCounter) {
+    AssertLockHeld(wallet.cs_wallet);
+    fActive = db.BatchBegin();
+}
+
+CWalletDBBatch::~CWalletDBBatch() {
+    if (fActive && !db.BatchCommit()) {
+        LogPrintf("%s: Batch to %s failed and was aborted\n", __func__,
+                  m_dbw.GetName());
+    }
+}
+
+bool CWalletDBBatch::CommitIfFull() {
+    if (!fActive ||
+        m_dbw.nUpdateCounter - nCommittedCounter < MAX_WALLETDB_BATCH_WRITES) {
+        return true;
+    }
+
+    nCommittedCounter = m_dbw.nUpdateCounter;
+    if (!db.BatchCommit()) {
+        fActive = false;
+        return false;
+    }
+
+    fActive = db.BatchBegin();
+    return fActive;
+}
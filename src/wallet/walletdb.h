@@ -38,6 +38,8 @@
  */
 
 static const bool DEFAULT_FLUSHWALLET = true;
+//! Writes after which CWalletDBBatch::CommitIfFull() starts a new transaction
+static const unsigned int MAX_WALLETDB_BATCH_WRITES = 10000;
 
 class CAccount;
 class CAccountingEntry;
@@ -270,6 +272,43 @@ private:
     void operator=(const CWalletDB &);
 };
 
+/**
+ * Groups the writes made to a wallet database while it exists, through any
+ * CWalletDB handle opened on the same thread, into a single database
+ * transaction which is committed and flushed to disk once, instead of once per
+ * handle. Meant for bulk operations such as keypool refills, imports and
+ * rescans. If any of the writes fails, the whole batch is aborted instead.
+ *
+ * Batches don't nest: an inner one does nothing and leaves it to the
+ * outermost one. Handles on other threads, such as the one recording the best
+ * block, keep out of the batch. It must be created with cs_wallet held.
+ */
+class CWalletDBBatch {
+private:
+    CDB db;
+    CWalletDBWrapper &m_dbw;
+    //! Whether this is the outermost batch.
+    bool fActive;
+    //! Update counter of the database at the last commit.
+    unsigned int nCommittedCounter;
+
+    CWalletDBBatch(const CWalletDBBatch &);
+    void operator=(const CWalletDBBatch &);
+
+public:
+    explicit CWalletDBBatch(CWallet &wallet);
+    ~CWalletDBBatch();
+
+    /**
+     * Commit what was written so far and carry on in a new transaction if
+     * more than MAX_WALLETDB_BATCH_WRITES writes went into the current one,
+     * which keeps the locks held by huge batches within bounds. Only call in
+     * between operations, with no cursor or explicit transaction open.
+     * Returns false if the batch failed, after which it is over.
+     */
+    bool CommitIfFull();
+};
+
 //! Compacts BDB state so that wallet.dat is self-contained (if there are
 //! changes)
 void MaybeCompactWalletDB();
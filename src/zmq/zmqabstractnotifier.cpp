@@ -9,7 +9,9 @@ CZMQAbstractNotifier::~CZMQAbstractNotifier() {
     assert(!psocket);
 }
 
-bool CZMQAbstractNotifier::NotifyBlock(const CBlockIndex * /*CBlockIndex*/) {
+bool CZMQAbstractNotifier::NotifyBlock(
+    const CBlockIndex * /*CBlockIndex*/,
+    const std::shared_ptr<const CBlock> & /*pblock*/) {
     return true;
 }
 
@@ -17,3 +19,24 @@ bool CZMQAbstractNotifier::NotifyTransaction(
     const CTransaction & /*transaction*/) {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyBlockConnect(const uint256 & /*blockhash*/,
+                                              uint64_t /*nMempoolSequence*/) {
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyBlockDisconnect(
+    const uint256 & /*blockhash*/, uint64_t /*nMempoolSequence*/) {
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyTransactionAcceptance(
+    const CTransaction & /*transaction*/, uint64_t /*nMempoolSequence*/) {
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyTransactionRemoval(
+    const CTransaction & /*transaction*/, MemPoolRemovalReason /*reason*/,
+    uint64_t /*nMempoolSequence*/) {
+    return true;
+}
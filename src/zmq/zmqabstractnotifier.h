@@ -7,8 +7,13 @@
 
 #include "zmqconfig.h"
 
+#include <cstdint>
+#include <memory>
+
 class CBlockIndex;
 class CZMQAbstractNotifier;
+class uint256;
+enum class MemPoolRemovalReason;
 
 typedef CZMQAbstractNotifier *(*CZMQNotifierFactory)();
 
@@ -29,9 +34,28 @@ public:
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
+    /**
+     * Notify about a new tip. pblock is the tip block if it is still in
+     * memory, otherwise null.
+     */
+    virtual bool NotifyBlock(const CBlockIndex *pindex,
+                             const std::shared_ptr<const CBlock> &pblock);
     virtual bool NotifyTransaction(const CTransaction &transaction);
 
+    /**
+     * Mempool sequence events: nMempoolSequence is the sequence number of the
+     * mempool change for transactions, and the current one for blocks.
+     */
+    virtual bool NotifyBlockConnect(const uint256 &blockhash,
+                                    uint64_t nMempoolSequence);
+    virtual bool NotifyBlockDisconnect(const uint256 &blockhash,
+                                       uint64_t nMempoolSequence);
+    virtual bool NotifyTransactionAcceptance(const CTransaction &transaction,
+                                             uint64_t nMempoolSequence);
+    virtual bool NotifyTransactionRemoval(const CTransaction &transaction,
+                                          MemPoolRemovalReason reason,
+                                          uint64_t nMempoolSequence);
+
 protected:
     void *psocket;
     std::string type;
@@ -6,10 +6,13 @@
 #include "zmqpublishnotifier.h"
 
 #include "streams.h"
+#include "txmempool.h"
 #include "util.h"
 #include "validation.h"
 #include "version.h"
 
+#include <boost/bind.hpp>
+
 void zmqError(const char *str) {
     LogPrint(BCLog::ZMQ, "zmq: Error: %s, errno=%s\n", str,
              zmq_strerror(errno));
@@ -39,6 +42,8 @@ CZMQNotificationInterface *CZMQNotificationInterface::Create() {
         CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] =
         CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubsequence"] =
+        CZMQAbstractNotifier::Create<CZMQPublishSequenceNotifier>;
 
     for (std::map<std::string, CZMQNotifierFactory>::const_iterator i =
              factories.begin();
@@ -96,6 +101,11 @@ bool CZMQNotificationInterface::Initialize() {
         return false;
     }
 
+    mempool.NotifyEntryAdded.connect(boost::bind(
+        &CZMQNotificationInterface::MempoolEntryAdded, this, _1, _2));
+    mempool.NotifyEntryRemoved.connect(boost::bind(
+        &CZMQNotificationInterface::MempoolEntryRemoved, this, _1, _2, _3));
+
     return true;
 }
 
@@ -103,6 +113,12 @@ bool CZMQNotificationInterface::Initialize() {
 void CZMQNotificationInterface::Shutdown() {
     LogPrint(BCLog::ZMQ, "zmq: Shutdown notification interface\n");
     if (pcontext) {
+        mempool.NotifyEntryAdded.disconnect(boost::bind(
+            &CZMQNotificationInterface::MempoolEntryAdded, this, _1, _2));
+        mempool.NotifyEntryRemoved.disconnect(
+            boost::bind(&CZMQNotificationInterface::MempoolEntryRemoved, this,
+                        _1, _2, _3));
+
         for (std::list<CZMQAbstractNotifier *>::iterator i = notifiers.begin();
              i != notifiers.end(); ++i) {
             CZMQAbstractNotifier *notifier = *i;
@@ -116,16 +132,16 @@ void CZMQNotificationInterface::Shutdown() {
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew,
-                                                const CBlockIndex *pindexFork,
-                                                bool fInitialDownload) {
-    // In IBD or blocks were disconnected without any new ones
-    if (fInitialDownload || pindexNew == pindexFork) return;
+namespace {
 
+/** Call func on every notifier, shutting down and dropping failed ones */
+template <typename Function>
+void TryForEachAndRemoveFailed(std::list<CZMQAbstractNotifier *> &notifiers,
+                               const Function &func) {
     for (std::list<CZMQAbstractNotifier *>::iterator i = notifiers.begin();
          i != notifiers.end();) {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew)) {
+        if (func(notifier)) {
             i++;
         } else {
             notifier->Shutdown();
@@ -134,32 +150,85 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew,
     }
 }
 
+/** Mempool sequence number that the next mempool change will get */
+uint64_t GetMempoolSequence() {
+    LOCK(mempool.cs);
+    return mempool.GetSequence();
+}
+
+} // namespace
+
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew,
+                                                const CBlockIndex *pindexFork,
+                                                bool fInitialDownload) {
+    // Only the new tip is published, drop any other connected block as well
+    std::shared_ptr<const CBlock> pblock;
+    {
+        std::lock_guard<std::mutex> lock(cs_blockConnected);
+        if (pindexConnected == pindexNew) {
+            pblock = std::move(pblockConnected);
+        }
+        pblockConnected.reset();
+        pindexConnected = nullptr;
+    }
+
+    // In IBD or blocks were disconnected without any new ones
+    if (fInitialDownload || pindexNew == pindexFork) return;
+
+    TryForEachAndRemoveFailed(notifiers, [&](CZMQAbstractNotifier *notifier) {
+        return notifier->NotifyBlock(pindexNew, pblock);
+    });
+}
+
 void CZMQNotificationInterface::TransactionAddedToMempool(
     const CTransactionRef &ptx) {
     // Used by BlockConnected and BlockDisconnected as well, because they're all
     // the same external callback.
     const CTransaction &tx = *ptx;
 
-    for (std::list<CZMQAbstractNotifier *>::iterator i = notifiers.begin();
-         i != notifiers.end();) {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx)) {
-            i++;
-        } else {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
-    }
+    TryForEachAndRemoveFailed(notifiers, [&](CZMQAbstractNotifier *notifier) {
+        return notifier->NotifyTransaction(tx);
+    });
+}
+
+void CZMQNotificationInterface::MempoolEntryAdded(CTransactionRef ptx,
+                                                  uint64_t nMempoolSequence) {
+    TryForEachAndRemoveFailed(notifiers, [&](CZMQAbstractNotifier *notifier) {
+        return notifier->NotifyTransactionAcceptance(*ptx, nMempoolSequence);
+    });
+}
+
+void CZMQNotificationInterface::MempoolEntryRemoved(
+    CTransactionRef ptx, MemPoolRemovalReason reason,
+    uint64_t nMempoolSequence) {
+    TryForEachAndRemoveFailed(notifiers, [&](CZMQAbstractNotifier *notifier) {
+        return notifier->NotifyTransactionRemoval(*ptx, reason,
+                                                  nMempoolSequence);
+    });
 }
 
 void CZMQNotificationInterface::BlockConnected(
     const std::shared_ptr<const CBlock> &pblock,
     const CBlockIndex *pindexConnected,
     const std::vector<CTransactionRef> &vtxConflicted) {
+    {
+        std::lock_guard<std::mutex> lock(cs_blockConnected);
+        this->pblockConnected = pblock;
+        this->pindexConnected = pindexConnected;
+    }
+
     for (const CTransactionRef &ptx : pblock->vtx) {
         // Do a normal notify for each transaction added in the block
         TransactionAddedToMempool(ptx);
     }
+
+    // Blocks are announced after the whole ActivateBestChainStep, so this is
+    // the sequence after the mempool was updated for all of its blocks.
+    const uint256 hash = pindexConnected->GetBlockHash();
+    const uint64_t nMempoolSequence = GetMempoolSequence();
+    TryForEachAndRemoveFailed(notifiers, [&](CZMQAbstractNotifier *notifier) {
+        return notifier->NotifyBlockConnect(hash, nMempoolSequence);
+    });
 }
 
 void CZMQNotificationInterface::BlockDisconnected(
@@ -169,4 +238,10 @@ void CZMQNotificationInterface::BlockDisconnected(
         // disconnection
         TransactionAddedToMempool(ptx);
     }
+
+    const uint256 hash = pblock->GetHash();
+    const uint64_t nMempoolSequence = GetMempoolSequence();
+    TryForEachAndRemoveFailed(notifiers, [&](CZMQAbstractNotifier *notifier) {
+        return notifier->NotifyBlockDisconnect(hash, nMempoolSequence);
+    });
 }
@@ -9,9 +9,12 @@
 
 #include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
+enum class MemPoolRemovalReason;
 
 class CZMQNotificationInterface final : public CValidationInterface {
 public:
@@ -38,8 +41,22 @@ protected:
 private:
     CZMQNotificationInterface();
 
+    // Connected to the mempool signals for the sequence notifications
+    void MempoolEntryAdded(CTransactionRef ptx, uint64_t nMempoolSequence);
+    void MempoolEntryRemoved(CTransactionRef ptx, MemPoolRemovalReason reason,
+                             uint64_t nMempoolSequence);
+
     void *pcontext;
     std::list<CZMQAbstractNotifier *> notifiers;
+
+    /**
+     * Last block seen by BlockConnected, kept until the following
+     * UpdatedBlockTip so that it can be published without reading it back
+     * from disk.
+     */
+    std::mutex cs_blockConnected;
+    std::shared_ptr<const CBlock> pblockConnected;
+    const CBlockIndex *pindexConnected = nullptr;
 };
 
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
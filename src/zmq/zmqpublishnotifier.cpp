@@ -6,10 +6,11 @@
 #include "config.h"
 #include "rpc/server.h"
 #include "streams.h"
+#include "txmempool.h"
 #include "util.h"
 #include "validation.h"
 
-#include <cstdarg>
+#include <cstring>
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier *>
     mapPublishNotifiers;
@@ -18,40 +19,56 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX = "hashtx";
 static const char *MSG_RAWBLOCK = "rawblock";
 static const char *MSG_RAWTX = "rawtx";
+static const char *MSG_SEQUENCE = "sequence";
 
-// Internal function to send multipart message
-static int zmq_send_multipart(void *sock, const void *data, size_t size, ...) {
-    va_list args;
-    va_start(args, size);
-
-    while (1) {
-        zmq_msg_t msg;
-
-        int rc = zmq_msg_init_size(&msg, size);
-        if (rc != 0) {
-            zmqError("Unable to initialize ZMQ msg");
-            return -1;
-        }
-
-        void *buf = zmq_msg_data(&msg);
-        memcpy(buf, data, size);
-
-        data = va_arg(args, const void *);
-
-        rc = zmq_msg_send(&msg, sock, data ? ZMQ_SNDMORE : 0);
-        if (rc == -1) {
-            zmqError("Unable to send ZMQ msg");
-            zmq_msg_close(&msg);
-            return -1;
-        }
+// Internal function to send one part of a multipart message, consuming msg
+static bool zmq_send_part(void *sock, zmq_msg_t &msg, bool fMore) {
+    int rc = zmq_msg_send(&msg, sock, fMore ? ZMQ_SNDMORE : 0);
+    if (rc == -1) {
+        zmqError("Unable to send ZMQ msg");
+    }
+    zmq_msg_close(&msg);
+    return rc != -1;
+}
 
-        zmq_msg_close(&msg);
+// Internal function to initialize a message holding a copy of data
+static bool zmq_init_copy(zmq_msg_t &msg, const void *data, size_t size) {
+    int rc = zmq_msg_init_size(&msg, size);
+    if (rc != 0) {
+        zmqError("Unable to initialize ZMQ msg");
+        return false;
+    }
+    memcpy(zmq_msg_data(&msg), data, size);
+    return true;
+}
 
-        if (!data) break;
+// Called by ZMQ, possibly from its I/O thread, once it is done with the data
+// of a zero-copy message
+static void zmq_free_vector(void * /* data */, void *hint) {
+    delete static_cast<std::vector<uint8_t> *>(hint);
+}
 
-        size = va_arg(args, size_t);
+// Internal function to send multipart message: command, data and sequence
+// number. Consumes data.
+static bool zmq_send_multipart(void *sock, const char *command,
+                               zmq_msg_t &data, uint32_t nSequence) {
+    zmq_msg_t msg;
+    if (!zmq_init_copy(msg, command, strlen(command))) {
+        zmq_msg_close(&data);
+        return false;
     }
-    return 0;
+    if (!zmq_send_part(sock, msg, true)) {
+        zmq_msg_close(&data);
+        return false;
+    }
+    if (!zmq_send_part(sock, data, true)) {
+        return false;
+    }
+
+    uint8_t msgseq[sizeof(uint32_t)];
+    WriteLE32(&msgseq[0], nSequence);
+    return zmq_init_copy(msg, msgseq, sizeof(msgseq)) &&
+           zmq_send_part(sock, msg, false);
 }
 
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext) {
@@ -122,11 +139,11 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command,
     assert(psocket);
 
     /* send three parts, command & data & a LE 4byte sequence number */
-    uint8_t msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size,
-                                msgseq, (size_t)sizeof(uint32_t), (void *)0);
-    if (rc == -1) return false;
+    zmq_msg_t msg;
+    if (!zmq_init_copy(msg, data, size) ||
+        !zmq_send_multipart(psocket, command, msg, nSequence)) {
+        return false;
+    }
 
     /* increment memory only sequence number after sending */
     nSequence++;
@@ -134,7 +151,31 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command,
     return true;
 }
 
-bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex) {
+bool CZMQAbstractPublishNotifier::SendMessage(
+    const char *command, std::unique_ptr<std::vector<uint8_t>> data) {
+    assert(psocket);
+
+    /* ZMQ owns the data from here on and frees it once it has been sent */
+    zmq_msg_t msg;
+    int rc = zmq_msg_init_data(&msg, data->data(), data->size(),
+                               zmq_free_vector, data.get());
+    if (rc != 0) {
+        zmqError("Unable to initialize ZMQ msg");
+        return false;
+    }
+    data.release();
+
+    if (!zmq_send_multipart(psocket, command, msg, nSequence)) {
+        return false;
+    }
+
+    nSequence++;
+
+    return true;
+}
+
+bool CZMQPublishHashBlockNotifier::NotifyBlock(
+    const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock) {
     uint256 hash = pindex->GetBlockHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish hashblock %s\n", hash.GetHex());
     char data[32];
@@ -153,31 +194,96 @@ bool CZMQPublishHashTransactionNotifier::NotifyTransaction(
     return SendMessage(MSG_HASHTX, data, 32);
 }
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex) {
+/** Serialize obj into a buffer that can be handed to ZMQ without copying */
+template <typename T>
+static std::unique_ptr<std::vector<uint8_t>> SerializeForZMQ(const T &obj) {
+    const int nVersion = PROTOCOL_VERSION | RPCSerializationFlags();
+    std::unique_ptr<std::vector<uint8_t>> data(new std::vector<uint8_t>());
+    data->reserve(GetSerializeSize(obj, SER_NETWORK, nVersion));
+    CVectorWriter(SER_NETWORK, nVersion, *data, 0, obj);
+    return data;
+}
+
+bool CZMQPublishRawBlockNotifier::NotifyBlock(
+    const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &pblock) {
     LogPrint(BCLog::ZMQ, "zmq: Publish rawblock %s\n",
              pindex->GetBlockHash().GetHex());
 
+    if (pblock) {
+        return SendMessage(MSG_RAWBLOCK, SerializeForZMQ(*pblock));
+    }
+
+    // The block is no longer in memory, e.g. when the tip was reached through
+    // a reorganization spanning several calls to ActivateBestChain.
     const Config &config = GetConfig();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    CBlock block;
     {
         LOCK(cs_main);
-        CBlock block;
         if (!ReadBlockFromDisk(block, pindex, config)) {
             zmqError("Can't read block from disk");
             return false;
         }
-
-        ss << block;
     }
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWBLOCK, SerializeForZMQ(block));
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(
     const CTransaction &transaction) {
     uint256 txid = transaction.GetId();
     LogPrint(BCLog::ZMQ, "zmq: Publish rawtx %s\n", txid.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ss << transaction;
-    return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWTX, SerializeForZMQ(transaction));
+}
+
+/**
+ * Body of a sequence message: the 32 byte hash as in hashblock and hashtx, a
+ * one character label, the 8 byte LE mempool sequence number and, for
+ * removals, one byte holding the MemPoolRemovalReason.
+ */
+static bool SendSequenceMsg(CZMQAbstractPublishNotifier &notifier,
+                            const uint256 &hash, char label,
+                            uint64_t nMempoolSequence, int nReason = -1) {
+    uint8_t data[sizeof(uint256) + 1 + sizeof(uint64_t) + 1];
+    for (unsigned int i = 0; i < 32; i++) {
+        data[31 - i] = hash.begin()[i];
+    }
+    data[32] = label;
+    WriteLE64(&data[33], nMempoolSequence);
+    size_t size = sizeof(data) - 1;
+    if (nReason >= 0) {
+        data[size++] = nReason;
+    }
+    return notifier.SendMessage(MSG_SEQUENCE, data, size);
+}
+
+bool CZMQPublishSequenceNotifier::NotifyBlockConnect(
+    const uint256 &blockhash, uint64_t nMempoolSequence) {
+    LogPrint(BCLog::ZMQ, "zmq: Publish sequence block connect %s\n",
+             blockhash.GetHex());
+    return SendSequenceMsg(*this, blockhash, 'C', nMempoolSequence);
+}
+
+bool CZMQPublishSequenceNotifier::NotifyBlockDisconnect(
+    const uint256 &blockhash, uint64_t nMempoolSequence) {
+    LogPrint(BCLog::ZMQ, "zmq: Publish sequence block disconnect %s\n",
+             blockhash.GetHex());
+    return SendSequenceMsg(*this, blockhash, 'D', nMempoolSequence);
+}
+
+bool CZMQPublishSequenceNotifier::NotifyTransactionAcceptance(
+    const CTransaction &transaction, uint64_t nMempoolSequence) {
+    uint256 txid = transaction.GetId();
+    LogPrint(BCLog::ZMQ, "zmq: Publish sequence mempool acceptance %s\n",
+             txid.GetHex());
+    return SendSequenceMsg(*this, txid, 'A', nMempoolSequence);
+}
+
+bool CZMQPublishSequenceNotifier::NotifyTransactionRemoval(
+    const CTransaction &transaction, MemPoolRemovalReason reason,
+    uint64_t nMempoolSequence) {
+    uint256 txid = transaction.GetId();
+    LogPrint(BCLog::ZMQ, "zmq: Publish sequence mempool removal %s\n",
+             txid.GetHex());
+    return SendSequenceMsg(*this, txid, 'R', nMempoolSequence,
+                           static_cast<int>(reason));
 }
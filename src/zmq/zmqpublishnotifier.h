@@ -7,6 +7,10 @@
 
 #include "zmqabstractnotifier.h"
 
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 class CBlockIndex;
 
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier {
@@ -22,6 +26,9 @@ public:
           * message sequence number
     */
     bool SendMessage(const char *command, const void *data, size_t size);
+    /* same, but hands the data to ZMQ without copying it */
+    bool SendMessage(const char *command,
+                     std::unique_ptr<std::vector<uint8_t>> data);
 
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
@@ -29,7 +36,8 @@ public:
 
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex,
+                     const std::shared_ptr<const CBlock> &pblock) override;
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier {
@@ -39,7 +47,8 @@ public:
 
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex,
+                     const std::shared_ptr<const CBlock> &pblock) override;
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier {
@@ -47,4 +56,17 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+class CZMQPublishSequenceNotifier : public CZMQAbstractPublishNotifier {
+public:
+    bool NotifyBlockConnect(const uint256 &blockhash,
+                            uint64_t nMempoolSequence) override;
+    bool NotifyBlockDisconnect(const uint256 &blockhash,
+                               uint64_t nMempoolSequence) override;
+    bool NotifyTransactionAcceptance(const CTransaction &transaction,
+                                     uint64_t nMempoolSequence) override;
+    bool NotifyTransactionRemoval(const CTransaction &transaction,
+                                  MemPoolRemovalReason reason,
+                                  uint64_t nMempoolSequence) override;
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
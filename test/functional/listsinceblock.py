@@ -74,6 +74,18 @@ class ListSinceBlockTest (BitcoinTestFramework):
                 break
         assert_equal(found, True)
 
+        # Paging with count and a cursor goes through the same transactions.
+        all_txs = self.nodes[0].listsinceblock()['transactions']
+        txs = []
+        cursor = None
+        while True:
+            res = self.nodes[0].listsinceblock("", 1, False, 1, cursor)
+            txs += res['transactions']
+            if 'cursor' not in res:
+                break
+            cursor = res['cursor']
+        assert_equal(txs, all_txs)
+
 
 if __name__ == '__main__':
     ListSinceBlockTest().main()
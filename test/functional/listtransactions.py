@@ -97,6 +97,28 @@ class ListTransactionsTest(BitcoinTestFramework):
             {"category": "receive", "amount": Decimal("0.1")},
             {"txid": txid, "account": "watchonly"})
 
+        # Paging with a cursor goes through the same transactions, newest
+        # pages first.
+        all_txs = self.nodes[0].listtransactions("*", 1000)
+        pages = []
+        cursor = -1
+        while True:
+            page = self.nodes[0].listtransactions("*", 2, 0, False, cursor)
+            pages.insert(0, page["transactions"])
+            if "cursor" not in page:
+                break
+            cursor = page["cursor"]
+        assert_equal([tx for page in pages for tx in page], all_txs)
+        assert_raises_rpc_error(-8, "Cannot combine skip with cursor",
+                                self.nodes[0].listtransactions, "*", 2, 1, False, -1)
+        assert_raises_rpc_error(-8, "Count must be positive with cursor",
+                                self.nodes[0].listtransactions, "*", 0, 0, False, -1)
+
+        # Skipping gives the same entries as slicing the full list.
+        for skip in range(len(all_txs) + 1):
+            assert_equal(self.nodes[0].listtransactions("*", 3, skip),
+                         all_txs[max(0, len(all_txs) - skip - 3):len(all_txs) - skip])
+
 
 if __name__ == '__main__':
     ListTransactionsTest().main()
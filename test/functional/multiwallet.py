@@ -95,6 +95,29 @@ class MultiWalletTest(BitcoinTestFramework):
         assert_equal(batch[0]["result"]["chain"], "regtest")
         assert_equal(batch[1]["result"]["walletname"], "w1")
 
+        # A wallet that was not loaded catches up with the blocks it missed
+        # when the wallets are read again.
+        w2_address = w2.getnewaddress()
+        self.stop_node(0)
+        self.start_node(0, ['-wallet=w1'])
+        w1 = self.nodes[0].get_wallet_rpc("w1")
+        w1.sendtoaddress(w2_address, 4)
+        w1.generate(1)
+        self.stop_node(0)
+        self.start_node(0, self.extra_args[0])
+        w2 = self.nodes[0].get_wallet_rpc("w2")
+        w3 = self.nodes[0].get_wallet_rpc("w3")
+        w4 = self.nodes[0].get_wallet_rpc("w")
+        assert_equal(w2.getbalance(), 5)
+        assert_equal(w3.getbalance(), 2)
+        assert_equal(w4.getbalance(), 3)
+
+        # An error in any of the wallets fails init, with the ones loaded
+        # before it.
+        self.stop_node(0)
+        self.assert_start_raises_init_error(
+            0, ['-wallet=w5', '-wallet=w1', '-usehd=0'], "Error loading w1: You can't disable HD on a already existing HD wallet")
+
 
 if __name__ == '__main__':
     MultiWalletTest().main()
@@ -379,6 +379,61 @@ class RESTTest (BitcoinTestFramework):
         for tx in txs:
             assert_equal(tx in json_obj['tx'], True)
 
+        # get contiguous ranges of headers, blocks and undo data by height
+        height = self.nodes[0].getblockcount()
+        response = http_get_call(
+            url.hostname, url.port, '/rest/headerrange/0/' + str(height + 1) + self.FORMAT_SEPARATOR + 'bin', True)
+        assert_equal(response.status, 200)
+        headers = response.read()
+        assert_equal(len(headers), 80 * (height + 1))
+        assert_equal(bytes_to_hex_str(headers[-80:]), self.nodes[0].getblockheader(
+            newblockhash[0], False))
+
+        # ranges past the tip are cut short and tell what was sent
+        response = http_get_call(
+            url.hostname, url.port, '/rest/blockrange/' + str(height - 1) + '/5' + self.FORMAT_SEPARATOR + 'bin', True)
+        assert_equal(response.status, 206)
+        assert_equal(response.getheader('content-range'),
+                     'height %d-%d/%d' % (height - 1, height, height + 1))
+        data = response.read()
+        blocks = []
+        while data:
+            size = unpack(b"<I", data[4:8])[0]
+            blocks.append(bytes_to_hex_str(data[8:8 + size]))
+            data = data[8 + size:]
+        assert_equal(blocks, [self.nodes[0].getblock(self.nodes[0].getblockhash(h), False)
+                              for h in (height - 1, height)])
+
+        # the same range through a Range header
+        conn = http.client.HTTPConnection(url.hostname, url.port)
+        conn.request('GET', '/rest/blockrange' + self.FORMAT_SEPARATOR + 'bin',
+                     headers={'Range': 'height=%d-' % (height - 1)})
+        response = conn.getresponse()
+        assert_equal(response.status, 206)
+        assert_equal(response.getheader('content-range'),
+                     'height %d-%d/%d' % (height - 1, height, height + 1))
+
+        # the undo data of the last block holds the coins its txs spent
+        response = http_get_call(
+            url.hostname, url.port, '/rest/undorange/' + str(height) + '/1' + self.FORMAT_SEPARATOR + 'bin', True)
+        assert_equal(response.status, 200)
+        data = response.read()
+        assert_equal(unpack(b"<I", data[4:8])[0], len(data) - 8)
+        assert_equal(data[8], 3)
+
+        response = http_get_call(
+            url.hostname, url.port, '/rest/blockrange/' + str(height + 1) + '/1' + self.FORMAT_SEPARATOR + 'bin', True)
+        assert_equal(response.status, 416)
+
+        # ranges over the per-request limit of 1000 blocks are cut short too
+        self.nodes[0].generate(1001 - self.nodes[0].getblockcount())
+        response = http_get_call(
+            url.hostname, url.port, '/rest/blockrange/0/5000' + self.FORMAT_SEPARATOR + 'bin', True)
+        assert_equal(response.status, 206)
+        assert_equal(response.getheader('content-range'),
+                     'height 0-999/1002')
+        response.read()
+
         # test rest bestblock
         bb_hash = self.nodes[0].getbestblockhash()
 
@@ -43,6 +43,7 @@ class WalletTest(BitcoinTestFramework):
         walletinfo = self.nodes[0].getwalletinfo()
         assert_equal(walletinfo['immature_balance'], 50)
         assert_equal(walletinfo['balance'], 0)
+        assert_equal(walletinfo['scanning'], False)
 
         self.sync_all([self.nodes[0:3]])
         self.nodes[1].generate(101)
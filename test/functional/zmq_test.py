@@ -9,6 +9,7 @@ import struct
 
 from test_framework.test_framework import BitcoinTestFramework, SkipTest
 from test_framework.util import (assert_equal,
+                                 assert_raises_rpc_error,
                                  bytes_to_hex_str,
                                  hash256,
                                  )
@@ -44,8 +45,16 @@ class ZMQTest (BitcoinTestFramework):
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"rawtx")
         ip_address = "tcp://127.0.0.1:28332"
         self.zmqSubSocket.connect(ip_address)
+        # The sequence topic gets its own socket so that it does not interleave
+        # with the messages checked above
+        self.zmqSeqSocket = self.zmqContext.socket(zmq.SUB)
+        self.zmqSeqSocket.set(zmq.RCVTIMEO, 60000)
+        self.zmqSeqSocket.setsockopt(zmq.SUBSCRIBE, b"sequence")
+        seq_address = "tcp://127.0.0.1:28333"
+        self.zmqSeqSocket.connect(seq_address)
         self.extra_args = [['-zmqpubhashblock=%s' % ip_address, '-zmqpubhashtx=%s' % ip_address,
-                            '-zmqpubrawblock=%s' % ip_address, '-zmqpubrawtx=%s' % ip_address], []]
+                            '-zmqpubrawblock=%s' % ip_address, '-zmqpubrawtx=%s' % ip_address,
+                            '-zmqpubsequence=%s' % seq_address], []]
         self.add_nodes(self.num_nodes, self.extra_args)
         self.start_nodes()
 
@@ -57,8 +66,17 @@ class ZMQTest (BitcoinTestFramework):
             self.log.debug("Destroying zmq context")
             self.zmqContext.destroy(linger=None)
 
+    def recv_sequence(self):
+        msg = self.zmqSeqSocket.recv_multipart()
+        assert_equal(msg[0], b"sequence")
+        body = msg[1]
+        mempool_sequence = struct.unpack('<Q', body[33:41])[-1]
+        return (bytes_to_hex_str(body[:32]), chr(body[32]), mempool_sequence,
+                body[41:])
+
     def _zmq_test(self):
         genhashes = self.nodes[0].generate(1)
+        allhashes = list(genhashes)
         self.sync_all()
 
         self.log.info("Wait for tx")
@@ -106,6 +124,7 @@ class ZMQTest (BitcoinTestFramework):
         n = 10
         genhashes = self.nodes[1].generate(n)
         self.sync_all()
+        allhashes += genhashes
 
         zmqHashes = []
         zmqRawHashed = []
@@ -155,6 +174,31 @@ class ZMQTest (BitcoinTestFramework):
         assert_equal(hashRPC, hashZMQ)
         assert_equal(hashRPC, hashedZMQ)
 
+        self.log.info("Check the mempool sequence stream")
+        # Blocks are reported with the mempool sequence, which has not moved
+        # while the mempool was empty
+        for blockhash in allhashes:
+            assert_equal(self.recv_sequence(), (blockhash, 'C', 1, b""))
+        assert_equal(self.recv_sequence(), (hashRPC, 'A', 1, b""))
+        assert_equal(self.nodes[0].getrawmempool(False, True),
+                     {"txids": [hashRPC], "mempool_sequence": 2})
+        assert_raises_rpc_error(-8, "Verbose results cannot contain mempool sequence values",
+                                self.nodes[0].getrawmempool, True, True)
+
+        # Mining the transaction removes it for the block (reason 4)
+        blockhash = self.nodes[0].generate(1)[0]
+        assert_equal(self.recv_sequence(), (hashRPC, 'R', 2, b"\x04"))
+        assert_equal(self.recv_sequence(), (blockhash, 'C', 3, b""))
+
+        # A reorg disconnects the block and puts the transaction back
+        self.nodes[0].invalidateblock(blockhash)
+        assert_equal(self.recv_sequence(), (blockhash, 'D', 3, b""))
+        assert_equal(self.recv_sequence(), (hashRPC, 'A', 3, b""))
+        assert_equal(self.nodes[0].getrawmempool(False, True),
+                     {"txids": [hashRPC], "mempool_sequence": 4})
+        assert_equal(self.nodes[0].getrawmempool(mempool_sequence=True),
+                     {"txids": [hashRPC], "mempool_sequence": 4})
+
 
 if __name__ == '__main__':
     ZMQTest().main()